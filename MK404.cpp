@@ -21,8 +21,12 @@
  */
 
 #include "Config.h"
+#if ENABLE_CB_PROFILE
+#include "CallbackProfiler.h"
+#endif
 #include "EnabledType.h"
 #include "FatImage.h"                 // for FatImage
+#include "InputRecorder.h"
 #include "KeyController.h"
 #include "Macros.h"
 #include "PrintVisualType.h"
@@ -207,6 +211,11 @@ void displayCB()		/* function called whenever redisplay needed */
 // pragma: LCOV_EXCL_START
 void MouseCB(int button, int action, int x, int y)	/* called on key press */
 {
+	if (InputRecorder::GetRecorder().IsActive())
+	{
+		InputRecorder::GetRecorder().QueueMouse(button, action);
+		return;
+	}
 	printer->OnMousePress(button,action,x,y);
 }
 
@@ -324,10 +333,20 @@ int main(int argc, char *argv[])
 	SwitchArg argWait("w","wait","Wait after the printer (and any PTYs) are set up but before starting execution.", cmd);
 	MultiSwitchArg argSpam("v","verbose","Increases verbosity of the output, where supported.",cmd);
 	ValueArg<int> argVCDRate("","tracerate", "Sets the logging frequency of the VCD trace (default 100uS)",false, 100,"integer",cmd);
+	ValueArg<string> argTelSocket("","telemetry-socket","Streams telemetry to subscribers on the given Unix socket. Connect and send 'list' or 'sub <name>'.",false,"","file",cmd);
+	SwitchArg argISRStats("","isr-stats","Tracks per-vector interrupt latency, handler duration, nesting and lost interrupts. Prints a summary on exit; the live signals are in the Interrupt trace category.",cmd);
+	ValueArg<unsigned int> argPosRate("","pos-rate","Rate (Hz of simulated time) at which stepper positions are sent to the 3D visuals. Logic such as PINDA and endstops always sees every step. 0 updates visuals on every step.",false,100,"Hz",cmd);
+	ValueArg<float> argHotendLag("","hotend-lag","Models the hotend thermistor lagging the heater block with the given time constant. 0 (the default) reads the block directly.",false,0,"seconds",cmd);
+	ValueArg<unsigned int> argProfile("","profile-fw","Samples the firmware PC and call stack every N cycles. Writes <board>_profile.folded (collapsed stacks for flame graphs) and a per-function report on exit. ELF firmware is needed for symbol names.",false,0,"cycles",cmd);
+	MultiArg<string> argStats("","stats","Keeps online statistics (counts, min/max/mean, rates, interval histograms) for the specified categories or IRQs and writes them as JSON on exit. Takes the same names as --trace.",false,"string",cmd);
 	MultiArg<string> argVCD("t","trace","Enables VCD traces for the specified categories or IRQs. use '-t ?' to get a printout of available traces",false,"string",cmd);
 	SwitchArg argTerm("","terminal","Enable an in-UI terminal for interactive scripting (--EXPERIMENTAL!!--)", cmd);
 	SwitchArg argTest("","test","Run it test mode (don't auto-exit due to lack of GL event loop and waiting for the window to close)", cmd);
+	ValueArg<string> argRecord("","record","Logs every external input (keys, mouse, menus, terminal lines, PTY bytes) with the AVR cycle it was delivered on.",false,"","file",cmd);
+	ValueArg<string> argReplay("","replay","Replays an input log from --record at the recorded cycles and ignores live input. Runs without wall-clock pacing; use the same printer, firmware and options as the recording.",false,"","file",cmd);
+	SwitchArg argFastFwd("","fast-forward","Don't spend time on firmware idling: AVR sleep and _delay_*/delayMicroseconds busy loops jump straight to the next timer event. Not for real-time use.", cmd);
 	SwitchArg argSkew("","skew-correct","Attempt to correct for fast clock skew of the simulated board", cmd);
+	SwitchArg argShaderRender("","shader-render","Draws the printer meshes in the 3D view with a shader and vertex array objects (needs OpenGL 3.1) instead of fixed-function calls.", cmd);
 	SwitchArg argSerial("s","serial","Connect a printer's serial port to a PTY instead of printing its output to the console.", cmd);
 	ValueArg<string> argSD("","sdimage","Use the given SD card .img file instead of the default", false ,"", "file:img|bin", cmd);
 	SwitchArg argScriptHelp("","scripthelp", "Prints the available scripting commands for the current printer/context",cmd, false);
@@ -342,10 +361,20 @@ int main(int argc, char *argv[])
 	SwitchArg argLegacyModel("","legacythermal","Use the legacy thermal model for the nozzle heater.", cmd);
 	ValueArg<uint8_t> argLCDSCheme("","lcd-scheme", "Sets the default LCD colour scheme index, 0, 1, or 2",false, 0,"0|1|2",cmd);
 	SwitchArg argKlipper("","klipper","Synonym for --skew-correct and --no-hacks",cmd,false);
+	std::vector<string> vstrMMU {"full","fast"};
+	ValuesConstraint<string> vcMMU(vstrMMU);
+	ValueArg<string> argMMU("","mmu","Selects the MMU2 for printers that have one: full runs MM-control-01 firmware on a second board, fast is a behavioural model of its serial protocol and mechanics that runs at close to single-board speed.",false,"full",&vcMMU,cmd);
+	std::vector<string> vstrCore {"stock","predecoded"};
+	ValuesConstraint<string> vcCore(vstrCore);
+	ValueArg<string> argCore("","core","Selects the AVR instruction engine: stock is simavr's interpreter, predecoded decodes the firmware once and runs most instructions straight from the decoded table. Peripherals, timers and interrupts behave the same with either.",false,"stock",&vcCore,cmd);
 	SwitchArg argKeyHelp("k","keys","Prints the list of available keyboard controls",cmd,false);
 	std::vector<string> vstrSizes = FatImage::GetSizes();
 	ValuesConstraint<string> vcSizes(vstrSizes);
 	ValueArg<string> argImgSize("","image-size","Specify a size for a new SD image. You must specify an image with --sdimage",false,"256M",&vcSizes,cmd);
+	std::vector<string> vstrOverlay {"discard","commit"};
+	ValuesConstraint<string> vcOverlay(vstrOverlay);
+	ValueArg<string> argSDOverlay("","sd-overlay","Mounts the SD image copy-on-write so several instances can share it. Changes are discarded or committed back to the image at unmount.",false,"discard",&vcOverlay,cmd);
+	MultiArg<string> argSDAdd("","sd-add","Copies the given host file into the root directory of the --sdimage image (after creating it, if --image-size is also given).",false,"file",cmd);
 	SwitchArg argGDB("","gdb","Enable SimAVR's GDB support",cmd);
 	SwitchArg argGDB2("","gdb2","Enable SimAVR's GDB support on the MMU/secondary board",cmd);
 	std::vector<string> vstrGfx = {"none","lite","fancy", "bear"};
@@ -425,10 +454,29 @@ int main(int argc, char *argv[])
 			std::cerr << "Cannot create an SD image without a filename." << '\n';
 			exit(1);
 		}
-		if (FatImage::MakeFatImage(argSD.getValue(), argImgSize.getValue()))
+		if (!FatImage::MakeFatImage(argSD.getValue(), argImgSize.getValue()))
+		{
+			return 1;
+		}
+		std::cout << "Wrote " << argSD.getValue() << ". You can now use --sd-add to copy gcode files into the image." << '\n';
+	}
+	if (argSDAdd.isSet())
+	{
+		if(!argSD.isSet())
+		{
+			std::cerr << "Cannot add files to an SD image without a filename." << '\n';
+			exit(1);
+		}
+		for (auto &strFile : argSDAdd.getValue())
 		{
-			std::cout << "Wrote " << argSD.getValue() << ". You can now use mcopy to copy gcode files into the image." << '\n';
+			if (!FatImage::AddFile(argSD.getValue(), strFile))
+			{
+				return 1;
+			}
 		}
+	}
+	if (argImgSize.isSet())
+	{
 		return 0;
 	}
 	bool bNoGraphics = argGfx.isSet() && (argGfx.getValue()=="none");
@@ -443,11 +491,38 @@ int main(int argc, char *argv[])
 	Config::Get().SetColourE(argColourE.isSet());
 	Config::Get().SetFW2(argFW2.getValue());
 	Config::Get().SetGDB2(argGDB2.isSet());
+	Config::Get().SetTelemetrySocket(argTelSocket.getValue());
+	Config::Get().SetProfileRate(argProfile.getValue());
+	Config::Get().SetISRStats(argISRStats.isSet());
+	Config::Get().SetPosPublishRate(argPosRate.getValue());
+	Config::Get().SetHotendLag(argHotendLag.getValue());
+	Config::Get().SetFastForward(argFastFwd.isSet());
+	Config::Get().SetShaderRender(argShaderRender.isSet());
+	Config::Get().SetMMUFast(argMMU.getValue() == "fast");
+	Config::Get().SetPredecode(argCore.getValue() == "predecoded");
+	Config::Get().SetSDOverlay(argSDOverlay.isSet());
+	Config::Get().SetSDOverlayCommit(argSDOverlay.getValue() == "commit");
 
 	TelemetryHost::GetHost().SetCategories(argVCD.getValue());
+	TelemetryHost::GetHost().SetStatCategories(argStats.getValue());
+
+	if (argRecord.isSet() && argReplay.isSet())
+	{
+		std::cerr << "--record and --replay cannot be used together." << '\n';
+		exit(1);
+	}
+	if ((argRecord.isSet() && !InputRecorder::GetRecorder().Record(argRecord.getValue())) ||
+		(argReplay.isSet() && !InputRecorder::GetRecorder().Replay(argReplay.getValue())))
+	{
+		exit(1);
+	}
 
 	ScriptHost::Init();
 
+#if ENABLE_CB_PROFILE
+	CallbackProfiler::GetProfiler(); // Registers its script actions before the script is validated.
+#endif
+
 	std::string strFW;
 	if (!argLoad.isSet() && !argFW.isSet())
 	{
@@ -492,6 +567,9 @@ int main(int argc, char *argv[])
 
 	pBoard->SetPrimary(true); // This is the primary board, responsible for scripting/dispatch. Blocks contention from sub-boards, e.g. MMU.
 
+	// Mouse input reaches the printer on the AVR thread while recording/replaying.
+	InputRecorder::GetRecorder().SetMouseHandler([](int iButton, int iAction) { printer->OnMousePress(iButton, iAction, 0, 0); });
+
 	pBoard->SetAdjustSkew(bArgSkew);
 
 	if (!bNoGraphics)
@@ -618,6 +696,13 @@ int main(int argc, char *argv[])
 	}
 	pBoard->WaitForFinish();
 
+	TelemetryHost::GetHost().StopStream();
+	TelemetryHost::GetHost().WriteStats();
+
+#if ENABLE_CB_PROFILE
+	CallbackProfiler::GetProfiler().PrintReport(std::cout);
+#endif
+
 	PrinterFactory::DestroyPrinterByName(argModel.getValue(), pRawPrinter);
 
 	std::cout << "Done" << '\n';
@@ -23,7 +23,10 @@
 
 #include "gsl-lite.hpp"
 #include "sim_avr.h"
+#include "sim_cycle_timers.h"  // for avr_cycle_timer_register, avr_cycle_timer_cancel
+#include "sim_io.h"            // for avr_io_t, avr_register_io
 #include "sim_irq.h"
+#include "sim_time.h"          // for avr_usec_to_cycles
 #include <algorithm>         // for copy
 #include <array>
 #include <iostream>
@@ -33,6 +36,22 @@
 // Use lambdas to expose something that can be called from C, but returns to our C++ object
 // TODO(anyone): find a way to ditch the macro. I tried and failed, see the template blocks below...
 
+#if ENABLE_CB_PROFILE
+// Instrumented variants that account host time per (peripheral, callback), see CallbackProfiler.
+#include "CallbackProfiler.h"
+
+#define MAKE_C_CALLBACK(class, function) \
+   [](struct avr_irq_t *irq, uint32_t value, void* param) {auto *p = static_cast<class*>(param); \
+		static thread_local CallbackProfiler::SiteCache _site {}; \
+		CallbackProfiler::Scope _scope(_site.Get(#class "::" #function, p)); \
+		p->function(irq,value); }
+
+#define MAKE_C_TIMER_CALLBACK(class, function) \
+   [](avr_t * avr, avr_cycle_count_t when, void* param) {auto *p = static_cast<class*>(param); \
+		static thread_local CallbackProfiler::SiteCache _site {}; \
+		CallbackProfiler::Scope _scope(_site.Get(#class "::" #function, p)); \
+		return p->function(avr,when); }
+#else
 // Generates a lambda function inline that can be called from SimAVR's C IRQ code.
 #define MAKE_C_CALLBACK(class, function) \
    [](struct avr_irq_t *irq, uint32_t value, void* param) {auto *p = static_cast<class*>(param); p->function(irq,value); }
@@ -40,7 +59,166 @@
 // Generates an inline lambda for use with aver_cycle_timer
 #define MAKE_C_TIMER_CALLBACK(class, function) \
    [](avr_t * avr, avr_cycle_count_t when, void* param) {auto *p = static_cast<class*>(param); return p->function(avr,when); }
+#endif
+
+// Generates an inline lambda for use with ResetHook
+#define MAKE_C_RESET_CALLBACK(class, function) \
+   [](void* param) {auto *p = static_cast<class*>(param); p->function(); }
+
+// Calls back from avr_reset(), after simavr has flushed its cycle timers, so a part can drop
+// any "timer pending" state and re-arm what it still needs. It hooks in the same way simavr's
+// own peripherals do, as an avr_io_t with only a reset handler.
+class ResetHook
+{
+	public:
+		using Callback = void (*)(void *pParam);
+
+		ResetHook(Callback fcnReset, void *pParam):m_fcnReset(fcnReset),m_pParam(pParam)
+		{
+			m_io.kind = "reset_hook";
+			m_io.reset = OnReset;
+			m_io.dealloc = OnDealloc;
+		};
+
+		~ResetHook() { Detach(); }
+
+		ResetHook(const ResetHook&) = delete;
+		ResetHook& operator=(const ResetHook&) = delete;
+
+		// Starts listening for resets of avr. Does nothing if already attached to it.
+		inline void Attach(avr_t *avr)
+		{
+			if (m_io.avr == avr)
+			{
+				return;
+			}
+			Detach();
+			avr_register_io(avr, &m_io);
+			m_io.avr = avr;
+		}
+
+		inline void Detach()
+		{
+			if (m_io.avr == nullptr)
+			{
+				return;
+			}
+			for (avr_io_t **ppIO = &m_io.avr->io_port; *ppIO != nullptr; ppIO = &(*ppIO)->next)
+			{
+				if (*ppIO == &m_io)
+				{
+					*ppIO = m_io.next;
+					break;
+				}
+			}
+			m_io.avr = nullptr;
+		}
+
+	private:
+		static void OnReset(avr_io_t *pIO)
+		{
+			auto *p = reinterpret_cast<ResetHook*>(pIO); //NOLINT - io is the first member
+			p->m_fcnReset(p->m_pParam);
+		}
+
+		// avr_terminate() drops the whole list, so there is nothing left to unlink from.
+		static void OnDealloc(avr_io_t *pIO) { pIO->avr = nullptr; }
+
+		avr_io_t m_io {}; // Must stay first, see OnReset.
+		Callback m_fcnReset;
+		void *m_pParam;
+};
+
+// Timeout for deadlines that get pushed back far more often than they expire,
+// e.g. a standstill timeout restarted on every step pulse. Set() only stamps the new
+// deadline; the simavr timer stays armed and, if it fires early, re-arms itself for
+// the remainder. simavr's timer list is only touched when the deadline moves earlier.
+class DeadlineTimer
+{
+	public:
+		DeadlineTimer(avr_cycle_timer_t fcnExpired, void *pParam):m_fcnExpired(fcnExpired),m_pParam(pParam){};
+
+		~DeadlineTimer() { Cancel(); }
+
+		DeadlineTimer(const DeadlineTimer&) = delete;
+		DeadlineTimer& operator=(const DeadlineTimer&) = delete;
+
+		// (Re)starts the timeout to expire uiCycles from now.
+		inline void Set(avr_t *avr, avr_cycle_count_t uiCycles)
+		{
+			m_pAVR = avr;
+			m_reset.Attach(avr);
+			m_uiDeadline = avr->cycle + uiCycles;
+			m_bActive = true;
+			if (!m_bArmed || m_uiDeadline < m_uiFireAt)
+			{
+				Arm(uiCycles);
+			}
+		}
+
+		inline void SetUsec(avr_t *avr, uint32_t uiUsec)
+		{
+			Set(avr, avr_usec_to_cycles(avr, uiUsec));
+		}
+
+		// Stops the timeout from expiring. The armed simavr timer is left to lapse.
+		inline void Clear() { m_bActive = false; }
+
+		// Stops the timeout and removes the simavr timer.
+		inline void Cancel()
+		{
+			m_bActive = false;
+			if (m_bArmed && m_pAVR)
+			{
+				avr_cycle_timer_cancel(m_pAVR, m_fcnTimer, this);
+			}
+			m_bArmed = false;
+		}
 
+		inline bool IsActive() const { return m_bActive; }
+
+	private:
+		inline void Arm(avr_cycle_count_t uiCycles)
+		{
+			m_bArmed = true;
+			m_uiFireAt = m_pAVR->cycle + uiCycles;
+			avr_cycle_timer_register(m_pAVR, uiCycles, m_fcnTimer, this);
+		}
+
+		inline avr_cycle_count_t OnTimer(avr_t *avr, avr_cycle_count_t when)
+		{
+			if (m_bActive && when < m_uiDeadline)
+			{
+				m_uiFireAt = m_uiDeadline;
+				return m_uiDeadline;
+			}
+			m_bArmed = false;
+			if (m_bActive)
+			{
+				m_bActive = false;
+				m_fcnExpired(avr, when, m_pParam);
+			}
+			return 0;
+		}
+
+		// avr_reset() has flushed the simavr timer; a pending deadline still stands.
+		inline void OnAVRReset()
+		{
+			m_bArmed = false;
+			if (m_bActive)
+			{
+				Arm(m_uiDeadline > m_pAVR->cycle ? m_uiDeadline - m_pAVR->cycle : 1);
+			}
+		}
+
+		avr_cycle_timer_t m_fcnTimer = MAKE_C_TIMER_CALLBACK(DeadlineTimer, OnTimer);
+		avr_cycle_timer_t m_fcnExpired;
+		void *m_pParam;
+		avr_t *m_pAVR = nullptr;
+		avr_cycle_count_t m_uiDeadline = 0, m_uiFireAt = 0;
+		bool m_bActive = false, m_bArmed = false;
+		ResetHook m_reset {MAKE_C_RESET_CALLBACK(DeadlineTimer, OnAVRReset), this};
+};
 
 class BasePeripheral
 {
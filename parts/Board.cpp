@@ -22,6 +22,8 @@
 
 #include "Board.h"
 #include "BasePeripheral.h"  // for BasePeripheral
+#include "Config.h"
+#include "InputRecorder.h"
 #include "KeyController.h"  // for KeyController
 #include "ScriptHost.h"     // for ScriptHost
 #include "TelemetryHost.h"
@@ -192,6 +194,16 @@ namespace Boards {
 
 		TelemetryHost::GetHost().Init(m_pAVR, strVCD,uiVCDRate);
 
+		if (Config::Get().GetProfileRate()>0)
+		{
+			m_profiler.Init(m_pAVR, Config::Get().GetProfileRate());
+		}
+
+		if (Config::Get().GetISRStats())
+		{
+			m_ISRs.Init(m_pAVR, m_strBoard);
+		}
+
 		// even if not setup at startup, activate gdb if crashing
 		m_pAVR->gdb_port = 1234;
 
@@ -246,47 +258,66 @@ namespace Boards {
 	void Board::_OnAVRInit()
 	{
 		std::string strFlash = GetStorageFileName("flash");
-		std::ifstream fsIn(strFlash, fsIn.binary | fsIn.ate);
-		if (!fsIn.is_open() || fsIn.tellg() < m_pAVR->flashend) {
-			std::cerr << "ERROR: Could not open flash file. Flash contents will NOT persist." << '\n';
+		size_t uiSize = m_pAVR->flashend+1;
+		if (!m_flash.Map(strFlash, uiSize))
+		{
+			std::cerr << "ERROR: Could not map flash file. Flash contents will NOT persist." << '\n';
 		}
 		else
 		{
-			fsIn.seekg(fsIn.beg);
-			fsIn.read(reinterpret_cast<char*>(m_pAVR->flash), m_pAVR->flashend+1); //NOLINT maybe if fstream supported unsigned chars...
-			std::cout << strFlash << ": Read " << fsIn.gcount() << " bytes.\n";
-			if (fsIn.fail() || fsIn.gcount() != m_pAVR->flashend+1)
+			auto data = m_flash.GetData();
+			if (m_flash.IsNew()) // Start from the AVR's erased flash rather than zeroes.
+			{
+				std::copy(m_pAVR->flash, m_pAVR->flash + uiSize, data.begin()); //NOLINT - flash is a raw buffer
+			}
+			m_pSimFlash = m_pAVR->flash;
+			m_pAVR->flash = data.data();
+			std::cout << strFlash << ": Mapped " << uiSize << " bytes";
+			if (m_flash.IsPrivate())
 			{
-				std::cerr << "Unable to load flash memory.\n";
-				exit(1);
+				std::cout << " (read-only or in use, shared copy-on-write; changes will NOT persist)";
 			}
+			std::cout << ".\n";
 		}
 		// NB: EEPROM happens later, because the AVR is not ready yet right now.
-		fsIn.close();
 		OnAVRInit();
 	}
 
 	void Board::_OnAVRDeinit()
 	{
-		std::ofstream fsOut(GetStorageFileName("flash"),fsOut.binary | fsOut.out | fsOut.trunc);
-		if (!fsOut.is_open())
+		m_EEPROM.Unload();
+		if (m_profiler.IsEnabled())
 		{
-			std::cerr << "Could not open flash file for writing\n";
+			std::string strProfile = GetStorageFileName("profile");
+			strProfile.erase(strProfile.find(".bin"), 4);
+			m_profiler.Write(strProfile);
 		}
-		else
+		if (m_ISRs.IsEnabled())
 		{
-			fsOut.write(reinterpret_cast<char*>(m_pAVR->flash),m_pAVR->flashend+1); //NOLINT maybe if fstream supported unsigned chars...
-			if ( fsOut.fail() || fsOut.tellp() != m_pAVR->flashend+1) {
-				std::cerr <<  "Unable to write flash memory for " << m_strBoard << '\n';
-			}
-			else
-			{
-				std::cout << "Wrote " << fsOut.tellp() << " bytes of flash\n";
-			}
-			fsOut.close();
+			std::cout << m_strBoard << ": ";
+			m_ISRs.PrintReport(std::cout);
+		}
+		if (m_fastFwd.GetSkippedCycles() > 0)
+		{
+			std::cout << m_strBoard << ": fast-forwarded " << avr_cycles_to_nsec(m_pAVR, m_fastFwd.GetSkippedCycles())/1000000U << " ms of delay loops\n";
 		}
-		m_EEPROM.Save();
+		if (m_core.IsEnabled())
+		{
+			uint64_t uiTotal = m_core.GetFastCount() + m_core.GetSlowCount();
+			std::cout << m_strBoard << ": predecoded core ran " << m_core.GetFastCount() << " of " << uiTotal << " instructions from the table ("
+				<< (uiTotal ? (100U*m_core.GetFastCount())/uiTotal : 0U) << "%)\n";
+		}
+		// Picked up by scripts/tests/run_parallel.py and bench_core.py for the per-test report.
+		std::cout << m_strBoard << ": ran " << m_pAVR->cycle << " cycles (" << avr_cycles_to_nsec(m_pAVR, m_pAVR->cycle)/1000000U << " ms simulated) in "
+			<< m_uiRunNs/1000000U << " ms\n";
 		OnAVRDeinit();
+		if (m_pSimFlash != nullptr)
+		{
+			// simavr frees its own buffer; the file already has everything written to the mapping.
+			m_pAVR->flash = m_pSimFlash;
+			m_pSimFlash = nullptr;
+			m_flash.Unmap();
+		}
 	}
 
 	void Board::OnKeyPress(const Key& key)
@@ -362,6 +393,7 @@ namespace Boards {
 				elf_firmware_t fw = {};
 				elf_read_firmware(strFW.c_str(), &fw);
 				avr_load_firmware(m_pAVR, &fw);
+				m_profiler.LoadSymbols(fw);
 				std::cout << "Loaded "  << fw.flashsize << " bytes from ELF file: " << strFW << '\n';
 				return fw.flashbase;
 			}
@@ -453,16 +485,31 @@ namespace Boards {
 		uint64_t idlens = tp.tv_nsec - tStart.tv_nsec;
 		auto fnsPerIdle = static_cast<float>(idlens)/1e6f;
 		std::cout << "10M idle cycles is " << std::to_string(idlens) << " ns (" << std::to_string(fnsPerIdle) << " ns per tick)\n";
-		if (m_bCorrectSkew)
+		// Fast-forward: sleep already jumps to the next timer in simavr, just don't wait for it in real time.
+		bool bFastFwd = Config::Get().GetFastForward();
+		// Replays don't need wall-clock pacing, inputs arrive by cycle.
+		bool bReplay = InputRecorder::GetRecorder().IsReplaying();
+		if (m_bCorrectSkew || bFastFwd || bReplay)
 		{
 			m_pAVR->sleep = fcnSleep;
 		}
+		// Decodes the firmware that's been loaded by now.
+		bool bPredecode = Config::Get().GetPredecode();
+		if (bPredecode)
+		{
+			m_core.Init(m_pAVR);
+		}
+		if (bFastFwd)
+		{
+			m_fastFwd.Init(m_pAVR);
+		}
 		int state = cpu_Running;
 		auto tNext = m_pAVR->cycle;
+		clock_gettime(CLOCK_MONOTONIC, &tStart);
 		uint64_t uiIdle = 10000, uiLost = 0;
 		while ((state != cpu_Done) && (state != cpu_Crashed) && !m_bQuit){
 			// Check the timing every 10k cycles, ~10 ms
-			if (m_bCorrectSkew && m_pAVR->cycle>tNext)
+			if (m_bCorrectSkew && !bReplay && m_pAVR->cycle>tNext)
 			{
 				auto tWall = avr_get_time_stamp(m_pAVR);
 				auto tSim = avr_cycles_to_nsec(m_pAVR, m_pAVR->cycle) + uiLost;
@@ -513,6 +560,10 @@ namespace Boards {
 			}
 			if (m_bIsPrimary) // Only one board should be scripting.
 			{
+				if (InputRecorder::GetRecorder().IsActive())
+				{
+					InputRecorder::GetRecorder().OnAVRCycle(m_pAVR->cycle);
+				}
 				ScriptHost::DispatchMenuCB();
 				KeyController::GetController().OnAVRCycle(); // Handle/dispatch any pressed keys.
 			}
@@ -545,8 +596,18 @@ namespace Boards {
 				avr_reset(m_pAVR);
 				avr_regbit_set(m_pAVR, m_pAVR->reset_flags.extrf);
 			}
-			state = avr_run(m_pAVR);
+			if (bFastFwd)
+			{
+				state = m_fastFwd.OnStep(m_pAVR);
+				if (state == cpu_Done || state == cpu_Crashed)
+				{
+					continue; // Ends the loop.
+				}
+			}
+			state = bPredecode ? m_core.Run(m_pAVR) : avr_run(m_pAVR);
 		}
+		clock_gettime(CLOCK_MONOTONIC, &tp);
+		m_uiRunNs = (static_cast<uint64_t>(tp.tv_sec - tStart.tv_sec)*1000000000ULL) + tp.tv_nsec - tStart.tv_nsec;
 		std::cout << m_wiring.GetMCUName() << "finished (" << state << ").\n";
 		avr_terminate(m_pAVR);
 		// std::cout << "cycles, wall, sim\n";
@@ -23,9 +23,14 @@
 #pragma once
 
 #include "EEPROM.h"         // for EEPROM
+#include "FastForward.h"
+#include "FirmwareProfiler.h"
+#include "ISRTracker.h"
 #include "IKeyClient.h"
 #include "IScriptable.h"    // for ArgType, IScriptable::LineStatus, IScript...
+#include "MappedFile.h"     // for MappedFile
 #include "PinNames.h"       // for Pin
+#include "PredecodedCore.h"
 #include "Scriptable.h"     // for Scriptable
 #include "Wiring.h"         // for Wiring
 #include "gsl-lite.hpp"   // for span
@@ -189,6 +194,9 @@ namespace Boards
 
 			bool m_bLostTimeLogged = false;
 
+			// Wall time spent in RunAVR's loop, for the throughput report.
+			uint64_t m_uiRunNs = 0;
+
 			enum class StateReset {
 				IDLE,
 				WAITING,
@@ -198,6 +206,11 @@ namespace Boards
 			StateReset m_stResetWaitFlag = StateReset::IDLE;
 
 			pthread_t m_thread = 0;
+
+			FirmwareProfiler m_profiler;
+			FastForward m_fastFwd;
+			PredecodedCore m_core;
+			ISRTracker m_ISRs;
 			const Wirings::Wiring &m_wiring;
 			std::string m_strBoard = "";
 
@@ -213,5 +226,9 @@ namespace Boards
 			// Loads an ELF or HEX file into the MCU. Returns boot PC
 
 			EEPROM m_EEPROM;
+
+			// Flash is backed directly by the storage file; the AVR's own buffer is kept to hand back at deinit.
+			MappedFile m_flash;
+			uint8_t *m_pSimFlash = nullptr;
 	};
 }; // namespace Boards
@@ -0,0 +1,114 @@
+/*
+	CallbackProfiler.cpp - Host-time accounting for peripheral IRQ and timer callbacks.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CallbackProfiler.h"
+#include <algorithm>  // for sort
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+thread_local CallbackProfiler::Scope* CallbackProfiler::Scope::m_pCurrent = nullptr;
+
+CallbackProfiler& CallbackProfiler::GetProfiler()
+{
+	static CallbackProfiler p;
+	return p;
+}
+
+CallbackProfiler::CallbackProfiler():Scriptable("CBProfiler")
+{
+	RegisterActionAndMenu("Report", "Prints the per-peripheral callback cost report", ActReport);
+	RegisterActionAndMenu("Reset", "Clears all callback profiling counters", ActReset);
+}
+
+std::string CallbackProfiler::AddressName(const void *pObj)
+{
+	std::ostringstream os;
+	os << pObj;
+	return os.str();
+}
+
+CallbackProfiler::Entry& CallbackProfiler::GetEntry(const char* strSite, const void* pObj, const std::string &strInstance)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	auto &pEntry = m_mEntries[{pObj, strSite}];
+	if (!pEntry)
+	{
+		pEntry.reset(new Entry());
+		pEntry->strName = strInstance + ' ' + strSite;
+	}
+	return *pEntry;
+}
+
+void CallbackProfiler::Reset()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	for (auto &it : m_mEntries)
+	{
+		it.second->uiCalls = 0;
+		it.second->uiTotalNs = 0;
+		it.second->uiSelfNs = 0;
+	}
+}
+
+void CallbackProfiler::PrintReport(std::ostream &os)
+{
+	std::vector<const Entry*> vSorted;
+	uint64_t uiSelfSum = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		for (auto &it : m_mEntries)
+		{
+			if (it.second->uiCalls > 0)
+			{
+				vSorted.push_back(it.second.get());
+				uiSelfSum += it.second->uiSelfNs;
+			}
+		}
+	}
+	std::sort(vSorted.begin(), vSorted.end(), [](const Entry *a, const Entry *b) { return a->uiSelfNs > b->uiSelfNs; });
+	os << "Peripheral callback profile (host time, sorted by self time):\n";
+	os << std::setw(12) << "Calls" << std::setw(12) << "Self ms" << std::setw(12) << "Total ms" << std::setw(10) << "ns/call" << std::setw(8) << "Self%" << "  Callback\n";
+	for (auto *pEntry : vSorted)
+	{
+		uint64_t uiCalls = pEntry->uiCalls, uiSelf = pEntry->uiSelfNs, uiTotal = pEntry->uiTotalNs;
+		os << std::setw(12) << uiCalls;
+		os << std::setw(12) << std::fixed << std::setprecision(2) << static_cast<double>(uiSelf)/1e6;
+		os << std::setw(12) << static_cast<double>(uiTotal)/1e6;
+		os << std::setw(10) << (uiSelf/uiCalls);
+		os << std::setw(7) << std::setprecision(1) << (uiSelfSum ? 100.0*static_cast<double>(uiSelf)/static_cast<double>(uiSelfSum) : 0.0) << '%';
+		os << "  " << pEntry->strName << '\n';
+	}
+}
+
+IScriptable::LineStatus CallbackProfiler::ProcessAction(unsigned int iAct, const std::vector<std::string> &/*vArgs*/)
+{
+	switch (iAct)
+	{
+		case ActReport:
+			PrintReport(std::cout);
+			return LineStatus::Finished;
+		case ActReset:
+			Reset();
+			return LineStatus::Finished;
+	}
+	return LineStatus::Unhandled;
+}
@@ -0,0 +1,151 @@
+/*
+	CallbackProfiler.h - Host-time accounting for peripheral IRQ and timer callbacks.
+	Only active when built with ENABLE_CB_PROFILE, see BasePeripheral.h
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "IScriptable.h"
+#include "Scriptable.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class CallbackProfiler: public Scriptable
+{
+	public:
+		struct Entry
+		{
+			std::string strName;
+			std::atomic<uint64_t> uiCalls {0};
+			std::atomic<uint64_t> uiTotalNs {0};
+			// Excludes time spent in nested (profiled) callbacks, e.g. IRQ chains.
+			std::atomic<uint64_t> uiSelfNs {0};
+		};
+
+		// Times one callback invocation. Nested scopes subtract from their parent's self time.
+		class Scope
+		{
+			public:
+				explicit Scope(Entry &entry):m_entry(entry),m_pParent(m_pCurrent),m_tStart(Clock::now())
+				{
+					m_pCurrent = this;
+				}
+
+				~Scope()
+				{
+					auto uiNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_tStart).count());
+					m_entry.uiCalls.fetch_add(1, std::memory_order_relaxed);
+					m_entry.uiTotalNs.fetch_add(uiNs, std::memory_order_relaxed);
+					m_entry.uiSelfNs.fetch_add(uiNs - std::min(uiNs, m_uiChildNs), std::memory_order_relaxed);
+					if (m_pParent)
+					{
+						m_pParent->m_uiChildNs += uiNs;
+					}
+					m_pCurrent = m_pParent;
+				}
+
+				Scope(const Scope&) = delete;
+				Scope& operator=(const Scope&) = delete;
+
+			private:
+				using Clock = std::chrono::steady_clock;
+				static thread_local Scope* m_pCurrent;
+				Entry &m_entry;
+				Scope *m_pParent;
+				Clock::time_point m_tStart;
+				uint64_t m_uiChildNs = 0;
+		};
+
+		// Per-call-site cache of the entries for each instance seen there, so the shared
+		// (locked) entry map is only consulted the first time a site runs for an instance.
+		// Sites are usually shared by a handful of instances (e.g. one per axis), a short list does.
+		struct SiteCache
+		{
+			const void *pLast = nullptr;
+			Entry *pEntry = nullptr;
+			std::vector<std::pair<const void*, Entry*>> vSeen;
+
+			template<class C>
+			inline Entry& Get(const char* strSite, C* pObj)
+			{
+				if (pObj != pLast)
+				{
+					auto it = std::find_if(vSeen.begin(), vSeen.end(), [pObj](const std::pair<const void*, Entry*> &seen) { return seen.first == pObj; });
+					if (it == vSeen.end())
+					{
+						vSeen.emplace_back(pObj, &GetProfiler().GetEntry(strSite, pObj, InstanceName(pObj)));
+						it = vSeen.end() - 1;
+					}
+					pEntry = it->second;
+					pLast = pObj;
+				}
+				return *pEntry;
+			}
+		};
+
+		static CallbackProfiler& GetProfiler();
+
+		// Prints all entries sorted by self time, most expensive first.
+		void PrintReport(std::ostream &os);
+
+		void Reset();
+
+	protected:
+		LineStatus ProcessAction(unsigned int iAct, const std::vector<std::string> &vArgs) override;
+
+	private:
+		CallbackProfiler();
+
+		Entry& GetEntry(const char* strSite, const void* pObj, const std::string &strInstance);
+
+		// Scriptable peripherals are labelled with their script name, everything else by address.
+		template<class C>
+		static inline typename std::enable_if<std::is_convertible<C*,IScriptable*>::value, std::string>::type InstanceName(C* pObj)
+		{
+			return static_cast<IScriptable*>(pObj)->GetName();
+		}
+
+		template<class C>
+		static inline typename std::enable_if<!std::is_convertible<C*,IScriptable*>::value, std::string>::type InstanceName(C* pObj)
+		{
+			return AddressName(pObj);
+		}
+
+		static std::string AddressName(const void *pObj);
+
+		enum Actions
+		{
+			ActReport,
+			ActReset
+		};
+
+		std::mutex m_lock;
+		std::map<std::pair<const void*, const char*>, std::unique_ptr<Entry>> m_mEntries;
+};
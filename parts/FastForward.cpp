@@ -0,0 +1,162 @@
+/*
+	FastForward.cpp - Skips simulated time spent in firmware busy-wait delay loops.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FastForward.h"
+#include "gsl-lite.hpp"
+#include "sim_cycle_timers.h" // for avr_cycle_timer_slot_t
+#include "sim_interrupts.h"   // for avr_has_pending_interrupt
+#include <algorithm>          // for min
+#include <array>
+
+static inline uint16_t FlashWord(const avr_t *avr, avr_flashaddr_t uiAddr)
+{
+	return avr->flash[uiAddr] | (avr->flash[uiAddr+1]<<8U); //NOLINT - flash is a raw buffer
+}
+
+bool FastForward::Match(const avr_t *avr, avr_flashaddr_t uiPC, Loop &loop)
+{
+	if (uiPC + 1 > avr->flashend)
+	{
+		return false;
+	}
+	uint16_t uiOp = FlashWord(avr, uiPC);
+	loop.uiBytes = 0;
+	loop.uiCycles = 1;
+	avr_flashaddr_t uiNext = uiPC + 2;
+	if ((uiOp & 0xFFCFU) == OP_SBIW_1)
+	{
+		loop.aRegs[0] = 24U + (((uiOp>>4U) & 3U)*2U);
+		loop.aRegs[1] = loop.aRegs[0] + 1U;
+		loop.uiBytes = 2;
+		loop.uiCycles = 2;
+	}
+	else if ((uiOp & 0xFE0FU) == OP_DEC)
+	{
+		loop.aRegs[loop.uiBytes++] = (uiOp>>4U) & 0x1FU;
+	}
+	else if ((uiOp & 0xFF0FU) == OP_SUBI_1)
+	{
+		loop.aRegs[loop.uiBytes++] = 16U + ((uiOp>>4U) & 0xFU);
+		// Wider counters carry through sbci; Z stays set only if every byte is zero.
+		while (loop.uiBytes < loop.aRegs.size() && uiNext + 1 <= avr->flashend && (FlashWord(avr, uiNext) & 0xFF0FU) == OP_SBCI_0)
+		{
+			gsl::at(loop.aRegs, loop.uiBytes++) = 16U + ((FlashWord(avr, uiNext)>>4U) & 0xFU);
+			loop.uiCycles++;
+			uiNext += 2;
+		}
+	}
+	else
+	{
+		return false;
+	}
+	if (uiNext + 1 > avr->flashend)
+	{
+		return false;
+	}
+	// The brne has to jump back to the head, i.e. k = -(words in the body + 1).
+	uint16_t uiBranch = FlashWord(avr, uiNext);
+	loop.uiWords = ((uiNext - uiPC)/2U) + 1U;
+	if ((uiBranch & 0xFC07U) != OP_BRNE || ((uiBranch>>3U) & 0x7FU) != ((128U - loop.uiWords) & 0x7FU))
+	{
+		return false;
+	}
+	loop.uiCycles += 2; // brne, taken
+	return true;
+}
+
+void FastForward::Init(avr_t *avr)
+{
+	m_vLoopPos.assign((avr->flashend + 1U)/2U, 0);
+	Loop loop {};
+	for (avr_flashaddr_t uiPC = 0; uiPC + 1 <= avr->flashend; uiPC += 2)
+	{
+		if (Match(avr, uiPC, loop))
+		{
+			for (unsigned int i = 0; i < loop.uiWords; i++)
+			{
+				m_vLoopPos.at((uiPC/2U) + i) = i + 1U;
+			}
+		}
+	}
+}
+
+int FastForward::Enter(avr_t *avr)
+{
+	// The core runs up to the next timer in one go, so it mostly stops somewhere in the body
+	// rather than at the head. Step it round to the head first; it's only a few instructions.
+	auto fcnPos = [this, avr]()
+	{
+		avr_flashaddr_t uiWord = avr->pc>>1U;
+		return uiWord < m_vLoopPos.size() ? m_vLoopPos[uiWord] : 0U;
+	};
+	int state = avr->state;
+	while (fcnPos() > 1 && state == cpu_Running)
+	{
+		avr->run_cycle_count = 1;
+		state = avr_run(avr);
+	}
+	Loop loop {};
+	if (fcnPos() == 1 && state == cpu_Running && Match(avr, avr->pc, loop)) // Flash may have been rewritten since Init.
+	{
+		TrySkip(avr, loop);
+	}
+	return state;
+}
+
+void FastForward::TrySkip(avr_t *avr, const Loop &loop)
+{
+	// A pending interrupt would be serviced between iterations.
+	if (avr->state != cpu_Running || (avr->sreg[S_I] && avr_has_pending_interrupt(avr)))
+	{
+		return;
+	}
+	uint32_t uiCount = 0;
+	for (size_t i=loop.uiBytes; i>0; i--)
+	{
+		uiCount = (uiCount<<8U) | avr->data[gsl::at(loop.aRegs,i-1)]; //NOLINT - data is a raw buffer
+	}
+	// Always leave the last pass to the core so the exit (flags, fall-through) is real.
+	if (uiCount < 2)
+	{
+		return;
+	}
+	avr_cycle_count_t uiIters = uiCount - 1;
+	// Stop short of the next timer so it fires at the same point it would have.
+	if (avr->cycle_timers.timer != nullptr)
+	{
+		avr_cycle_count_t uiWhen = avr->cycle_timers.timer->when;
+		if (uiWhen <= avr->cycle + loop.uiCycles)
+		{
+			return;
+		}
+		uiIters = std::min(uiIters, (uiWhen - avr->cycle - 1)/loop.uiCycles);
+	}
+	uiCount -= uiIters;
+	for (size_t i=0; i<loop.uiBytes; i++)
+	{
+		avr->data[gsl::at(loop.aRegs,i)] = (uiCount>>(8U*i)) & 0xFFU; //NOLINT - data is a raw buffer
+	}
+	avr_cycle_count_t uiSkip = uiIters*loop.uiCycles;
+	avr->cycle += uiSkip;
+	// The core batches instructions up to the next timer; keep that budget in step.
+	avr->run_cycle_count = avr->run_cycle_count > uiSkip ? avr->run_cycle_count - uiSkip : 1;
+	m_uiSkipped += uiSkip;
+}
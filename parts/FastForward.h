@@ -0,0 +1,82 @@
+/*
+	FastForward.h - Skips simulated time spent in firmware busy-wait delay loops.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "sim_avr.h"           // for avr_t
+#include "sim_avr_types.h"     // for avr_cycle_count_t
+#include <array>              // for array
+#include <cstddef>            // for size_t
+#include <cstdint>            // for uint16_t, uint64_t
+#include <vector>             // for vector
+
+// Recognises the counted delay loops emitted for _delay_us/_delay_ms, _delay_loop_1/2 and
+// delayMicroseconds, i.e. a decrement of a 1-4 byte counter followed by a "brne" back to it:
+//   sbiw rX,1 / dec rX / subi rX,1 [sbci rY,0 ...]  ; brne .-N
+// When the core is about to run such a loop, the iterations that would complete before the
+// next cycle timer are applied in one step (counter and cycle count), so peripherals still
+// see every event at the same cycle they would have without skipping.
+class FastForward
+{
+	public:
+		// Finds the loops in avr's flash. Call once firmware is loaded.
+		void Init(avr_t *avr);
+
+		// Called before each run of the core. Cheap unless the last run stopped inside a loop.
+		// Returns the core's state, as it may have to step the core to the loop head.
+		inline int OnStep(avr_t *avr)
+		{
+			avr_flashaddr_t uiWord = avr->pc>>1U;
+			if (uiWord < m_vLoopPos.size() && m_vLoopPos[uiWord] != 0)
+			{
+				return Enter(avr);
+			}
+			return avr->state;
+		}
+
+		inline uint64_t GetSkippedCycles() const { return m_uiSkipped; }
+
+	private:
+		struct Loop
+		{
+			std::array<uint8_t,4> aRegs; // Counter registers, least significant first.
+			size_t uiBytes;
+			unsigned int uiCycles; // One pass through the body, brne taken.
+			unsigned int uiWords; // Including the brne.
+		};
+
+		// Returns false unless uiPC is the head of a loop.
+		static bool Match(const avr_t *avr, avr_flashaddr_t uiPC, Loop &loop);
+
+		int Enter(avr_t *avr);
+		void TrySkip(avr_t *avr, const Loop &loop);
+
+		static constexpr uint16_t OP_SBIW_1 = 0x9701U; // sbiw Rd,1
+		static constexpr uint16_t OP_DEC = 0x940AU; // dec Rd
+		static constexpr uint16_t OP_SUBI_1 = 0x5001U; // subi Rd,1
+		static constexpr uint16_t OP_SBCI_0 = 0x4000U; // sbci Rd,0
+		static constexpr uint16_t OP_BRNE = 0xF401U; // brne k
+
+		// Per flash word: 0 outside any loop, else 1 + its offset in words from the loop head.
+		std::vector<uint8_t> m_vLoopPos;
+
+		uint64_t m_uiSkipped = 0;
+};
@@ -0,0 +1,187 @@
+/*
+	FirmwareProfiler.cpp - Sampling profiler for the simulated AVR firmware.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FirmwareProfiler.h"
+#include "gsl-lite.hpp"
+#include <algorithm>      // for sort, upper_bound, reverse
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+// Data-space symbols are offset by this in avr-gcc ELFs.
+static constexpr uint32_t AVR_DATA_OFFSET = 0x800000;
+
+void FirmwareProfiler::LoadSymbols(const elf_firmware_t &fw)
+{
+	m_vSymbols.clear();
+	gsl::span<avr_symbol_t*> vSyms {fw.symbol, fw.symbolcount};
+	for (auto *pSym : vSyms)
+	{
+		if (pSym == nullptr || pSym->addr >= AVR_DATA_OFFSET)
+		{
+			continue;
+		}
+		m_vSymbols.push_back({pSym->addr, pSym->size, pSym->symbol});
+	}
+	std::sort(m_vSymbols.begin(), m_vSymbols.end(), [](const Symbol &a, const Symbol &b) { return a.uiAddr < b.uiAddr; });
+	std::cout << "Profiler: loaded " << m_vSymbols.size() << " flash symbols\n";
+}
+
+void FirmwareProfiler::AddSymbol(avr_flashaddr_t uiAddr, uint32_t uiSize, const std::string &strName)
+{
+	auto it = std::upper_bound(m_vSymbols.begin(), m_vSymbols.end(), uiAddr, [](avr_flashaddr_t addr, const Symbol &s) { return addr < s.uiAddr; });
+	m_vSymbols.insert(it, {uiAddr, uiSize, strName});
+}
+
+void FirmwareProfiler::Init(avr_t *pAVR, uint32_t uiCycles)
+{
+	_Init(pAVR, this);
+	m_reset.Attach(pAVR);
+	m_uiPeriod = uiCycles;
+	m_vStack.reserve(MAX_DEPTH);
+	RegisterTimer(m_fcnSample, m_uiPeriod, this);
+	std::cout << "Profiler: sampling firmware every " << m_uiPeriod << " cycles\n";
+}
+
+void FirmwareProfiler::OnAVRReset()
+{
+	RegisterTimer(m_fcnSample, m_uiPeriod, this);
+}
+
+avr_flashaddr_t FirmwareProfiler::FunctionOf(avr_flashaddr_t uiPC)
+{
+	auto it = std::upper_bound(m_vSymbols.begin(), m_vSymbols.end(), uiPC, [](avr_flashaddr_t pc, const Symbol &s) { return pc < s.uiAddr; });
+	if (it == m_vSymbols.begin())
+	{
+		return uiPC;
+	}
+	--it;
+	// Symbols without a size (e.g. from assembly) cover everything up to the next one.
+	if (it->uiSize == 0 || uiPC < it->uiAddr + it->uiSize)
+	{
+		return it->uiAddr;
+	}
+	return uiPC;
+}
+
+std::string FirmwareProfiler::NameOf(avr_flashaddr_t uiFunc)
+{
+	auto it = std::lower_bound(m_vSymbols.begin(), m_vSymbols.end(), uiFunc, [](const Symbol &s, avr_flashaddr_t pc) { return s.uiAddr < pc; });
+	if (it != m_vSymbols.end() && it->uiAddr == uiFunc)
+	{
+		return it->strName;
+	}
+	std::ostringstream os;
+	os << "0x" << std::hex << uiFunc;
+	return os.str();
+}
+
+bool FirmwareProfiler::IsReturnAddress(uint32_t uiWordAddr)
+{
+	uint32_t uiByte = uiWordAddr<<1U;
+	if (uiByte < 4 || uiByte > m_pAVR->flashend)
+	{
+		return false;
+	}
+	auto fcnWord = [this](uint32_t addr) { return static_cast<uint16_t>(m_pAVR->flash[addr] | (m_pAVR->flash[addr+1]<<8U)); }; //NOLINT - flash is a raw buffer
+	uint16_t uiPrev = fcnWord(uiByte-2);
+	if ((uiPrev & 0xF000U) == 0xD000U /* RCALL */ || uiPrev == 0x9509U /* ICALL */ || uiPrev == 0x9519U /* EICALL */)
+	{
+		return true;
+	}
+	uint16_t uiPrev2 = fcnWord(uiByte-4);
+	return (uiPrev2 & 0xFE0EU) == 0x940EU; // CALL k
+}
+
+avr_cycle_count_t FirmwareProfiler::OnSample(avr_t *avr, avr_cycle_count_t when)
+{
+	m_uiSamples++;
+	m_vStack.clear();
+	m_vStack.push_back(FunctionOf(avr->pc));
+	// Walk the stack looking for plausible return addresses. This is the same
+	// heuristic a debugger uses without frame info; saved registers and locals
+	// that happen to look like a return address after a call can add spurious frames.
+	uint32_t uiSP = avr->data[R_SPL] | (avr->data[R_SPH]<<8U); //NOLINT - data is a raw buffer
+	uint32_t uiEnd = std::min<uint32_t>(avr->ramend, uiSP + MAX_STACK_SCAN);
+	unsigned uiPCBytes = avr->address_size == 3 ? 3 : 2;
+	for (uint32_t uiAddr = uiSP + 1; uiAddr + uiPCBytes - 1 <= uiEnd && m_vStack.size() < MAX_DEPTH; uiAddr++)
+	{
+		// Return addresses are pushed low byte first, so they read big-endian upwards.
+		uint32_t uiRet = 0;
+		for (unsigned i=0; i<uiPCBytes; i++)
+		{
+			uiRet = (uiRet<<8U) | avr->data[uiAddr+i]; //NOLINT - data is a raw buffer
+		}
+		if (IsReturnAddress(uiRet))
+		{
+			m_vStack.push_back(FunctionOf((uiRet<<1U) - 2));
+			uiAddr += uiPCBytes - 1;
+		}
+	}
+	std::reverse(m_vStack.begin(), m_vStack.end());
+	m_mStacks[m_vStack]++;
+	return when + m_uiPeriod;
+}
+
+void FirmwareProfiler::Write(const std::string &strBase)
+{
+	if (!IsEnabled() || m_uiSamples == 0)
+	{
+		return;
+	}
+	std::map<avr_flashaddr_t, std::pair<uint64_t,uint64_t>> mFuncs; // self, inclusive
+	{
+		std::ofstream fsOut(strBase + ".folded");
+		for (auto &it : m_mStacks)
+		{
+			std::string strStack;
+			std::vector<avr_flashaddr_t> vSeen;
+			for (auto &uiFunc : it.first)
+			{
+				strStack += (strStack.empty() ? "" : ";") + NameOf(uiFunc);
+				if (std::find(vSeen.begin(), vSeen.end(), uiFunc) == vSeen.end()) // Don't count recursion twice.
+				{
+					mFuncs[uiFunc].second += it.second;
+					vSeen.push_back(uiFunc);
+				}
+			}
+			mFuncs[it.first.back()].first += it.second;
+			fsOut << strStack << ' ' << it.second << '\n';
+		}
+	}
+	std::vector<std::pair<avr_flashaddr_t, std::pair<uint64_t,uint64_t>>> vSorted(mFuncs.begin(), mFuncs.end());
+	std::sort(vSorted.begin(), vSorted.end(), [](const std::pair<avr_flashaddr_t, std::pair<uint64_t,uint64_t>> &a, const std::pair<avr_flashaddr_t, std::pair<uint64_t,uint64_t>> &b) { return a.second.first > b.second.first; });
+	std::ofstream fsRpt(strBase + ".txt");
+	fsRpt << "Samples: " << m_uiSamples << " every " << m_uiPeriod << " cycles\n";
+	fsRpt << std::setw(8) << "Self%" << std::setw(14) << "Self cycles" << std::setw(8) << "Incl%" << std::setw(14) << "Incl cycles" << "  Function\n";
+	for (auto &it : vSorted)
+	{
+		fsRpt << std::fixed << std::setprecision(2);
+		fsRpt << std::setw(7) << 100.0*static_cast<double>(it.second.first)/static_cast<double>(m_uiSamples) << '%';
+		fsRpt << std::setw(14) << it.second.first*m_uiPeriod;
+		fsRpt << std::setw(7) << 100.0*static_cast<double>(it.second.second)/static_cast<double>(m_uiSamples) << '%';
+		fsRpt << std::setw(14) << it.second.second*m_uiPeriod;
+		fsRpt << "  " << NameOf(it.first) << '\n';
+	}
+	std::cout << "Profiler: wrote " << strBase << ".folded and " << strBase << ".txt (" << m_uiSamples << " samples)\n";
+}
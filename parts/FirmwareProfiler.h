@@ -0,0 +1,95 @@
+/*
+	FirmwareProfiler.h - Sampling profiler for the simulated AVR firmware.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "BasePeripheral.h"    // for BasePeripheral, MAKE_C_TIMER_CALLBACK
+#include "sim_avr.h"           // for avr_t
+#include "sim_avr_types.h"     // for avr_cycle_count_t, avr_flashaddr_t
+#include "sim_cycle_timers.h"  // for avr_cycle_timer_t
+#include "sim_elf.h"           // for elf_firmware_t
+#include <cstdint>            // for uint32_t, uint64_t
+#include <map>
+#include <string>              // for string
+#include <vector>              // for vector
+
+// Samples the PC (and a heuristic call stack from the AVR stack) every N cycles.
+// Results are symbolised against the ELF symbol table and written as collapsed
+// stacks (for flamegraph.pl/speedscope) and a per-function cycle report.
+class FirmwareProfiler: public BasePeripheral
+{
+	public:
+		enum IRQ {
+			COUNT
+		};
+
+		const char *_IRQNAMES[IRQ::COUNT] = {
+		};
+
+		// Copies the function symbols from a loaded ELF.
+		void LoadSymbols(const elf_firmware_t &fw);
+
+		// Adds a single flash symbol (byte address and size), for firmware without an ELF.
+		void AddSymbol(avr_flashaddr_t uiAddr, uint32_t uiSize, const std::string &strName);
+
+		// Starts sampling every uiCycles cycles.
+		void Init(avr_t *pAVR, uint32_t uiCycles);
+
+		inline bool IsEnabled() { return m_uiPeriod > 0; }
+
+		// Writes strBase.folded and strBase.txt.
+		void Write(const std::string &strBase);
+
+	private:
+		struct Symbol
+		{
+			avr_flashaddr_t uiAddr;
+			uint32_t uiSize;
+			std::string strName;
+		};
+
+		avr_cycle_count_t OnSample(avr_t *avr, avr_cycle_count_t when);
+		avr_cycle_timer_t m_fcnSample = MAKE_C_TIMER_CALLBACK(FirmwareProfiler, OnSample);
+
+		// avr_reset() flushes the sample timer, start it again.
+		void OnAVRReset();
+		ResetHook m_reset {MAKE_C_RESET_CALLBACK(FirmwareProfiler, OnAVRReset), this};
+
+		// Returns the start address of the function containing uiPC (in bytes), or uiPC if unknown.
+		avr_flashaddr_t FunctionOf(avr_flashaddr_t uiPC);
+
+		std::string NameOf(avr_flashaddr_t uiFunc);
+
+		// Checks whether the word address is immediately preceded by a CALL/RCALL/ICALL/EICALL.
+		bool IsReturnAddress(uint32_t uiWordAddr);
+
+		uint32_t m_uiPeriod = 0;
+		uint64_t m_uiSamples = 0;
+
+		std::vector<Symbol> m_vSymbols;
+
+		// Stacks are stored outermost-first as function start addresses.
+		std::map<std::vector<avr_flashaddr_t>, uint64_t> m_mStacks;
+		std::vector<avr_flashaddr_t> m_vStack;
+
+		static constexpr unsigned MAX_DEPTH = 32;
+		static constexpr unsigned MAX_STACK_SCAN = 256;
+};
@@ -0,0 +1,246 @@
+/*
+	ISRTracker.cpp - Per-vector interrupt latency and duration statistics.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ISRTracker.h"
+#include "TelemetryHost.h"
+#include "gsl-lite.hpp"
+#include "sim_irq.h"      // for avr_irq_register_notify
+#include "sim_regbit.h"   // for avr_regbit_get
+#include <algorithm>      // for min, max
+#include <cmath>          // for ceil
+#include <iomanip>
+#include <iostream>
+
+size_t ISRTracker::Histogram::IndexOf(uint32_t uiVal)
+{
+	if (uiVal < 8)
+	{
+		return uiVal;
+	}
+	unsigned uiExp = 31U - static_cast<unsigned>(__builtin_clz(uiVal));
+	return 8U + (uiExp-3U)*4U + ((uiVal >> (uiExp-2U)) & 3U);
+}
+
+uint32_t ISRTracker::Histogram::UpperBound(size_t uiIdx)
+{
+	if (uiIdx < 8)
+	{
+		return uiIdx;
+	}
+	uint64_t uiExp = (uiIdx-8U)/4U + 3U;
+	uint64_t uiLower = (4U + (uiIdx-8U)%4U) << (uiExp-2U);
+	return gsl::narrow_cast<uint32_t>(uiLower + (1ULL<<(uiExp-2U)) - 1U);
+}
+
+void ISRTracker::Histogram::Add(uint32_t uiVal)
+{
+	gsl::at(m_aBuckets, IndexOf(uiVal))++;
+	m_uiCount++;
+	m_uiSum += uiVal;
+	m_uiMax = std::max(m_uiMax, uiVal);
+}
+
+void ISRTracker::Histogram::Clear()
+{
+	m_aBuckets.fill(0);
+	m_uiCount = m_uiSum = 0;
+	m_uiMax = 0;
+}
+
+uint32_t ISRTracker::Histogram::Percentile(double dPct) const
+{
+	if (m_uiCount == 0)
+	{
+		return 0;
+	}
+	auto uiTarget = static_cast<uint64_t>(std::ceil(dPct/100.0 * static_cast<double>(m_uiCount)));
+	uint64_t uiSeen = 0;
+	for (size_t i=0; i<BUCKETS; i++)
+	{
+		uiSeen += gsl::at(m_aBuckets, i);
+		if (uiSeen >= uiTarget)
+		{
+			return std::min(UpperBound(i), m_uiMax);
+		}
+	}
+	return m_uiMax;
+}
+
+void ISRTracker::Init(avr_t *avr, const std::string &strBoard)
+{
+	// The traces take the name before it is registered (and de-duplicated), so make it unique per board.
+	if (!strBoard.empty())
+	{
+		SetName(strBoard + "_ISR");
+	}
+	_Init(avr, this);
+	m_tStart = avr->cycle;
+	gsl::span<avr_int_vector_p> vVectors {avr->interrupts.vector, avr->interrupts.vector_count};
+	// Notify params point into this, so it must not reallocate.
+	m_vVectors.resize(vVectors.size());
+	for (size_t i=0; i<vVectors.size(); i++)
+	{
+		auto &vec = m_vVectors.at(i);
+		vec.pOwner = this;
+		vec.pVector = vVectors[i];
+		auto fcnPending = [](avr_irq_t*, uint32_t value, void *param) { auto *p = static_cast<Vector*>(param); p->pOwner->OnPending(*p, value); };
+		auto fcnRunning = [](avr_irq_t*, uint32_t value, void *param) { auto *p = static_cast<Vector*>(param); p->pOwner->OnRunning(*p, value); };
+		avr_irq_register_notify(&vec.pVector->irq[AVR_INT_IRQ_PENDING], fcnPending, &vec);  //NOLINT - simavr array
+		avr_irq_register_notify(&vec.pVector->irq[AVR_INT_IRQ_RUNNING], fcnRunning, &vec);  //NOLINT - simavr array
+	}
+	m_vRunning.reserve(m_vVectors.size());
+
+	auto &TH = TelemetryHost::GetHost();
+	TH.AddTrace(this, VECTOR_OUT, {TC::Interrupt}, 8);
+	TH.AddTrace(this, LATENCY_OUT, {TC::Interrupt}, 32);
+	TH.AddTrace(this, DEPTH_OUT, {TC::Interrupt}, 8);
+
+	RegisterActionAndMenu("Report", "Prints the interrupt latency/duration summary", ActReport);
+	RegisterActionAndMenu("Reset", "Clears the interrupt statistics", ActReset);
+	std::cout << "ISR tracker: watching " << m_vVectors.size() << " interrupt vectors\n";
+}
+
+void ISRTracker::OnPending(Vector &vec, uint32_t value)
+{
+	if (!value)
+	{
+		vec.bPending = false;
+		return;
+	}
+	// Flags are raised for polling even if the interrupt is disabled; those never run.
+	if (!avr_regbit_get(m_pAVR, vec.pVector->enable))
+	{
+		return;
+	}
+	vec.uiRaised++;
+	if (vec.bPending)
+	{
+		vec.uiMissed++; // Flag was already set, this event is lost.
+		return;
+	}
+	for (auto &frame : m_vRunning)
+	{
+		if (frame.pVec == &vec)
+		{
+			vec.uiReentered++; // Raised again before the previous handler finished.
+			break;
+		}
+	}
+	vec.bPending = true;
+	vec.tPending = m_pAVR->cycle;
+}
+
+void ISRTracker::OnRunning(Vector &vec, uint32_t value)
+{
+	avr_cycle_count_t tNow = m_pAVR->cycle;
+	if (value)
+	{
+		uint32_t uiLatency = 0;
+		if (vec.bPending)
+		{
+			uiLatency = gsl::narrow_cast<uint32_t>(tNow - vec.tPending);
+			vec.latency.Add(uiLatency);
+			vec.bPending = false;
+		}
+		if (!m_vRunning.empty())
+		{
+			vec.uiNested++;
+		}
+		m_vRunning.push_back({&vec, tNow, 0});
+		vec.uiMaxDepth = std::max<uint64_t>(vec.uiMaxDepth, m_vRunning.size());
+		RaiseIRQ(LATENCY_OUT, uiLatency);
+		RaiseIRQ(DEPTH_OUT, m_vRunning.size());
+		RaiseIRQ(VECTOR_OUT, vec.pVector->vector);
+		return;
+	}
+	// reti always returns from the innermost handler.
+	if (m_vRunning.empty() || m_vRunning.back().pVec != &vec)
+	{
+		return; // Started before we were attached.
+	}
+	Frame frame = m_vRunning.back();
+	m_vRunning.pop_back();
+	avr_cycle_count_t uiCycles = tNow - frame.tEntry;
+	vec.duration.Add(gsl::narrow_cast<uint32_t>(uiCycles));
+	vec.self.Add(gsl::narrow_cast<uint32_t>(uiCycles - std::min(uiCycles, frame.uiChildCycles)));
+	if (m_vRunning.empty())
+	{
+		m_uiBusyCycles += uiCycles;
+		RaiseIRQ(VECTOR_OUT, 0);
+	}
+	else
+	{
+		m_vRunning.back().uiChildCycles += uiCycles;
+		RaiseIRQ(VECTOR_OUT, m_vRunning.back().pVec->pVector->vector);
+	}
+	RaiseIRQ(DEPTH_OUT, m_vRunning.size());
+}
+
+void ISRTracker::Reset()
+{
+	for (auto &vec : m_vVectors)
+	{
+		vec.uiRaised = vec.uiMissed = vec.uiReentered = vec.uiNested = vec.uiMaxDepth = 0;
+		vec.latency.Clear();
+		vec.duration.Clear();
+		vec.self.Clear();
+	}
+	m_uiBusyCycles = 0;
+	m_tStart = m_pAVR->cycle;
+}
+
+void ISRTracker::PrintReport(std::ostream &os)
+{
+	avr_cycle_count_t uiElapsed = m_pAVR->cycle - m_tStart;
+	double dUsPerCycle = 1e6/static_cast<double>(m_pAVR->frequency);
+	os << "Interrupt summary over " << std::fixed << std::setprecision(3) << static_cast<double>(uiElapsed)*dUsPerCycle/1e6 << " s simulated (latency/duration in cycles):\n";
+	os << std::setw(4) << "Vec" << std::setw(10) << "Count" << std::setw(8) << "Missed" << std::setw(8) << "Reent" << std::setw(8) << "Nested" << std::setw(6) << "Depth";
+	os << std::setw(8) << "Lat p50" << std::setw(8) << "p99" << std::setw(8) << "max";
+	os << std::setw(8) << "Dur p50" << std::setw(8) << "p99" << std::setw(8) << "max" << std::setw(8) << "CPU%\n";
+	for (auto &vec : m_vVectors)
+	{
+		if (vec.duration.Count() == 0 && vec.uiRaised == 0)
+		{
+			continue;
+		}
+		os << std::setw(4) << static_cast<unsigned>(vec.pVector->vector);
+		os << std::setw(10) << vec.duration.Count() << std::setw(8) << vec.uiMissed << std::setw(8) << vec.uiReentered;
+		os << std::setw(8) << vec.uiNested << std::setw(6) << vec.uiMaxDepth;
+		os << std::setw(8) << vec.latency.Percentile(50) << std::setw(8) << vec.latency.Percentile(99) << std::setw(8) << vec.latency.Max();
+		os << std::setw(8) << vec.duration.Percentile(50) << std::setw(8) << vec.duration.Percentile(99) << std::setw(8) << vec.duration.Max();
+		os << std::setw(7) << std::setprecision(2) << (uiElapsed ? 100.0*static_cast<double>(vec.self.Sum())/static_cast<double>(uiElapsed) : 0.0) << "%\n";
+	}
+	os << "Total time in interrupts: " << std::setprecision(2) << (uiElapsed ? 100.0*static_cast<double>(m_uiBusyCycles)/static_cast<double>(uiElapsed) : 0.0) << "% of CPU\n";
+}
+
+IScriptable::LineStatus ISRTracker::ProcessAction(unsigned int iAct, const std::vector<std::string> &/*vArgs*/)
+{
+	switch (iAct)
+	{
+		case ActReport:
+			PrintReport(std::cout);
+			return LineStatus::Finished;
+		case ActReset:
+			Reset();
+			return LineStatus::Finished;
+	}
+	return LineStatus::Unhandled;
+}
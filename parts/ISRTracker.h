@@ -0,0 +1,116 @@
+/*
+	ISRTracker.h - Per-vector interrupt latency and duration statistics.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "BasePeripheral.h"    // for BasePeripheral
+#include "IScriptable.h"       // for IScriptable::LineStatus
+#include "Scriptable.h"        // for Scriptable
+#include "sim_avr.h"           // for avr_t
+#include "sim_avr_types.h"     // for avr_cycle_count_t
+#include "sim_interrupts.h"    // for avr_int_vector_t
+#include <array>
+#include <cstdint>            // for uint32_t, uint64_t
+#include <ostream>
+#include <string>              // for string
+#include <vector>              // for vector
+
+// Hooks the pending/running IRQs of every interrupt vector and records, per vector,
+// the pending->entry latency, the handler duration (inclusive and excluding nested ISRs),
+// nesting, and flags that were raised again before being serviced (i.e. lost).
+class ISRTracker: public BasePeripheral, public Scriptable
+{
+	public:
+		#define IRQPAIRS \
+			_IRQ(VECTOR_OUT,	">isr.vector") \
+			_IRQ(LATENCY_OUT,	">isr.latency") \
+			_IRQ(DEPTH_OUT,		">isr.depth")
+		#include "IRQHelper.h"
+
+		ISRTracker():Scriptable("ISR"){};
+
+		// Starts tracking avr's vectors. Traces and script actions are named after strBoard, if given.
+		void Init(avr_t *avr, const std::string &strBoard = "");
+
+		inline bool IsEnabled() { return m_pAVR != nullptr; }
+
+		// Prints the per-vector summary with latency/duration percentiles.
+		void PrintReport(std::ostream &os);
+
+		void Reset();
+
+	protected:
+		LineStatus ProcessAction(unsigned int iAct, const std::vector<std::string> &vArgs) override;
+
+	private:
+		// Log-linear histogram: exact below 8, then 4 sub-buckets per power of two (<=12.5% error).
+		class Histogram
+		{
+			public:
+				void Add(uint32_t uiVal);
+				void Clear();
+				// Returns the upper bound of the bucket containing the given percentile.
+				uint32_t Percentile(double dPct) const;
+				inline uint64_t Count() const { return m_uiCount; }
+				inline uint64_t Sum() const { return m_uiSum; }
+				inline uint32_t Max() const { return m_uiMax; }
+
+			private:
+				static constexpr size_t BUCKETS = 8 + 29*4;
+				static size_t IndexOf(uint32_t uiVal);
+				static uint32_t UpperBound(size_t uiIdx);
+				std::array<uint64_t, BUCKETS> m_aBuckets {};
+				uint64_t m_uiCount = 0, m_uiSum = 0;
+				uint32_t m_uiMax = 0;
+		};
+
+		struct Vector
+		{
+			ISRTracker *pOwner = nullptr;
+			avr_int_vector_t *pVector = nullptr;
+			bool bPending = false;
+			avr_cycle_count_t tPending = 0;
+			uint64_t uiRaised = 0, uiMissed = 0, uiReentered = 0, uiNested = 0, uiMaxDepth = 0;
+			Histogram latency, duration, self;
+		};
+
+		struct Frame
+		{
+			Vector *pVec;
+			avr_cycle_count_t tEntry;
+			avr_cycle_count_t uiChildCycles;
+		};
+
+		void OnPending(Vector &vec, uint32_t value);
+		void OnRunning(Vector &vec, uint32_t value);
+
+		std::vector<Vector> m_vVectors;
+		std::vector<Frame> m_vRunning;
+
+		avr_cycle_count_t m_tStart = 0;
+		uint64_t m_uiBusyCycles = 0;
+
+		enum Actions
+		{
+			ActReport,
+			ActReset
+		};
+};
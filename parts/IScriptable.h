@@ -30,6 +30,7 @@
 #include <string>
 #include <utility>
 #include <vector>
+class CallbackProfiler;
 class Scriptable;
 class ScriptHost;
 class TelemetryHost;
@@ -51,6 +52,7 @@ class IScriptable
 
 	friend ScriptHost;
 	friend TelemetryHost;
+	friend CallbackProfiler;
     public:
 		explicit IScriptable(std::string strName):m_strName(std::move(strName)){}
         virtual ~IScriptable() = default;
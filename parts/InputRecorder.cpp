@@ -0,0 +1,150 @@
+/*
+	InputRecorder.cpp - Records external inputs with their AVR cycle and replays them.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "InputRecorder.h"
+#include <iostream>
+#include <sstream>
+
+static constexpr char LOG_HEADER[] = "# MK404 input log v1";
+
+InputRecorder& InputRecorder::GetRecorder()
+{
+	static InputRecorder r {};
+	return r;
+}
+
+bool InputRecorder::Record(const std::string &strFile)
+{
+	m_fsLog.open(strFile, std::ios::out | std::ios::trunc);
+	if (!m_fsLog.is_open())
+	{
+		std::cerr << "InputRecorder: Could not open " << strFile << " for writing\n";
+		return false;
+	}
+	m_fsLog << static_cast<const char*>(LOG_HEADER) << '\n';
+	m_mode = Mode::Record;
+	std::cout << "InputRecorder: recording inputs to " << strFile << '\n';
+	return true;
+}
+
+bool InputRecorder::Replay(const std::string &strFile)
+{
+	std::ifstream fsIn(strFile);
+	if (!fsIn.is_open())
+	{
+		std::cerr << "InputRecorder: Could not open " << strFile << '\n';
+		return false;
+	}
+	std::string strLn;
+	size_t uiCount = 0, uiLine = 0;
+	while (getline(fsIn, strLn))
+	{
+		uiLine++;
+		if (strLn.empty() || strLn[0]=='#')
+		{
+			continue;
+		}
+		std::istringstream ssLine(strLn);
+		Event ev {0, ""};
+		std::string strChannel;
+		if (!(ssLine >> ev.uiCycle >> strChannel))
+		{
+			std::cerr << "InputRecorder: Malformed line " << uiLine << " in " << strFile << '\n';
+			return false;
+		}
+		ssLine.get(); // separator
+		getline(ssLine, ev.strData);
+		GetChannel(strChannel)->m_vEvents.push_back(std::move(ev));
+		uiCount++;
+	}
+	m_mode = Mode::Replay;
+	std::cout << "InputRecorder: replaying " << uiCount << " inputs from " << strFile << '\n';
+	return true;
+}
+
+void InputRecorder::Stop()
+{
+	m_mode = Mode::Off;
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (m_fsLog.is_open())
+	{
+		m_fsLog.close();
+	}
+	for (auto &it : m_mChannels)
+	{
+		it.second->m_vEvents.clear();
+		it.second->m_uiNext = 0;
+		it.second->m_qLive.clear();
+		it.second->m_uiQueued = 0;
+	}
+}
+
+InputRecorder::Channel* InputRecorder::GetChannel(const std::string &strName)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	auto &pCh = m_mChannels[strName];
+	if (!pCh)
+	{
+		pCh.reset(new Channel(strName));
+	}
+	return pCh.get();
+}
+
+void InputRecorder::Queue(Channel *pCh, const std::string &strData)
+{
+	if (m_mode == Mode::Replay)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_lock);
+	pCh->m_qLive.push_back(strData);
+	pCh->m_uiQueued++;
+}
+
+void InputRecorder::Log(Channel *pCh, avr_cycle_count_t uiCycle, const std::string &strData)
+{
+	if (m_mode != Mode::Record)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_lock);
+	// Flushed every time so the log survives a crash, which is often the point.
+	m_fsLog << uiCycle << ' ' << pCh->m_strName << ' ' << strData << std::endl;
+}
+
+void InputRecorder::OnAVRCycle(avr_cycle_count_t uiCycle)
+{
+	m_uiCycle = uiCycle;
+	Take(m_pMouse, uiCycle, [this](const std::string &strData)
+	{
+		int iButton = 0, iAction = 0;
+		std::istringstream(strData) >> iButton >> iAction;
+		if (m_fcnMouse)
+		{
+			m_fcnMouse(iButton, iAction);
+		}
+	});
+}
+
+void InputRecorder::QueueMouse(int iButton, int iAction)
+{
+	Queue(m_pMouse, std::to_string(iButton) + ' ' + std::to_string(iAction));
+}
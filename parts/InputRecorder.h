@@ -0,0 +1,152 @@
+/*
+	InputRecorder.h - Records external inputs with their AVR cycle and replays them.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "sim_avr_types.h"  // for avr_cycle_count_t
+#include <atomic>
+#include <cstddef>         // for size_t
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Everything that reaches the simulation from outside (UI keys, mouse, menu, terminal lines, PTY bytes)
+// is handed to the AVR thread through a named channel. When recording, each input is logged with
+// the cycle it was delivered on; when replaying, live input is dropped and the log is delivered
+// at exactly those cycles instead.
+class InputRecorder
+{
+	public:
+		struct Event
+		{
+			avr_cycle_count_t uiCycle;
+			std::string strData;
+		};
+
+		class Channel
+		{
+			friend InputRecorder;
+			public:
+				explicit Channel(std::string strName):m_strName(std::move(strName)){};
+
+				// Replay: is the next logged event due by uiCycle?
+				inline bool IsDue(avr_cycle_count_t uiCycle) const
+				{
+					return m_uiNext < m_vEvents.size() && m_vEvents[m_uiNext].uiCycle <= uiCycle;
+				}
+
+				// Replay: returns the next logged event's data.
+				inline const std::string& Pop() { return m_vEvents.at(m_uiNext++).strData; }
+
+			private:
+				std::string m_strName;
+				std::vector<Event> m_vEvents {};
+				size_t m_uiNext = 0;
+				std::deque<std::string> m_qLive {};
+				std::atomic_uint m_uiQueued {0};
+		};
+
+		static InputRecorder& GetRecorder();
+
+		// Starts logging inputs to strFile.
+		bool Record(const std::string &strFile);
+
+		// Loads strFile and switches to replaying it.
+		bool Replay(const std::string &strFile);
+
+		// Closes the log and goes back to passing live input through.
+		void Stop();
+
+		inline bool IsActive() const { return m_mode != Mode::Off; }
+		inline bool IsRecording() const { return m_mode == Mode::Record; }
+		inline bool IsReplaying() const { return m_mode == Mode::Replay; }
+
+		// Returns the named channel, creating it if needed. The pointer stays valid.
+		Channel* GetChannel(const std::string &strName);
+
+		// Any thread: passes a live input to be delivered on the next AVR cycle. Dropped while replaying.
+		void Queue(Channel *pCh, const std::string &strData);
+
+		// AVR thread: delivers everything due on pCh at uiCycle - the queued live input
+		// (logging it) when recording, or the logged input when replaying.
+		template<class F>
+		void Take(Channel *pCh, avr_cycle_count_t uiCycle, F fcnDeliver)
+		{
+			if (m_mode == Mode::Replay)
+			{
+				while (pCh->IsDue(uiCycle))
+				{
+					fcnDeliver(pCh->Pop());
+				}
+			}
+			else if (pCh->m_uiQueued > 0)
+			{
+				std::deque<std::string> qLive;
+				{
+					std::lock_guard<std::mutex> lock(m_lock);
+					std::swap(qLive, pCh->m_qLive);
+					pCh->m_uiQueued = 0;
+				}
+				for (auto &strData : qLive)
+				{
+					Log(pCh, uiCycle, strData);
+					fcnDeliver(strData);
+				}
+			}
+		}
+
+		// Logs an input the caller delivered itself at uiCycle (e.g. a PTY byte). Record mode only.
+		void Log(Channel *pCh, avr_cycle_count_t uiCycle, const std::string &strData);
+
+		// Primary board, each AVR cycle: sets the cycle for the UI channels and delivers mouse events.
+		void OnAVRCycle(avr_cycle_count_t uiCycle);
+
+		// Cycle of the primary board as of its last OnAVRCycle.
+		inline avr_cycle_count_t GetCycle() const { return m_uiCycle; }
+
+		// Mouse input is only delivered to the printer through here when active.
+		inline void SetMouseHandler(std::function<void(int,int)> fcn) { m_fcnMouse = std::move(fcn); }
+		void QueueMouse(int iButton, int iAction);
+
+	private:
+		InputRecorder() = default;
+
+		enum class Mode
+		{
+			Off,
+			Record,
+			Replay
+		};
+
+		std::atomic<Mode> m_mode {Mode::Off};
+		std::map<std::string, std::unique_ptr<Channel>> m_mChannels;
+		std::mutex m_lock;
+		std::ofstream m_fsLog;
+		avr_cycle_count_t m_uiCycle = 0;
+		Channel *m_pMouse = GetChannel("mouse");
+		std::function<void(int,int)> m_fcnMouse {};
+};
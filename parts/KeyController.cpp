@@ -99,8 +99,27 @@ void KeyController::PutNiceKeyName(unsigned char key)
 	}
 }
 
+void KeyController::OnExternalKey(unsigned char key)
+{
+	auto &rec = InputRecorder::GetRecorder();
+	if (rec.IsActive())
+	{
+		rec.Queue(m_pRecKeys, std::to_string(key));
+	}
+	else
+	{
+		OnKeyPressed(key);
+	}
+}
+
 void KeyController::OnAVRCycle()
 {
+	auto &rec = InputRecorder::GetRecorder();
+	if (rec.IsActive())
+	{
+		rec.Take(m_pRecKeys, rec.GetCycle(), [this](const std::string &strKey) { DispatchKey(std::stoi(strKey)); });
+	}
+
 	auto key = m_key.load();
 
 	if (key==0)
@@ -110,6 +129,11 @@ void KeyController::OnAVRCycle()
 
 	m_key.store(0);
 
+	DispatchKey(key);
+}
+
+void KeyController::DispatchKey(unsigned char key)
+{
 	if (key == '?') {
 		PrintKeys(false);
 		return;
@@ -22,6 +22,7 @@
 #pragma once
 
 #include "IScriptable.h"
+#include "InputRecorder.h"
 #include "Scriptable.h"
 #include <atomic>
 #include <map>               // for map
@@ -47,8 +48,11 @@ class KeyController: private Scriptable
 
 		void PrintKeys(bool bMarkdown);
 
-		static inline void GLKeyReceiver(unsigned char key, int /*x*/, int /*y*/) { KeyController::GetController().OnKeyPressed(key); };
-		static inline void GLSpecialKeyReceiver(int key, int /*x*/, int /*y*/) { KeyController::GetController().OnKeyPressed(key | SPECIAL_KEY_MASK); };
+		// Called for keys from the UI. These go through the input recorder when it is active.
+		void OnExternalKey(unsigned char key);
+
+		static inline void GLKeyReceiver(unsigned char key, int /*x*/, int /*y*/) { KeyController::GetController().OnExternalKey(key); };
+		static inline void GLSpecialKeyReceiver(int key, int /*x*/, int /*y*/) { KeyController::GetController().OnExternalKey(key | SPECIAL_KEY_MASK); };
 
 	protected:
 		KeyController();
@@ -62,8 +66,11 @@ class KeyController: private Scriptable
 	private:
 		void PutNiceKeyName(unsigned char key);
 
+		void DispatchKey(unsigned char key);
+
 		std::map<unsigned char, std::vector<IKeyClient*>> m_mClients {};
 		std::map<unsigned char, std::string> m_mDescrs {};
 		std::atomic_uchar m_key {0};
+		InputRecorder::Channel *m_pRecKeys = InputRecorder::GetRecorder().GetChannel("key");
 
 };
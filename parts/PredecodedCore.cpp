@@ -0,0 +1,762 @@
+/*
+	PredecodedCore.cpp - Threaded-code front end for the simavr core.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PredecodedCore.h"
+#include "sim_cycle_timers.h" // for avr_cycle_timer_slot_t
+#include <algorithm>          // for min
+
+namespace
+{
+	using Op = PredecodedCore::Op;
+
+	// Registers live at the bottom of the data space; SREG is kept unpacked in avr->sreg, as the stock core does.
+	inline uint8_t& Reg(avr_t *avr, unsigned int uiReg) { return avr->data[uiReg]; } //NOLINT - data is a raw buffer
+	inline uint16_t Ptr(avr_t *avr, unsigned int uiReg) { return Reg(avr, uiReg) | (Reg(avr, uiReg+1U)<<8U); }
+	inline void SetPtr(avr_t *avr, unsigned int uiReg, uint16_t uiVal)
+	{
+		Reg(avr, uiReg+1U) = uiVal>>8U;
+		Reg(avr, uiReg) = uiVal & 0xFFU;
+	}
+
+	// Above the I/O space there are no callbacks, so SRAM can be accessed directly.
+	inline bool IsSRAM(const avr_t *avr, uint32_t uiAddr) { return uiAddr > avr->ioend && uiAddr <= avr->ramend; }
+
+	inline bool Next(avr_t *avr, const Op &op, avr_cycle_count_t uiCycles)
+	{
+		avr->pc = op.uiNext;
+		avr->cycle += uiCycles;
+		return true;
+	}
+
+	inline bool Jump(avr_t *avr, avr_flashaddr_t uiTo, avr_cycle_count_t uiCycles)
+	{
+		avr->pc = uiTo;
+		avr->cycle += uiCycles;
+		return true;
+	}
+
+	// Z, N and S for a byte result, V must already be set.
+	inline void FlagsZNS(avr_t *avr, uint8_t uiRes)
+	{
+		avr->sreg[S_Z] = uiRes == 0;
+		avr->sreg[S_N] = uiRes>>7U;
+		avr->sreg[S_S] = avr->sreg[S_N] ^ avr->sreg[S_V];
+	}
+
+	inline void FlagsAdd(avr_t *avr, unsigned int uiD, unsigned int uiR, uint8_t uiRes)
+	{
+		unsigned int uiCarry = (uiD & uiR) | (uiR & ~uiRes) | (~uiRes & uiD);
+		avr->sreg[S_H] = (uiCarry>>3U) & 1U;
+		avr->sreg[S_C] = (uiCarry>>7U) & 1U;
+		avr->sreg[S_V] = (((uiD & uiR & ~uiRes) | (~uiD & ~uiR & uiRes))>>7U) & 1U;
+		FlagsZNS(avr, uiRes);
+	}
+
+	inline void FlagsSub(avr_t *avr, unsigned int uiD, unsigned int uiR, uint8_t uiRes)
+	{
+		unsigned int uiBorrow = (~uiD & uiR) | (uiR & uiRes) | (uiRes & ~uiD);
+		avr->sreg[S_H] = (uiBorrow>>3U) & 1U;
+		avr->sreg[S_C] = (uiBorrow>>7U) & 1U;
+		avr->sreg[S_V] = (((uiD & ~uiR & ~uiRes) | (~uiD & uiR & uiRes))>>7U) & 1U;
+		FlagsZNS(avr, uiRes);
+	}
+
+	inline void FlagsLogic(avr_t *avr, uint8_t uiRes)
+	{
+		avr->sreg[S_V] = 0;
+		FlagsZNS(avr, uiRes);
+	}
+
+	// Shifts: C is the bit shifted out, V = N ^ C.
+	inline void FlagsShift(avr_t *avr, uint8_t uiRes, uint8_t uiC)
+	{
+		avr->sreg[S_C] = uiC;
+		avr->sreg[S_N] = uiRes>>7U;
+		avr->sreg[S_V] = avr->sreg[S_N] ^ uiC;
+		avr->sreg[S_S] = avr->sreg[S_N] ^ avr->sreg[S_V];
+		avr->sreg[S_Z] = uiRes == 0;
+	}
+
+	inline void FlagsMul(avr_t *avr, uint16_t uiRes)
+	{
+		Reg(avr, 0) = uiRes & 0xFFU;
+		Reg(avr, 1) = uiRes>>8U;
+		avr->sreg[S_C] = uiRes>>15U;
+		avr->sreg[S_Z] = uiRes == 0;
+	}
+
+	// IMM: Rr is the immediate in uiR (subi, sbci, cpi, andi, ori).
+	template<bool IMM>
+	inline uint8_t RrOrK(avr_t *avr, const Op &op) { return IMM ? op.uiR : Reg(avr, op.uiR); }
+
+	bool Nop(avr_t *avr, const Op &op) { return Next(avr, op, 1); }
+
+	bool Add(avr_t *avr, const Op &op)
+	{
+		uint8_t uiD = Reg(avr, op.uiD), uiR = Reg(avr, op.uiR), uiRes = uiD + uiR;
+		FlagsAdd(avr, uiD, uiR, uiRes);
+		Reg(avr, op.uiD) = uiRes;
+		return Next(avr, op, 1);
+	}
+
+	bool Adc(avr_t *avr, const Op &op)
+	{
+		uint8_t uiD = Reg(avr, op.uiD), uiR = Reg(avr, op.uiR), uiRes = uiD + uiR + avr->sreg[S_C];
+		FlagsAdd(avr, uiD, uiR, uiRes);
+		Reg(avr, op.uiD) = uiRes;
+		return Next(avr, op, 1);
+	}
+
+	template<bool IMM>
+	bool Sub(avr_t *avr, const Op &op)
+	{
+		uint8_t uiD = Reg(avr, op.uiD), uiR = RrOrK<IMM>(avr, op), uiRes = uiD - uiR;
+		FlagsSub(avr, uiD, uiR, uiRes);
+		Reg(avr, op.uiD) = uiRes;
+		return Next(avr, op, 1);
+	}
+
+	// Z only stays set if it was before, so multi-byte results compare as a whole.
+	template<bool IMM>
+	bool Sbc(avr_t *avr, const Op &op)
+	{
+		uint8_t uiD = Reg(avr, op.uiD), uiR = RrOrK<IMM>(avr, op), uiRes = uiD - uiR - avr->sreg[S_C];
+		uint8_t uiZ = avr->sreg[S_Z];
+		FlagsSub(avr, uiD, uiR, uiRes);
+		avr->sreg[S_Z] &= uiZ;
+		Reg(avr, op.uiD) = uiRes;
+		return Next(avr, op, 1);
+	}
+
+	template<bool IMM>
+	bool Cp(avr_t *avr, const Op &op)
+	{
+		uint8_t uiD = Reg(avr, op.uiD), uiR = RrOrK<IMM>(avr, op);
+		FlagsSub(avr, uiD, uiR, uiD - uiR);
+		return Next(avr, op, 1);
+	}
+
+	bool Cpc(avr_t *avr, const Op &op)
+	{
+		uint8_t uiD = Reg(avr, op.uiD), uiR = Reg(avr, op.uiR);
+		uint8_t uiZ = avr->sreg[S_Z];
+		FlagsSub(avr, uiD, uiR, uiD - uiR - avr->sreg[S_C]);
+		avr->sreg[S_Z] &= uiZ;
+		return Next(avr, op, 1);
+	}
+
+	template<bool IMM>
+	bool And(avr_t *avr, const Op &op)
+	{
+		uint8_t uiRes = Reg(avr, op.uiD) & RrOrK<IMM>(avr, op);
+		FlagsLogic(avr, uiRes);
+		Reg(avr, op.uiD) = uiRes;
+		return Next(avr, op, 1);
+	}
+
+	template<bool IMM>
+	bool Or(avr_t *avr, const Op &op)
+	{
+		uint8_t uiRes = Reg(avr, op.uiD) | RrOrK<IMM>(avr, op);
+		FlagsLogic(avr, uiRes);
+		Reg(avr, op.uiD) = uiRes;
+		return Next(avr, op, 1);
+	}
+
+	bool Eor(avr_t *avr, const Op &op)
+	{
+		uint8_t uiRes = Reg(avr, op.uiD) ^ Reg(avr, op.uiR);
+		FlagsLogic(avr, uiRes);
+		Reg(avr, op.uiD) = uiRes;
+		return Next(avr, op, 1);
+	}
+
+	bool Mov(avr_t *avr, const Op &op)
+	{
+		Reg(avr, op.uiD) = Reg(avr, op.uiR);
+		return Next(avr, op, 1);
+	}
+
+	bool Movw(avr_t *avr, const Op &op)
+	{
+		Reg(avr, op.uiD) = Reg(avr, op.uiR);
+		Reg(avr, op.uiD+1U) = Reg(avr, op.uiR+1U);
+		return Next(avr, op, 1);
+	}
+
+	bool Ldi(avr_t *avr, const Op &op)
+	{
+		Reg(avr, op.uiD) = op.uiR;
+		return Next(avr, op, 1);
+	}
+
+	bool Com(avr_t *avr, const Op &op)
+	{
+		uint8_t uiRes = ~Reg(avr, op.uiD);
+		FlagsLogic(avr, uiRes);
+		avr->sreg[S_C] = 1;
+		Reg(avr, op.uiD) = uiRes;
+		return Next(avr, op, 1);
+	}
+
+	bool Neg(avr_t *avr, const Op &op)
+	{
+		uint8_t uiD = Reg(avr, op.uiD), uiRes = 0U - uiD;
+		avr->sreg[S_H] = ((uiRes | uiD)>>3U) & 1U;
+		avr->sreg[S_V] = uiRes == 0x80U;
+		avr->sreg[S_C] = uiRes != 0;
+		FlagsZNS(avr, uiRes);
+		Reg(avr, op.uiD) = uiRes;
+		return Next(avr, op, 1);
+	}
+
+	bool Swap(avr_t *avr, const Op &op)
+	{
+		uint8_t uiD = Reg(avr, op.uiD);
+		Reg(avr, op.uiD) = (uiD<<4U) | (uiD>>4U);
+		return Next(avr, op, 1);
+	}
+
+	bool Inc(avr_t *avr, const Op &op)
+	{
+		uint8_t uiRes = Reg(avr, op.uiD) + 1U;
+		avr->sreg[S_V] = uiRes == 0x80U;
+		FlagsZNS(avr, uiRes);
+		Reg(avr, op.uiD) = uiRes;
+		return Next(avr, op, 1);
+	}
+
+	bool Dec(avr_t *avr, const Op &op)
+	{
+		uint8_t uiRes = Reg(avr, op.uiD) - 1U;
+		avr->sreg[S_V] = uiRes == 0x7FU;
+		FlagsZNS(avr, uiRes);
+		Reg(avr, op.uiD) = uiRes;
+		return Next(avr, op, 1);
+	}
+
+	bool Asr(avr_t *avr, const Op &op)
+	{
+		uint8_t uiD = Reg(avr, op.uiD), uiRes = (uiD>>1U) | (uiD & 0x80U);
+		FlagsShift(avr, uiRes, uiD & 1U);
+		Reg(avr, op.uiD) = uiRes;
+		return Next(avr, op, 1);
+	}
+
+	bool Lsr(avr_t *avr, const Op &op)
+	{
+		uint8_t uiD = Reg(avr, op.uiD), uiRes = uiD>>1U;
+		FlagsShift(avr, uiRes, uiD & 1U);
+		Reg(avr, op.uiD) = uiRes;
+		return Next(avr, op, 1);
+	}
+
+	bool Ror(avr_t *avr, const Op &op)
+	{
+		uint8_t uiD = Reg(avr, op.uiD), uiRes = (uiD>>1U) | (avr->sreg[S_C]<<7U);
+		FlagsShift(avr, uiRes, uiD & 1U);
+		Reg(avr, op.uiD) = uiRes;
+		return Next(avr, op, 1);
+	}
+
+	bool Adiw(avr_t *avr, const Op &op)
+	{
+		uint16_t uiD = Ptr(avr, op.uiD), uiRes = uiD + op.uiR;
+		avr->sreg[S_V] = ((~uiD & uiRes)>>15U) & 1U;
+		avr->sreg[S_C] = ((~uiRes & uiD)>>15U) & 1U;
+		avr->sreg[S_N] = uiRes>>15U;
+		avr->sreg[S_S] = avr->sreg[S_N] ^ avr->sreg[S_V];
+		avr->sreg[S_Z] = uiRes == 0;
+		SetPtr(avr, op.uiD, uiRes);
+		return Next(avr, op, 2);
+	}
+
+	bool Sbiw(avr_t *avr, const Op &op)
+	{
+		uint16_t uiD = Ptr(avr, op.uiD), uiRes = uiD - op.uiR;
+		avr->sreg[S_V] = ((uiD & ~uiRes)>>15U) & 1U;
+		avr->sreg[S_C] = ((uiRes & ~uiD)>>15U) & 1U;
+		avr->sreg[S_N] = uiRes>>15U;
+		avr->sreg[S_S] = avr->sreg[S_N] ^ avr->sreg[S_V];
+		avr->sreg[S_Z] = uiRes == 0;
+		SetPtr(avr, op.uiD, uiRes);
+		return Next(avr, op, 2);
+	}
+
+	bool Mul(avr_t *avr, const Op &op)
+	{
+		FlagsMul(avr, Reg(avr, op.uiD) * Reg(avr, op.uiR));
+		return Next(avr, op, 2);
+	}
+
+	bool Muls(avr_t *avr, const Op &op)
+	{
+		int16_t iRes = static_cast<int8_t>(Reg(avr, op.uiD)) * static_cast<int8_t>(Reg(avr, op.uiR));
+		FlagsMul(avr, static_cast<uint16_t>(iRes));
+		return Next(avr, op, 2);
+	}
+
+	bool Mulsu(avr_t *avr, const Op &op)
+	{
+		int16_t iRes = static_cast<int8_t>(Reg(avr, op.uiD)) * Reg(avr, op.uiR);
+		FlagsMul(avr, static_cast<uint16_t>(iRes));
+		return Next(avr, op, 2);
+	}
+
+	// uiR is the bit (bst/bld/sbrc/sbrs) or SREG flag (bset/bclr/brbs/brbc).
+	bool Bst(avr_t *avr, const Op &op)
+	{
+		avr->sreg[S_T] = (Reg(avr, op.uiD)>>op.uiR) & 1U;
+		return Next(avr, op, 1);
+	}
+
+	bool Bld(avr_t *avr, const Op &op)
+	{
+		uint8_t uiMask = 1U<<op.uiR;
+		Reg(avr, op.uiD) = avr->sreg[S_T] ? (Reg(avr, op.uiD) | uiMask) : (Reg(avr, op.uiD) & ~uiMask);
+		return Next(avr, op, 1);
+	}
+
+	bool Bset(avr_t *avr, const Op &op)
+	{
+		avr->sreg[op.uiR] = 1;
+		return Next(avr, op, 1);
+	}
+
+	bool Bclr(avr_t *avr, const Op &op)
+	{
+		avr->sreg[op.uiR] = 0;
+		return Next(avr, op, 1);
+	}
+
+	bool Brbs(avr_t *avr, const Op &op)
+	{
+		return avr->sreg[op.uiR] ? Jump(avr, op.uiTarget, 2) : Next(avr, op, 1);
+	}
+
+	bool Brbc(avr_t *avr, const Op &op)
+	{
+		return avr->sreg[op.uiR] ? Next(avr, op, 1) : Jump(avr, op.uiTarget, 2);
+	}
+
+	// Skips: uiTarget is past the next instruction and uiMaxCycles what skipping it costs.
+	bool Cpse(avr_t *avr, const Op &op)
+	{
+		return Reg(avr, op.uiD) == Reg(avr, op.uiR) ? Jump(avr, op.uiTarget, op.uiMaxCycles) : Next(avr, op, 1);
+	}
+
+	bool Sbrc(avr_t *avr, const Op &op)
+	{
+		return (Reg(avr, op.uiD)>>op.uiR) & 1U ? Next(avr, op, 1) : Jump(avr, op.uiTarget, op.uiMaxCycles);
+	}
+
+	bool Sbrs(avr_t *avr, const Op &op)
+	{
+		return (Reg(avr, op.uiD)>>op.uiR) & 1U ? Jump(avr, op.uiTarget, op.uiMaxCycles) : Next(avr, op, 1);
+	}
+
+	bool Rjmp(avr_t *avr, const Op &op) { return Jump(avr, op.uiTarget, 2); }
+
+	bool Jmp(avr_t *avr, const Op &op) { return Jump(avr, op.uiTarget, 3); }
+
+	bool Ijmp(avr_t *avr, const Op &)
+	{
+		avr_flashaddr_t uiTo = Ptr(avr, 30)<<1U;
+		if (uiTo > avr->flashend)
+		{
+			return false;
+		}
+		return Jump(avr, uiTo, 2);
+	}
+
+	// Data accesses: uiD is Rd/Rr, uiR the pointer register and uiTarget the displacement (or address for lds/sts).
+	bool Lds(avr_t *avr, const Op &op)
+	{
+		Reg(avr, op.uiD) = avr->data[op.uiTarget]; //NOLINT - data is a raw buffer
+		return Next(avr, op, 2);
+	}
+
+	bool Sts(avr_t *avr, const Op &op)
+	{
+		avr->data[op.uiTarget] = Reg(avr, op.uiD); //NOLINT - data is a raw buffer
+		return Next(avr, op, 2);
+	}
+
+	bool LdDisp(avr_t *avr, const Op &op)
+	{
+		uint32_t uiAddr = Ptr(avr, op.uiR) + op.uiTarget;
+		if (!IsSRAM(avr, uiAddr))
+		{
+			return false;
+		}
+		Reg(avr, op.uiD) = avr->data[uiAddr]; //NOLINT - data is a raw buffer
+		return Next(avr, op, 2);
+	}
+
+	bool LdInc(avr_t *avr, const Op &op)
+	{
+		uint16_t uiAddr = Ptr(avr, op.uiR);
+		if (!IsSRAM(avr, uiAddr))
+		{
+			return false;
+		}
+		Reg(avr, op.uiD) = avr->data[uiAddr]; //NOLINT - data is a raw buffer
+		SetPtr(avr, op.uiR, uiAddr + 1U);
+		return Next(avr, op, 2);
+	}
+
+	bool LdDec(avr_t *avr, const Op &op)
+	{
+		uint16_t uiAddr = Ptr(avr, op.uiR) - 1U;
+		if (!IsSRAM(avr, uiAddr))
+		{
+			return false;
+		}
+		Reg(avr, op.uiD) = avr->data[uiAddr]; //NOLINT - data is a raw buffer
+		SetPtr(avr, op.uiR, uiAddr);
+		return Next(avr, op, 2);
+	}
+
+	bool StDisp(avr_t *avr, const Op &op)
+	{
+		uint32_t uiAddr = Ptr(avr, op.uiR) + op.uiTarget;
+		if (!IsSRAM(avr, uiAddr))
+		{
+			return false;
+		}
+		avr->data[uiAddr] = Reg(avr, op.uiD); //NOLINT - data is a raw buffer
+		return Next(avr, op, 2);
+	}
+
+	bool StInc(avr_t *avr, const Op &op)
+	{
+		uint16_t uiAddr = Ptr(avr, op.uiR);
+		if (!IsSRAM(avr, uiAddr))
+		{
+			return false;
+		}
+		avr->data[uiAddr] = Reg(avr, op.uiD); //NOLINT - data is a raw buffer
+		SetPtr(avr, op.uiR, uiAddr + 1U);
+		return Next(avr, op, 2);
+	}
+
+	bool StDec(avr_t *avr, const Op &op)
+	{
+		uint16_t uiAddr = Ptr(avr, op.uiR) - 1U;
+		if (!IsSRAM(avr, uiAddr))
+		{
+			return false;
+		}
+		avr->data[uiAddr] = Reg(avr, op.uiD); //NOLINT - data is a raw buffer
+		SetPtr(avr, op.uiR, uiAddr);
+		return Next(avr, op, 2);
+	}
+
+	bool Lpm(avr_t *avr, const Op &op)
+	{
+		uint16_t uiAddr = Ptr(avr, 30);
+		if (uiAddr > avr->flashend)
+		{
+			return false;
+		}
+		Reg(avr, op.uiD) = avr->flash[uiAddr]; //NOLINT - flash is a raw buffer
+		return Next(avr, op, 3);
+	}
+
+	bool LpmInc(avr_t *avr, const Op &op)
+	{
+		uint16_t uiAddr = Ptr(avr, 30);
+		if (uiAddr > avr->flashend)
+		{
+			return false;
+		}
+		Reg(avr, op.uiD) = avr->flash[uiAddr]; //NOLINT - flash is a raw buffer
+		SetPtr(avr, 30, uiAddr + 1U);
+		return Next(avr, op, 3);
+	}
+
+	// JMP, CALL, LDS and STS carry a second word.
+	inline bool IsTwoWord(uint16_t uiOp)
+	{
+		return (uiOp & 0xFE0CU) == 0x940CU || (uiOp & 0xFC0FU) == 0x9000U;
+	}
+}
+
+void PredecodedCore::Init(avr_t *avr)
+{
+	m_pAVR = avr;
+	m_vOps.assign((avr->flashend + 1U)/2U, {});
+	Decode(0, avr->flashend + 1U);
+}
+
+void PredecodedCore::Decode(avr_flashaddr_t uiFrom, avr_flashaddr_t uiTo)
+{
+	for (avr_flashaddr_t uiPC = uiFrom; uiPC < uiTo; uiPC += 2U)
+	{
+		m_vOps.at(uiPC>>1U) = DecodeAt(uiPC);
+	}
+}
+
+PredecodedCore::Op PredecodedCore::DecodeAt(avr_flashaddr_t uiPC) const
+{
+	auto fcnWord = [this](avr_flashaddr_t uiAddr) { return static_cast<uint16_t>(m_pAVR->flash[uiAddr] | (m_pAVR->flash[uiAddr+1]<<8U)); }; //NOLINT - flash is a raw buffer
+	avr_flashaddr_t uiEnd = m_pAVR->flashend + 1U;
+	uint16_t uiOp = fcnWord(uiPC);
+
+	Op op;
+	op.uiNext = uiPC + (IsTwoWord(uiOp) ? 4U : 2U);
+	if (op.uiNext > uiEnd)
+	{
+		return {};
+	}
+	auto fcnSet = [&op](Handler fcn, unsigned int uiD, unsigned int uiR, unsigned int uiCycles)
+	{
+		op.fcn = fcn;
+		op.uiD = uiD;
+		op.uiR = uiR;
+		op.uiMaxCycles = uiCycles;
+		return op;
+	};
+	// Relative jumps that would leave flash are left to the stock core.
+	auto fcnRelative = [&op, uiPC, uiEnd](Handler fcn, int32_t iWords, unsigned int uiR, unsigned int uiCycles)
+	{
+		int64_t iTo = static_cast<int64_t>(uiPC) + 2 + (2*iWords);
+		if (iTo < 0 || iTo >= uiEnd)
+		{
+			return Op {};
+		}
+		op.uiTarget = static_cast<avr_flashaddr_t>(iTo);
+		op.fcn = fcn;
+		op.uiR = uiR;
+		op.uiMaxCycles = uiCycles;
+		return op;
+	};
+	// Skips step over the whole next instruction.
+	auto fcnSkip = [&](Handler fcn, unsigned int uiD, unsigned int uiR)
+	{
+		if (op.uiNext + 1U >= uiEnd)
+		{
+			return Op {};
+		}
+		unsigned int uiWords = IsTwoWord(fcnWord(op.uiNext)) ? 2U : 1U;
+		op.uiTarget = op.uiNext + (2U*uiWords);
+		if (op.uiTarget > uiEnd)
+		{
+			return Op {};
+		}
+		return fcnSet(fcn, uiD, uiR, 1U + uiWords);
+	};
+
+	unsigned int uiD5 = (uiOp>>4U) & 0x1FU;
+	unsigned int uiR5 = (uiOp & 0xFU) | ((uiOp>>5U) & 0x10U);
+	unsigned int uiD4 = 16U + ((uiOp>>4U) & 0xFU);
+	unsigned int uiK8 = ((uiOp>>4U) & 0xF0U) | (uiOp & 0xFU);
+	unsigned int uiBit = uiOp & 7U;
+
+	if (uiOp == 0)
+	{
+		return fcnSet(Nop, 0, 0, 1);
+	}
+	switch (uiOp & 0xFC00U)
+	{
+		case 0x0400U: return fcnSet(Cpc, uiD5, uiR5, 1);
+		case 0x0800U: return fcnSet(Sbc<false>, uiD5, uiR5, 1);
+		case 0x0C00U: return fcnSet(Add, uiD5, uiR5, 1);
+		case 0x1000U: return fcnSkip(Cpse, uiD5, uiR5);
+		case 0x1400U: return fcnSet(Cp<false>, uiD5, uiR5, 1);
+		case 0x1800U: return fcnSet(Sub<false>, uiD5, uiR5, 1);
+		case 0x1C00U: return fcnSet(Adc, uiD5, uiR5, 1);
+		case 0x2000U: return fcnSet(And<false>, uiD5, uiR5, 1);
+		case 0x2400U: return fcnSet(Eor, uiD5, uiR5, 1);
+		case 0x2800U: return fcnSet(Or<false>, uiD5, uiR5, 1);
+		case 0x2C00U: return fcnSet(Mov, uiD5, uiR5, 1);
+		case 0x9C00U: return fcnSet(Mul, uiD5, uiR5, 2);
+		case 0xF000U: // brbs/brbc, k is 7 bits signed
+		case 0xF400U:
+		{
+			auto iK = static_cast<int32_t>((uiOp>>3U) & 0x7FU);
+			iK = iK > 63 ? iK - 128 : iK;
+			return fcnRelative((uiOp & 0x0400U) ? Brbc : Brbs, iK, uiBit, 2);
+		}
+		default:
+			break;
+	}
+	switch (uiOp & 0xFF00U)
+	{
+		case 0x0100U: return fcnSet(Movw, (uiOp>>3U) & 0x1EU, (uiOp<<1U) & 0x1EU, 1);
+		case 0x0200U: return fcnSet(Muls, uiD4, 16U + (uiOp & 0xFU), 2);
+		case 0x9600U:
+		case 0x9700U:
+			return fcnSet((uiOp & 0x0100U) ? Sbiw : Adiw, 24U + ((uiOp>>3U) & 6U), (uiOp & 0xFU) | ((uiOp>>2U) & 0x30U), 2);
+		default:
+			break;
+	}
+	if ((uiOp & 0xFF88U) == 0x0300U) // fmul* share the prefix
+	{
+		return fcnSet(Mulsu, 16U + ((uiOp>>4U) & 7U), 16U + (uiOp & 7U), 2);
+	}
+	switch (uiOp & 0xF000U)
+	{
+		case 0x3000U: return fcnSet(Cp<true>, uiD4, uiK8, 1);
+		case 0x4000U: return fcnSet(Sbc<true>, uiD4, uiK8, 1);
+		case 0x5000U: return fcnSet(Sub<true>, uiD4, uiK8, 1);
+		case 0x6000U: return fcnSet(Or<true>, uiD4, uiK8, 1);
+		case 0x7000U: return fcnSet(And<true>, uiD4, uiK8, 1);
+		case 0xE000U: return fcnSet(Ldi, uiD4, uiK8, 1);
+		case 0xC000U:
+		{
+			auto iK = static_cast<int32_t>(uiOp & 0xFFFU);
+			iK = iK > 2047 ? iK - 4096 : iK;
+			return fcnRelative(Rjmp, iK, 0, 2);
+		}
+		default:
+			break;
+	}
+	if ((uiOp & 0xD000U) == 0x8000U) // ldd/std Y+q, Z+q
+	{
+		op.uiTarget = (uiOp & 7U) | ((uiOp>>7U) & 0x18U) | ((uiOp>>8U) & 0x20U);
+		return fcnSet((uiOp & 0x0200U) ? StDisp : LdDisp, uiD5, (uiOp & 8U) ? 28U : 30U, 2);
+	}
+	// Post-increment/pre-decrement through the register being loaded/stored is undefined, leave it be.
+	auto fcnPtr = [&](Handler fcn, unsigned int uiPtr)
+	{
+		return (uiD5 == uiPtr || uiD5 == uiPtr + 1U) ? Op {} : fcnSet(fcn, uiD5, uiPtr, 2);
+	};
+	switch (uiOp & 0xFE0FU)
+	{
+		case 0x9000U: // lds
+		case 0x9200U: // sts
+			op.uiTarget = fcnWord(uiPC + 2U);
+			if (!IsSRAM(m_pAVR, op.uiTarget))
+			{
+				return {};
+			}
+			return fcnSet((uiOp & 0x0200U) ? Sts : Lds, uiD5, 0, 2);
+		case 0x900CU: return fcnSet(LdDisp, uiD5, 26, 2); // ld X
+		case 0x920CU: return fcnSet(StDisp, uiD5, 26, 2);
+		case 0x9001U: return fcnPtr(LdInc, 30);
+		case 0x9009U: return fcnPtr(LdInc, 28);
+		case 0x900DU: return fcnPtr(LdInc, 26);
+		case 0x9002U: return fcnPtr(LdDec, 30);
+		case 0x900AU: return fcnPtr(LdDec, 28);
+		case 0x900EU: return fcnPtr(LdDec, 26);
+		case 0x9201U: return fcnPtr(StInc, 30);
+		case 0x9209U: return fcnPtr(StInc, 28);
+		case 0x920DU: return fcnPtr(StInc, 26);
+		case 0x9202U: return fcnPtr(StDec, 30);
+		case 0x920AU: return fcnPtr(StDec, 28);
+		case 0x920EU: return fcnPtr(StDec, 26);
+		case 0x9004U: return fcnSet(Lpm, uiD5, 0, 3);
+		case 0x9005U:
+			return (uiD5 == 30U || uiD5 == 31U) ? Op {} : fcnSet(LpmInc, uiD5, 0, 3);
+		case 0x9400U: return fcnSet(Com, uiD5, 0, 1);
+		case 0x9401U: return fcnSet(Neg, uiD5, 0, 1);
+		case 0x9402U: return fcnSet(Swap, uiD5, 0, 1);
+		case 0x9403U: return fcnSet(Inc, uiD5, 0, 1);
+		case 0x9405U: return fcnSet(Asr, uiD5, 0, 1);
+		case 0x9406U: return fcnSet(Lsr, uiD5, 0, 1);
+		case 0x9407U: return fcnSet(Ror, uiD5, 0, 1);
+		case 0x940AU: return fcnSet(Dec, uiD5, 0, 1);
+		default:
+			break;
+	}
+	// bset/bclr, except on I: sei/cli change the interrupt state, which is the stock core's business.
+	unsigned int uiFlag = (uiOp>>4U) & 7U;
+	if ((uiOp & 0xFF8FU) == 0x9408U && uiFlag != S_I)
+	{
+		return fcnSet(Bset, 0, uiFlag, 1);
+	}
+	if ((uiOp & 0xFF8FU) == 0x9488U && uiFlag != S_I)
+	{
+		return fcnSet(Bclr, 0, uiFlag, 1);
+	}
+	if (uiOp == 0x95C8U) // lpm (r0 implied)
+	{
+		return fcnSet(Lpm, 0, 0, 3);
+	}
+	if (uiOp == 0x9409U)
+	{
+		return fcnSet(Ijmp, 0, 0, 2);
+	}
+	if ((uiOp & 0xFE0EU) == 0x940CU) // jmp
+	{
+		op.uiTarget = ((((uiOp>>3U) & 0x3EU) | (uiOp & 1U))<<17U) | (fcnWord(uiPC + 2U)<<1U);
+		return op.uiTarget < uiEnd ? fcnSet(Jmp, 0, 0, 3) : Op {};
+	}
+	switch (uiOp & 0xFE08U)
+	{
+		case 0xF800U: return fcnSet(Bld, uiD5, uiBit, 1);
+		case 0xFA00U: return fcnSet(Bst, uiD5, uiBit, 1);
+		case 0xFC00U: return fcnSkip(Sbrc, uiD5, uiBit);
+		case 0xFE00U: return fcnSkip(Sbrs, uiD5, uiBit);
+		default:
+			break;
+	}
+	return {};
+}
+
+int PredecodedCore::Run(avr_t *avr)
+{
+	// Breakpoints and watchpoints need the stock core's checks on every instruction.
+	if (avr->state != cpu_Running || avr->gdb != nullptr)
+	{
+		return avr_run(avr);
+	}
+	auto fcnNextTimer = [avr]()
+	{
+		return avr->cycle_timers.timer != nullptr ? avr->cycle_timers.timer->when : avr->cycle + MAX_SLICE;
+	};
+	avr_cycle_count_t uiStop = std::min(fcnNextTimer(), avr->cycle + MAX_SLICE);
+	int state = cpu_Running;
+	do
+	{
+		// Only while no interrupt is pending, and never up to the next timer: the instruction
+		// that reaches it is the stock core's, so the timer runs right after it as usual.
+		avr_cycle_count_t uiLimit = fcnNextTimer();
+		while (avr->interrupt_state == 0 && avr->pc <= avr->flashend)
+		{
+			const Op &op = m_vOps[avr->pc>>1U];
+			if (op.fcn == nullptr || avr->cycle + op.uiMaxCycles >= uiLimit || !op.fcn(avr, op))
+			{
+				break;
+			}
+			m_uiFast++;
+		}
+
+		bool bSPM = avr->pc + 1U <= avr->flashend && (avr->flash[avr->pc] | (avr->flash[avr->pc+1]<<8U)) == OP_SPM; //NOLINT - flash is a raw buffer
+		avr_flashaddr_t uiPage = 0;
+		if (bSPM)
+		{
+			uint32_t uiRAMPZ = avr->rampz ? avr->data[avr->rampz] : 0U; //NOLINT - data is a raw buffer
+			uiPage = ((uiRAMPZ<<16U) | Ptr(avr, 30)) & ~(SPM_PAGE - 1U);
+		}
+		// One instruction, then timers and interrupts, exactly as at the end of a stock batch.
+		avr->run_cycle_count = 1;
+		state = avr_run(avr);
+		m_uiSlow++;
+		if (bSPM && uiPage <= avr->flashend)
+		{
+			// Include the word before in case it's a two-word instruction or a skip into the page.
+			Decode(uiPage > 0 ? uiPage - 2U : 0, std::min<avr_flashaddr_t>(uiPage + SPM_PAGE, avr->flashend + 1U));
+		}
+	} while (state == cpu_Running && avr->cycle < uiStop && avr->gdb == nullptr);
+	return state;
+}
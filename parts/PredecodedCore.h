@@ -0,0 +1,77 @@
+/*
+	PredecodedCore.h - Threaded-code front end for the simavr core.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "sim_avr.h"           // for avr_t
+#include "sim_avr_types.h"     // for avr_flashaddr_t, avr_cycle_count_t
+#include <cstdint>              // for uint8_t, uint16_t, uint64_t
+#include <vector>              // for vector
+
+// Decodes flash once into a table with one entry per word: a handler pointer and its
+// pre-extracted operands, jump targets and data addresses. Run() then executes straight
+// from the table for the instructions that only touch registers, SREG and plain SRAM
+// (ALU, moves, branches/skips, jumps, LD/ST/LDS/STS, LPM).
+//
+// Everything else - I/O, stack, calls, SLEEP, SEI/CLI, SPM... - and every timer or interrupt
+// boundary goes through the stock core one instruction at a time, so peripherals see the
+// same cycles they would with avr_run(). SPM re-decodes the page it wrote.
+class PredecodedCore
+{
+	public:
+		struct Op;
+		// Runs one decoded instruction. Returns false, without side effects, to have the stock core run it instead.
+		using Handler = bool (*)(avr_t *avr, const Op &op);
+
+		struct Op
+		{
+			Handler fcn = nullptr; // nullptr: always the stock core
+			avr_flashaddr_t uiNext = 0; // byte address of the following instruction
+			avr_flashaddr_t uiTarget = 0; // jump/branch/skip destination, or SRAM address for lds/sts
+			uint8_t uiD = 0, uiR = 0; // registers; uiR is the immediate, bit or displacement where there's no Rr
+			uint8_t uiMaxCycles = 0; // worst case, to stay clear of the next timer
+		};
+
+		// Decodes avr's flash. Call once firmware is loaded.
+		void Init(avr_t *avr);
+
+		// Drop-in for avr_run(). Runs until the first cycle timer due at entry (or a short slice) has been processed.
+		int Run(avr_t *avr);
+
+		inline bool IsEnabled() const { return !m_vOps.empty(); }
+		inline uint64_t GetFastCount() const { return m_uiFast; }
+		inline uint64_t GetSlowCount() const { return m_uiSlow; }
+
+	private:
+		void Decode(avr_flashaddr_t uiFrom, avr_flashaddr_t uiTo);
+		Op DecodeAt(avr_flashaddr_t uiPC) const;
+
+		// Cycles run per call at most, so Board's housekeeping still gets a look in.
+		static constexpr avr_cycle_count_t MAX_SLICE = 1000;
+		// Largest SPM page of the supported parts (ATmega2560).
+		static constexpr avr_flashaddr_t SPM_PAGE = 256;
+		static constexpr uint16_t OP_SPM = 0x95E8U;
+
+		avr_t *m_pAVR = nullptr;
+		std::vector<Op> m_vOps;
+
+		uint64_t m_uiFast = 0, m_uiSlow = 0;
+};
@@ -343,6 +343,11 @@ void ScriptHost::KeyCB(char key)
 		case 0x0d: // return;
 			m_bCanAcceptInput = false;
 			m_eCmdStatus = TermIdle;
+			if (InputRecorder::GetRecorder().IsActive())
+			{
+				InputRecorder::GetRecorder().Queue(GetTermChannel(), m_strCmd);
+			}
+			else
 			{
 				std::lock_guard<std::mutex> lck (m_lckScript);
 				m_script.push_back(m_strCmd);
@@ -438,6 +443,12 @@ void ScriptHost::Draw()
 // Called from the execution context to process the menu action.
 void ScriptHost::DispatchMenuCB()
 {
+	auto &rec = InputRecorder::GetRecorder();
+	if (rec.IsActive())
+	{
+		static auto *pMenu = rec.GetChannel("menu");
+		rec.Take(pMenu, rec.GetCycle(), [](const std::string &strID) { m_uiQueuedMenu.store(std::stoi(strID)); });
+	}
 	if (m_uiQueuedMenu !=0)
 	{
 		unsigned iID = m_uiQueuedMenu;
@@ -451,6 +462,12 @@ void ScriptHost::DispatchMenuCB()
 void ScriptHost::MenuCB(int iID)
 {
 	//printf("Menu CB %d\n",iID);
+	auto &rec = InputRecorder::GetRecorder();
+	if (rec.IsActive())
+	{
+		rec.Queue(rec.GetChannel("menu"), std::to_string(iID));
+		return;
+	}
 	m_uiQueuedMenu.store(iID);
 }
 
@@ -670,6 +687,15 @@ void ScriptHost::OnAVRCycle()
 {
 	std::string strLine; // Local copy to reduce mutex lock time.
 	size_t scriptSize = 0;
+	auto &rec = InputRecorder::GetRecorder();
+	if (rec.IsActive())
+	{
+		rec.Take(GetTermChannel(), rec.GetCycle(), [](const std::string &strCmd)
+		{
+			std::lock_guard<std::mutex> lck (m_lckScript);
+			m_script.push_back(strCmd);
+		});
+	}
 	if (!m_bIsTerminalEnabled)
 	{
 		scriptSize = m_script.size();
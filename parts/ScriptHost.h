@@ -25,6 +25,7 @@
 
 
 #include "IScriptable.h"  // for ArgType, ArgType::Bool, ArgType::Int, IScri...
+#include "InputRecorder.h"
 
 #include <atomic>         // for atomic_uint
 #include <map>            // for map
@@ -108,6 +109,13 @@ class ScriptHost: public IScriptable
 
 		static void AddSubmenu(IScriptable *src);
 
+		// Terminal lines are external input for the recorder.
+		inline static InputRecorder::Channel* GetTermChannel()
+		{
+			static auto *pCh = InputRecorder::GetRecorder().GetChannel("term");
+			return pCh;
+		}
+
 		//We can't register ourselves as a scriptable so just fake it with a processing func.
 		LineStatus ProcessAction(unsigned int ID, const std::vector<std::string> &vArgs) override;
 
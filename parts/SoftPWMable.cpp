@@ -32,7 +32,7 @@ void SoftPWMable::OnDigitalInSPWM(avr_irq_t *irq, uint32_t value)
 	}
 	if (value) // Was off, start at full, we'll update rate later.
 	{
-		RegisterTimerUsec(m_fcnSoftTimeout,m_uiSoftTimeoutUs,this);
+		m_softTimeout.SetUsec(m_pAVR,m_uiSoftTimeoutUs);
 		if (m_cntTOn>m_cntSoftPWM)
 		{
 			uint32_t uiTTotal = m_pAVR->cycle - m_cntSoftPWM;
@@ -47,6 +47,6 @@ void SoftPWMable::OnDigitalInSPWM(avr_irq_t *irq, uint32_t value)
 		uint16_t uiSoftPWM = ((uiCycleDelta/m_uiPrescale)-1); //62.5 Hz means full on is ~256k cycles.
 		OnPWMChange(irq,uiSoftPWM);
 		m_cntTOn = m_pAVR->cycle;
-		RegisterTimerUsec(m_fcnSoftTimeout,m_uiSoftTimeoutUs,this);
+		m_softTimeout.SetUsec(m_pAVR,m_uiSoftTimeoutUs);
 	}
 }
@@ -33,10 +33,10 @@ class SoftPWMable : public BasePeripheral
 {
 	public:
 		template<class C>
-		SoftPWMable(bool bEnabled, C */*p*/, uint16_t uiPrescale = 1000, uint32_t uiTimeoutMs = 17):m_bIsSoftPWM(bEnabled),m_uiPrescale(uiPrescale)
+		SoftPWMable(bool bEnabled, C */*p*/, uint16_t uiPrescale = 1000, uint32_t uiTimeoutMs = 17):m_bIsSoftPWM(bEnabled),m_uiPrescale(uiPrescale),
+			m_softTimeout(MAKE_C_TIMER_CALLBACK(SoftPWMable,OnSoftPWMChangeTimeout<C>), this)
 		{
 			m_uiSoftTimeoutUs = 1000*uiTimeoutMs;
-			m_fcnSoftTimeout = MAKE_C_TIMER_CALLBACK(SoftPWMable,OnSoftPWMChangeTimeout<C>);
 		};
 
 	protected:
@@ -74,6 +74,7 @@ class SoftPWMable : public BasePeripheral
 
 		uint16_t m_uiPrescale = 1000;
 		avr_cycle_count_t m_cntSoftPWM = 0, m_cntTOn = 0;
-		avr_cycle_timer_t m_fcnSoftTimeout;
+		// Re-armed on every edge, so this only pushes back a deadline.
+		DeadlineTimer m_softTimeout;
 
 };
@@ -20,9 +20,13 @@
  */
 
 #include "TelemetryHost.h"
+#include "Config.h"
 #include "sim_vcd_file.h"  // for avr_vcd_add_signal
 #include <algorithm>       // for find
+#include <cstddef>         // for offsetof
+#include <cstdint>         // for uintptr_t
 #include <cstring>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 
@@ -39,6 +43,8 @@ TelemetryHost::TelemetryHost():Scriptable("TelHost"),IKeyClient()
 	RegisterAction("IsEqual", "Checks if a value is equal to the specified value and errors if not.", ActIsEqual, {ArgType::String, ArgType::uint32});
 	RegisterActionAndMenu("StartTrace", "Starts the telemetry trace. You must have set a category or set of items with the -t option",ActStartTrace);
 	RegisterActionAndMenu("StopTrace", "Stops a running telemetry trace.",ActStopTrace);
+	RegisterAction("DumpStats", "Writes the online telemetry statistics (see --stats) to the given JSON file.",ActDumpStats, {ArgType::String});
+	RegisterAction("ResetStats", "Clears all online telemetry statistics.",ActResetStats);
 #endif
 	RegisterKeyHandler('+',"Start VCD trace");
 	RegisterKeyHandler('-',"Stop VCD trace");
@@ -48,33 +54,59 @@ void TelemetryHost::Init(avr_t *pAVR, const std::string &strVCDFile, uint32_t ui
 {
 	_Init(pAVR, this);
 	avr_vcd_init(m_pAVR,strVCDFile.c_str(),&m_trace,uiRateUs);
+	if (m_strStatsFile.empty()) // Secondary boards re-init, keep the primary's name.
+	{
+		m_strStatsFile = strVCDFile.substr(0, strVCDFile.rfind('.')) + "_stats.json";
+	}
+	if (!Config::Get().GetTelemetrySocket().empty())
+	{
+		m_stream.Init(pAVR, Config::Get().GetTelemetrySocket());
+	}
 }
 
-void TelemetryHost::AddTrace(avr_irq_t *pIRQ, std::string strName, TelCats vCats, uint8_t uiBits)
+bool TelemetryHost::IsSelected(const std::string &strName, TelCats vCats, const std::vector<TC> &vSelCats, const std::vector<std::string> &vSelNames)
 {
-	bool bShouldAdd = false;
 	// Check categories.
 	for (auto &vCat : vCats)
 	{
-		if (find(m_VLoglst.begin(), m_VLoglst.end(), vCat)!=m_VLoglst.end())
+		if (find(vSelCats.begin(), vSelCats.end(), vCat)!=vSelCats.end())
 		{
-			bShouldAdd = true;
-			break;
+			return true;
 		}
 	}
-	strName+= "_";
-	strName.append(pIRQ->name);
 	// Check explicit names
-	for (auto &sName : m_vsNames)
+	for (auto &sName : vSelNames)
 	{
 		if (strName.rfind(sName,0)==0)
 		{
-			bShouldAdd = true;
-			break;
+			return true;
 		}
 	}
+	return false;
+}
+
+// Parts and simavr's own I/O modules all allocate their IRQs from the AVR's pool.
+avr_t* TelemetryHost::GetIRQOwner(const avr_irq_t *pIRQ)
+{
+	if (pIRQ->pool == nullptr)
+	{
+		return nullptr;
+	}
+	return reinterpret_cast<avr_t*>(reinterpret_cast<uintptr_t>(pIRQ->pool) - offsetof(avr_t, irq_pool)); //NOLINT - container_of, as simavr does.
+}
+
+void TelemetryHost::AddTrace(avr_irq_t *pIRQ, std::string strName, TelCats vCats, uint8_t uiBits)
+{
+	// Not necessarily the board that called Init() last, e.g. a part of the printer set up after the MMU's board.
+	avr_t *pOwner = GetIRQOwner(pIRQ);
+	if (pOwner == nullptr)
+	{
+		pOwner = m_pAVR;
+	}
+	strName+= "_";
+	strName.append(pIRQ->name);
 
-	if (bShouldAdd)
+	if (IsSelected(strName, vCats, m_VLoglst, m_vsNames))
 	{
 		std::cout << "Telemetry: Added trace " << strName << '\n';
 		avr_vcd_add_signal(&m_trace, pIRQ, uiBits, strName.c_str());
@@ -83,10 +115,16 @@ void TelemetryHost::AddTrace(avr_irq_t *pIRQ, std::string strName, TelCats vCats
 	{
 		m_mIRQs[strName] = pIRQ;
 		m_mCatsByName[strName] = vCats;
+		m_stream.AddSignal(strName, pIRQ, pOwner);
 		for(auto &vCat : vCats)
 		{
 			m_mNamesByCat[vCat].push_back(strName);
 		}
+		if (IsSelected(strName, vCats, m_VStatlst, m_vsStatNames))
+		{
+			std::cout << "Telemetry: Collecting statistics for " << strName << '\n';
+			m_stats.Add(pOwner, strName, pIRQ);
+		}
 	}
 	else
 	{
@@ -109,21 +147,42 @@ void TelemetryHost::OnKeyPress(const Key& key)
 	}
 }
 
-void TelemetryHost::SetCategories(const std::vector<std::string> &vsCats)
+void TelemetryHost::ParseSelection(const std::vector<std::string> &vsCats, std::vector<TC> &vCats, std::vector<std::string> &vNames)
 {
 	for (auto &sCat : vsCats)
 	{
 		if (!m_mStr2Cat.count(sCat))
 		{
-			m_vsNames.push_back(sCat); // Save non-category for name check later.
+			vNames.push_back(sCat); // Save non-category for name check later.
 		}
-		else if (find(m_VLoglst.begin(), m_VLoglst.end(), m_mStr2Cat.at(sCat))==m_VLoglst.end())
+		else if (find(vCats.begin(), vCats.end(), m_mStr2Cat.at(sCat))==vCats.end())
 		{
-			m_VLoglst.push_back(m_mStr2Cat.at(sCat));
+			vCats.push_back(m_mStr2Cat.at(sCat));
 		}
 	}
 }
 
+void TelemetryHost::SetCategories(const std::vector<std::string> &vsCats)
+{
+	ParseSelection(vsCats, m_VLoglst, m_vsNames);
+}
+
+void TelemetryHost::SetStatCategories(const std::vector<std::string> &vsCats)
+{
+	ParseSelection(vsCats, m_VStatlst, m_vsStatNames);
+}
+
+void TelemetryHost::WriteStats()
+{
+	if (m_stats.IsEmpty())
+	{
+		return;
+	}
+	std::ofstream fsOut(m_strStatsFile);
+	m_stats.WriteJSON(fsOut);
+	std::cout << "Telemetry: Wrote statistics to " << m_strStatsFile << '\n';
+}
+
 Scriptable::LineStatus TelemetryHost::ProcessAction(unsigned int iAct, const std::vector<std::string> &vArgs)
 {
 	switch (iAct)
@@ -185,6 +244,19 @@ Scriptable::LineStatus TelemetryHost::ProcessAction(unsigned int iAct, const std
 		case ActStopTrace:
 			StopTrace();
 			return LineStatus::Finished;
+		case ActDumpStats:
+		{
+			std::ofstream fsOut(vArgs.at(0));
+			if (!fsOut.is_open())
+			{
+				return IssueLineError("Could not open " + vArgs.at(0) + " for writing");
+			}
+			m_stats.WriteJSON(fsOut);
+			return LineStatus::Finished;
+		}
+		case ActResetStats:
+			m_stats.Reset();
+			return LineStatus::Finished;
 		default:
 			return LineStatus::Unhandled;
 	}
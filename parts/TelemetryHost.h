@@ -25,6 +25,8 @@
 #include "IKeyClient.h"
 #include "IScriptable.h"     // for ArgType, ArgType::Int, ArgType::String
 #include "Scriptable.h"      // for Scriptable
+#include "TelemetryStats.h"  // for TelemetryStats
+#include "TelemetryStream.h" // for TelemetryStream
 #include "sim_avr.h"         // for avr_t
 #include "sim_irq.h"         // for avr_irq_t
 #include "sim_vcd_file.h"    // for avr_vcd_init, avr_vcd_start, avr_vcd_stop
@@ -50,7 +52,8 @@
 	_TC(ADC,"ADC"),\
 	_TC(PWM,"PWM"),\
 	_TC(Misc,"Misc"),\
-	_TC(Mux,"Mux")
+	_TC(Mux,"Mux"),\
+	_TC(Interrupt,"Interrupt")
 
 // Ugh, not ideal, but a dirty macro to generate references for string->enum and vice versa.
 #define _TC(x,y) x
@@ -87,6 +90,9 @@ class TelemetryHost: public BasePeripheral, public Scriptable, private IKeyClien
 		// Inits the VCD file at the specified rate (in us)
 		void Init(avr_t *pAVR, const std::string &strVCDFile, uint32_t uiRateUs = 100);
 
+		// The AVR an IRQ was allocated on, or nullptr if it has no pool.
+		static avr_t* GetIRQOwner(const avr_irq_t *pIRQ);
+
 		inline void StartTrace()
 		{
 			avr_vcd_start(&m_trace);
@@ -101,6 +107,12 @@ class TelemetryHost: public BasePeripheral, public Scriptable, private IKeyClien
 
 		void SetCategories(const std::vector<std::string> &vsCats);
 
+		// Selects categories/names to keep online statistics for.
+		void SetStatCategories(const std::vector<std::string> &vsCats);
+
+		// Writes the collected statistics (if any) to the default JSON file.
+		void WriteStats();
+
 		// Convenience wrapper for scriptable BasePeripherals
 		template<class C>
 		inline void AddTrace(C* p, unsigned int eIRQ, TelCats vCats, uint8_t uiBits = 1)
@@ -117,6 +129,12 @@ class TelemetryHost: public BasePeripheral, public Scriptable, private IKeyClien
 			StopTrace();
 		}
 
+		// Disconnects any live telemetry subscribers.
+		inline void StopStream()
+		{
+			m_stream.Stop();
+		}
+
 		void OnKeyPress(const Key& key) override;
 
 	private:
@@ -129,11 +147,26 @@ class TelemetryHost: public BasePeripheral, public Scriptable, private IKeyClien
 			ActWaitForLT,
 			ActIsEqual,
 			ActStartTrace,
-			ActStopTrace
+			ActStopTrace,
+			ActDumpStats,
+			ActResetStats
 		};
 
+		// Splits a list of category/name selectors into the two lists.
+		void ParseSelection(const std::vector<std::string> &vsCats, std::vector<TC> &vCats, std::vector<std::string> &vNames);
+
+		// Checks whether a trace is selected by category or name prefix.
+		static bool IsSelected(const std::string &strName, TelCats vCats, const std::vector<TC> &vSelCats, const std::vector<std::string> &vSelNames);
+
 		avr_vcd_t m_trace {};
 
+		TelemetryStream m_stream;
+
+		TelemetryStats m_stats;
+		std::vector<TelCategory> m_VStatlst;
+		std::vector<std::string> m_vsStatNames;
+		std::string m_strStatsFile;
+
 		std::vector<TelCategory> m_VLoglst;
 		std::vector<std::string> m_vsNames;
 
@@ -0,0 +1,117 @@
+/*
+	TelemetryStats.cpp - Online per-signal statistics for telemetry IRQs.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TelemetryStats.h"
+#include "gsl-lite.hpp"
+#include <algorithm>      // for min, max
+#include <iomanip>
+
+void TelemetryStats::Add(avr_t *pAVR, const std::string &strName, avr_irq_t *pIRQ)
+{
+	std::unique_ptr<Stat> pStat {new Stat()};
+	pStat->strName = strName;
+	pStat->pIRQ = pIRQ;
+	pStat->pAVR = pAVR;
+	Clear(*pStat);
+	auto fcnNotify = [](avr_irq_t*, uint32_t value, void *param) { auto *p = static_cast<Stat*>(param); TelemetryStats::OnChange(*p, value); };
+	avr_irq_register_notify(pIRQ, fcnNotify, pStat.get());
+	m_vStats.push_back(std::move(pStat));
+}
+
+void TelemetryStats::Clear(Stat &stat)
+{
+	stat.uiChanges = 0;
+	stat.uiRising = 0;
+	stat.uiMin = stat.uiMax = stat.uiLast = stat.pIRQ->value;
+	stat.dSum = 0;
+	stat.dIntegral = 0;
+	stat.tStart = stat.tLast = stat.pAVR->cycle;
+	stat.aHist.fill(0);
+}
+
+void TelemetryStats::Reset()
+{
+	for (auto &pStat : m_vStats)
+	{
+		Clear(*pStat);
+	}
+}
+
+void TelemetryStats::OnChange(Stat &stat, uint32_t value)
+{
+	if (value == stat.uiLast && stat.uiChanges > 0)
+	{
+		return; // Re-raise of the same value, not an event.
+	}
+	avr_cycle_count_t tNow = stat.pAVR->cycle;
+	avr_cycle_count_t tDelta = tNow - stat.tLast;
+	stat.dIntegral += static_cast<double>(stat.uiLast) * static_cast<double>(tDelta);
+	if (stat.uiChanges > 0 && tDelta > 0)
+	{
+		size_t uiBucket = 63U - static_cast<unsigned>(__builtin_clzll(tDelta));
+		gsl::at(stat.aHist, std::min(uiBucket, HIST_BUCKETS-1))++;
+	}
+	if (stat.uiLast == 0 && value != 0) // Edges, e.g. pulses on a pin, not every increase.
+	{
+		stat.uiRising++;
+	}
+	stat.uiChanges++;
+	stat.uiMin = std::min(stat.uiMin, value);
+	stat.uiMax = std::max(stat.uiMax, value);
+	stat.dSum += value;
+	stat.uiLast = value;
+	stat.tLast = tNow;
+}
+
+void TelemetryStats::WriteJSON(std::ostream &os)
+{
+	os << "{\n";
+	for (auto it = m_vStats.begin(); it != m_vStats.end(); ++it)
+	{
+		auto &stat = **it;
+		auto tNow = stat.pAVR->cycle;
+		double dElapsed = static_cast<double>(tNow - stat.tStart)/static_cast<double>(stat.pAVR->frequency);
+		// Include the time spent at the current value so the average is up to date.
+		double dIntegral = stat.dIntegral + static_cast<double>(stat.uiLast) * static_cast<double>(tNow - stat.tLast);
+		os << "\t\"" << stat.strName << "\": {";
+		os << "\"changes\": " << stat.uiChanges;
+		os << ", \"rising\": " << stat.uiRising;
+		os << ", \"min\": " << stat.uiMin;
+		os << ", \"max\": " << stat.uiMax;
+		os << ", \"mean\": " << (stat.uiChanges ? stat.dSum/static_cast<double>(stat.uiChanges) : static_cast<double>(stat.uiLast));
+		os << ", \"time_avg\": " << (tNow > stat.tStart ? dIntegral/static_cast<double>(tNow - stat.tStart) : static_cast<double>(stat.uiLast));
+		os << ", \"rate_hz\": " << (dElapsed > 0 ? static_cast<double>(stat.uiChanges)/dElapsed : 0.0);
+		os << ", \"elapsed_s\": " << dElapsed;
+		os << ", \"interval_log2_cycles\": {";
+		bool bFirst = true;
+		for (size_t i=0; i<HIST_BUCKETS; i++)
+		{
+			if (gsl::at(stat.aHist, i) == 0)
+			{
+				continue;
+			}
+			os << (bFirst ? "" : ", ") << '"' << i << "\": " << gsl::at(stat.aHist, i);
+			bFirst = false;
+		}
+		os << "}}" << ((it+1) == m_vStats.end() ? "" : ",") << '\n';
+	}
+	os << "}\n";
+}
@@ -0,0 +1,77 @@
+/*
+	TelemetryStats.h - Online per-signal statistics for telemetry IRQs.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "sim_avr.h"           // for avr_t
+#include "sim_avr_types.h"     // for avr_cycle_count_t
+#include "sim_irq.h"           // for avr_irq_t
+#include <array>
+#include <cstdint>            // for uint32_t, uint64_t
+#include <memory>              // for unique_ptr
+#include <ostream>
+#include <string>              // for string
+#include <vector>              // for vector
+
+// Keeps running aggregates for a set of IRQs, updated from their notify hooks.
+// Memory use is fixed per signal regardless of how long the simulation runs.
+class TelemetryStats
+{
+	public:
+		// Begins collecting statistics for the given IRQ.
+		void Add(avr_t *pAVR, const std::string &strName, avr_irq_t *pIRQ);
+
+		// Clears all counters, e.g. to exclude the boot sequence from a measurement.
+		void Reset();
+
+		// Writes all statistics as a JSON object keyed by signal name.
+		void WriteJSON(std::ostream &os);
+
+		inline bool IsEmpty() { return m_vStats.empty(); }
+
+	private:
+		// Intervals are bucketed by floor(log2(cycles)).
+		static constexpr size_t HIST_BUCKETS = 40;
+
+		struct Stat
+		{
+			std::string strName;
+			avr_irq_t *pIRQ = nullptr;
+			avr_t *pAVR = nullptr;
+			uint64_t uiChanges = 0;
+			uint64_t uiRising = 0; // zero to non-zero transitions
+			uint32_t uiMin = UINT32_MAX;
+			uint32_t uiMax = 0;
+			double dSum = 0;
+			// Time-weighted integral of the value, e.g. for PWM duty.
+			double dIntegral = 0;
+			uint32_t uiLast = 0;
+			avr_cycle_count_t tStart = 0;
+			avr_cycle_count_t tLast = 0;
+			std::array<uint64_t, HIST_BUCKETS> aHist {};
+		};
+
+		static void OnChange(Stat &stat, uint32_t value);
+
+		static void Clear(Stat &stat);
+
+		std::vector<std::unique_ptr<Stat>> m_vStats;
+};
@@ -0,0 +1,378 @@
+/*
+	TelemetryStream.cpp - Live telemetry streaming over a Unix domain socket.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TelemetryStream.h"
+#include "gsl-lite.hpp"
+#include <algorithm>       // for remove_if
+#include <array>
+#include <cerrno>          // for errno, EINTR
+#include <cstdio>          // for perror
+#include <cstring>         // for strncpy
+#include <fcntl.h>         // for fcntl, O_NONBLOCK
+#include <iostream>
+#include <poll.h>          // for poll, pollfd
+#include <sys/socket.h>    // for socket, bind, listen, accept, send
+#include <sys/un.h>        // for sockaddr_un
+#include <unistd.h>        // for close, unlink
+
+#ifndef MSG_NOSIGNAL // macOS uses SO_NOSIGPIPE instead.
+#define MSG_NOSIGNAL 0
+#endif
+
+TelemetryStream::~TelemetryStream()
+{
+	Stop();
+}
+
+bool TelemetryStream::Init(avr_t *pAVR, const std::string &strSocket, uint32_t uiBatchUs)
+{
+	if (m_thread != 0)
+	{
+		return true; // Already running, e.g. a secondary board.
+	}
+	_Init(pAVR, this);
+
+	sockaddr_un addr {};
+	if (strSocket.size() >= sizeof(addr.sun_path))
+	{
+		std::cerr << "Telemetry: socket path " << strSocket << " is too long.\n";
+		return false;
+	}
+	m_fdListen = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_fdListen < 0)
+	{
+		perror("Telemetry: socket");
+		return false;
+	}
+	addr.sun_family = AF_UNIX;
+	strncpy(static_cast<char*>(addr.sun_path), strSocket.c_str(), sizeof(addr.sun_path)-1);
+	unlink(strSocket.c_str()); // Remove a stale socket from a previous run.
+	if (bind(m_fdListen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(m_fdListen, MAX_CLIENTS) < 0) //NOLINT - sockaddr cast is the socket API.
+	{
+		perror(strSocket.c_str());
+		close(m_fdListen);
+		m_fdListen = -1;
+		return false;
+	}
+	m_strSocket = strSocket;
+	m_uiBatchCycles = avr_usec_to_cycles(m_pAVR, uiBatchUs);
+	RegisterTimer(m_fcnBatch, m_uiBatchCycles, this);
+	m_reset.Attach(m_pAVR);
+
+	auto fcnThread = [](void *param){ auto *p = static_cast<TelemetryStream*>(param); return p->Run(); };
+	pthread_create(&m_thread, nullptr, fcnThread, this);
+	std::cout << "Telemetry: streaming on " << m_strSocket << '\n';
+	return true;
+}
+
+void TelemetryStream::Stop()
+{
+	if (m_thread == 0)
+	{
+		return;
+	}
+	m_bQuit = true;
+	pthread_join(m_thread, nullptr);
+	m_thread = 0;
+	for (auto &client : m_vClients)
+	{
+		close(client.fd);
+	}
+	m_vClients.clear();
+	close(m_fdListen);
+	m_fdListen = -1;
+	unlink(m_strSocket.c_str());
+	if (m_uiDropped)
+	{
+		std::cout << "Telemetry: " << m_uiDropped << " samples were dropped because subscribers could not keep up.\n";
+	}
+}
+
+void TelemetryStream::AddSignal(const std::string &strName, avr_irq_t *pIRQ, avr_t *pOwner)
+{
+	std::lock_guard<std::mutex> lock(m_lockSignals);
+	std::unique_ptr<Signal> pSig {new Signal()};
+	pSig->pStream = this;
+	pSig->uiID = gsl::narrow<uint16_t>(m_vSignals.size());
+	pSig->strName = strName;
+	pSig->pIRQ = pIRQ;
+	pSig->pOwner = pOwner;
+	m_vSignals.push_back(std::move(pSig));
+}
+
+// Called from the AVR thread(s) on every value change of a hooked signal.
+void TelemetryStream::OnSignal(const Signal &sig, uint32_t value)
+{
+	if (sig.uiSubs == 0)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_lockSamples);
+	if (m_vSamples.size() < MAX_PENDING)
+	{
+		m_vSamples.push_back({avr_cycles_to_nsec(sig.pOwner, sig.pOwner->cycle), sig.uiID, value});
+	}
+	else
+	{
+		m_uiDropped++;
+	}
+}
+
+avr_cycle_count_t TelemetryStream::OnBatchTimer(avr_t *avr, avr_cycle_count_t when)
+{
+	// Notifies are only registered from the AVR thread, the server just flags what it wants.
+	{
+		std::lock_guard<std::mutex> lock(m_lockSignals);
+		for (auto &pSig : m_vSignals)
+		{
+			if (pSig->bWantHook && !pSig->bHooked)
+			{
+				auto fcnNotify = [](avr_irq_t*, uint32_t value, void *param) { auto *p = static_cast<Signal*>(param); p->pStream->OnSignal(*p, value); };
+				avr_irq_register_notify(pSig->pIRQ, fcnNotify, pSig.get());
+				pSig->bHooked = true;
+				OnSignal(*pSig, pSig->pIRQ->value); // Give the subscriber a starting value.
+			}
+		}
+	}
+	std::lock_guard<std::mutex> lock(m_lockSamples);
+	if (m_vReady.empty())
+	{
+		m_vReady.swap(m_vSamples);
+	}
+	else if (m_vReady.size() + m_vSamples.size() < MAX_PENDING)
+	{
+		m_vReady.insert(m_vReady.end(), m_vSamples.begin(), m_vSamples.end());
+		m_vSamples.clear();
+	}
+	else
+	{
+		m_uiDropped += m_vSamples.size();
+		m_vSamples.clear();
+	}
+	return when + m_uiBatchCycles;
+}
+
+void TelemetryStream::OnAVRReset()
+{
+	RegisterTimer(m_fcnBatch, m_uiBatchCycles, this);
+}
+
+void* TelemetryStream::Run()
+{
+	std::vector<pollfd> vFds;
+	std::vector<Sample> vBatch;
+	while (!m_bQuit)
+	{
+		vFds.clear();
+		vFds.push_back({m_fdListen, POLLIN, 0});
+		for (auto &client : m_vClients)
+		{
+			vFds.push_back({client.fd, POLLIN, 0});
+		}
+		int iReady = poll(vFds.data(), vFds.size(), 10);
+		if (iReady < 0 && errno != EINTR)
+		{
+			perror("Telemetry: poll");
+			break;
+		}
+		if (iReady > 0)
+		{
+			if (vFds.front().revents & POLLIN) //NOLINT - system flags are signed.
+			{
+				Accept();
+			}
+			for (size_t i=1; i<vFds.size(); i++)
+			{
+				if (vFds.at(i).revents != 0 && !ReadClient(m_vClients.at(i-1)))
+				{
+					DropClient(m_vClients.at(i-1));
+				}
+			}
+			m_vClients.erase(std::remove_if(m_vClients.begin(), m_vClients.end(), [](const Client &c) { return c.fd < 0; }), m_vClients.end());
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_lockSamples);
+			vBatch.swap(m_vReady);
+		}
+		if (!vBatch.empty())
+		{
+			SendBatch(vBatch);
+			vBatch.clear();
+		}
+	}
+	return nullptr;
+}
+
+void TelemetryStream::Accept()
+{
+	int fd = accept(m_fdListen, nullptr, nullptr);
+	if (fd < 0)
+	{
+		return;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK); // NOLINT - vararg system call.
+	if (m_vClients.size() >= MAX_CLIENTS)
+	{
+		Send(fd, "error too many clients\n");
+		close(fd);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_lockSignals);
+		m_vClients.push_back({fd, std::vector<bool>(m_vSignals.size(), false), ""});
+	}
+	Send(fd, "MK404 telemetry 1\n");
+}
+
+bool TelemetryStream::ReadClient(Client &client)
+{
+	std::array<char,256> buff {};
+	auto iRead = read(client.fd, buff.data(), buff.size());
+	if (iRead <= 0)
+	{
+		return iRead < 0 && errno == EAGAIN;
+	}
+	client.strRx.append(buff.data(), iRead);
+	size_t pos = 0;
+	while ((pos = client.strRx.find('\n')) != std::string::npos)
+	{
+		ProcessCommand(client, client.strRx.substr(0, pos));
+		client.strRx.erase(0, pos+1);
+	}
+	return client.strRx.size() < buff.size(); // Don't let a client buffer junk forever.
+}
+
+void TelemetryStream::ProcessCommand(Client &client, const std::string &strCmd)
+{
+	if (strCmd == "list")
+	{
+		std::string strOut;
+		{
+			std::lock_guard<std::mutex> lock(m_lockSignals);
+			for (auto &pSig : m_vSignals)
+			{
+				strOut += "signal " + std::to_string(pSig->uiID) + ' ' + pSig->strName + '\n';
+			}
+		}
+		// Sends block for a slow client, and the AVR thread wants m_lockSignals on every batch.
+		Send(client.fd, strOut + "end\n");
+	}
+	else if (strCmd.compare(0, 4, "sub ") == 0)
+	{
+		Subscribe(client, strCmd.substr(4), true);
+	}
+	else if (strCmd.compare(0, 6, "unsub ") == 0)
+	{
+		Subscribe(client, strCmd.substr(6), false);
+	}
+	else if (!strCmd.empty())
+	{
+		Send(client.fd, "error unknown command " + strCmd + '\n');
+	}
+}
+
+void TelemetryStream::Subscribe(Client &client, const std::string &strPrefix, bool bSub)
+{
+	std::string strOut;
+	{
+		std::lock_guard<std::mutex> lock(m_lockSignals);
+		client.vSubs.resize(m_vSignals.size(), false); // Signals may have been added after connecting.
+		for (auto &pSig : m_vSignals)
+		{
+			if (pSig->strName.rfind(strPrefix, 0) != 0 || client.vSubs.at(pSig->uiID) == bSub)
+			{
+				continue;
+			}
+			client.vSubs.at(pSig->uiID) = bSub;
+			if (bSub)
+			{
+				pSig->uiSubs++;
+				pSig->bWantHook = true;
+			}
+			else
+			{
+				pSig->uiSubs--;
+			}
+			strOut += (bSub ? "+ " : "- ") + std::to_string(pSig->uiID) + ' ' + pSig->strName + '\n';
+		}
+	}
+	Send(client.fd, strOut);
+}
+
+void TelemetryStream::SendBatch(const std::vector<Sample> &vBatch)
+{
+	for (auto &client : m_vClients)
+	{
+		std::string strOut;
+		size_t uiCount = 0;
+		for (auto &sample : vBatch)
+		{
+			if (sample.uiID < client.vSubs.size() && client.vSubs.at(sample.uiID))
+			{
+				strOut += std::to_string(sample.uiTimeNs) + ' ' + std::to_string(sample.uiID) + ' ' + std::to_string(sample.uiValue) + '\n';
+				uiCount++;
+			}
+		}
+		if (uiCount && !Send(client.fd, "batch " + std::to_string(uiCount) + '\n' + strOut))
+		{
+			DropClient(client);
+		}
+	}
+	m_vClients.erase(std::remove_if(m_vClients.begin(), m_vClients.end(), [](const Client &c) { return c.fd < 0; }), m_vClients.end());
+}
+
+void TelemetryStream::DropClient(Client &client)
+{
+	std::lock_guard<std::mutex> lock(m_lockSignals);
+	for (size_t i=0; i<client.vSubs.size(); i++)
+	{
+		if (client.vSubs.at(i))
+		{
+			m_vSignals.at(i)->uiSubs--;
+		}
+	}
+	close(client.fd);
+	client.fd = -1;
+}
+
+bool TelemetryStream::Send(int fd, const std::string &strData)
+{
+	size_t uiSent = 0;
+	while (uiSent < strData.size())
+	{
+		auto iOut = send(fd, strData.data() + uiSent, strData.size() - uiSent, MSG_NOSIGNAL);
+		if (iOut < 0)
+		{
+			if (errno == EAGAIN || errno == EINTR)
+			{
+				pollfd pfd {fd, POLLOUT, 0};
+				if (poll(&pfd, 1, 100) <= 0) // A client that stalls for 100ms gets dropped.
+				{
+					return false;
+				}
+				continue;
+			}
+			return false;
+		}
+		uiSent += iOut;
+	}
+	return true;
+}
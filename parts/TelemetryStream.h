@@ -0,0 +1,136 @@
+/*
+	TelemetryStream.h - Live telemetry streaming over a Unix domain socket.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "BasePeripheral.h"    // for BasePeripheral, MAKE_C_TIMER_CALLBACK
+#include "sim_avr.h"           // for avr_t
+#include "sim_avr_types.h"     // for avr_cycle_count_t
+#include "sim_cycle_timers.h"  // for avr_cycle_timer_t
+#include "sim_irq.h"           // for avr_irq_t
+#include <atomic>
+#include <cstdint>            // for uint32_t, uint16_t
+#include <memory>              // for unique_ptr
+#include <mutex>
+#include <pthread.h>           // for pthread_t
+#include <string>              // for string
+#include <vector>              // for vector
+
+// Streams selected telemetry signals to any number of local subscribers.
+// Clients connect to the socket and send newline-terminated commands:
+//   list           - lists all available signals as "signal <id> <name>", terminated by "end"
+//   sub <prefix>   - subscribes to all signals starting with prefix, replies "+ <id> <name>" for each
+//   unsub <prefix> - removes a subscription, replies "- <id> <name>" for each
+// Samples are delivered in batches: a "batch <count>" header followed by <count>
+// lines of "<time_ns> <id> <value>", with time in simulated nanoseconds.
+class TelemetryStream: public BasePeripheral
+{
+	public:
+		enum IRQ {
+			COUNT
+		};
+
+		const char *_IRQNAMES[IRQ::COUNT] = {
+		};
+
+		TelemetryStream() = default;
+
+		~TelemetryStream();
+
+		// Opens the socket and starts the server thread. Batches are handed
+		// to the server every uiBatchUs of simulated time.
+		bool Init(avr_t *pAVR, const std::string &strSocket, uint32_t uiBatchUs = 10000);
+
+		// Makes a named IRQ available to subscribers. Its samples are timed by pOwner, the AVR it belongs to.
+		void AddSignal(const std::string &strName, avr_irq_t *pIRQ, avr_t *pOwner);
+
+		// Shuts down the server thread and removes the socket.
+		void Stop();
+
+		inline bool IsStarted() { return m_thread != 0; }
+
+	private:
+		struct Signal
+		{
+			TelemetryStream *pStream;
+			uint16_t uiID;
+			std::string strName;
+			avr_irq_t *pIRQ;
+			avr_t *pOwner;
+			std::atomic_uint uiSubs {0};
+			std::atomic_bool bWantHook {false};
+			bool bHooked = false;
+		};
+
+		struct Sample
+		{
+			uint64_t uiTimeNs;
+			uint16_t uiID;
+			uint32_t uiValue;
+		};
+
+		struct Client
+		{
+			int fd;
+			std::vector<bool> vSubs;
+			std::string strRx;
+		};
+
+		void* Run();
+
+		void OnSignal(const Signal &sig, uint32_t value);
+
+		avr_cycle_count_t OnBatchTimer(avr_t *avr, avr_cycle_count_t when);
+		avr_cycle_timer_t m_fcnBatch = MAKE_C_TIMER_CALLBACK(TelemetryStream, OnBatchTimer);
+
+		// A reset flushes the batch timer, start it again.
+		void OnAVRReset();
+		ResetHook m_reset {MAKE_C_RESET_CALLBACK(TelemetryStream, OnAVRReset), this};
+
+		// Server thread helpers:
+		void Accept();
+		bool ReadClient(Client &client);
+		void ProcessCommand(Client &client, const std::string &strCmd);
+		void Subscribe(Client &client, const std::string &strPrefix, bool bSub);
+		void SendBatch(const std::vector<Sample> &vBatch);
+		void DropClient(Client &client);
+		static bool Send(int fd, const std::string &strData);
+
+		std::string m_strSocket;
+		int m_fdListen = -1;
+		avr_cycle_count_t m_uiBatchCycles = 0;
+
+		pthread_t m_thread = 0;
+		std::atomic_bool m_bQuit = {false};
+
+		std::mutex m_lockSignals;
+		std::vector<std::unique_ptr<Signal>> m_vSignals;
+
+		// Samples are gathered in the AVR thread and handed off to the server on the batch timer.
+		std::mutex m_lockSamples;
+		std::vector<Sample> m_vSamples, m_vReady;
+		uint64_t m_uiDropped = 0;
+
+		std::vector<Client> m_vClients;
+
+		static constexpr size_t MAX_PENDING = 1U<<18U;
+		static constexpr size_t MAX_CLIENTS = 16;
+};
@@ -143,6 +143,8 @@ namespace Boards
 
 		m_ht.ConnectTo(Heater::TEMP_OUT, m_tAmb.GetIRQ(Thermistor::TEMP_IN));
 		m_htUV.ConnectTo(Heater::TEMP_OUT, m_tUV.GetIRQ(Thermistor::TEMP_IN));
+		m_tAmb.ConnectTo(Thermistor::TEMP_REQ_OUT, m_ht.GetIRQ(Heater::TEMP_REQ_IN));
+		m_tUV.ConnectTo(Thermistor::TEMP_REQ_OUT, m_htUV.GetIRQ(Heater::TEMP_REQ_IN));
 
 		#ifndef __APPLE__ // pragma: LCOV_EXCL_START
 			m_usb = usbip_create(m_pAVR);
@@ -20,6 +20,7 @@
 
 #include "3rdParty/MK3/thermistortables.h"  // for OVERSAMPLENR, temptable_1, temptable_2000
 #include "EinsyRambo.h"
+#include "Config.h"             // for Config
 #include "Einsy_1_1a.h"        // for Einsy_1_1a
 #include "HD44780.h"           // for HD44780
 #include "PinNames.h"          // for Pin, Pin::BTN_ENC, Pin::W25X20CL_PIN_CS
@@ -56,6 +57,7 @@ namespace Boards
 
 		AddHardware(m_Mon0,'0');
 		AddHardware(m_Mon1,'1');
+		AddHardware(m_Host0,'0');
 
 		// SD card
 		std::string strSD = GetSDCardFile();
@@ -107,14 +109,20 @@ namespace Boards
 
 		AddHardware(hBed, nullptr, GetDIRQ(HEATER_BED_PIN));
 		hBed.ConnectTo(Heater::TEMP_OUT, tBed.GetIRQ(Thermistor::TEMP_IN));
+		tBed.ConnectTo(Thermistor::TEMP_REQ_OUT, hBed.GetIRQ(Heater::TEMP_REQ_IN));
 
 		if ( m_bNoHacks )
 		{
 			hBed.SetSoftPWM(false);
 		}
 
+		if (Config::Get().GetHotendLag() > 0)
+		{
+			hExtruder.AddNode(Config::Get().GetHotendLag());
+		}
 		AddHardware(hExtruder, nullptr, GetDIRQ(HEATER_0_PIN));
 		hExtruder.ConnectTo(Heater::TEMP_OUT, tExtruder.GetIRQ(Thermistor::TEMP_IN));
+		tExtruder.ConnectTo(Thermistor::TEMP_REQ_OUT, hExtruder.GetIRQ(Heater::TEMP_REQ_IN));
 
 		AddHardware(m_buzzer);
 		m_buzzer.ConnectFrom(GetDIRQ(BEEPER),Beeper::DIGITAL_IN);
@@ -30,6 +30,7 @@
 #include "LED.h"                                 // for LED
 #include "Macros.h"
 #include "PINDA.h"                               // for PINDA
+#include "PrintHost.h"                           // for PrintHost
 #include "RotaryEncoder.h"                       // for RotaryEncoder
 #include "SDCard.h"                              // for SDCard
 #include "SerialLineMonitor.h"                   // for SerialLineMonitor
@@ -80,6 +81,7 @@ namespace Boards
 			uart_pty UART0, UART1, UART2;
 			SerialLineMonitor m_Mon0 = SerialLineMonitor("Serial0");
 			SerialLineMonitor m_Mon1 = SerialLineMonitor("Serial1");
+			PrintHost m_Host0 {"PrintHost"};
 			Thermistor tExtruder, tBed, tPinda, tAmbient;
 			Fan fExtruder {3300,'E'}, fPrint {5000,'P',true};
 			Heater hExtruder = {1.5,25.0,false,'H',30,250},
@@ -21,6 +21,7 @@
 #include "MiniRambo.h"
 #include "3rdParty/MK3/thermistortables.h"  // for OVERSAMPLENR, temptable_1, temptable_2000
 #include "Beeper.h"
+#include "Config.h"
 #include "HD44780.h"           // for HD44780
 #include "LED.h"
 #include "PinNames.h"          // for Pin, Pin::BTN_ENC, Pin::W25X20CL_PIN_CS
@@ -60,6 +61,7 @@ namespace Boards
 		AddHardware(UART0,'0');
 
 		AddHardware(m_Mon0,'0');
+		AddHardware(m_Host0,'0');
 
 		AddHardware(lcd);
 		// D4-D7,
@@ -93,9 +95,15 @@ namespace Boards
 
 		AddHardware(hBed, nullptr, GetDIRQ(HEATER_BED_PIN));
 		hBed.ConnectTo(Heater::TEMP_OUT, tBed.GetIRQ(Thermistor::TEMP_IN));
+		tBed.ConnectTo(Thermistor::TEMP_REQ_OUT, hBed.GetIRQ(Heater::TEMP_REQ_IN));
 
+		if (Config::Get().GetHotendLag() > 0)
+		{
+			hExtruder.AddNode(Config::Get().GetHotendLag());
+		}
 		AddHardware(hExtruder, nullptr, GetDIRQ(HEATER_0_PIN));
 		hExtruder.ConnectTo(Heater::TEMP_OUT, tExtruder.GetIRQ(Thermistor::TEMP_IN));
+		tExtruder.ConnectTo(Thermistor::TEMP_REQ_OUT, hExtruder.GetIRQ(Heater::TEMP_REQ_IN));
 
 		AddHardware(m_buzzer);
 		m_buzzer.ConnectFrom(GetDIRQ(BEEPER),Beeper::DIGITAL_IN);
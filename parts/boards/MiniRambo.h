@@ -30,6 +30,7 @@
 #include "LED.h"
 #include "MMU1.h"
 #include "PINDA.h"
+#include "PrintHost.h"
 #include "RotaryEncoder.h"
 #include "SDCard.h"
 #include "SerialLineMonitor.h"
@@ -77,6 +78,7 @@ namespace Boards
 			MMU1 m_mmu;
 
 			SerialLineMonitor m_Mon0 {"Serial0"};
+			PrintHost m_Host0 {"PrintHost"};
 
 		private:
 
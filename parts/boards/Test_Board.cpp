@@ -37,6 +37,7 @@ namespace Boards
 		DisableInterruptLevelPoll(8);
 
 		AddHardware(m_Monitor,'0');
+		AddHardware(m_host,'0');
 
 		AddHardware(encoder);
 		TryConnect(&encoder, RotaryEncoder::OUT_A, BTN_EN2);
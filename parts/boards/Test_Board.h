@@ -37,6 +37,7 @@
 #include "MMU1.h"
 #include "PAT9125.h"
 #include "PINDA.h"                               // for PINDA
+#include "PrintHost.h"                           // for PrintHost
 #include "RotaryEncoder.h"                       // for RotaryEncoder
 #include "SDCard.h"                              // for SDCard
 #include "SerialLineMonitor.h"                   // for SerialLineMonitor
@@ -78,6 +79,8 @@ namespace Boards
 
 			SerialLineMonitor m_Monitor {"Serial0"};
 
+			PrintHost m_host;
+
 			IRSensor m_IR;
 
 			w25x20cl m_spiFlash;
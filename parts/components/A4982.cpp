@@ -20,6 +20,7 @@
  */
 
 #include "A4982.h"
+#include "Config.h"
 #include "TelemetryHost.h"
 #include <algorithm>          // for min
 #include <atomic>
@@ -68,6 +69,33 @@ void A4982::OnStepIn(struct avr_irq_t * /*irq*/, uint32_t value)
 	std::memcpy(&posOut, &m_fCurPos, sizeof(posOut)); // both 32 bits, just mangle it for sending over the wire.
     RaiseIRQ(POSITION_OUT, posOut);
 	RaiseIRQ(STEP_POS_OUT, m_iCurStep);
+	if (m_uiPosPeriod == 0)
+	{
+		RaiseIRQ(POSITION_COARSE_OUT, posOut);
+	}
+	else if (!m_bPosPending)
+	{
+		m_bPosPending = true;
+		RegisterTimer(m_fcnPosPublish, m_uiPosPeriod, this);
+	}
+}
+
+avr_cycle_count_t A4982::OnPosPublish(struct avr_t *,avr_cycle_count_t)
+{
+	m_bPosPending = false;
+	float fPos = m_fCurPos;
+	uint32_t posOut;
+	std::memcpy(&posOut, &fPos, sizeof(posOut));
+	RaiseIRQ(POSITION_COARSE_OUT, posOut);
+	return 0;
+}
+
+void A4982::OnAVRReset()
+{
+	if (m_bPosPending)
+	{
+		OnPosPublish(m_pAVR, m_pAVR->cycle);
+	}
 }
 
 void A4982::CheckEndstops()
@@ -123,11 +151,12 @@ void A4982::OnSleepIn(avr_irq_t */*irq*/, uint32_t value)
 	if (value)
 	{
 		m_bSleep = true;
+		m_wakeup.Clear();
 	}
 	else
 	{
 		// per datasheet, wake 1ms after line goes low.
-		RegisterTimerUsec(m_fcnWakeup,1000,this);
+		m_wakeup.SetUsec(m_pAVR,1000);
 	}
 }
 
@@ -181,8 +210,14 @@ void A4982::OnMSIn(avr_irq_t *irq, uint32_t value)
 void A4982::Init(struct avr_t * avr)
 {
     _Init(avr, this);
+	m_reset.Attach(avr);
 	ReparseConfig();
 
+	if (Config::Get().GetPosPublishRate() > 0)
+	{
+		m_uiPosPeriod = avr->frequency/Config::Get().GetPosPublishRate();
+	}
+
 	m_bConfigured = true;
 
 	GetIRQ(MIN_OUT)->flags |= IRQ_FLAG_FILTERED; // Don't re-raise if already at value.
@@ -213,6 +248,7 @@ void A4982::Init(struct avr_t * avr)
 	TH.AddTrace(this, SLEEP_IN,{TC::OutputPin, TC::Stepper});
 	TH.AddTrace(this, MAX_OUT,{TC::InputPin, TC::Stepper});
 	TH.AddTrace(this, MIN_OUT,{TC::InputPin, TC::Stepper});
+	TH.AddTrace(this, POSITION_COARSE_OUT,{TC::Stepper},32);
 }
 
 float A4982::StepToPos(int32_t step)
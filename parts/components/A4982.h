@@ -45,7 +45,8 @@ class A4982: public BasePeripheral, public GLMotor
 			_IRQ(MIN_OUT,	       	">A4982.min_endstop") \
 			_IRQ(MAX_OUT,	       	">A4982.max_endstop") \
 			_IRQ(POSITION_OUT,		">A4982.position") \
-			_IRQ(STEP_POS_OUT,		">A4982.step_out")
+			_IRQ(STEP_POS_OUT,		">A4982.step_out") \
+			_IRQ(POSITION_COARSE_OUT,	">A4982.position_coarse")
 		#include "IRQHelper.h"
 
 		struct A4982_cfg_t {
@@ -84,6 +85,16 @@ class A4982: public BasePeripheral, public GLMotor
 		avr_cycle_count_t OnWakeup(struct avr_t * avr, avr_cycle_count_t when);
 
 		avr_cycle_timer_t m_fcnWakeup = MAKE_C_TIMER_CALLBACK(A4982,OnWakeup);
+		DeadlineTimer m_wakeup {m_fcnWakeup, this};
+
+		// Coalesced position for visuals, see Config::GetPosPublishRate
+		avr_cycle_count_t OnPosPublish(struct avr_t * avr, avr_cycle_count_t when);
+		avr_cycle_timer_t m_fcnPosPublish = MAKE_C_TIMER_CALLBACK(A4982,OnPosPublish);
+		avr_cycle_count_t m_uiPosPeriod = 0;
+		bool m_bPosPending = false;
+		// A reset drops the publish timer; put out the pending position instead.
+		void OnAVRReset();
+		ResetHook m_reset {MAKE_C_RESET_CALLBACK(A4982,OnAVRReset), this};
 
 		bool m_bDir  = false;
 		bool m_bReset = false;
@@ -24,14 +24,9 @@
 #include "gsl-lite.hpp"
 #include "sim_avr.h"     // for avr_t
 #include "sim_io.h"      // for avr_ioctl
-#include <algorithm>     // for copy, fill, max
-#include <cstdlib>      // for malloc, exit, free, size_t
-#include <fstream>       // IWYU pragma: keep
+#include <algorithm>     // for copy, all_of
 #include <iostream>       // for perror, printf, fprintf, stderr
 
-using std::ifstream;
-using std::ofstream;
-
 EEPROM::EEPROM():Scriptable("EEPROM")
 {
 	RegisterAction("Poke","Pokes a value into the EEPROM. Args are (address,value)", ActPoke, {ArgType::Int, ArgType::Int});
@@ -46,45 +41,78 @@ EEPROM::EEPROM(struct avr_t * avr, const std::string &strFile):EEPROM()
 	Load(avr, strFile);
 };
 
+// simavr has no setter for the EEPROM buffer, so find its peripheral to point it at the file.
+static avr_eeprom_t* GetSimEEPROM(avr_t *avr)
+{
+	for (avr_io_t *pIO = avr->io_port; pIO != nullptr; pIO = pIO->next)
+	{
+		if (std::string(pIO->kind) == "eeprom")
+		{
+			return reinterpret_cast<avr_eeprom_t*>(pIO); //NOLINT - io is the first member
+		}
+	}
+	return nullptr;
+}
+
 void EEPROM::Load(struct avr_t *avr, const std::string &strFile)
 {
+	Unload();
 	m_strFile = strFile;
 	m_pAVR = avr;
-	Load();
+	m_vSaved.clear();
+	Map();
 }
 
-void EEPROM::Load()
+void EEPROM::Map()
 {
 	m_uiSize = m_pAVR->e2end + 1;
+	auto *pEE = GetSimEEPROM(m_pAVR);
+	if (pEE == nullptr || !m_file.Map(m_strFile, m_uiSize))
+	{
+		std::cerr << "ERROR: Could not map EEPROM file. EEPROM contents were NOT restored" << '\n';
+		return;
+	}
+	auto data = m_file.GetData();
+	bool bEmpty = std::all_of(data.begin(), data.end(), [](uint8_t b) { return b==0; });
+	if (m_file.IsNew() || bEmpty) // If the file was newly created (all null) this keeps the internal eeprom full of 0xFFs.
+	{
+		std::copy(pEE->eeprom, pEE->eeprom + m_uiSize, data.begin()); //NOLINT - eeprom is a raw buffer
+	}
+	m_pSimEE = pEE->eeprom;
+	pEE->eeprom = data.data();
+	std::cout << "Mapped " << m_uiSize << " bytes of EEPROM from " << m_strFile;
+	if (m_file.IsPrivate())
+	{
+		std::cout << " (read-only or in use, changes will NOT persist)";
+	}
+	std::cout << '\n';
+}
 
-    ifstream fsIn(m_strFile, fsIn.binary | fsIn.ate);
-	if (!fsIn.is_open() || fsIn.tellg() < m_pAVR->e2end) {
-		std::cerr << "ERROR: Could not open flash file. Flash contents were NOT restored" << '\n';
+void EEPROM::Unload()
+{
+	if (m_pSimEE == nullptr)
+	{
+		return;
 	}
-	else
+	auto data = m_file.GetData();
+	std::copy(data.begin(), data.end(), m_pSimEE);
+	GetSimEEPROM(m_pAVR)->eeprom = m_pSimEE;
+	m_pSimEE = nullptr;
+	m_file.Sync();
+	m_file.Unmap();
+}
+
+void EEPROM::Load()
+{
+	if (m_vSaved.empty())
 	{
-		std::cout << "Loading " << m_uiSize  <<" bytes of EEPROM\n";
-		std::vector<uint8_t> vEE;
-		vEE.resize(m_uiSize,0);
-		avr_eeprom_desc_t io {.ee= vEE.data(), .offset = 0, .size = m_uiSize};
-		fsIn.seekg(fsIn.beg);
-		fsIn.read(reinterpret_cast<char*>(vEE.data()), m_uiSize); //NOLINT maybe if fstream supported unsigned chars...
-		std::cout << "Read " << fsIn.tellg() << " bytes\n";
-		if (fsIn.fail() || fsIn.gcount() != m_uiSize) {
-			std::cerr << "Unable to load EEPROM\n";
-			exit(1);
-		}
-		bool bEmpty = true;
-		for (auto &b : vEE)
-		{
-			bEmpty &= b==0;
-		}
-		if (!bEmpty) // If the file was newly created (all null) this leaves the internal eeprom as full of 0xFFs.
-		{
-			avr_ioctl(m_pAVR, AVR_IOCTL_EEPROM_SET,&io); //NOLINT- complaint is external macro
-		}
+		// The mapping is the file, there's nothing older to go back to.
+		std::cout << "EEPROM has not been saved, contents unchanged\n";
+		return;
 	}
-	fsIn.close();
+	avr_eeprom_desc_t io {.ee= m_vSaved.data(), .offset = 0, .size = m_uiSize};
+	avr_ioctl(m_pAVR, AVR_IOCTL_EEPROM_SET,&io); //NOLINT- complaint is external macro
+	std::cout << "Restored " << m_uiSize << " bytes of EEPROM\n";
 }
 
 void EEPROM::Clear()
@@ -97,24 +125,17 @@ void EEPROM::Clear()
 
 void EEPROM::Save()
 {
-	// Write out the EEPROM contents:
-	ofstream fsOut(m_strFile, fsOut.binary | fsOut.out | fsOut.trunc);
-	if (!fsOut.is_open())
+	m_vSaved.resize(m_uiSize,0);
+	avr_eeprom_desc_t io {.ee= m_vSaved.data(), .offset = 0, .size = m_uiSize};
+	//NOLINTNEXTLINE - complaint is external macro
+	avr_ioctl(m_pAVR,AVR_IOCTL_EEPROM_GET,&io);
+	if (!m_file.IsMapped() || m_file.IsPrivate())
 	{
-		std::cerr << "Failed to open EEPROM output file\n";
+		std::cerr << "EEPROM file is not writable, contents were NOT saved\n";
 		return;
 	}
-	std::vector<uint8_t> vEE;
-	vEE.resize(m_uiSize,0);
-	avr_eeprom_desc_t io {.ee= vEE.data(), .offset = 0, .size = m_uiSize};
-	//NOLINTNEXTLINE - complaint is external macro
-	avr_ioctl(m_pAVR,AVR_IOCTL_EEPROM_GET,&io); // Should net a pointer to eeprom[0]
-	fsOut.write(reinterpret_cast<char*>(vEE.data()),m_uiSize); //NOLINT maybe if fstream supported unsigned chars...
-	std::cout << "Wrote "<< fsOut.tellp() <<" bytes of EEPROM to " << m_strFile <<'\n';
-	if (fsOut.tellp() != m_uiSize) {
-		std::cerr << "Unable to write EEPROM memory\n";
-	}
-	fsOut.close();
+	m_file.Sync();
+	std::cout << "Synced "<< m_uiSize <<" bytes of EEPROM to " << m_strFile <<'\n';
 }
 
 Scriptable::LineStatus EEPROM::ProcessAction(unsigned int uiAct, const std::vector<std::string> &vArgs)
@@ -24,6 +24,7 @@
 
 #include "BasePeripheral.h"  // for BasePeripheral
 #include "IScriptable.h"     // for ArgType, ArgType::Int, IScriptable::Line...
+#include "MappedFile.h"      // for MappedFile
 #include "Scriptable.h"      // for Scriptable
 #include <cstdint>          // for uint16_t, uint8_t
 #include <string>            // for string
@@ -36,15 +37,18 @@ class EEPROM: public BasePeripheral, public Scriptable {
 	// Loads EEPROM from a file or initializes the file for the first time.
 	EEPROM(struct avr_t * avr, const std::string &strFile);
 
-	// Loads the given file.
+	// Maps the given file as the AVR's EEPROM. Writes reach the file as they happen.
 	void Load(struct avr_t * avr, const std::string &strFile);
 
-	// Reloads last file:
+	// Reverts to the contents as of the last Save.
 	void Load();
 
-	// Saves EEPROM to the file
+	// Flushes EEPROM to the file and remembers the contents for Load.
 	void Save();
 
+	// Flushes and hands the EEPROM back to the AVR's own buffer. Call before the AVR is terminated.
+	void Unload();
+
 	// Clears the contents to 0xFF
 	void Clear();
 
@@ -63,8 +67,13 @@ class EEPROM: public BasePeripheral, public Scriptable {
 
 
 	private:
+		void Map();
+
 		std::string m_strFile;
 		uint16_t m_uiSize = 4096;
+		MappedFile m_file;
+		uint8_t *m_pSimEE = nullptr; // The AVR's own buffer while the file is mapped.
+		std::vector<uint8_t> m_vSaved;
 		enum Actions {
 			ActPoke,
 			ActSave,
@@ -24,34 +24,35 @@
 #include "TelemetryHost.h"
 #include "avr_uart.h"  // for ::UART_IRQ_OUTPUT, AVR_IOCTL_UART_GETIRQ
 #include "sim_io.h"    // for avr_io_getirq
-#include <algorithm>        // for copy
 #include <iostream>     // for printf
 
 void GCodeSniffer::OnByteIn(struct avr_irq_t *, uint32_t value)
 {
-    unsigned char c = value & 0xFFU;
-	if (m_bNewLine && c==m_chrCode)
+	if (m_tokenizer.Feed(static_cast<char>(value & 0xFFU)))
 	{
-		m_bCapture = true;
-		return;
+		OnCommand(m_tokenizer.GetCommand());
 	}
+}
 
-	m_bNewLine = (c == 0x0a);
-
-	if (m_bCapture)
+void GCodeSniffer::OnCommand(const GCodeCommand &cmd)
+{
+	if (cmd.chrLetter == m_chrCode && cmd.iCode >= 0)
+	{
+		std::cout << "Captured code " << cmd.iCode << '\n';
+		RaiseIRQ(CODEVAL_OUT, cmd.iCode);
+	}
+	RaiseIRQ(CMD_OUT, CommandValue(cmd.chrLetter, cmd.iCode));
+	if (cmd.iLine >= 0)
+	{
+		RaiseIRQ(LINE_OUT, cmd.iLine);
+	}
+	if (cmd.bHasChecksum && !cmd.bChecksumOK)
+	{
+		RaiseIRQ(CHECKSUM_ERR_OUT, ++m_uiBadChecksums);
+	}
+	for (auto &fcn : m_vSubscribers)
 	{
-		if (c == ' ' || m_bNewLine)
-		{
-			m_bCapture = false;
-			std::cout << "Captured code " << m_strLine << '\n';
-			uint32_t uiOut = stoi(m_strLine);
-			RaiseIRQ(CODEVAL_OUT,uiOut);
-			m_strLine.clear();
-		}
-		else
-		{
-			m_strLine.push_back(c);
-		}
+		fcn(cmd);
 	}
 }
 
@@ -71,4 +72,7 @@ void GCodeSniffer::Init(struct avr_t * avr, unsigned char chrUART)
     std::cout << "UART " << m_chrUART << " is now being monitored for '" << m_chrCode << "'" << '\n';
 
 	TelemetryHost::GetHost().AddTrace(this, CODEVAL_OUT, {TC::Misc, TC::Serial},8);
+	TelemetryHost::GetHost().AddTrace(this, CMD_OUT, {TC::Misc, TC::Serial},32);
+	TelemetryHost::GetHost().AddTrace(this, LINE_OUT, {TC::Misc, TC::Serial},32);
+	TelemetryHost::GetHost().AddTrace(this, CHECKSUM_ERR_OUT, {TC::Misc, TC::Serial},32);
 }
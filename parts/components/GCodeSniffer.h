@@ -23,20 +23,37 @@
 #pragma once
 
 #include "BasePeripheral.h"  // for BasePeripheral
+#include "GCodeTokenizer.h"  // for GCodeTokenizer, GCodeCommand
 #include "sim_avr.h"         // for avr_t
 #include "sim_irq.h"         // for avr_irq_t
 #include <cstdint>          // for uint32_t
+#include <functional>        // for function
 #include <string>            // for string
+#include <vector>            // for vector
 
+// Decodes the G-code going out of a UART. Every decoded line goes to the subscribers and
+// updates the command/line telemetry; CODEVAL_OUT carries the number of the sniffed command
+// (e.g. T for tool changes). The IRQ outputs are for tracing and only show changes, so a
+// repeat of the same line is only seen by subscribers.
 class GCodeSniffer : public BasePeripheral
 {
 	public:
-		#define IRQPAIRS _IRQ(BYTE_IN,"8<logger.in") _IRQ(CODEVAL_OUT, "8>val_out")
+		#define IRQPAIRS _IRQ(BYTE_IN,"8<logger.in") _IRQ(CODEVAL_OUT, "8>val_out") \
+			_IRQ(CMD_OUT, "32>cmd_out") _IRQ(LINE_OUT, "32>line_out") _IRQ(CHECKSUM_ERR_OUT, "32>cksum_err")
 		#include "IRQHelper.h"
 
 		// Creates a logger that sniffs for
 		explicit GCodeSniffer(unsigned char chrSniff):m_chrCode(chrSniff){};
 
+		// Called for every decoded line. The command is only valid for the duration of the call.
+		inline void AddSubscriber(std::function<void(const GCodeCommand&)> fcn) { m_vSubscribers.push_back(std::move(fcn)); }
+
+		// CMD_OUT value for a command, letter in the upper half.
+		static constexpr uint32_t CommandValue(char chrLetter, int32_t iCode)
+		{
+			return (static_cast<uint32_t>(static_cast<uint8_t>(chrLetter)) << 16U) | (static_cast<uint32_t>(iCode) & 0xFFFFU);
+		}
+
 		// Shuts down the logger/closes file.
 		~GCodeSniffer() = default;
 
@@ -49,9 +66,12 @@ class GCodeSniffer : public BasePeripheral
 
 		void OnByteIn(avr_irq_t *irq, uint32_t value);
 
+		void OnCommand(const GCodeCommand &cmd);
+
 		unsigned char m_chrCode;
-		std::string m_strLine;
-		bool m_bNewLine = false, m_bCapture = false;
+		GCodeTokenizer m_tokenizer;
+		std::vector<std::function<void(const GCodeCommand&)>> m_vSubscribers;
+		uint32_t m_uiBadChecksums = 0;
 		char m_chrUART = '0';
 
 };
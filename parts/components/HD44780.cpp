@@ -33,6 +33,11 @@
 #define TRACE(_w)
 #endif
 
+// A frame is published once writes have stopped for this long...
+static constexpr uint32_t PUBLISH_QUIET_US = 500;
+// ...or this long after the first unpublished write, if they never do.
+static constexpr uint32_t PUBLISH_MAX_US = 20000;
+
 		// Makes a display with the given dimensions.
 HD44780::HD44780(uint8_t width, uint8_t height):Scriptable("LCD"),m_uiHeight(height),m_uiWidth(width)
 {
@@ -67,6 +72,7 @@ void HD44780::ClearScreen()
 		}
 	}
 	SetFlag(HD44780_FLAG_DIRTY, 1);
+	MarkFrameDirty();
 	RaiseIRQ(ADDR, m_uiCursor);
 	for (int i=0; i<m_uiHeight; i++)
 	{
@@ -75,6 +81,49 @@ void HD44780::ClearScreen()
 	m_uiLineChg = 0xFF;
 }
 
+void HD44780::MarkFrameDirty()
+{
+	if (!m_pAVR)
+	{
+		PublishFrame();
+		return;
+	}
+	m_uiLastWrite = m_pAVR->cycle;
+	if (!m_bPublishPending)
+	{
+		m_bPublishPending = true;
+		m_uiFirstWrite = m_uiLastWrite;
+		RegisterTimerUsec(m_fcnPublish, PUBLISH_QUIET_US, this);
+	}
+}
+
+void HD44780::PublishFrame()
+{
+	Frame frame {m_vRam, m_cgRam};
+	m_frame.Publish(frame);
+}
+
+avr_cycle_count_t HD44780::OnPublishTimer(avr_t *avr, avr_cycle_count_t when)
+{
+	avr_cycle_count_t uiQuiet = avr_usec_to_cycles(avr, PUBLISH_QUIET_US);
+	if ((when - m_uiLastWrite) < uiQuiet && (when - m_uiFirstWrite) < avr_usec_to_cycles(avr, PUBLISH_MAX_US))
+	{
+		return m_uiLastWrite + uiQuiet; // Still being written to, look again once it might have settled.
+	}
+	PublishFrame();
+	m_bPublishPending = false;
+	return 0;
+}
+
+void HD44780::OnAVRReset()
+{
+	if (m_bPublishPending)
+	{
+		m_bPublishPending = false;
+		PublishFrame();
+	}
+}
+
 /*
  * This is called when the delay between operation is triggered
  * without the AVR firmware 'reading' the status byte. It
@@ -216,6 +265,7 @@ uint32_t HD44780::OnDataReady()
 	if (m_bInCGRAM)
 	{
 		gsl::at(m_cgRam,m_uiCGCursor) = m_uiDataPins;
+		MarkFrameDirty();
 		TRACE(printf("hd44780_write_data %02x to CGRAM %02x\n",m_uiDataPins,m_uiCGCursor));
 		IncrementCGRAMCursor();
 	}
@@ -225,6 +275,7 @@ uint32_t HD44780::OnDataReady()
 			if (m_uiCursor<m_vRam.size()) // For desync case, it's possible to go OOB.
 			{
 				m_vRam.at(m_uiCursor) = m_uiDataPins;
+				MarkFrameDirty();
 			}
 		}
 
@@ -499,6 +550,7 @@ void HD44780::OnPinChanged(struct avr_irq_t * irq,uint32_t value)
 void HD44780::Init(avr_t *avr)
 {
     _Init(avr,this);
+	m_reset.Attach(avr);
 	/*
 	 * Register callbacks on all our IRQs
 	 */
@@ -510,6 +562,7 @@ void HD44780::Init(avr_t *avr)
 
 	ResetCursor();
     ClearScreen();
+	PublishFrame();
 
 	// printf("LCD: %duS is %d cycles for your AVR\n",
 	// 		37, (int)avr_usec_to_cycles(avr, 37));
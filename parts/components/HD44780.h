@@ -52,6 +52,7 @@
 #include "BasePeripheral.h"    // for MAKE_C_TIMER_CALLBACK, BasePeripheral
 #include "IScriptable.h"       // for ArgType, ArgType::Int, ArgType::String
 #include "Scriptable.h"        // for Scriptable
+#include "SeqLock.h"           // for SeqLock
 #include "sim_avr.h"           // for avr_t
 #include "sim_avr_types.h"     // for avr_cycle_count_t
 #include "sim_cycle_timers.h"  // for avr_cycle_timer_t
@@ -97,11 +98,21 @@ class HD44780:public BasePeripheral, public Scriptable
         inline uint8_t GetHeight() { return m_uiHeight;}
 
     protected:
+		// What the GL thread draws from.
+		struct Frame
+		{
+			std::array<uint8_t,104> ddram;
+			std::array<uint8_t,64> cgram;
+		};
+
     // The GL draw accesses these:
 		std::atomic_uint8_t m_uiHeight = {4};				// width and height of the LCD
         std::atomic_uint8_t	m_uiWidth = {20};
-		std::array<std::atomic_uint8_t,104> m_vRam = {};
-        std::array<std::atomic_uint8_t,64> m_cgRam = {};
+		SeqLock<Frame> m_frame;
+
+		// AVR thread only. Changes reach m_frame in whole frames, see MarkFrameDirty().
+		std::array<uint8_t,104> m_vRam = {};
+        std::array<uint8_t,64> m_cgRam = {};
 
 		LineStatus ProcessAction(unsigned int iAction, const std::vector<std::string> &args) override;
 
@@ -179,6 +190,20 @@ class HD44780:public BasePeripheral, public Scriptable
 
 		avr_cycle_timer_t m_fcnBusy = MAKE_C_TIMER_CALLBACK(HD44780,OnBusyTimeout);
 
+		// Schedules a publish once the firmware stops writing, so a redraw in progress is never shown.
+		void MarkFrameDirty();
+		void PublishFrame();
+		avr_cycle_count_t OnPublishTimer(avr_t *avr, avr_cycle_count_t when);
+
+		avr_cycle_timer_t m_fcnPublish = MAKE_C_TIMER_CALLBACK(HD44780,OnPublishTimer);
+
+		// A reset drops the publish timer; put out what was pending instead.
+		void OnAVRReset();
+		ResetHook m_reset {MAKE_C_RESET_CALLBACK(HD44780,OnAVRReset), this};
+
+		bool m_bPublishPending = false;
+		avr_cycle_count_t m_uiFirstWrite = 0, m_uiLastWrite = 0;
+
         uint16_t m_uiCursor = 0, m_uiCGCursor = 0;			// offset in vram
         bool m_bInCGRAM = false;
 
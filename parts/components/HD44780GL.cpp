@@ -157,7 +157,7 @@ void HD44780GL::GLPutChar(unsigned char c, uint32_t character, uint32_t text, ui
 		{
 			for (int i=0; i<iCols; i++)
 			{
-				pChar[i] = m_cgRam.at(((c & 7U) <<3U)+i);
+				pChar[i] = m_drawFrame.cgram.at(((c & 7U) <<3U)+i);
 			}
 			uiData = pChar.begin(); // m_cgRam.begin() + ((c & 7U) <<3U);
 		}
@@ -220,6 +220,7 @@ void HD44780GL::Draw(
 		uint32_t text,
 		uint32_t shadow, bool bMaterial)
 {
+	m_frame.ReadIfChanged(m_drawFrame, m_uiDrawnGen); // Otherwise keep drawing the last one.
 	uint8_t iCols = m_uiWidth;
 	uint8_t iRows = m_uiHeight;
 	int border = 3;
@@ -245,7 +246,7 @@ void HD44780GL::Draw(
 	for (int v = 0 ; v < m_uiHeight; v++) {
 		glPushMatrix();
 		for (int i = 0; i < m_uiWidth; i++) {
-			GLPutChar(gsl::at(m_vRam,m_lineOffsets.at(v) + i), character, text, shadow, bMaterial);
+			GLPutChar(gsl::at(m_drawFrame.ddram,m_lineOffsets.at(v) + i), character, text, shadow, bMaterial);
 			glTranslatef(6, 0, 0);
 		}
 		glPopMatrix();
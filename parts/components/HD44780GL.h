@@ -76,6 +76,10 @@ class HD44780GL:public HD44780, private IKeyClient
 		std::atomic_uint8_t m_iScheme {0};
 
 		GLuint m_bgVtxBuffer = 0;
+
+		// Last complete frame taken from m_frame, and its generation.
+		Frame m_drawFrame {};
+		uint32_t m_uiDrawnGen = 0;
 		std::vector<uint32_t> m_colors = {
 		0x0066ccff, 0x0a02ebff, 0xFFFFFFff, 0x00000055,
 		0x382200ff, 0x000000ff , 0xFF9900ff, 0x00000055,
@@ -24,8 +24,8 @@
 #include "Heater.h"
 #include "TelemetryHost.h"
 #include "sim_regbit.h"       // for avr_regbit_get, AVR_IO_REGBIT
-#include <algorithm>        // for copy
-#include <cmath>             // for pow
+#include <algorithm>        // for copy, fill
+#include <cmath>             // for exp, abs
 
 #define TRACE(_w)
 #ifndef TRACE
@@ -34,39 +34,136 @@
 #endif
 
 
-avr_cycle_count_t Heater::OnTempTick(avr_t * pAVR, avr_cycle_count_t)
+// Newtonian cooling rate of the old tick model (0.005/s)
+static constexpr double COOL_TAU_S = 200.0;
+
+double Heater::NodeExpr::At(double dT) const
 {
-	if (m_bStopTicking)
+	double dVal = dA + dB*dT;
+	for (auto &e : vExp)
 	{
-		return 0;
+		dVal += e.first*std::exp(-dT/e.second);
 	}
+	return dVal;
+}
 
-    if (m_uiPWM>0 || (pAVR->cycle-m_cntOff)<(pAVR->frequency/100))
-    {
-        float fDelta = (m_fThermalMass*(static_cast<float>(m_uiPWM)/255.0f))*0.3f;
-        m_fCurrentTemp += fDelta;
-    }
-    else // Cooling - do a little exponential decay
-    {
-        float dT = (m_fCurrentTemp - m_fAmbientTemp)*pow(2.7183,-0.005*0.3);
-        m_fCurrentTemp -= m_fCurrentTemp - (m_fAmbientTemp + dT);
-    }
+void Heater::BuildExprs()
+{
+	m_vExprs.resize(m_vAnchorTemps.size());
+	// Heater block: linear rise while powered, exponential decay to ambient when off.
+	auto &block = m_vExprs.at(0);
+	block.vExp.clear();
+	if (m_uiPWM>0)
+	{
+		block.dA = m_vAnchorTemps.at(0);
+		block.dB = m_fThermalMass*(static_cast<double>(m_uiPWM)/255.0);
+	}
+	else
+	{
+		block.dA = m_fAmbientTemp;
+		block.dB = 0;
+		block.vExp.emplace_back(m_vAnchorTemps.at(0) - m_fAmbientTemp, COOL_TAU_S);
+	}
+	// Each further node is a first order lag of the one before it, which maps
+	// every term of the upstream expression onto a term of the same shape.
+	for (size_t i=1; i<m_vExprs.size(); i++)
+	{
+		const auto &up = m_vExprs.at(i-1);
+		auto &node = m_vExprs.at(i);
+		double dTau = m_vTau.at(i-1);
+		node.dA = up.dA - up.dB*dTau;
+		node.dB = up.dB;
+		node.vExp.clear();
+		double dAtZero = node.dA;
+		for (auto &e : up.vExp)
+		{
+			double dTauK = e.second;
+			if (std::abs(dTauK - dTau) < 1e-6*dTau)
+			{
+				dTauK *= 1.0001; // Sidestep the degenerate t*exp(-t/tau) case.
+			}
+			double dC = e.first*dTauK/(dTauK - dTau);
+			node.vExp.emplace_back(dC, dTauK);
+			dAtZero += dC;
+		}
+		node.vExp.emplace_back(m_vAnchorTemps.at(i) - dAtZero, dTau);
+	}
+}
+
+void Heater::Anchor()
+{
+	if (!m_pAVR)
+	{
+		return;
+	}
+	if (!m_bStopTicking) // Frozen heaters keep their anchor temperatures.
+	{
+		double dT = static_cast<double>(m_pAVR->cycle - m_cntAnchor)/static_cast<double>(m_pAVR->frequency);
+		for (size_t i=0; i<m_vExprs.size(); i++)
+		{
+			m_vAnchorTemps.at(i) = m_vExprs.at(i).At(dT);
+		}
+	}
+	m_cntAnchor = m_pAVR->cycle;
+	BuildExprs();
+}
+
+void Heater::Publish()
+{
+	if (m_bStopTicking)
+	{
+		return;
+	}
+	double dT = static_cast<double>(m_pAVR->cycle - m_cntAnchor)/static_cast<double>(m_pAVR->frequency);
+	double dOut = m_vExprs.back().At(dT);
+	bool bSettled = m_uiPWM == 0 && dOut < m_fAmbientTemp+0.3;
+	// Upstream nodes may still be hot with heat on its way to the output.
+	for (size_t i=0; bSettled && i+1<m_vExprs.size(); i++)
+	{
+		bSettled = m_vExprs.at(i).At(dT) < m_fAmbientTemp+0.3;
+	}
+	if (bSettled)
+	{
+		// Settled, pin everything to ambient so the value stops changing.
+		std::fill(m_vAnchorTemps.begin(), m_vAnchorTemps.end(), m_fAmbientTemp);
+		m_cntAnchor = m_pAVR->cycle;
+		BuildExprs();
+		dOut = m_fAmbientTemp;
+	}
+	m_fCurrentTemp = dOut;
+	auto uiOut = static_cast<uint32_t>(static_cast<int>(m_fCurrentTemp*256.f));
+	if (uiOut == GetIRQ(TEMP_OUT)->value)
+	{
+		return;
+	}
 	float v = (m_fCurrentTemp - m_fColdTemp) / (m_fHotTemp - m_fColdTemp);
 	SetLerp(255.F*v);
 
-    TRACE(printf("New temp value: %.02f\n",m_fCurrentTemp));
-    RaiseIRQ(TEMP_OUT,static_cast<int>(m_fCurrentTemp*256.f));
+	TRACE(printf("New temp value: %.02f\n",m_fCurrentTemp));
+	RaiseIRQ(TEMP_OUT,uiOut);
+}
+
+void Heater::OnTempRequest(struct avr_irq_t *,uint32_t)
+{
+	m_bPulled = true;
+	Publish();
+}
+
+avr_cycle_count_t Heater::OnTempTick(avr_t *, avr_cycle_count_t)
+{
+	if (m_bStopTicking)
+	{
+		return 0;
+	}
+
+	Publish();
 
-    if (m_uiPWM>0 || m_fCurrentTemp>m_fAmbientTemp+0.3)
+	// Someone is reading us on demand, no need to keep ticking.
+	if (!m_bPulled && (m_uiPWM>0 || m_fCurrentTemp>m_fAmbientTemp))
 	{
-        RegisterTimerUsec(m_fcnTempTick,300000,this);
+		RegisterTimerUsec(m_fcnTempTick,300000,this);
 	}
-    else
-    {
-        m_fCurrentTemp = m_fAmbientTemp;
-        RaiseIRQ(TEMP_OUT,static_cast<int>(m_fCurrentTemp*256.f));
-    }
-    return 0;
+	return 0;
 }
 
 void Heater::Reset()
@@ -74,21 +171,24 @@ void Heater::Reset()
 	RegisterTimerUsec(m_fcnTempTick, 100000, this);
 }
 
+void Heater::AddNode(float fTauS)
+{
+	m_vTau.push_back(fTauS);
+}
+
 void Heater::OnPWMChanged(struct avr_irq_t *,uint32_t value)
 {
+	Anchor(); // Close out the previous PWM segment.
     if (m_bAuto) // Only update if auto (pwm-controlled). Else user supplied RPM.
 	{
         m_uiPWM = value;
 	}
+	BuildExprs();
 	TRACE(printf("New PWM: %02x\n",value));
-    if (m_uiPWM > 0)
+    if (m_uiPWM > 0 && !m_bPulled)
 	{
         RegisterTimerUsec(m_fcnTempTick, 100000, this);
 	}
-	else
-	{
-		m_cntOff = m_pAVR->cycle;
-	}
 
     if (GetIRQ(ON_OUT)->value != (m_uiPWM>0))
 	{
@@ -148,6 +248,7 @@ Scriptable::LineStatus Heater::ProcessAction(unsigned int iAct, const std::vecto
 			Resume_Auto();
 			return LineStatus::Finished;
 		case ActStopHeating:
+			Anchor();
 			m_bStopTicking = true;
 			return LineStatus::Finished;
 
@@ -163,6 +264,11 @@ void Heater::Init(struct avr_t * avr, avr_irq_t *irqPWM, avr_irq_t *irqDigital)
 
     RegisterNotify(PWM_IN, MAKE_C_CALLBACK(Heater,OnPWMChanged),this);
     RegisterNotify(DIGITAL_IN, MAKE_C_CALLBACK(Heater,OnDigitalChanged),this);
+    RegisterNotify(TEMP_REQ_IN, MAKE_C_CALLBACK(Heater,OnTempRequest),this);
+
+	m_vAnchorTemps.assign(m_vTau.size()+1, m_fCurrentTemp);
+	m_cntAnchor = avr->cycle;
+	BuildExprs();
 
 
 	auto &TH = TelemetryHost::GetHost();
@@ -177,6 +283,7 @@ void Heater::Init(struct avr_t * avr, avr_irq_t *irqPWM, avr_irq_t *irqDigital)
 
 void Heater::Set(uint8_t uiPWM)
 {
+	Anchor();
     m_bAuto = false;
     m_uiPWM = uiPWM;
     RaiseIRQ(PWM_IN,0XFF);
@@ -185,6 +292,12 @@ void Heater::Set(uint8_t uiPWM)
 void Heater::Resume_Auto()
 {
     m_bAuto = true;
+	if (m_bStopTicking && m_pAVR)
+	{
+		// Pick up from the frozen temperature.
+		m_cntAnchor = m_pAVR->cycle;
+		BuildExprs();
+	}
 	m_bStopTicking = false;
 	RaiseIRQ(PWM_IN,m_uiPWM);
 }
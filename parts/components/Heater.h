@@ -34,12 +34,14 @@
 #include "sim_irq.h"           // for avr_irq_t
 #include <cstdint>            // for uint32_t, uint16_t, uint8_t
 #include <string>              // for string
+#include <utility>             // for pair
 #include <vector>              // for vector
 
 class Heater : public BasePeripheral, public Scriptable, public GLIndicator
 {
 public:
-    #define IRQPAIRS _IRQ(PWM_IN,"<heater.pwm_in") _IRQ(DIGITAL_IN,"<heater.digital_in") _IRQ(TEMP_OUT,">heater.temp_out") _IRQ(ON_OUT,">heater.on")
+    #define IRQPAIRS _IRQ(PWM_IN,"<heater.pwm_in") _IRQ(DIGITAL_IN,"<heater.digital_in") _IRQ(TEMP_OUT,">heater.temp_out") _IRQ(ON_OUT,">heater.on") \
+		_IRQ(TEMP_REQ_IN,"<heater.temp_req")
     #include "IRQHelper.h"
 
 
@@ -48,6 +50,10 @@ public:
     Heater(float fThermalMass, float fAmbientTemp, bool bIsBed, char chrLabel,
 		   float fColdTemp, float fHotTemp);
 
+    // Adds a thermal node that lags the previous one (heater block -> nozzle -> sensor...)
+    // with the given time constant, in seconds. TEMP_OUT reports the last node. Call before Init.
+    void AddNode(float fTauS);
+
     // Initializes the heater on "avr" and on irqPQM/irqDigital,
     void Init(avr_t *avr, avr_irq_t *irqPWM, avr_irq_t *irqDigital);
 
@@ -82,9 +88,34 @@ public:
         // Hook for digital full on/off
         void OnDigitalChanged(avr_irq_t *irq, uint32_t value);
 
-        // Function for a temperature "tick" to add or remove heat
+        // Raised by a consumer (e.g. Thermistor ADC read) that wants an up-to-date TEMP_OUT.
+        void OnTempRequest(avr_irq_t *irq, uint32_t value);
+
+        // Fallback publication "tick" for heaters nobody requests a temperature from.
         avr_cycle_count_t OnTempTick(avr_t * avr, avr_cycle_count_t when);
 
+        // Closed-form temperature of one node since the last anchor:
+        // A + B*t + sum(c*exp(-t/tau)), t in seconds.
+        struct NodeExpr
+        {
+            double dA = 0, dB = 0;
+            std::vector<std::pair<double,double>> vExp;
+            double At(double dT) const;
+        };
+
+        // Re-evaluates the model at the current cycle and restarts it from there (on PWM changes).
+        void Anchor();
+        // Rebuilds the node expressions from the anchor temperatures and current PWM.
+        void BuildExprs();
+        // Evaluates the model now and raises TEMP_OUT if the reported value changed.
+        void Publish();
+
+        std::vector<double> m_vTau;         // Lag per node after the heater block.
+        std::vector<double> m_vAnchorTemps; // Block + nodes at m_cntAnchor.
+        std::vector<NodeExpr> m_vExprs;
+        avr_cycle_count_t m_cntAnchor = 0;
+        bool m_bPulled = false;
+
         avr_cycle_timer_t m_fcnTempTick = MAKE_C_TIMER_CALLBACK(Heater,OnTempTick);
         bool m_bAuto = true;
         float m_fThermalMass = 1.0;
@@ -95,5 +126,4 @@ public:
         float m_fHotTemp;
         uint8_t m_uiPWM = {0};
 		bool m_bStopTicking = false;
-		avr_cycle_count_t m_cntOff = 0;
 };
@@ -0,0 +1,603 @@
+/*
+	MMU2Fast.cpp - Behavioural model of the MMU2 for printer-side testing.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MMU2Fast.h"
+#include "TelemetryHost.h"
+#include "avr_uart.h"                 // for AVR_IOCTL_UART_GETIRQ, ::UART_IRQ_INPUT, ::UAR...
+#include "sim_io.h"                   // for avr_io_getirq
+#include "sim_time.h"                 // for avr_usec_to_cycles
+#include <GL/freeglut_std.h>          // for glutStrokeCharacter, GLUT_STROKE_MONO_ROMAN
+#if defined(__APPLE__)
+# include <OpenGL/gl.h>       // for glTranslatef, glVertex3f, glColor3f
+#else
+# include <GL/gl.h>           // for glTranslatef, glVertex3f, glColor3f
+#endif
+#include <cmath>                      // for fabs
+#include <cstring>                    // for memcpy
+#include <exception>                  // for exception
+#include <iostream>                   // for operator<<, cout
+#include <string>                     // for string, stoi, to_string
+
+// Timing and geometry. These are close to MMU firmware 1.0.6 on real hardware, not exact.
+static constexpr uint32_t TICK_US = 10000;
+static constexpr uint32_t CHAR_US = 87; // One byte at 115200 baud.
+static constexpr float BOOT_MS = 300.f;
+
+static constexpr float SELECTOR_SLOT0_MM = 6.f;
+static constexpr float SELECTOR_PITCH_MM = 14.f;
+static constexpr float SELECTOR_MAX_MM = 76.f; // Endstop, and where it homes.
+static constexpr float SELECTOR_MM_S = 40.f;
+
+static constexpr float IDLER_SLOT0_DEG = 15.f;
+static constexpr float IDLER_PITCH_DEG = 40.f;
+static constexpr float IDLER_PARK_DEG = 24.f; // Past the engaged position.
+static constexpr float IDLER_DEG_S = 200.f;
+
+static constexpr float PULLEY_SLOW_MM_S = 20.f;
+static constexpr float PULLEY_FAST_MM_S = 120.f;
+static constexpr float BOWDEN_MM = 385.f;
+static constexpr float PUSH_MM = 40.f; // C0, past the printer's IR sensor.
+static constexpr float EJECT_MM = -60.f;
+
+static constexpr uint8_t SLOTS = 5;
+static constexpr uint32_t FW_VERSION = 106;
+static constexpr uint32_t FW_BUILD = 372;
+
+MMU2Fast::MMU2Fast():IKeyClient(),Scriptable("MMU2")
+{
+	RegisterKeyHandler('F',"Toggle the FINDA");
+	RegisterKeyHandler('A', "Resumes full-auto MMU mode.");
+	RegisterActionAndMenu("ToggleFINDA","Toggles the FINDA", ActToggleFINDA);
+	RegisterActionAndMenu("SetFINDAAuto", "Returns FINDA operation to automatic", ActSetFINDAAuto);
+	RegisterAction("SetFINDA", "Sets FINDA state", ActSetFINDA, {ArgType::Bool});
+	RegisterActionAndMenu("FailNextLoad", "The next load stalls before reaching the FINDA and waits for Resolve", ActFailNextLoad);
+	RegisterActionAndMenu("FailNextUnload", "The next unload leaves the FINDA triggered and waits for Resolve", ActFailNextUnload);
+	RegisterActionAndMenu("IgnoreNext", "The next command received is never answered", ActIgnoreNext);
+	RegisterActionAndMenu("Resolve", "Waits for a failed load/unload and clears it (as if the user fixed it and pressed the button)", ActResolve);
+	RegisterAction("WaitIdle", "Waits until all received commands have been answered", ActWaitIdle);
+}
+
+void MMU2Fast::Init(struct avr_t *avr, char chrUART)
+{
+	_Init(avr, this);
+
+	RegisterNotify(BYTE_IN, MAKE_C_CALLBACK(MMU2Fast, OnByteIn), this);
+	RegisterNotify(RESET, MAKE_C_CALLBACK(MMU2Fast, OnResetIn), this);
+
+	avr_irq_t * src = avr_io_getirq(m_pAVR, AVR_IOCTL_UART_GETIRQ(chrUART), UART_IRQ_OUTPUT); //NOLINT - complaint in external macro
+	avr_irq_t * dst = avr_io_getirq(m_pAVR, AVR_IOCTL_UART_GETIRQ(chrUART), UART_IRQ_INPUT); //NOLINT - complaint in external macro
+	avr_irq_t * xon = avr_io_getirq(m_pAVR, AVR_IOCTL_UART_GETIRQ(chrUART), UART_IRQ_OUT_XON); //NOLINT - complaint in external macro
+	avr_irq_t * xoff = avr_io_getirq(m_pAVR, AVR_IOCTL_UART_GETIRQ(chrUART), UART_IRQ_OUT_XOFF); //NOLINT - complaint in external macro
+	if (src && dst) {
+		ConnectFrom(src, BYTE_IN);
+		ConnectTo(BYTE_OUT, dst);
+	}
+	if (xon) avr_irq_register_notify(xon, MAKE_C_CALLBACK(MMU2Fast,OnXOnIn), this);
+	if (xoff) avr_irq_register_notify(xoff, MAKE_C_CALLBACK(MMU2Fast,OnXOffIn),this);
+
+	auto &TH = TelemetryHost::GetHost();
+	TH.AddTrace(this, FINDA_OUT, {TC::Misc});
+	TH.AddTrace(this, TOOL_OUT, {TC::Misc}, 8);
+
+	Boot();
+}
+
+void MMU2Fast::OnKeyPress(const Key& key)
+{
+	switch (key)
+	{
+		case 'F':
+			std::cout << "FINDA toggled (in manual control)\n";
+			m_bAutoFINDA = false;
+			m_bFINDAManual = !m_bFINDAManual;
+			UpdateOutputs();
+			break;
+		case 'A':
+			std::cout << "FINDA in Auto control\n";
+			m_bAutoFINDA = true;
+			UpdateOutputs();
+			break;
+	}
+}
+
+IScriptable::LineStatus MMU2Fast::ProcessAction(unsigned int iAct, const std::vector<std::string> &vArgs)
+{
+	switch (iAct)
+	{
+		case ActToggleFINDA:
+			m_bAutoFINDA = false;
+			m_bFINDAManual = !m_bFINDAManual;
+			break;
+		case ActSetFINDA:
+			m_bAutoFINDA = false;
+			m_bFINDAManual = std::stoi(vArgs.at(0))!=0;
+			break;
+		case ActSetFINDAAuto:
+			m_bAutoFINDA = true;
+			break;
+		case ActFailNextLoad:
+			m_bFailLoad = true;
+			return LineStatus::Finished;
+		case ActFailNextUnload:
+			m_bFailUnload = true;
+			return LineStatus::Finished;
+		case ActIgnoreNext:
+			m_bIgnoreNext = true;
+			return LineStatus::Finished;
+		case ActResolve:
+			if (!m_bHolding)
+			{
+				// Like the user, wait for the LED to start blinking if a failure is on its way.
+				bool bHoldQueued = m_bFailLoad || m_bFailUnload;
+				for (auto &step : m_qSteps)
+				{
+					bHoldQueued |= step.kind == Step::Hold;
+				}
+				if (bHoldQueued)
+				{
+					return LineStatus::Waiting;
+				}
+				return IssueLineError("The MMU is not waiting for the user");
+			}
+			m_bHolding = false;
+			m_bFINDAStuck = false;
+			m_qSteps.pop_front();
+			break;
+		case ActWaitIdle:
+			return (m_qSteps.empty() && m_qCommands.empty() && !m_bTxActive) ? LineStatus::Finished : LineStatus::Waiting;
+		default:
+			return LineStatus::Unhandled;
+	}
+	UpdateOutputs();
+	return LineStatus::Finished;
+}
+
+void MMU2Fast::OnByteIn(struct avr_irq_t *, uint32_t value)
+{
+	char c = static_cast<char>(value & 0xFFU);
+	if (c == '\n')
+	{
+		if (!m_strLine.empty())
+		{
+			m_qCommands.push_back(m_strLine);
+			m_strLine.clear();
+			RunQueue();
+		}
+	}
+	else if (c != '\r' && m_strLine.size() < 32)
+	{
+		m_strLine.push_back(c);
+	}
+}
+
+void MMU2Fast::OnResetIn(struct avr_irq_t *irq, uint32_t value)
+{
+	if (irq->value && !value)
+	{
+		std::cout << "MMU2 (fast) reset\n";
+		Boot();
+	}
+}
+
+void MMU2Fast::OnXOnIn(struct avr_irq_t *, uint32_t)
+{
+	m_bXOn = true;
+}
+
+void MMU2Fast::OnXOffIn(struct avr_irq_t *, uint32_t)
+{
+	m_bXOn = false;
+}
+
+void MMU2Fast::Boot()
+{
+	// The timers may be long gone (a printer reset flushes them) or still armed; start both afresh.
+	CancelTimer(m_fcnTick, this);
+	CancelTimer(m_fcnTx, this);
+	m_bTicking = m_bTxActive = false;
+	m_qCommands.clear();
+	m_qSteps.clear();
+	m_strLine.clear();
+	m_strTx.clear();
+	m_uiTxPos = 0;
+	m_bHolding = false;
+	m_bFINDAStuck = false;
+	m_bFailLoad = m_bFailUnload = m_bIgnoreNext = false;
+	// Filament that is past the FINDA stays loaded across a reset.
+	m_bLoaded = m_fPulleyPos > FINDA_TRIGGER_DISTANCE;
+
+	QueueDelay(BOOT_MS);
+	QueueMove(Axis::Selector, SELECTOR_MAX_MM, SELECTOR_MM_S);
+	QueueMove(Axis::Selector, SelectorPos(m_uiSlot), SELECTOR_MM_S);
+	QueueMove(Axis::Idler, 0, IDLER_DEG_S);
+	QueueMove(Axis::Idler, IdlerPos(m_uiSlot, m_bLoaded), IDLER_DEG_S);
+	QueueReply("start\n");
+	RunQueue();
+}
+
+float MMU2Fast::SelectorPos(uint8_t uiSlot)
+{
+	return SELECTOR_SLOT0_MM + (SELECTOR_PITCH_MM * static_cast<float>(uiSlot));
+}
+
+float MMU2Fast::IdlerPos(uint8_t uiSlot, bool bEngaged)
+{
+	return IDLER_SLOT0_DEG + (IDLER_PITCH_DEG * static_cast<float>(uiSlot)) + (bEngaged ? 0.f : IDLER_PARK_DEG);
+}
+
+float& MMU2Fast::AxisPos(Axis axis)
+{
+	switch (axis)
+	{
+		case Axis::Selector:
+			return m_fSelPos;
+		case Axis::Idler:
+			return m_fIdlPos;
+		case Axis::Pulley:
+		default:
+			return m_fPulleyPos;
+	}
+}
+
+void MMU2Fast::QueueSelect(uint8_t uiSlot)
+{
+	QueueMove(Axis::Idler, IdlerPos(m_uiSlot, false), IDLER_DEG_S);
+	QueueMove(Axis::Selector, SelectorPos(uiSlot), SELECTOR_MM_S);
+	m_uiSlot = uiSlot;
+}
+
+void MMU2Fast::QueueUnload(bool bFail)
+{
+	QueueMove(Axis::Idler, IdlerPos(m_uiSlot, true), IDLER_DEG_S);
+	QueueMove(Axis::Pulley, FINDA_TRIGGER_DISTANCE + 5.f, PULLEY_FAST_MM_S);
+	QueueMove(Axis::Pulley, 0, PULLEY_SLOW_MM_S);
+	if (bFail)
+	{
+		m_bFINDAStuck = true;
+		QueueHold();
+	}
+	QueueMove(Axis::Idler, IdlerPos(m_uiSlot, false), IDLER_DEG_S);
+	m_bLoaded = false;
+}
+
+void MMU2Fast::QueueLoad(bool bFail, bool bRetract)
+{
+	QueueMove(Axis::Idler, IdlerPos(m_uiSlot, true), IDLER_DEG_S);
+	if (bFail)
+	{
+		QueueMove(Axis::Pulley, FINDA_TRIGGER_DISTANCE - 10.f, PULLEY_SLOW_MM_S);
+		QueueHold();
+	}
+	QueueMove(Axis::Pulley, FINDA_TRIGGER_DISTANCE + 5.f, PULLEY_SLOW_MM_S);
+	if (bRetract)
+	{
+		QueueMove(Axis::Pulley, 0, PULLEY_SLOW_MM_S);
+		QueueMove(Axis::Idler, IdlerPos(m_uiSlot, false), IDLER_DEG_S);
+	}
+	else
+	{
+		QueueMove(Axis::Pulley, BOWDEN_MM, PULLEY_FAST_MM_S);
+		m_bLoaded = true;
+	}
+}
+
+bool MMU2Fast::QueueCommand(const std::string &strCmd)
+{
+	char chrCmd = strCmd.at(0);
+	int iVal = 0;
+	if (strCmd.size() > 1)
+	{
+		try
+		{
+			iVal = std::stoi(strCmd.substr(1));
+		}
+		catch (const std::exception &)
+		{
+			return false;
+		}
+	}
+	bool bSlotOK = iVal >= 0 && iVal < SLOTS;
+	uint8_t uiSlot = static_cast<uint8_t>(iVal);
+	switch (chrCmd)
+	{
+		case 'T':
+			if (!bSlotOK) return false;
+			if (m_bLoaded)
+			{
+				QueueUnload(m_bFailUnload);
+			}
+			QueueSelect(uiSlot);
+			RaiseIRQ(TOOL_OUT, uiSlot);
+			QueueLoad(m_bFailLoad, false);
+			m_bFailLoad = m_bFailUnload = false;
+			break;
+		case 'L':
+			if (!bSlotOK) return false;
+			QueueSelect(uiSlot);
+			QueueLoad(m_bFailLoad, true);
+			m_bFailLoad = false;
+			break;
+		case 'U':
+			if (m_bLoaded)
+			{
+				QueueUnload(m_bFailUnload);
+				m_bFailUnload = false;
+			}
+			break;
+		case 'C':
+			if (m_bLoaded)
+			{
+				QueueMove(Axis::Idler, IdlerPos(m_uiSlot, true), IDLER_DEG_S);
+				QueueMove(Axis::Pulley, BOWDEN_MM + PUSH_MM, PULLEY_SLOW_MM_S);
+				QueueMove(Axis::Idler, IdlerPos(m_uiSlot, false), IDLER_DEG_S);
+			}
+			break;
+		case 'E':
+			if (!bSlotOK) return false;
+			QueueSelect(uiSlot);
+			QueueMove(Axis::Idler, IdlerPos(m_uiSlot, true), IDLER_DEG_S);
+			QueueMove(Axis::Pulley, EJECT_MM, PULLEY_FAST_MM_S);
+			QueueMove(Axis::Idler, IdlerPos(m_uiSlot, false), IDLER_DEG_S);
+			m_bLoaded = false;
+			break;
+		case 'K':
+			if (!bSlotOK) return false;
+			QueueSelect(uiSlot);
+			QueueMove(Axis::Selector, SelectorPos(uiSlot) + (SELECTOR_PITCH_MM/2.f), SELECTOR_MM_S);
+			QueueMove(Axis::Selector, SelectorPos(uiSlot), SELECTOR_MM_S);
+			break;
+		case 'W':
+			QueueHold();
+			break;
+		case 'R':
+		case 'F':
+		case 'M':
+			break;
+		case 'X':
+			Boot();
+			return true;
+		case 'S':
+			switch (iVal)
+			{
+				case 0:
+					break;
+				case 1:
+					QueueReply(std::to_string(FW_VERSION) + "ok\n");
+					return true;
+				case 2:
+					QueueReply(std::to_string(FW_BUILD) + "ok\n");
+					return true;
+				case 3:
+					QueueReply("0ok\n"); // Drive errors
+					return true;
+				default:
+					return false;
+			}
+			break;
+		case 'P':
+			QueueReply(std::string(m_bFINDA ? "1" : "0") + "ok\n");
+			return true;
+		default:
+			return false;
+	}
+	QueueReply("ok\n");
+	return true;
+}
+
+void MMU2Fast::RunQueue()
+{
+	while (m_qSteps.empty() && !m_qCommands.empty())
+	{
+		std::string strCmd = m_qCommands.front();
+		m_qCommands.pop_front();
+		if (m_bIgnoreNext)
+		{
+			std::cout << "MMU2 (fast) ignoring: " << strCmd << '\n';
+			m_bIgnoreNext = false;
+		}
+		else if (!QueueCommand(strCmd))
+		{
+			std::cout << "MMU2 (fast) unhandled command: " << strCmd << '\n';
+		}
+	}
+	Advance(0);
+	if (!m_bTicking && !m_qSteps.empty())
+	{
+		m_bTicking = true;
+		RegisterTimerUsec(m_fcnTick, TICK_US, this);
+	}
+}
+
+void MMU2Fast::Advance(float fMs)
+{
+	while (!m_qSteps.empty())
+	{
+		Step &step = m_qSteps.front();
+		if (step.kind == Step::Move)
+		{
+			float &fPos = AxisPos(step.axis);
+			float fDist = std::fabs(step.fTarget - fPos);
+			float fNeedMs = (fDist * 1000.f) / step.fSpeed;
+			if (fNeedMs > fMs)
+			{
+				float fStep = (step.fSpeed * fMs) / 1000.f;
+				fPos += (step.fTarget > fPos) ? fStep : -fStep;
+				break;
+			}
+			fPos = step.fTarget;
+			fMs -= fNeedMs;
+		}
+		else if (step.kind == Step::Delay)
+		{
+			if (step.fTarget > fMs)
+			{
+				step.fTarget -= fMs;
+				break;
+			}
+			fMs -= step.fTarget;
+		}
+		else if (step.kind == Step::Hold)
+		{
+			if (!m_bHolding)
+			{
+				std::cout << "MMU2 (fast) waiting for the user\n";
+			}
+			m_bHolding = true;
+			break;
+		}
+		else
+		{
+			Send(step.strReply);
+		}
+		m_qSteps.pop_front();
+	}
+	UpdateOutputs();
+}
+
+avr_cycle_count_t MMU2Fast::OnTick(struct avr_t *, avr_cycle_count_t when)
+{
+	m_uiTicks++;
+	Advance(TICK_US/1000.f);
+	if (!m_qSteps.empty())
+	{
+		return when + avr_usec_to_cycles(m_pAVR, TICK_US);
+	}
+	// Next command, if one came in while busy. RunQueue re-arms the tick itself if needed,
+	// which also covers an X0 in there having rebooted us.
+	m_bTicking = false;
+	RunQueue();
+	return 0;
+}
+
+void MMU2Fast::Send(const std::string &strData)
+{
+	m_strTx += strData;
+	if (!m_bTxActive)
+	{
+		m_bTxActive = true;
+		RegisterTimerUsec(m_fcnTx, CHAR_US, this);
+	}
+}
+
+avr_cycle_count_t MMU2Fast::OnTxTimer(struct avr_t *, avr_cycle_count_t when)
+{
+	if (m_bXOn && m_uiTxPos < m_strTx.size())
+	{
+		RaiseIRQ(BYTE_OUT, static_cast<uint8_t>(m_strTx[m_uiTxPos++]));
+	}
+	if (m_uiTxPos >= m_strTx.size())
+	{
+		m_strTx.clear();
+		m_uiTxPos = 0;
+		m_bTxActive = false;
+		return 0;
+	}
+	return when + avr_usec_to_cycles(m_pAVR, CHAR_US);
+}
+
+void MMU2Fast::UpdateOutputs()
+{
+	auto raiseFloat = [this](unsigned int uiIRQ, float fVal)
+	{
+		uint32_t uiVal;
+		std::memcpy(&uiVal, &fVal, 4);
+		if (GetIRQ(uiIRQ)->value != uiVal)
+		{
+			RaiseIRQ(uiIRQ, uiVal);
+		}
+	};
+	raiseFloat(SELECTOR_OUT, m_fSelPos);
+	raiseFloat(IDLER_OUT, m_fIdlPos);
+	raiseFloat(FEED_DISTANCE, m_fPulleyPos);
+
+	if (m_bAutoFINDA)
+	{
+		m_bFINDA = m_bFINDAStuck || m_fPulleyPos > FINDA_TRIGGER_DISTANCE;
+	}
+	else
+	{
+		m_bFINDA = m_bFINDAManual.load();
+	}
+	if (GetIRQ(FINDA_OUT)->value != m_bFINDA)
+	{
+		RaiseIRQ(FINDA_OUT, m_bFINDA);
+	}
+	UpdateLEDs();
+}
+
+void MMU2Fast::UpdateLEDs()
+{
+	// LEDS_OUT bits are G0 R0 G4 R4 G3 R3 G2 R2 G1 R1, as MMU2 reports them from the shift register.
+	uint32_t uiGreen = m_uiSlot == 0 ? 0U : 2U*(SLOTS - m_uiSlot);
+	uint32_t uiLEDs = 0;
+	if (m_bHolding)
+	{
+		// Blink the red one at 2Hz.
+		if (((m_uiTicks * TICK_US) / 250000U) % 2U)
+		{
+			uiLEDs = 1U << (uiGreen + 1U);
+		}
+	}
+	else
+	{
+		uiLEDs = 1U << uiGreen;
+	}
+	if (GetIRQ(LEDS_OUT)->value != uiLEDs)
+	{
+		RaiseIRQ(LEDS_OUT, uiLEDs);
+	}
+}
+
+void MMU2Fast::Draw(float fY)
+{
+	std::string strTitle = "MMU2 (fast model)";
+	std::string strStatus = std::string("Slot ") + std::to_string(m_uiSlot) + (m_bLoaded ? " loaded" : " empty")
+		+ (m_bFINDA ? "  FINDA" : "  -----") + (m_bHolding ? "  WAITING FOR USER" : "");
+	glPushMatrix();
+		glColor3f(0,0,0);
+		glTranslatef(0,fY-50,0);
+		glBegin(GL_QUADS);
+			glVertex3f(0,0,0);
+			glVertex3f(350,0,0);
+			glVertex3f(350,50,0);
+			glVertex3f(0,50,0);
+		glEnd();
+		glTranslatef(20,7,0);
+		glColor3f(1,1,1);
+		glPushMatrix();
+			glScalef(0.09,-0.05,0);
+			for (auto &c : strTitle)
+			{
+				glutStrokeCharacter(GLUT_STROKE_MONO_ROMAN,c);
+			}
+		glPopMatrix();
+		glTranslatef(0,20,0);
+		if (m_bHolding)
+		{
+			glColor3f(1,0.2,0.2);
+		}
+		glScalef(0.09,-0.05,0);
+		for (auto &c : strStatus)
+		{
+			glutStrokeCharacter(GLUT_STROKE_MONO_ROMAN,c);
+		}
+	glPopMatrix();
+}
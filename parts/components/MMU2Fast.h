@@ -0,0 +1,170 @@
+/*
+	MMU2Fast.h - Behavioural model of the MMU2 for printer-side testing.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "BasePeripheral.h"    // for BasePeripheral, MAKE_C_TIMER_CALLBACK
+#include "IKeyClient.h"        // for IKeyClient, Key
+#include "IScriptable.h"       // for IScriptable::LineStatus
+#include "Scriptable.h"        // for Scriptable
+#include "sim_avr.h"           // for avr_t
+#include "sim_avr_types.h"     // for avr_cycle_count_t
+#include "sim_cycle_timers.h"  // for avr_cycle_timer_t
+#include "sim_irq.h"           // for avr_irq_t
+#include <atomic>              // for atomic_bool, atomic_uint8_t
+#include <cstdint>             // for uint8_t, uint32_t
+#include <deque>               // for deque
+#include <string>              // for string
+#include <vector>              // for vector
+
+// Stands in for a whole MM-control-01 board when only the printer side matters. It answers
+// the MMU serial protocol (as of MMU firmware 1.0.6) on the printer's UART directly, with the
+// selector, idler and pulley moving at roughly real speeds so replies arrive when the real
+// unit's would. The outputs match MMU2's so the visuals, FINDA and IR sensor work unchanged.
+//
+// Failures can be injected from scripts: a load that never reaches the FINDA, an unload that
+// leaves it triggered, or a command that is never answered. Like the real unit, a failed
+// load/unload waits (red LED blinking) until resolved - here with MMU2::Resolve().
+class MMU2Fast: public BasePeripheral, public Scriptable, virtual private IKeyClient
+{
+	public:
+		#define IRQPAIRS _IRQ(BYTE_IN,"8<mmu.byte_in") _IRQ(BYTE_OUT,"8>mmu.byte_out") _IRQ(RESET,"<mmu.reset") \
+						_IRQ(FEED_DISTANCE,">mmu.feed_distance") _IRQ(SELECTOR_OUT,">sel_pos.out") _IRQ(IDLER_OUT,">idler_pos.out") \
+						_IRQ(LEDS_OUT,">leds.out") _IRQ(FINDA_OUT,">finda.out") _IRQ(TOOL_OUT,"8>tool.out")
+		#include "IRQHelper.h"
+
+		MMU2Fast();
+
+		~MMU2Fast() override = default;
+
+		// Registers with SimAVR and listens on the given UART of the printer.
+		void Init(avr_t *avr, char chrUART);
+
+		// Draws the status strip in the printer window, like MM_Control_01::Draw.
+		void Draw(float fY);
+
+		static constexpr float FINDA_TRIGGER_DISTANCE = 33.f;
+
+	protected:
+		LineStatus ProcessAction(unsigned int iAct, const std::vector<std::string> &vArgs) override;
+
+		void OnKeyPress(const Key& key) override;
+
+	private:
+		enum class Axis : uint8_t
+		{
+			Selector,
+			Idler,
+			Pulley
+		};
+
+		struct Step
+		{
+			enum Kind : uint8_t
+			{
+				Move,  // axis to fTarget at fSpeed units/s
+				Delay, // fTarget ms
+				Hold,  // until Resolve()
+				Reply  // sends strReply
+			} kind;
+			Axis axis;
+			float fTarget;
+			float fSpeed;
+			std::string strReply;
+		};
+
+		enum Actions
+		{
+			ActToggleFINDA,
+			ActSetFINDA,
+			ActSetFINDAAuto,
+			ActFailNextLoad,
+			ActFailNextUnload,
+			ActIgnoreNext,
+			ActResolve,
+			ActWaitIdle
+		};
+
+		void OnByteIn(avr_irq_t *irq, uint32_t value);
+		void OnResetIn(avr_irq_t *irq, uint32_t value);
+		void OnXOnIn(avr_irq_t *irq, uint32_t value);
+		void OnXOffIn(avr_irq_t *irq, uint32_t value);
+
+		avr_cycle_count_t OnTick(avr_t *avr, avr_cycle_count_t when);
+		avr_cycle_timer_t m_fcnTick = MAKE_C_TIMER_CALLBACK(MMU2Fast,OnTick);
+
+		avr_cycle_count_t OnTxTimer(avr_t *avr, avr_cycle_count_t when);
+		avr_cycle_timer_t m_fcnTx = MAKE_C_TIMER_CALLBACK(MMU2Fast,OnTxTimer);
+
+		// Power-on/reset: homes and then announces itself with "start".
+		void Boot();
+
+		// Turns a received line into steps. Returns false if it isn't a command we answer.
+		bool QueueCommand(const std::string &strCmd);
+
+		// Steps for each part of a tool change.
+		void QueueSelect(uint8_t uiSlot);
+		void QueueUnload(bool bFail);
+		void QueueLoad(bool bFail, bool bRetract);
+
+		inline void QueueMove(Axis axis, float fTarget, float fSpeed) { m_qSteps.push_back({Step::Move, axis, fTarget, fSpeed, {}});}
+		inline void QueueDelay(float fMs) { m_qSteps.push_back({Step::Delay, Axis::Pulley, fMs, 0, {}});}
+		inline void QueueHold() { m_qSteps.push_back({Step::Hold, Axis::Pulley, 0, 0, {}});}
+		inline void QueueReply(std::string strReply) { m_qSteps.push_back({Step::Reply, Axis::Pulley, 0, 0, std::move(strReply)});}
+
+		// Starts the next queued command if idle.
+		void RunQueue();
+
+		// Runs the current steps forward by fMs of simulated time.
+		void Advance(float fMs);
+
+		float& AxisPos(Axis axis);
+
+		void Send(const std::string &strData);
+		void UpdateOutputs();
+		void UpdateLEDs();
+
+		static float SelectorPos(uint8_t uiSlot);
+		static float IdlerPos(uint8_t uiSlot, bool bEngaged);
+
+		std::deque<std::string> m_qCommands;
+		std::deque<Step> m_qSteps;
+		std::string m_strLine;
+		std::string m_strTx;
+		size_t m_uiTxPos = 0;
+		bool m_bXOn = true;
+		bool m_bTxActive = false;
+		bool m_bTicking = false;
+
+		float m_fSelPos = 0.f, m_fIdlPos = 0.f, m_fPulleyPos = 0.f;
+		// Shown by Draw() from the GL thread.
+		std::atomic_uint8_t m_uiSlot {0};
+		std::atomic_bool m_bLoaded {false};
+		std::atomic_bool m_bHolding {false};
+		std::atomic_bool m_bFINDA {false};
+
+		uint32_t m_uiTicks = 0;
+
+		bool m_bFailLoad = false, m_bFailUnload = false, m_bIgnoreNext = false;
+		bool m_bFINDAStuck = false;
+		std::atomic_bool m_bAutoFINDA {true};
+		std::atomic_bool m_bFINDAManual {false};
+};
@@ -22,10 +22,11 @@
 #include "PINDA.h"
 #include "TelemetryHost.h"
 #include "gsl-lite.hpp"
-#include <algorithm>         // for copy
-#include <cmath>    // for pow, floor, round, sqrt
+#include <algorithm>         // for min, max
+#include <cmath>    // for floor, ceil
 #include <cstring>
 #include <iostream>
+#include <limits>
 
 //#define TRACE(_w)_w
 #ifndef TRACE
@@ -37,13 +38,18 @@ void PINDA::CheckTriggerNoSheet()
 {
     float fEdistSquared = 1000.f;
     bool bFound = false;
+	if (!InCell())
+	{
+		LocateCalCell();
+	}
     //printf("PINDA: X: %f Y: %f\n", m_fPos[0], m_fPos[1]);
 	if (m_fPos[2]<10.f)
 	{
-		for (auto i=0U; i<GetXYCalPoints().size()/2; i++)
+		// Only the points that can be within range of this grid cell need checking.
+		for (auto i : *m_pCellCands)
 		{
-			fEdistSquared = pow(m_fPos[0] - GetXYCalPoints().at(2*i),2)  +
-				pow(m_fPos[1] - GetXYCalPoints().at((2*i)+1),2);
+			float fDX = m_fPos[0] - GetXYCalPoints().at(2*i), fDY = m_fPos[1] - GetXYCalPoints().at((2*i)+1);
+			fEdistSquared = (fDX*fDX) + (fDY*fDY);
 			if (fEdistSquared<100.f) // 10mm search radius (squared)
 			{
 				//printf("PINDA: squared distance : %f\n", fEdistSquared);
@@ -58,19 +64,113 @@ void PINDA::CheckTriggerNoSheet()
 		bool bHasSheet = m_XYCalType != XYCalMap::MK2;
         float fTrigZ = (1.0*(1-fEdistSquared/25.f)) + (bHasSheet? 3.0 : 0.0) ;
         //printf("fTZ:%f fZ: %f\n",fTrigZ, this->fPos[2]);
-        if (m_fPos[2]<=fTrigZ)
+		SetTrigger(m_fPos[2]<=fTrigZ);
+    }
+	else
+	{
+		SetTrigger(false);
+	}
+}
+
+void PINDA::SetTrigger(bool bTrig)
+{
+	if (GetIRQ(TRIGGER_OUT)->value != static_cast<uint32_t>(bTrig))
+	{
+		RaiseIRQ(TRIGGER_OUT,bTrig);
+	}
+}
+
+void PINDA::BuildCalGrid()
+{
+	auto &vPts = GetXYCalPoints();
+	float fMin[2] = {vPts.at(0), vPts.at(1)}, fMax[2] = {vPts.at(0), vPts.at(1)};
+	for (auto i=0U; i<vPts.size()/2; i++)
+	{
+		for (auto j=0U; j<2; j++)
 		{
-            RaiseIRQ(TRIGGER_OUT,1);
+			fMin[j] = std::min(fMin[j], vPts.at((2*i)+j));
+			fMax[j] = std::max(fMax[j], vPts.at((2*i)+j));
 		}
-        else
+	}
+	// Pad by the search radius so everything outside the grid is out of range of every point.
+	m_fGridOrigin[0] = fMin[0] - CAL_RADIUS;
+	m_fGridOrigin[1] = fMin[1] - CAL_RADIUS;
+	m_uiGridW = static_cast<unsigned int>(std::ceil((fMax[0] - fMin[0])/CAL_RADIUS)) + 2;
+	m_uiGridH = static_cast<unsigned int>(std::ceil((fMax[1] - fMin[1])/CAL_RADIUS)) + 2;
+	m_vCalGrid.assign(m_uiGridW*m_uiGridH, {});
+	for (auto y=0U; y<m_uiGridH; y++)
+	{
+		for (auto x=0U; x<m_uiGridW; x++)
 		{
-            RaiseIRQ(TRIGGER_OUT,0);
+			float fXLo = m_fGridOrigin[0] + (x*CAL_RADIUS), fYLo = m_fGridOrigin[1] + (y*CAL_RADIUS);
+			auto &vCell = m_vCalGrid.at(x + (y*m_uiGridW));
+			for (auto i=0U; i<vPts.size()/2; i++)
+			{
+				// Distance from the point to the nearest edge of the cell.
+				float fDX = std::max({fXLo - vPts.at(2*i), vPts.at(2*i) - (fXLo + CAL_RADIUS), 0.f});
+				float fDY = std::max({fYLo - vPts.at((2*i)+1), vPts.at((2*i)+1) - (fYLo + CAL_RADIUS), 0.f});
+				if (((fDX*fDX) + (fDY*fDY)) < (CAL_RADIUS*CAL_RADIUS))
+				{
+					vCell.push_back(gsl::narrow_cast<uint8_t>(i));
+				}
+			}
 		}
-    }
+	}
+	InvalidateCell();
+}
+
+void PINDA::LocateCalCell()
+{
+	static const std::vector<uint8_t> vNone {};
+	const float fInf = std::numeric_limits<float>::infinity();
+	// Returns the cell index along one axis, or -1 if outside the grid (with lo/hi spanning the outside region)
+	auto fcnAxis = [&fInf](float fPos, float fOrigin, unsigned int uiCells, float &fLo, float &fHi)
+	{
+		float fRel = fPos - fOrigin;
+		if (fRel < 0.f)
+		{
+			fLo = -fInf;
+			fHi = fOrigin;
+			return -1;
+		}
+		else if (fRel >= (uiCells*CAL_RADIUS))
+		{
+			fLo = fOrigin + (uiCells*CAL_RADIUS);
+			fHi = fInf;
+			return -1;
+		}
+		auto iCell = static_cast<int>(std::floor(fRel/CAL_RADIUS));
+		fLo = fOrigin + (iCell*CAL_RADIUS);
+		fHi = fLo + CAL_RADIUS;
+		return iCell;
+	};
+	int iX = fcnAxis(m_fPos[0], m_fGridOrigin[0], m_uiGridW, m_cell.fXLo, m_cell.fXHi);
+	int iY = fcnAxis(m_fPos[1], m_fGridOrigin[1], m_uiGridH, m_cell.fYLo, m_cell.fYHi);
+	if (iX<0 || iY<0)
+	{
+		m_pCellCands = &vNone;
+	}
 	else
 	{
-		RaiseIRQ(TRIGGER_OUT,0);
+		m_pCellCands = &m_vCalGrid.at(iX + (iY*m_uiGridW));
 	}
+	m_bCellValid = true;
+}
+
+void PINDA::LocateMeshCell()
+{
+	const float fInf = std::numeric_limits<float>::infinity();
+	auto fcnAxis = [&fInf](float fPos, float fOffset, float fMax, float &fLo, float &fHi)
+	{
+		auto iCell = static_cast<int>(std::floor((std::min(fMax-1.f, std::max(0.f, fPos - fOffset))/fMax)*7));
+		fLo = iCell == 0 ? -fInf : fOffset + ((iCell*fMax)/7.f);
+		fHi = iCell == 6 ? fInf : fOffset + (((iCell+1)*fMax)/7.f);
+		return iCell;
+	};
+	int iX = fcnAxis(m_fPos[0], m_fOffset[0], MESH_MAX_X, m_cell.fXLo, m_cell.fXHi);
+	int iY = fcnAxis(m_fPos[1], m_fOffset[1], MESH_MAX_Y, m_cell.fYLo, m_cell.fYHi);
+	m_iMeshIdx = iX+(7*iY);
+	m_bCellValid = true;
 }
 
 Scriptable::LineStatus PINDA::ProcessAction (unsigned int iAct, const std::vector<std::string> &vArgs)
@@ -115,6 +215,7 @@ Scriptable::LineStatus PINDA::ProcessAction (unsigned int iAct, const std::vecto
 			float fX = stof(vArgs.at(1)), fY = stof(vArgs.at(2));
 			GetXYCalPoints().at(2*iVal) = fX;
 			GetXYCalPoints().at((2*iVal)+1) = fY;
+			BuildCalGrid();
 			return LineStatus::Finished;
 		}
 	}
@@ -127,27 +228,20 @@ void PINDA::CheckTrigger()
     // Bail early if too high to matter, to avoid needing to do all the math.
     if (m_fPos[2]>5)
 	{
-		RaiseIRQ(TRIGGER_OUT,0);
+		SetTrigger(false);
         return;
 	}
 
-    // Just calc the nearest MBL point and report it.
-	const float fMaxX = 255.;
-	const float fMaxY = 210.;
-	uint8_t iX = std::floor((std::min(fMaxX-1.f, std::max(0.f, m_fPos[0] - m_fOffset[0]))/fMaxX)*7);
-	uint8_t iY = std::floor((std::min(fMaxY-1.f, std::max(0.f, m_fPos[1] - m_fOffset[1]))/fMaxY)*7);
-
-    float fZTrig = gsl::at(m_mesh.points,iX+(7*iY));
-
-    if (m_fPos[2]<=fZTrig)
-    {
-        //printf("Trig @ %u %u\n",iX,iY);
-        RaiseIRQ(TRIGGER_OUT,1);
-    }
-    else
+    // Just use the nearest MBL point, the cell only needs updating if XY left it since the last check.
+	if (!InCell())
 	{
-        RaiseIRQ(TRIGGER_OUT,0);
+		LocateMeshCell();
 	}
+
+    float fZTrig = gsl::at(m_mesh.points,m_iMeshIdx);
+
+	//printf("Trig @ %d\n",m_iMeshIdx);
+	SetTrigger(m_fPos[2]<=fZTrig);
 }
 
 void PINDA::OnXChanged(struct avr_irq_t*,uint32_t value)
@@ -245,6 +339,7 @@ void PINDA::ToggleSheet()
 	if (m_XYCalType == XYCalMap::MK2) return;
 
     m_bIsSheetPresent=!m_bIsSheetPresent;
+	InvalidateCell();
     std::cout << "Steel sheet: " << (m_bIsSheetPresent? "INSTALLED\n" : "REMOVED\n");
     RaiseIRQ(SHEET_OUT,m_bIsSheetPresent);
 }
@@ -272,12 +367,13 @@ void PINDA::Reconfigure(float fX, float fY, XYCalMap map)
 	m_fOffset[0] = fX;
 	m_fOffset[1] = fY;
 	m_bIsSheetPresent = m_XYCalType != XYCalMap::MK2;
-
+	BuildCalGrid();
 }
 
 void PINDA::Init(struct avr_t * avr, avr_irq_t *irqX, avr_irq_t *irqY, avr_irq_t *irqZ)
 {
     _Init(avr, this);
+	BuildCalGrid();
 
 	// The MK2 does not have a separate set of MBL points or a removable sheet.
 	RegisterActionAndMenu("ToggleSheet","Toggles the presence of the steel sheet",ActToggleSheet);
@@ -27,6 +27,7 @@
 #include "Scriptable.h"      // for Scriptable
 #include "sim_avr.h"         // for avr_t
 #include "sim_irq.h"         // for avr_irq_t
+#include <array>             // for array
 #include <atomic>
 #include <cstdint>          // for uint32_t
 #include <string>            // for string
@@ -102,6 +103,25 @@ private:
 
     void SetMBLMap();
 
+	// Bins the XY cal points into a grid of CAL_RADIUS cells so a position only needs
+	// to be checked against the few points that can be in range of its cell.
+	void BuildCalGrid();
+
+	// Looks up the cell containing the current position and caches its bounds.
+	void LocateCalCell();
+	void LocateMeshCell();
+
+	// Forces the next check to look the cell up again (map/points/sheet changed).
+	inline void InvalidateCell() { m_bCellValid = false; }
+
+	inline bool InCell() const
+	{
+		return m_bCellValid && m_fPos[0]>=m_cell.fXLo && m_fPos[0]<m_cell.fXHi && m_fPos[1]>=m_cell.fYLo && m_fPos[1]<m_cell.fYHi;
+	}
+
+	// Raises TRIGGER_OUT only if the state changed.
+	void SetTrigger(bool bTrig);
+
 	gsl::span<float>& GetXYCalPoints();
 
 	float m_fZTrigHeight = 1.0; // Trigger height above Z=0, i.e. the "zip tie" adjustment
@@ -111,4 +131,23 @@ private:
     std::atomic_bool m_bIsSheetPresent {true}; // Is the steel sheet present? IF yes, PINDA will attempt to simulate the bed sensing point for selfcal instead.
 	XYCalMap m_XYCalType;
 
+	static constexpr float CAL_RADIUS = 10.f; // XY cal point search radius
+	static constexpr float MESH_MAX_X = 255.f, MESH_MAX_Y = 210.f;
+
+	struct Cell
+	{
+		float fXLo, fXHi, fYLo, fYHi;
+	};
+
+	// Cal point grid: indices (into GetXYCalPoints()/2) of points within CAL_RADIUS of each cell.
+	std::vector<std::vector<uint8_t>> m_vCalGrid;
+	std::array<float,2> m_fGridOrigin = {{0,0}};
+	unsigned int m_uiGridW = 0, m_uiGridH = 0;
+
+	// Cached cell for the current position.
+	Cell m_cell {0,0,0,0};
+	bool m_bCellValid = false;
+	const std::vector<uint8_t> *m_pCellCands = nullptr; // No-sheet: candidate cal points.
+	int m_iMeshIdx = 0; // Sheet: MBL point index.
+
 };
@@ -0,0 +1,362 @@
+/*
+	PrintHost.cpp - A built-in print host that streams a G-code file over a UART.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PrintHost.h"
+#include "avr_uart.h"  // for AVR_IOCTL_UART_GETIRQ, ::UART_IRQ_INPUT, ::UAR...
+#include "sim_io.h"    // for avr_io_getirq
+#include <algorithm>   // for max
+#include <cstdlib>     // for strtoul
+#include <fstream>     // for ifstream
+#include <iomanip>     // for setprecision
+#include <iostream>    // for operator<<, basic_ostream, cout, ostream
+
+PrintHost::PrintHost(const std::string &strName):Scriptable(strName)
+{
+	RegisterAction("Stream","Streams the given G-code file with ok flow control, waits until the firmware has acknowledged all of it and prints throughput statistics.",ActStream,{ArgType::String});
+	RegisterAction("SetLineNumbers","Sends lines with line numbers and checksums, and honours resend requests.",ActSetLineNumbers,{ArgType::Bool});
+	RegisterAction("SetBufferLimits","Sets how many lines and bytes may be sent ahead of the firmware's acknowledgements (lines, bytes).",ActSetBufferLimits,{ArgType::Int,ArgType::Int});
+	RegisterAction("Stop","Stops the current stream and prints its statistics.",ActStop);
+	m_strLine.reserve(100);
+}
+
+bool PrintHost::LoadFile(const std::string &strFile)
+{
+	std::ifstream fIn(strFile);
+	if (!fIn.is_open())
+	{
+		return false;
+	}
+	m_vCommands.clear();
+	if (m_bLineNumbers)
+	{
+		m_vCommands.emplace_back("M110 N0"); // Reset the firmware's line count, so index == line number.
+	}
+	std::string strLine;
+	while (std::getline(fIn, strLine))
+	{
+		strLine = strLine.substr(0, strLine.find(';'));
+		auto iStart = strLine.find_first_not_of(" \t\r");
+		if (iStart == std::string::npos)
+		{
+			continue;
+		}
+		auto iEnd = strLine.find_last_not_of(" \t\r");
+		m_vCommands.push_back(strLine.substr(iStart, iEnd - iStart + 1));
+	}
+	return true;
+}
+
+std::string PrintHost::FormatLine(size_t i) const
+{
+	if (!m_bLineNumbers || i == 0)
+	{
+		return m_vCommands.at(i) + '\n';
+	}
+	std::string strLine = "N" + std::to_string(i) + ' ' + m_vCommands.at(i);
+	uint8_t uiSum = 0;
+	for (auto c : strLine)
+	{
+		uiSum ^= static_cast<uint8_t>(c);
+	}
+	return strLine + '*' + std::to_string(uiSum) + '\n';
+}
+
+void PrintHost::Pump()
+{
+	if (!m_bStreaming)
+	{
+		return;
+	}
+	while (m_uiNext < m_vCommands.size() && m_qInFlight.size() < m_uiMaxLines)
+	{
+		std::string strLine = FormatLine(m_uiNext);
+		// A line longer than the buffer still has to go, but only on its own.
+		if (!m_qInFlight.empty() && (m_uiInFlightBytes + strLine.size()) > m_uiMaxBytes)
+		{
+			break;
+		}
+		m_strTx += strLine;
+		m_qInFlight.push_back(strLine.size());
+		m_uiInFlightBytes += strLine.size();
+		m_uiNext++;
+	}
+	// XOFF comes back synchronously once the UART's receive FIFO fills up.
+	while (m_bXOn && m_uiTxPos < m_strTx.size())
+	{
+		char c = m_strTx[m_uiTxPos++];
+		RaiseIRQ(BYTE_OUT, c);
+		m_uiBytes++;
+		if (c == '\n')
+		{
+			m_uiPushed++;
+			m_qLineEnds.push_back(m_uiBytes);
+		}
+	}
+	if (m_uiTxPos == m_strTx.size())
+	{
+		m_strTx.clear();
+		m_uiTxPos = 0;
+	}
+}
+
+void PrintHost::UpdateDelivered()
+{
+	if (m_pUART != nullptr)
+	{
+		uint64_t uiRead = m_uiBytes - uart_fifo_get_read_size(&m_pUART->input);
+		while (!m_qLineEnds.empty() && m_qLineEnds.front() <= uiRead)
+		{
+			m_qLineEnds.pop_front();
+			m_uiDelivered++;
+		}
+	}
+	// An acknowledged line has obviously been read.
+	while (m_uiDelivered < m_uiAcked && !m_qLineEnds.empty())
+	{
+		m_qLineEnds.pop_front();
+		m_uiDelivered++;
+	}
+	m_uiDelivered = std::max(m_uiDelivered, m_uiAcked);
+}
+
+void PrintHost::UpdateStarved()
+{
+	bool bStarved = m_bStreaming && m_uiDelivered == m_uiAcked;
+	if (bStarved && !m_bStarved)
+	{
+		m_uiStarveStart = m_pAVR->cycle;
+		if (m_pUART != nullptr)
+		{
+			RegisterTimer(m_fcnPoll, 1, this);
+		}
+	}
+	else if (!bStarved && m_bStarved)
+	{
+		m_uiStarved += m_pAVR->cycle - m_uiStarveStart;
+		CancelTimer(m_fcnPoll, this);
+	}
+	m_bStarved = bStarved;
+}
+
+avr_cycle_count_t PrintHost::OnStarvedPoll(struct avr_t *avr, avr_cycle_count_t when)
+{
+	UpdateDelivered();
+	UpdateStarved();
+	// Every 10us, about a tenth of a byte at 115200 baud.
+	return m_bStarved ? when + (avr->frequency/100000U) : 0;
+}
+
+void PrintHost::OnXOnIn(struct avr_irq_t *, uint32_t)
+{
+	// The UART only signals XON once its FIFO is empty, so the firmware has read everything pushed so far.
+	m_bXOn = true;
+	m_uiDelivered = m_uiPushed;
+	m_qLineEnds.clear();
+	Pump();
+	UpdateStarved();
+}
+
+void PrintHost::OnXOffIn(struct avr_irq_t *, uint32_t)
+{
+	m_bXOn = false;
+}
+
+void PrintHost::OnByteIn(struct avr_irq_t *, uint32_t value)
+{
+	char c = static_cast<char>(value & 0xFFU);
+	if (c == '\n')
+	{
+		OnNewLine();
+		m_strLine.clear();
+	}
+	else if (c != '\r')
+	{
+		m_strLine.push_back(c);
+	}
+}
+
+void PrintHost::OnNewLine()
+{
+	if (!m_bStreaming)
+	{
+		return;
+	}
+	if (m_strLine.rfind("Error:",0) == 0)
+	{
+		m_uiErrors++;
+	}
+	else if (m_strLine.rfind("Resend:",0) == 0 || m_strLine.rfind("rs ",0) == 0)
+	{
+		// The firmware follows this with an "ok" for the rejected line.
+		m_bSkipOk = true;
+		size_t uiLine = std::strtoul(m_strLine.substr(m_strLine.find_first_of(": ") + 1).c_str(), nullptr, 10);
+		// Lines sent after the bad one are rejected too, each asking for the same line again.
+		if (!m_bLineNumbers || uiLine == m_uiLastResend || uiLine == 0 || uiLine >= m_vCommands.size())
+		{
+			return;
+		}
+		m_uiLastResend = uiLine;
+		m_uiResends++;
+		// Finish the line that's partly on the wire, drop the rest and go again from the requested one.
+		size_t uiKeep = m_uiTxPos;
+		if (m_uiTxPos > 0 && m_strTx[m_uiTxPos - 1] != '\n')
+		{
+			uiKeep = m_strTx.find('\n', m_uiTxPos) + 1;
+		}
+		m_strTx.resize(uiKeep);
+		m_qInFlight.clear();
+		m_qLineEnds.clear();
+		m_uiInFlightBytes = 0;
+		m_uiAcked = m_uiDelivered = m_uiPushed;
+		m_uiNext = uiLine;
+		Pump();
+	}
+	else if (m_strLine == "ok" || m_strLine.rfind("ok ",0) == 0)
+	{
+		if (m_bSkipOk)
+		{
+			m_bSkipOk = false;
+		}
+		else if (!m_qInFlight.empty())
+		{
+			m_uiInFlightBytes -= m_qInFlight.front();
+			m_qInFlight.pop_front();
+			m_uiAcked++;
+			m_uiLastResend = 0;
+		}
+		if (m_qInFlight.empty() && m_strTx.empty() && m_uiNext == m_vCommands.size())
+		{
+			m_uiEnd = m_pAVR->cycle;
+			m_bStreaming = false;
+			UpdateStarved();
+			return;
+		}
+		Pump();
+	}
+	UpdateDelivered();
+	UpdateStarved();
+}
+
+void PrintHost::PrintStats()
+{
+	if (m_bStreaming) // Stopped early
+	{
+		m_uiEnd = m_pAVR->cycle;
+		m_bStreaming = false;
+		UpdateStarved();
+	}
+	auto fSecs = [this](avr_cycle_count_t uiCycles) { return static_cast<double>(uiCycles)/static_cast<double>(m_pAVR->frequency); };
+	double fTime = fSecs(m_uiEnd - m_uiStart);
+	double fRate = fTime > 0 ? 1.0/fTime : 0;
+	size_t uiLines = m_vCommands.size() - (m_bLineNumbers ? 1 : 0);
+	std::cout << std::fixed << std::setprecision(3) << GetName() << ": " << uiLines << " lines, " << m_uiBytes << " bytes in " << fTime << " s simulated: "
+		<< static_cast<double>(uiLines)*fRate << " lines/s, " << static_cast<double>(m_uiBytes)*fRate << " bytes/s, starved "
+		<< fSecs(m_uiStarved) << " s (" << (fTime > 0 ? 100.0*fSecs(m_uiStarved)/fTime : 0) << "%), "
+		<< m_uiResends << " resends, " << m_uiErrors << " errors\n" << std::defaultfloat;
+}
+
+Scriptable::LineStatus PrintHost::ProcessAction(unsigned int ID, const std::vector<std::string> &vArgs)
+{
+	switch (ID)
+	{
+		case ActStream:
+		{
+			if (m_bStreaming)
+			{
+				return LineStatus::Waiting;
+			}
+			else if (m_bActive) // Finished.
+			{
+				PrintStats();
+				m_bActive = false;
+				return LineStatus::Finished;
+			}
+			if (!LoadFile(vArgs.at(0)))
+			{
+				return IssueLineError("Could not open " + vArgs.at(0));
+			}
+			m_strTx.clear();
+			m_qInFlight.clear();
+			m_qLineEnds.clear();
+			m_uiTxPos = m_uiNext = m_uiInFlightBytes = m_uiLastResend = 0;
+			m_uiPushed = m_uiDelivered = m_uiAcked = m_uiResends = m_uiErrors = 0;
+			m_uiBytes = m_uiStarved = 0;
+			m_bSkipOk = m_bStarved = false;
+			m_uiStart = m_uiEnd = m_pAVR->cycle;
+			m_bStreaming = !m_vCommands.empty();
+			m_bActive = true;
+			Pump();
+			UpdateStarved();
+			return LineStatus::Waiting;
+		}
+		case ActSetLineNumbers:
+			m_bLineNumbers = std::stoi(vArgs.at(0))!=0;
+			return LineStatus::Finished;
+		case ActSetBufferLimits:
+		{
+			int iLines = std::stoi(vArgs.at(0)), iBytes = std::stoi(vArgs.at(1));
+			if (iLines < 1 || iBytes < 1)
+			{
+				return IssueLineError("Buffer limits must be at least 1");
+			}
+			m_uiMaxLines = iLines;
+			m_uiMaxBytes = iBytes;
+			return LineStatus::Finished;
+		}
+		case ActStop:
+			if (m_bActive)
+			{
+				PrintStats();
+				m_bActive = false;
+				m_strTx.clear();
+				m_uiTxPos = 0;
+			}
+			return LineStatus::Finished;
+	}
+	return LineStatus::Unhandled;
+}
+
+void PrintHost::Init(struct avr_t * avr, char chrUART)
+{
+	_Init(avr, this);
+	m_chrUART = chrUART;
+	RegisterNotify(BYTE_IN, MAKE_C_CALLBACK(PrintHost, OnByteIn),this);
+
+	avr_irq_t * src = avr_io_getirq(m_pAVR, AVR_IOCTL_UART_GETIRQ(chrUART), UART_IRQ_OUTPUT); //NOLINT - complaint in external macro
+	avr_irq_t * dst = avr_io_getirq(m_pAVR, AVR_IOCTL_UART_GETIRQ(chrUART), UART_IRQ_INPUT); //NOLINT - complaint in external macro
+	avr_irq_t * xon = avr_io_getirq(m_pAVR, AVR_IOCTL_UART_GETIRQ(chrUART), UART_IRQ_OUT_XON); //NOLINT - complaint in external macro
+	avr_irq_t * xoff = avr_io_getirq(m_pAVR, AVR_IOCTL_UART_GETIRQ(chrUART), UART_IRQ_OUT_XOFF); //NOLINT - complaint in external macro
+	if (src && dst) {
+		ConnectFrom(src, BYTE_IN);
+		ConnectTo(BYTE_OUT, dst);
+	}
+	if (xon) avr_irq_register_notify(xon, MAKE_C_CALLBACK(PrintHost,OnXOnIn), this);
+	if (xoff) avr_irq_register_notify(xoff, MAKE_C_CALLBACK(PrintHost,OnXOffIn),this);
+
+	// Used to see how far the firmware has read. Without it, only XON (FIFO empty) tells us.
+	for (avr_io_t *pIO = avr->io_port; pIO != nullptr; pIO = pIO->next)
+	{
+		if (std::string(pIO->kind) == "uart" && reinterpret_cast<avr_uart_t*>(pIO)->name == chrUART) //NOLINT - io is the first member
+		{
+			m_pUART = reinterpret_cast<avr_uart_t*>(pIO); //NOLINT - io is the first member
+		}
+	}
+}
@@ -0,0 +1,126 @@
+/*
+	PrintHost.h - A built-in print host that streams a G-code file over a UART.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "BasePeripheral.h"  // for BasePeripheral
+#include "IScriptable.h"     // for ArgType, IScriptable::LineStatus
+#include "Scriptable.h"      // for Scriptable
+#include "avr_uart.h"        // for avr_uart_t
+#include "sim_avr.h"         // for avr_t
+#include "sim_avr_types.h"   // for avr_cycle_count_t
+#include "sim_irq.h"         // for avr_irq_t
+#include <cstdint>           // for uint32_t
+#include <deque>             // for deque
+#include <string>            // for string
+#include <vector>            // for vector
+
+// Streams a G-code file into the firmware the way a host program would: a line goes out
+// once the firmware has acknowledged enough of the previous ones with "ok" to have room for it.
+// Bytes are pushed as fast as the UART takes them (XON/XOFF), so the throughput figures are
+// those of the firmware and the wire, not of the script polling rate.
+class PrintHost : public BasePeripheral, public Scriptable
+{
+	public:
+		#define IRQPAIRS _IRQ(BYTE_IN,"8<host.in") _IRQ(BYTE_OUT,"8>host.out")
+		#include "IRQHelper.h"
+
+		explicit PrintHost(const std::string &strName = "PrintHost");
+
+		~PrintHost() override = default;
+
+		// Registers with SimAVR.
+		void Init(avr_t *avr, char chrUART);
+
+	protected:
+		LineStatus ProcessAction(unsigned int ID, const std::vector<std::string> &vArgs) override;
+
+	private:
+		void OnByteIn(avr_irq_t *irq, uint32_t value);
+		void OnXOnIn(avr_irq_t *irq, uint32_t value);
+		void OnXOffIn(avr_irq_t *irq, uint32_t value);
+		void OnNewLine();
+
+		// Queues as many lines as the buffer limits allow, and pushes bytes while the UART has room.
+		void Pump();
+
+		// Formats command i for the wire, with line number and checksum if enabled.
+		std::string FormatLine(size_t i) const;
+
+		// Counts the lines the firmware has read out of the UART's receive FIFO.
+		void UpdateDelivered();
+
+		// The firmware is starved when it has acknowledged every complete line it has read.
+		void UpdateStarved();
+
+		// Polls the FIFO while starved, to see when the next line has arrived.
+		avr_cycle_count_t OnStarvedPoll(avr_t *avr, avr_cycle_count_t when);
+		avr_cycle_timer_t m_fcnPoll = MAKE_C_TIMER_CALLBACK(PrintHost,OnStarvedPoll);
+
+		void PrintStats();
+
+		bool LoadFile(const std::string &strFile);
+
+		enum Actions
+		{
+			ActStream,
+			ActSetLineNumbers,
+			ActSetBufferLimits,
+			ActStop
+		};
+
+		std::vector<std::string> m_vCommands; // Stripped commands, index + 1 is the line number.
+		size_t m_uiNext = 0; // Next command to queue.
+
+		std::string m_strTx; // Bytes queued but not yet pushed into the UART.
+		size_t m_uiTxPos = 0;
+
+		std::deque<size_t> m_qInFlight; // Byte counts of sent lines awaiting "ok", oldest first.
+		size_t m_uiInFlightBytes = 0;
+		std::deque<uint64_t> m_qLineEnds; // Byte counts at which pushed lines end, for those not yet read.
+		uint32_t m_uiPushed = 0; // Complete lines pushed into the UART.
+		uint32_t m_uiDelivered = 0; // Complete lines the firmware has read out of the UART.
+		uint32_t m_uiAcked = 0;
+
+		size_t m_uiMaxLines = 1; // Unacknowledged lines allowed (firmware command buffer)
+		size_t m_uiMaxBytes = 127; // Unacknowledged bytes allowed (firmware RX buffer)
+		bool m_bLineNumbers = false;
+
+		bool m_bActive = false; // A Stream action is in progress.
+		bool m_bStreaming = false; // Lines remain to be sent or acknowledged.
+		bool m_bXOn = true;
+		bool m_bSkipOk = false; // The "ok" following a resend request doesn't acknowledge anything.
+		size_t m_uiLastResend = 0;
+
+		std::string m_strLine;
+
+		// Statistics
+		avr_cycle_count_t m_uiStart = 0;
+		avr_cycle_count_t m_uiEnd = 0;
+		avr_cycle_count_t m_uiStarveStart = 0;
+		avr_cycle_count_t m_uiStarved = 0;
+		bool m_bStarved = false;
+		uint64_t m_uiBytes = 0;
+		uint32_t m_uiResends = 0;
+		uint32_t m_uiErrors = 0;
+		avr_uart_t *m_pUART = nullptr;
+		char m_chrUART = '0';
+};
@@ -23,10 +23,13 @@
 	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "SDCard.h"
+#include "Config.h"
+#include "FatImage.h"   // for FatImage
 #include "IKeyClient.h"
 #include "Macros.h"
 #include "TelemetryHost.h"
 #include "gsl-lite.hpp"
+#include <algorithm>  // for min, equal
 #include <cerrno>     // for errno
 #include <cstring>    // for memset
 #include <fcntl.h>     // for open, O_CLOEXEC, O_CREAT, O_RDWR
@@ -34,7 +37,7 @@
 #include <sys/file.h>  // for flock, LOCK_UN, LOCK_EX
 #include <sys/mman.h>  // for mmap, msync, munmap, MAP_FAILED, MAP_SHARED
 #include <sys/stat.h>  // for fstat, stat, S_IRUSR, S_IWUSR
-#include <unistd.h>    // for close, off_t, ftruncate
+#include <unistd.h>    // for close, off_t, ftruncate, pread, pwrite
 #include <utility>
 
 void SDCard::OnKeyPress(const Key& key)
@@ -69,6 +72,7 @@ SDCard:: SDCard(std::string strFile):Scriptable("SDCard"),m_strFile(std::move(st
 	RegisterActionAndMenu("Unmount", "Unmounts the currently mounted file, if any.", Actions::ActUnmount);
 	RegisterActionAndMenu("Remount", "Remounts the last mounted file, if any.", Actions::ActMountLast);
 	RegisterAction("Mount", "Mounts the specified file on the SD card.",ActMountFile,{ArgType::String});
+	RegisterAction("AddFile", "Copies the given host file into the root directory of the mounted image. Remount for the firmware to see it.",ActAddFile,{ArgType::String});
 
 	RegisterKeyHandler('c',"Toggle SD card mount/unmount");
 };
@@ -99,6 +103,13 @@ Scriptable::LineStatus SDCard::ProcessAction(unsigned int iAct, const std::vecto
 			return LineStatus::Finished;
 		case ActMountFile:
 			return Mount(vArgs.at(0)) ? LineStatus::Error : LineStatus::Finished; // 0 = success.
+		case ActAddFile:
+			if (!m_bMounted || m_bRdOnly)
+			{
+				return IssueLineError("No writable SD image is mounted");
+			}
+			m_bUntracked |= m_bOverlay;
+			return FatImage::AddFile(m_data, vArgs.at(0)) ? LineStatus::Finished : LineStatus::Error;
 
 	};
 	return LineStatus::Unhandled;
@@ -275,6 +286,10 @@ SDCard::State SDCard::ProcessCommand()
 
 				next_state = State::DATA_WRITE_TOKEN;
 				m_currOp.SetData(m_data.subspan(addr,BLOCK_SIZE));
+				if (m_bOverlay)
+				{
+					m_vDirty[addr/BLOCK_SIZE] = true;
+				}
 			}
 
 			break;
@@ -577,7 +592,13 @@ int SDCard::Mount(const std::string &filename, off_t image_size)
 		std::cout << "SD file " << m_strFile << " does not exist. Will not create it.\n";
 		return -1;
 	}
-	if (access(m_strFile.c_str(), W_OK) == -1)
+	m_bOverlay = Config::Get().GetSDOverlay();
+	if (m_bOverlay)
+	{
+		std::cout << "SD file " << m_strFile << " mounted as a copy-on-write overlay, changes will be " << (Config::Get().GetSDOverlayCommit() ? "committed" : "discarded") << " at unmount.\n";
+		m_bRdOnly = false;
+	}
+	else if (access(m_strFile.c_str(), W_OK) == -1)
 	{
 		std::cout << "SD file " << m_strFile << " is READ-ONLY. Mounting accordingly, **write operations will fail!**.\n";
 		m_bRdOnly = true;
@@ -585,8 +606,8 @@ int SDCard::Mount(const std::string &filename, off_t image_size)
 		m_bRdOnly = false;
 	}
 
-	/* Open the specified disk image. */
-	if (m_bRdOnly) {
+	/* Open the specified disk image. Overlays never write through this. */
+	if (m_bRdOnly || m_bOverlay) {
 		fd = open (m_strFile.c_str(), O_RDONLY | O_CLOEXEC, S_IRUSR); //NOLINT - no c++ stl non vararg memmap available.
 	} else {
 		fd = open (m_strFile.c_str(), O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR); //NOLINT - no c++ stl non vararg memmap available.
@@ -597,8 +618,8 @@ int SDCard::Mount(const std::string &filename, off_t image_size)
 		return errno;
 	}
 
-	/* Lock it for exclusive access. */
-	if (flock (fd, LOCK_EX) == -1)
+	/* Lock it for exclusive access. Overlays share it with each other. */
+	if (flock (fd, m_bOverlay ? LOCK_SH : LOCK_EX) == -1)
 	{
 		return OnError(errno);
 	}
@@ -619,6 +640,10 @@ int SDCard::Mount(const std::string &filename, off_t image_size)
 		}
 		std::cout << "Autodetected SD image size as " << image_size/(1024*1024) << " Mb\n";
 	}
+	else if (stat_buf.st_size < image_size && m_bOverlay)
+	{
+		image_size = stat_buf.st_size;
+	}
 	else if (stat_buf.st_size < image_size)
 	{
 		if (ftruncate (fd, image_size) == -1)
@@ -632,7 +657,8 @@ int SDCard::Mount(const std::string &filename, off_t image_size)
 	if (!m_bRdOnly) {
 		iFlags |= US(PROT_WRITE);
 	}
-	mapped = mmap (nullptr, image_size,iFlags, MAP_SHARED, fd, 0);
+	// Private pages are copied on first write; the rest stay shared with every other user of the image.
+	mapped = mmap (nullptr, image_size,iFlags, m_bOverlay ? MAP_PRIVATE : MAP_SHARED, fd, 0);
 
 	if (mapped == MAP_FAILED) //NOLINT - complaint in system library
 	{
@@ -642,6 +668,11 @@ int SDCard::Mount(const std::string &filename, off_t image_size)
 	/* Success. */
 	m_data = {static_cast<uint8_t*>(mapped),gsl::narrow<uint64_t>(image_size)};
 	m_data_fd = fd;
+	if (m_bOverlay)
+	{
+		m_vDirty.assign((image_size + BLOCK_SIZE - 1)/BLOCK_SIZE, false);
+		m_bUntracked = false;
+	}
 
 	/* Update the C_SIZE field (number of sectors) in the CSD register. Reference for size calculations: JESD84-A44, Section 8.3, 'C_SIZE'. */
 	SetCSDCSize(image_size);
@@ -652,6 +683,44 @@ int SDCard::Mount(const std::string &filename, off_t image_size)
 	return 0;
 }
 
+void SDCard::CommitOverlay()
+{
+	// Everyone else sharing the image would see it change underneath them.
+	if (flock(m_data_fd, US(LOCK_EX) | US(LOCK_NB)) == -1)
+	{
+		std::cerr << "SD image " << m_strFile << " is in use by another instance, overlay changes were discarded.\n";
+		return;
+	}
+	int fd = open(m_strFile.c_str(), O_RDWR | O_CLOEXEC); //NOLINT - no c++ stl non vararg memmap available.
+	if (fd == -1)
+	{
+		std::cerr << "Could not open " << m_strFile << " for writing, overlay changes were discarded.\n";
+		return;
+	}
+	std::vector<uint8_t> vBase(BLOCK_SIZE);
+	size_t uiCount = 0;
+	for (size_t i = 0; i < m_vDirty.size(); i++)
+	{
+		auto block = m_data.subspan(i*BLOCK_SIZE, std::min<size_t>(BLOCK_SIZE, m_data.size() - (i*BLOCK_SIZE)));
+		if (!m_vDirty[i])
+		{
+			// Script changes aren't tracked by block, so find them the slow way.
+			if (!m_bUntracked || pread(fd, vBase.data(), block.size(), i*BLOCK_SIZE) != gsl::narrow<ssize_t>(block.size())
+				|| std::equal(block.begin(), block.end(), vBase.begin()))
+			{
+				continue;
+			}
+		}
+		if (pwrite(fd, block.data(), block.size(), i*BLOCK_SIZE) == gsl::narrow<ssize_t>(block.size()))
+		{
+			uiCount++;
+		}
+	}
+	fsync(fd);
+	close(fd);
+	std::cout << "Committed " << uiCount << " changed blocks of the SD overlay to " << m_strFile << '\n';
+}
+
 int SDCard::Unmount()
 {
 	// Force to idle so we don't keep trying to read the missing card.
@@ -662,7 +731,14 @@ int SDCard::Unmount()
 		/* No disk mounted. */
 
 		/* Synchronise changes. */
-		msync (m_data.data(), m_data.size(), US(MS_SYNC) | US(MS_INVALIDATE));
+		if (!m_bOverlay)
+		{
+			msync (m_data.data(), m_data.size(), US(MS_SYNC) | US(MS_INVALIDATE));
+		}
+		else if (Config::Get().GetSDOverlayCommit())
+		{
+			CommitOverlay();
+		}
 
 		/* Unlock the file. */
 		flock (m_data_fd, LOCK_UN);
@@ -75,7 +75,8 @@ class SDCard:public SPIPeripheral, public Scriptable, private IKeyClient
 		{
 			ActMountFile,
 			ActMountLast,
-			ActUnmount
+			ActUnmount,
+			ActAddFile
 		};
 
 		enum class State {
@@ -208,4 +209,10 @@ class SDCard:public SPIPeripheral, public Scriptable, private IKeyClient
 		/* Card data. */
 		gsl::span<uint8_t> m_data; /* mmap()ed data */
 		int m_data_fd = -1;
+
+		// Overlay mode: the image is mapped privately, so writes never reach the file unless committed.
+		void CommitOverlay();
+		bool m_bOverlay = false;
+		std::vector<bool> m_vDirty; // Blocks written by the firmware
+		bool m_bUntracked = false; // Changed outside the block writes, commit has to compare
 };
@@ -26,6 +26,7 @@
 #include "sim_io.h"    // for avr_io_getirq
 #include <algorithm>         // for copy
 #include <iostream>    // for operator<<, basic_ostream, cout, ostream
+#include <sstream>     // for stringstream
 
 
 SerialLineMonitor::SerialLineMonitor(const std::string &strName):Scriptable(strName)
@@ -34,6 +35,9 @@ SerialLineMonitor::SerialLineMonitor(const std::string &strName):Scriptable(strN
 	RegisterAction("WaitForLineContains","Waits for the serial output to contain a line with the given string.",WaitForContains,{ArgType::String});
 	RegisterAction("SendGCode","Sends the specified string as G-Code.",SendGCode,{ArgType::String});
 	RegisterAction("NextLineMustBe","Errors if the next output line is not as specified.",NextLineMustBe, {ArgType::String});
+	RegisterAction("WaitForAny","Waits for a line containing any of the |-separated patterns. {} in a pattern captures a field.",WaitForAny, {ArgType::String});
+	RegisterAction("Expect","As WaitForAny, but errors if a pattern other than the first one matches first.",Expect, {ArgType::String});
+	RegisterAction("CaptureMustBe","Errors if the given field captured by the last WaitForAny/Expect is not as specified. (index, value)",CaptureMustBe, {ArgType::Int,ArgType::String});
 	m_strLine.reserve(100);
 };
 
@@ -45,6 +49,10 @@ void SerialLineMonitor::OnByteIn(struct avr_irq_t *, uint32_t value)
 	if (!bNewLine)
 	{
 		m_strLine.push_back(c);
+		if (m_type == Any)
+		{
+			m_matcher.Feed(c);
+		}
 	}
 	else
 	{
@@ -65,6 +73,27 @@ void SerialLineMonitor::OnXOffIn(struct avr_irq_t *, uint32_t)
 
 Scriptable::LineStatus SerialLineMonitor::ProcessAction(unsigned int ID, const std::vector<std::string> &args)
 {
+	if ((ID == WaitForAny || ID == Expect) && m_type == Any && m_strMatch == args.at(0))
+	{
+		if (!m_bMatched)
+		{
+			return LineStatus::Waiting;
+		}
+		m_strMatch.clear();
+		m_type = None;
+		m_bMatched = false;
+		std::cout << GetName() << " matched: " << m_matcher.GetPattern(m_uiMatchId);
+		for (auto &strCap : m_vCaptures)
+		{
+			std::cout << " [" << strCap << ']';
+		}
+		std::cout << '\n';
+		if (ID == Expect && m_uiMatchId != 0)
+		{
+			return IssueLineError("Expected " + m_matcher.GetPattern(0) + " but got " + m_matcher.GetPattern(m_uiMatchId));
+		}
+		return LineStatus::Finished;
+	}
 	if (m_type != None && m_strMatch == args.at(0)) // already in wait state for same find
 	{
 		if (m_iLineCt>0 && !m_bMatched && ID == NextLineMustBe) // Failed to match on the next line.
@@ -99,6 +128,39 @@ Scriptable::LineStatus SerialLineMonitor::ProcessAction(unsigned int ID, const s
 			m_strMatch = args[0];
 			m_type = MustBe;
 			return LineStatus::Waiting;
+		case WaitForAny:
+		case Expect:
+		{
+			m_matcher.Clear();
+			std::stringstream strPatterns(args.at(0));
+			std::string strPattern;
+			while (std::getline(strPatterns, strPattern, '|'))
+			{
+				if (m_matcher.Add(strPattern) < 0)
+				{
+					return IssueLineError("Pattern " + strPattern + " has no text to match");
+				}
+			}
+			m_matcher.Compile();
+			m_vCaptures.clear();
+			m_bMatched = false;
+			m_strMatch = args[0];
+			m_type = Any;
+			return LineStatus::Waiting;
+		}
+		case CaptureMustBe:
+		{
+			size_t uiIndex = std::stoi(args.at(0));
+			if (uiIndex >= m_vCaptures.size())
+			{
+				return IssueLineError("Capture " + args.at(0) + " is out of range, there are " + std::to_string(m_vCaptures.size()));
+			}
+			if (m_vCaptures.at(uiIndex) != args.at(1))
+			{
+				return IssueLineError("Capture " + args.at(0) + " is " + m_vCaptures.at(uiIndex));
+			}
+			return LineStatus::Finished;
+		}
 		case SendGCode:
 			if (m_strGCode.empty())
 			{
@@ -149,6 +211,18 @@ void SerialLineMonitor::OnNewLine()
 		case Contains:
 			m_bMatched = m_strLine.find(m_strMatch) != std::string::npos;
 			break;
+		case Any:
+		{
+			auto vMatches = m_matcher.NewLine(m_strLine);
+			if (!m_bMatched && !vMatches.empty())
+			{
+				m_bMatched = true;
+				m_uiMatchId = vMatches.front().id;
+				m_vCaptures = vMatches.front().captures;
+				RaiseIRQ(MATCH, m_uiMatchId + 1);
+			}
+			break;
+		}
 		case None:
 			break;
 	}
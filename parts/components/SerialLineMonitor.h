@@ -23,6 +23,7 @@
 
 #include "BasePeripheral.h"  // for BasePeripheral
 #include "IScriptable.h"     // for ArgType, ArgType::String, IScriptable::L...
+#include "PatternMatcher.h"  // for PatternMatcher
 #include "Scriptable.h"      // for Scriptable
 #include "sim_avr.h"         // for avr_t
 #include "sim_irq.h"         // for avr_irq_t
@@ -33,7 +34,7 @@
 class SerialLineMonitor : public BasePeripheral,public Scriptable
 {
 	public:
-		#define IRQPAIRS _IRQ(BYTE_IN,"8<monitor.in") _IRQ(BYTE_OUT,"8>monitor.out")
+		#define IRQPAIRS _IRQ(BYTE_IN,"8<monitor.in") _IRQ(BYTE_OUT,"8>monitor.out") _IRQ(MATCH,"16>monitor.match")
 		#include "IRQHelper.h"
 
 		// Creates a logger that sniffs for
@@ -53,7 +54,8 @@ class SerialLineMonitor : public BasePeripheral,public Scriptable
 			None = 0,
 			Full,
 			Contains,
-			MustBe
+			MustBe,
+			Any
 		};
 		void OnByteIn(avr_irq_t *irq, uint32_t value);
 		void OnXOnIn(avr_irq_t *irq, uint32_t value);
@@ -71,6 +73,11 @@ class SerialLineMonitor : public BasePeripheral,public Scriptable
 
 		std::string::iterator  m_itGCode;
 
+		// Patterns for WaitForAny/Expect, checked as the bytes come in.
+		PatternMatcher m_matcher;
+		size_t m_uiMatchId = 0;
+		std::vector<std::string> m_vCaptures;
+
 		char m_chrUART = '0';
 		bool m_bMatched = false;
 		unsigned int m_iLineCt = 0;
@@ -79,7 +86,10 @@ class SerialLineMonitor : public BasePeripheral,public Scriptable
 			WaitForLine,
 			WaitForContains,
 			NextLineMustBe,
-			SendGCode
+			SendGCode,
+			WaitForAny,
+			Expect,
+			CaptureMustBe
 		};
 
 };
@@ -21,6 +21,7 @@
 
 #include "TMC2130.h"
 #include "3rdParty/catch2/catch.hpp"
+#include "Config.h"
 #include "TelemetryHost.h"
 #include "gsl-lite.hpp"
 #include <algorithm>          // for min
@@ -182,7 +183,6 @@ void TMC2130::OnStepIn(struct avr_irq_t * irq, uint32_t value)
 		// With DEDGE step on each value change
 		if (value == irq->value) return;
 	}
-    CancelTimer(m_fcnStandstill,this);
 	//TRACE2(printf("TMC2130 %c: STEP changed to %02x\n",m_cAxis,value));
     if (m_bDir)
 	{
@@ -212,6 +212,15 @@ void TMC2130::OnStepIn(struct avr_irq_t * irq, uint32_t value)
 	std::memcpy (&posOut, &m_fCurPos, 4);
     RaiseIRQ(POSITION_OUT, posOut);
 	RaiseIRQ(STEP_POS_OUT, m_iCurStep);
+	if (m_uiPosPeriod == 0)
+	{
+		RaiseIRQ(POSITION_COARSE_OUT, posOut);
+	}
+	else if (!m_bPosPending)
+	{
+		m_bPosPending = true;
+		RegisterTimer(m_fcnPosPublish, m_uiPosPeriod, this);
+	}
     TRACE(printf("cur pos: %f (%u)\n",m_fCurPos,m_iCurStep));
 	bStall |= m_bStall;
     if (bStall)
@@ -224,7 +233,25 @@ void TMC2130::OnStepIn(struct avr_irq_t * irq, uint32_t value)
 	}
     m_regs.defs.DRV_STATUS.stst = false;
     // 2^20 comes from the datasheet.
-    RegisterTimer(m_fcnStandstill,1U<<20U,this);
+    m_standstill.Set(m_pAVR, 1U<<20U);
+}
+
+avr_cycle_count_t TMC2130::OnPosPublish(avr_t *, avr_cycle_count_t)
+{
+	m_bPosPending = false;
+	float fPos = m_fCurPos;
+	uint32_t posOut;
+	std::memcpy(&posOut, &fPos, 4);
+	RaiseIRQ(POSITION_COARSE_OUT, posOut);
+	return 0;
+}
+
+void TMC2130::OnAVRReset()
+{
+	if (m_bPosPending)
+	{
+		OnPosPublish(m_pAVR, m_pAVR->cycle);
+	}
 }
 
 // Called when DRV_EN is triggered.
@@ -236,7 +263,7 @@ void TMC2130::OnEnableIn(struct avr_irq_t *, uint32_t value)
 	if(!m_bEnable)
 	{
 		// transition immediately to standstill
-		CancelTimer(m_fcnStandstill,this);
+		m_standstill.Clear();
 		OnStandStillTimeout(m_pAVR, 0);
 	}
 }
@@ -263,7 +290,7 @@ TMC2130::TMC2130(char cAxis):Scriptable(std::string("") + cAxis),GLMotor(cAxis)
 
 TMC2130::~TMC2130()
 {
-	CancelTimer(m_fcnStandstill,this);
+	m_standstill.Cancel();
 }
 
 Scriptable::LineStatus TMC2130::ProcessAction (unsigned int iAct, const std::vector<std::string> &)
@@ -297,6 +324,7 @@ void TMC2130::SetConfig(TMC2130_cfg_t cfgIn)
 void TMC2130::Init(struct avr_t * avr)
 {
     _InitWithArgs(avr, this, nullptr, SPI_CSEL);
+	m_reset.Attach(avr);
 
     RegisterNotify(DIR_IN,      MAKE_C_CALLBACK(TMC2130,OnDirIn), this);
     RegisterNotify(STEP_IN,     MAKE_C_CALLBACK(TMC2130,OnStepIn), this);
@@ -313,6 +341,12 @@ void TMC2130::Init(struct avr_t * avr)
 	TH.AddTrace(this, DIR_IN,{TC::OutputPin, TC::Stepper});
 	TH.AddTrace(this, ENABLE_IN,{TC::OutputPin, TC::Stepper});
 	TH.AddTrace(this, DIAG_OUT,{TC::InputPin, TC::Stepper});
+	TH.AddTrace(this, POSITION_COARSE_OUT,{TC::Stepper},32);
+
+	if (Config::Get().GetPosPublishRate() > 0)
+	{
+		m_uiPosPeriod = avr->frequency/Config::Get().GetPosPublishRate();
+	}
 
 	m_regs.defs.IOIN.one = 0x1;
 	m_regs.defs.IOIN.version = 0x11;
@@ -49,7 +49,8 @@ class TMC2130: public SPIPeripheral, public Scriptable, public GLMotor
             _IRQ(DIAG_OUT,          ">tmc2130.diag_out") \
             _IRQ(MIN_OUT,           ">tmc2130.min_out") \
             _IRQ(POSITION_OUT,      ">tmc2130.pos_out") \
-			_IRQ(STEP_POS_OUT, 		">tmc2130.step_out")
+			_IRQ(STEP_POS_OUT, 		">tmc2130.step_out") \
+			_IRQ(POSITION_COARSE_OUT,	">tmc2130.pos_coarse_out")
         #include "IRQHelper.h"
 
         using TMC2130_cfg_t = struct TMC2130_cfg_t
@@ -96,6 +97,16 @@ class TMC2130: public SPIPeripheral, public Scriptable, public GLMotor
         // Standstill register handler.
         avr_cycle_count_t OnStandStillTimeout(avr_t *avr, avr_cycle_count_t when);
         avr_cycle_timer_t m_fcnStandstill = MAKE_C_TIMER_CALLBACK(TMC2130,OnStandStillTimeout);
+        DeadlineTimer m_standstill {m_fcnStandstill, this};
+
+		// Coalesced position for visuals, see Config::GetPosPublishRate
+		avr_cycle_count_t OnPosPublish(avr_t *avr, avr_cycle_count_t when);
+		avr_cycle_timer_t m_fcnPosPublish = MAKE_C_TIMER_CALLBACK(TMC2130,OnPosPublish);
+		avr_cycle_count_t m_uiPosPeriod = 0;
+		bool m_bPosPending = false;
+		// A reset drops the publish timer; put out the pending position instead.
+		void OnAVRReset();
+		ResetHook m_reset {MAKE_C_RESET_CALLBACK(TMC2130,OnAVRReset), this};
 
         // Command processing
         void ProcessCommand();
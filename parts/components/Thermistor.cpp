@@ -60,6 +60,8 @@ Scriptable::LineStatus Thermistor::ProcessAction(unsigned int iAction, const std
 
 uint32_t Thermistor::OnADCRead(struct avr_irq_t*, uint32_t)
 {
+	// Lets an on-demand source (e.g. Heater) update TEMP_IN before we sample it.
+	RaiseIRQ(TEMP_REQ_OUT, 1);
 	if (m_eState == Shorted)
 	{
 		return 0;
@@ -40,7 +40,8 @@ class Thermistor: public ADCPeripheral, public Scriptable
 
 	public:
 
-		#define IRQPAIRS _IRQ(ADC_TRIGGER_IN,"<adc.trigger") _IRQ(ADC_VALUE_OUT,">adc.out") _IRQ(TEMP_OUT,">temp.out") _IRQ(TEMP_IN, "<temp.in") _IRQ(DIGITAL_OUT,">temp.digital_out")
+		#define IRQPAIRS _IRQ(ADC_TRIGGER_IN,"<adc.trigger") _IRQ(ADC_VALUE_OUT,">adc.out") _IRQ(TEMP_OUT,">temp.out") _IRQ(TEMP_IN, "<temp.in") _IRQ(DIGITAL_OUT,">temp.digital_out") \
+			_IRQ(TEMP_REQ_OUT,">temp.req")
 		#include "IRQHelper.h"
 
 		// Creates a new thermistor with given starting/ambient temperature.
@@ -24,6 +24,7 @@
 
 #include "uart_pty.h"
 #include "Config.h"
+#include "InputRecorder.h"
 #include "avr_uart.h"                   // for AVR_IOCTL_UART_GETIRQ, ::AVR_...
 #include "gsl-lite.hpp"
 #include "sim_io.h"                     // for avr_io_getirq, avr_ioctl
@@ -87,11 +88,30 @@ void uart_pty::OnByteIn(struct avr_irq_t *, uint32_t value)
 	}
 }
 
+void uart_pty::SendByte(uint8_t byte)
+{
+	auto &rec = InputRecorder::GetRecorder();
+	if (rec.IsRecording())
+	{
+		rec.Log(m_pRecCh, m_pAVR->cycle, std::to_string(byte));
+	}
+	RaiseIRQ(BYTE_OUT, byte);
+}
+
 // try to empty our fifo, the uart_pty_xoff_hook() will be called when
 // other side is full
 void uart_pty::FlushData()
 {
 	std::lock_guard<std::mutex> lock(m_lock);
+	if (InputRecorder::GetRecorder().IsReplaying())
+	{
+		// PTY input is ignored, the bytes come from the log at the cycle they arrived on.
+		while (m_bXOn && m_pRecCh->IsDue(m_pAVR->cycle))
+		{
+			RaiseIRQ(BYTE_OUT, std::stoi(m_pRecCh->Pop()));
+		}
+		return;
+	}
 	while (m_bXOn && !uart_pty_fifo_isempty(&pty.out)) {
 		TRACE(int r = pty.out.read;)
 		uint8_t byte = uart_pty_fifo_read(&pty.out);
@@ -106,7 +126,7 @@ void uart_pty::FlushData()
 			{
 				m_chrLast = byte;
 			}
-			RaiseIRQ(BYTE_OUT, byte);
+			SendByte(byte);
 
 		}
 
@@ -139,7 +159,7 @@ void uart_pty::FlushData()
 				{
 					m_chrLast = byte;
 				}
-				RaiseIRQ(BYTE_OUT, byte);
+				SendByte(byte);
 
 			}
 		}
@@ -282,6 +302,10 @@ void* uart_pty::Run()
 
 void uart_pty::InitPrivate()
 {
+	// PTYs are set up in a fixed order, so a counter identifies them across runs.
+	static unsigned int uiPtyCount = 0;
+	m_pRecCh = InputRecorder::GetRecorder().GetChannel("uart" + std::to_string(uiPtyCount++));
+
 	RegisterNotify(BYTE_IN, MAKE_C_CALLBACK(uart_pty,OnByteIn), this);
 
 	int hastap = (getenv("SIMAVR_UART_TAP") && stoi(getenv("SIMAVR_UART_TAP"))) ||
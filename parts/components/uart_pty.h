@@ -25,6 +25,7 @@
 #pragma once
 
 #include "BasePeripheral.h"    // for BasePeripheral, MAKE_C_TIMER_CALLBACK
+#include "InputRecorder.h"     // for InputRecorder::Channel
 #include "fifo_declare.h"      // for DECLARE_FIFO, DEFINE_FIFO
 #include "sim_avr.h"           // for avr_t
 #include "sim_avr_types.h"     // for avr_cycle_count_t
@@ -91,6 +92,9 @@ class uart_pty: public BasePeripheral
 
 		void FlushData();
 
+		// Sends a byte from the PTY to the AVR.
+		void SendByte(uint8_t byte);
+
 		pthread_t	m_thread = 0;
 		bool		m_bXOn = false;
 		std::atomic_bool m_bQuit = {false};
@@ -99,6 +103,8 @@ class uart_pty: public BasePeripheral
 
 		std::mutex m_lock;
 
+		InputRecorder::Channel *m_pRecCh = nullptr;
+
 		using uart_pty_port_t = struct{
 			unsigned int	tap : 1, crlf : 1;
 			int 		s;			// socket we chat on
@@ -23,10 +23,9 @@
 
 #include "w25x20cl.h"
 #include "TelemetryHost.h"
-#include <algorithm>   // for min
-#include <cstdlib>     // for exit, free, malloc
+#include <algorithm>   // for min, all_of, copy, transform
 #include <cstring>     // for memset, memcpy, strncpy
-#include <fstream>		// IWYU pragma: keep
+#include <functional>  // for bit_and
 #include <iostream>
 #include <string>
 
@@ -252,41 +251,42 @@ void w25x20cl::OnCSELIn(struct avr_irq_t *, uint32_t value)
 					if(!m_status_register.bits.WEL) break;
 					m_address /= W25X20CL_PAGE_SIZE;
 					m_address *= W25X20CL_PAGE_SIZE;
-					for (unsigned int i = 0; i < m_pageBuffer.size(); i++)
+					auto page = m_flash.subspan(m_address, W25X20CL_PAGE_SIZE);
+					// Programming can only clear bits. An erased page (the usual case) just takes the buffer.
+					if (std::all_of(page.begin(), page.end(), [](uint8_t b) { return b == 0xFFU; }))
 					{
-						m_flash[m_address + i] &= m_pageBuffer[i];
+						std::copy(m_pageBuffer.begin(), m_pageBuffer.end(), page.begin());
 					}
+					else
+					{
+						std::transform(page.begin(), page.end(), m_pageBuffer.begin(), page.begin(), std::bit_and<uint8_t>());
+					}
+					MarkDirty(m_address, W25X20CL_PAGE_SIZE);
 					m_status_register.bits.WEL = 0;
 				} break;
 				case _CMD_CHIP_ERASE:
 				case _CMD_CHIP_ERASE2:
 				{
 					if(!m_status_register.bits.WEL) break;
-					memset(m_flash.data(), 0xFF, m_flash.size_bytes());
+					Erase(0, W25X20CL_TOTAL_SIZE);
 					m_status_register.bits.WEL = 0;
 				} break;
 				case _CMD_SECTOR_ERASE:
 				{
 					if(!m_status_register.bits.WEL) break;
-					m_address /= W25X20CL_SECTOR_SIZE;
-					m_address *= W25X20CL_SECTOR_SIZE;
-					memset(m_flash.begin() + m_address, 0xFF, W25X20CL_SECTOR_SIZE);
+					Erase(m_address - (m_address % W25X20CL_SECTOR_SIZE), W25X20CL_SECTOR_SIZE);
 					m_status_register.bits.WEL = 0;
 				} break;
 				case _CMD_BLOCK32_ERASE:
 				{
 					if(!m_status_register.bits.WEL) break;
-					m_address /= W25X20CL_BLOCK32_SIZE;
-					m_address *= W25X20CL_BLOCK32_SIZE;
-					memset(m_flash.begin() + m_address, 0xFF, W25X20CL_BLOCK32_SIZE);
+					Erase(m_address - (m_address % W25X20CL_BLOCK32_SIZE), W25X20CL_BLOCK32_SIZE);
 					m_status_register.bits.WEL = 0;
 				} break;
 				case _CMD_BLOCK64_ERASE:
 				{
 					if(!m_status_register.bits.WEL) break;
-					m_address /= W25X20CL_BLOCK64_SIZE;
-					m_address *= W25X20CL_BLOCK64_SIZE;
-					memset(m_flash.begin() + m_address, 0xFF, W25X20CL_BLOCK64_SIZE);
+					Erase(m_address - (m_address % W25X20CL_BLOCK64_SIZE), W25X20CL_BLOCK64_SIZE);
 					m_status_register.bits.WEL = 0;
 				} break;
 			}
@@ -314,12 +314,13 @@ Scriptable::LineStatus w25x20cl::ProcessAction(unsigned int iAct, const std::vec
 	{
 		case ActClear:
 		{
-			memset(m_flash.data(),0xFF,m_flash.size_bytes());
+			Erase(0, W25X20CL_TOTAL_SIZE);
 			return LineStatus::Finished;
 		}
 		case ActFill:
 		{
 			memset(m_flash.data(),gsl::narrow<uint8_t>(stoi(vArgs.at(0))) & 0xFFU,m_flash.size_bytes());
+			MarkDirty(0, W25X20CL_TOTAL_SIZE);
 			return LineStatus::Finished;
 		}
 		case ActLoad:
@@ -352,68 +353,88 @@ Scriptable::LineStatus w25x20cl::ProcessAction(unsigned int iAct, const std::vec
 	}
 }
 
+void w25x20cl::Erase(uint32_t uiAddr, uint32_t uiLen)
+{
+	memset(m_flash.subspan(uiAddr, uiLen).data(), 0xFF, uiLen);
+	MarkDirty(uiAddr, uiLen);
+}
+
+void w25x20cl::MarkDirty(uint32_t uiAddr, uint32_t uiLen)
+{
+	for (auto i = uiAddr/W25X20CL_SECTOR_SIZE; i <= (uiAddr + uiLen - 1)/W25X20CL_SECTOR_SIZE; i++)
+	{
+		m_dirty.set(i);
+	}
+	// Only schedules the writeback, so the file catches up without stalling the AVR.
+	m_file.Sync(uiAddr, uiLen, true);
+}
+
 void w25x20cl::Load(const std::string &path)
 {
-		m_filepath = path;
-		Load();
+	m_filepath = path;
+	m_flash = {_m_flash};
+	m_vSaved.clear();
+	if (!m_file.Map(m_filepath, W25X20CL_TOTAL_SIZE))
+	{
+		std::cerr << "ERROR: Could not map SPI flash file. Flash contents were NOT restored" << '\n';
+		return;
+	}
+	m_flash = m_file.GetData();
+	if (m_file.IsNew() || std::all_of(m_flash.begin(), m_flash.end(), [](uint8_t b) { return b == 0; }))
+	{
+		memset(m_flash.data(), 0xFF, m_flash.size_bytes());
+		m_file.Sync();
+	}
+	m_dirty.reset();
+	std::cout << "Mapped " <<  W25X20CL_TOTAL_SIZE  <<" bytes of xflash from " << m_filepath;
+	if (m_file.IsPrivate())
+	{
+		std::cout << " (read-only or in use, changes will NOT persist)";
+	}
+	std::cout << '\n';
 }
 
 void w25x20cl::Load(const gsl::span<uint8_t> data, uint32_t uiOffset)
 {
 	size_t bytes = std::min(m_flash.size_bytes() - uiOffset, data.size_bytes());
 	memcpy(m_flash.begin() + uiOffset, data.begin(), bytes);
+	if (bytes > 0)
+	{
+		MarkDirty(uiOffset, bytes);
+	}
 	std::cout << "Loaded " << std::to_string(bytes) << " bytes from hex file to xflash\n";
 }
 
 void w25x20cl::Load()
 {
-	auto *path = m_filepath.c_str();
-	// Now deal with the external flash. Can't do this in special_init, it's not allocated yet then.
-	std::ifstream fsIn(path, fsIn.binary | fsIn.ate);
-	m_filepath = path;
-
-	if (!fsIn.is_open() || fsIn.tellg() < W25X20CL_TOTAL_SIZE) {
-		std::cerr << "ERROR: Could not open SPI flash file. Flash contents were NOT restored" << '\n';
-	}
-	else
+	if (m_vSaved.empty())
 	{
-		std::cout << "Loading " <<  W25X20CL_TOTAL_SIZE  <<" bytes of xflash\n";
-		fsIn.seekg(fsIn.beg);
-		fsIn.read(reinterpret_cast<char*>(m_flash.data()), W25X20CL_TOTAL_SIZE + 1); // NOLINT no choice but to cast...
-		if (fsIn.fail() || fsIn.gcount() != W25X20CL_TOTAL_SIZE + 1 ) {
-			std::cerr << "Unable to load w25x20cl\n";
-			exit(1);
-		}
-		bool bEmpty = true;
-		for (auto &b : m_flash)
-		{
-			bEmpty &= b==0;
-		}
-		if (bEmpty)
-		{
-			for (auto &c : m_flash)
-			{
-				c = 0xFF;
-			}
-		}
+		// The mapping is the file, there's nothing older to go back to.
+		std::cout << "xflash has not been saved, contents unchanged\n";
+		return;
 	}
-	fsIn.close();
+	std::copy(m_vSaved.begin(), m_vSaved.end(), m_flash.begin());
+	MarkDirty(0, W25X20CL_TOTAL_SIZE);
+	std::cout << "Restored " << W25X20CL_TOTAL_SIZE << " bytes of xflash\n";
 }
 
 void w25x20cl::Save()
 {
-	// Also write out the xflash contents. Note  you can save snapshots anytime you like.
-		// Write out the EEPROM contents:
-	std::ofstream fsOut(m_filepath, fsOut.binary);
-	if (!fsOut.is_open())
+	// Note you can save snapshots anytime you like.
+	m_vSaved.assign(m_flash.begin(), m_flash.end());
+	if (!m_file.IsMapped() || m_file.IsPrivate())
 	{
-		std::cerr << "Failed to open xflash output file\n";
+		std::cerr << "xflash file is not writable, contents were NOT saved\n";
 		return;
 	}
-	fsOut.write(reinterpret_cast<char*>(m_flash.data()),W25X20CL_TOTAL_SIZE+1); //NOLINT no choice but to cast...
-	std::cout << "Wrote "<< fsOut.tellp() <<" bytes of xflash to " << m_filepath <<'\n';
-	if (fsOut.tellp() != W25X20CL_TOTAL_SIZE + 1) {
-		std::cerr << "Unable to write xflash memory\n";
+	unsigned int uiCount = m_dirty.count();
+	for (size_t i = 0; i < m_dirty.size(); i++)
+	{
+		if (m_dirty.test(i))
+		{
+			m_file.Sync(i*W25X20CL_SECTOR_SIZE, W25X20CL_SECTOR_SIZE);
+		}
 	}
-	fsOut.close();
+	m_dirty.reset();
+	std::cout << "Synced "<< uiCount <<" dirty sectors of xflash to " << m_filepath <<'\n';
 }
@@ -24,10 +24,12 @@
 #pragma once
 
 #include "IScriptable.h"
+#include "MappedFile.h"     // for MappedFile
 #include "SPIPeripheral.h"  // for SPIPeripheral
 #include "Scriptable.h"
 #include "gsl-lite.hpp"
 #include "sim_irq.h"        // for avr_irq_t
+#include <bitset>
 #include <cstdint>         // for uint8_t, uint32_t, uint64_t
 #include <string>
 #include <vector>
@@ -55,16 +57,16 @@ class w25x20cl:public SPIPeripheral, public Scriptable
 	// Initializes an SPI flash on "avr" with a CSEL irq "irqCS"
 	void Init(struct avr_t * avr, avr_irq_t *irqCS);
 
-	// Loads the flash contents from file. (creates "path" if it does not exit)
+	// Maps the flash contents from file (creates "path" if it does not exit). Writes reach the file as they happen.
 	void Load(const std::string &path);
 
 	// Loads from an array
 	void Load(const gsl::span<uint8_t> data, uint32_t uiOffset = 0);
 
-	// Reloads the current file.
+	// Reverts to the contents as of the last Save.
 	void Load();
 
-	// Saves the SPI flash contents back out to file. (Does not close it in case you want to save multiple times)
+	// Flushes the sectors written since the last save and remembers the contents for Load.
 	void Save();
 
 	protected:
@@ -92,6 +94,12 @@ class w25x20cl:public SPIPeripheral, public Scriptable
 		uint8_t OnSPIIn(avr_irq_t *irq, uint32_t value) override;
         void OnCSELIn(avr_irq_t *irq, uint32_t value) override;
 
+		// Erases (to 0xFF) uiLen bytes at uiAddr.
+		void Erase(uint32_t uiAddr, uint32_t uiLen);
+
+		// Flags the sectors covering uiLen bytes at uiAddr and starts writing them back.
+		void MarkDirty(uint32_t uiAddr, uint32_t uiLen);
+
 		uint8_t _m_flash[W25X20CL_TOTAL_SIZE] = {0xFF};
 		uint8_t _m_pageBuffer[W25X20CL_PAGE_SIZE] = {0xFF};
 		uint8_t _m_cmdIn[5] = {0};
@@ -120,4 +128,7 @@ class w25x20cl:public SPIPeripheral, public Scriptable
 		w25x20cl_states m_state = STATE_IDLE;
 		std::string m_filepath;
 
+		MappedFile m_file;
+		std::bitset<W25X20CL_TOTAL_SIZE/W25X20CL_SECTOR_SIZE> m_dirty;
+		std::vector<uint8_t> m_vSaved;
 };
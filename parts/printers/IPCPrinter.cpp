@@ -27,6 +27,8 @@
 #include <memory>
 
 #ifdef ENABLE_ANY_IPC
+#include <cstring>    // for memcpy
+#include <ctime>      // for clock_gettime, timespec
 #include <fcntl.h>
 #include <iostream>
 #include <sys/stat.h>
@@ -34,7 +36,7 @@
 #include <unistd.h>
 #endif
 // NOTE: these are herer for future re-use and not actively supported but I could see it being useful for someone.
-// SHMQ can (in theory) be enabled via CMAKE options - if you need this feature and it's broken
+// SHMQ and the pipe can be enabled via CMAKE options (ENABLE_SHMQ, ENABLE_PIPE) - if you need this feature and it's broken
 // please open an issue and I will look into fixing the problem.
 //#define ENABLE_PIPE 0
 //#define ENABLE_MQ 0
@@ -47,12 +49,39 @@ static constexpr char IPC_FILE[] = "/MK404IPC";
 #if ENABLE_MQ
 static constexpr mqd_t MQ_ERR = -1;
 #elif ENABLE_SHMQ
+static constexpr size_t IPC_BATCH = 64; // Messages dequeued per handoff to the ring.
+#endif
 
+#ifdef ENABLE_ANY_IPC
+// Received messages are applied this many times per simulated second.
+static constexpr uint32_t IPC_APPLY_HZ = 1000;
+// How long the receiver backs off when there is nothing to read or the ring is full.
+static constexpr useconds_t IPC_IDLE_US = 100;
 #endif
 
 IPCPrinter::~IPCPrinter()
 {
 	m_pVis.release(); // Just to shut up clang-tidy if there are not defines.
+#ifdef ENABLE_ANY_IPC
+	m_bQuit = true;
+#if ENABLE_PIPE
+	// The receiver may be blocked waiting for a writer or a message; give it one.
+	int iFd = open(IPC_FILE, O_WRONLY | O_NONBLOCK); // NOLINT - vararg
+	if (iFd>=0)
+	{
+		char cWake = 0;
+		if (write(iFd, &cWake, 1)<0)
+		{
+			std::cerr << "Failed to wake the IPC receiver.\n";
+		}
+		close(iFd);
+	}
+#endif
+	if (m_receiver.joinable())
+	{
+		m_receiver.join();
+	}
+#endif
 #if ENABLE_PIPE
 	unlink(IPC_FILE);
 #elif ENABLE_MQ
@@ -71,7 +100,7 @@ IPCPrinter::~IPCPrinter()
 void IPCPrinter::SetupHardware()
 {
 #if ENABLE_MQ
-	m_qAttr.mq_msgsize =7;
+	m_qAttr.mq_msgsize = MK404_IPC_MAX_FRAME;
 	m_qAttr.mq_maxmsg = 50;
 	m_qAttr.mq_curmsgs = 0;
 	m_qAttr.mq_flags = 0;
@@ -93,11 +122,15 @@ void IPCPrinter::SetupHardware()
 		std::cerr << "Error - could not create FIFO pipe. Aborting.\n";
 		exit(2);
 	}
-	m_ifIn.open(IPC_FILE);
+	// Opened by the receiver thread since it blocks until a writer connects.
 #elif ENABLE_SHMQ
 	m_queue = shmemq_create(IPC_FILE);
 #endif
 	_Init(Board::m_pAVR,this);
+#ifdef ENABLE_ANY_IPC
+	RegisterTimer(m_fcnApply, Board::m_pAVR->frequency/IPC_APPLY_HZ, this);
+	m_receiver = std::thread(&IPCPrinter::ReceiveLoop, this);
+#endif
 #ifdef TEST_MODE
 	m_vMotors.push_back(std::unique_ptr<GLMotor>(new GLMotor('T')));
 	m_vMotors.at(0)->SetMaxPos(200);
@@ -109,47 +142,103 @@ void IPCPrinter::SetupHardware()
 
 
 #ifdef ENABLE_ANY_IPC
-void IPCPrinter::OnAVRCycle()
+void IPCPrinter::ReceiveLoop()
 {
-#if ENABLE_MQ
-	ssize_t len = mq_receive(m_queue, m_msg.data(), m_msg.size_bytes()-1, nullptr);
-	if (len == 0 || m_msg.at(0)=='C')
-	{
-			m_vMotors.clear(); // clear objects.
-			m_vInds.clear();
-			m_vStepIRQs.clear();
-			m_pVis->ClearPrint();
-			return;
-	}
+	std::vector<IPCFrame> vBatch(1);
+#if ENABLE_SHMQ
+	vBatch.resize(IPC_BATCH);
+	shm404_msg_t msg {0};
 #elif ENABLE_PIPE
-	uint8_t len = m_ifIn.get();
-	m_len = m_ifIn.readsome(m_msg.data(),len);
-	m_msg[len] = '\0';
-
-	if (m_len<len) // client has gone away, message truncated.
+	m_ifIn.open(IPC_FILE);
+#endif
+	while (!m_bQuit)
 	{
-		if(m_ifIn.eof())
+		size_t uiCount = 0;
+#if ENABLE_MQ
+		struct timespec tsTimeout {};
+		clock_gettime(CLOCK_REALTIME, &tsTimeout);
+		tsTimeout.tv_sec++; // So we notice m_bQuit.
+		ssize_t len = mq_timedreceive(m_queue, vBatch[0].data.data(), vBatch[0].data.size()-1, nullptr, &tsTimeout);
+		if (len>=0)
 		{
-			m_ifIn.close();
-			m_ifIn.clear();
-			m_vMotors.clear(); // clear objects.
-			m_vInds.clear();
-			m_vStepIRQs.clear();
-			m_ifIn.open(IPC_FILE);
+			vBatch[0].uiLen = len;
+			if (len == 0)
+			{
+				vBatch[0].data[0] = 'C';
+				vBatch[0].uiLen = 1;
+			}
+			uiCount = 1;
+		}
+#elif ENABLE_PIPE
+		int iLen = m_ifIn.get();
+		if (m_bQuit)
+		{
+			break;
+		}
+		if (iLen != EOF)
+		{
+			m_ifIn.read(vBatch[0].data.data(), iLen);
+		}
+		if (iLen == EOF || m_ifIn.gcount()<iLen)
+		{
+			if(m_ifIn.eof()) // client has gone away.
+			{
+				m_ifIn.close();
+				m_ifIn.clear();
+				vBatch[0].data[0] = 'C';
+				vBatch[0].uiLen = 1;
+				uiCount = 1;
+				m_ifIn.open(IPC_FILE);
+			}
+			else
+			{
+				std::cout << "Truncated message, ignoring.\n";
+			}
+		}
+		else
+		{
+			vBatch[0].data[iLen] = '\0';
+			vBatch[0].uiLen = iLen;
+			uiCount = 1;
+		}
+#elif ENABLE_SHMQ
+		while (uiCount<vBatch.size() && shmemq_try_dequeue(m_queue, &msg))
+		{
+			std::memcpy(vBatch[uiCount].data.data(), &msg, sizeof(msg));
+			vBatch[uiCount++].uiLen = sizeof(msg); // Fixed-size slots, the frame says how much of it is used.
+		}
+		if (uiCount == 0)
+		{
+			usleep(IPC_IDLE_US);
+			continue;
+		}
+#endif
+		// Never drop anything - a lost 'A' or 'L' would desync the client's indices.
+		size_t uiPushed = 0;
+		while (uiPushed<uiCount && !m_bQuit)
+		{
+			uiPushed += m_ring.Push(&vBatch[uiPushed], uiCount-uiPushed);
+			if (uiPushed<uiCount)
+			{
+				usleep(IPC_IDLE_US);
+			}
 		}
-		std::cout << "Truncated message, ignoring.\n";
-		return;
 	}
-	//std::cout << "msg len: " << std::to_string(len) << ':' << m_msg.data() << '\n';
+}
 
-	// std::cout << "Got line:'" <<m_msg << "'\n";
-#elif ENABLE_SHMQ
-	if (!shmemq_try_dequeue(m_queue, &_m_msg))
+avr_cycle_count_t IPCPrinter::OnApplyTimer(avr_t *avr, avr_cycle_count_t when)
+{
+	m_ring.PopAll([this](IPCFrame &frame)
 	{
-		usleep(100);
-		return;
-	}
-#endif
+		m_msg = gsl::span<char>(frame.data.data(), frame.data.size());
+		m_uiMsgLen = frame.uiLen;
+		ApplyMessage();
+	});
+	return when + (avr->frequency/IPC_APPLY_HZ);
+}
+
+void IPCPrinter::ApplyMessage()
+{
 	switch (m_msg.at(0))
 	{
 		case 'C':
@@ -157,10 +246,16 @@ void IPCPrinter::OnAVRCycle()
 			m_vMotors.clear(); // clear objects.
 			m_vInds.clear();
 			m_vStepIRQs.clear();
+			m_vIndIRQs.clear();
 			if (m_pVis) {
 				m_pVis->ClearPrint();
 			}
+			m_decoder.Reset();
 		}
+		break;
+		case MK404_IPC_BATCH:
+			ApplyBatch();
+			break;
 		case 'M': // Motor directive.
 		{
 			UpdateMotor();
@@ -200,6 +295,61 @@ void IPCPrinter::OnAVRCycle()
 	}
 }
 
+void IPCPrinter::ApplyBatch()
+{
+	auto pBuf = reinterpret_cast<const uint8_t*>(m_msg.data()); // NOLINT - bytes off the wire.
+	uint32_t uiLostBefore = m_decoder.GetLostBatches();
+	switch (m_decoder.Apply(pBuf, m_uiMsgLen))
+	{
+		case IPCBatchDecoder::Result::Version:
+			if (!m_bWarnedVersion)
+			{
+				std::cerr << "IPC: ignoring batches of unsupported protocol version " << std::to_string(m_decoder.GetLastVersion()) << '\n';
+				m_bWarnedVersion = true;
+			}
+			break;
+		case IPCBatchDecoder::Result::Malformed:
+			std::cerr << "IPC: malformed batch, ignoring.\n";
+			break;
+		case IPCBatchDecoder::Result::OK:
+			if (m_decoder.GetLostBatches() != uiLostBefore)
+			{
+				std::cerr << "IPC: " << (m_decoder.GetLostBatches() - uiLostBefore) << " batch(es) lost, " << m_decoder.GetLostBatches() << " in total.\n";
+			}
+			break;
+	}
+}
+
+void IPCPrinter::SetIndicatorValue(uint8_t index, uint8_t value)
+{
+	if (index>=m_vInds.size())
+	{
+		return;
+	}
+	m_vInds.at(index)->SetValue(value);
+	if (m_vIndIRQs.at(index)!=COUNT)
+	{
+		RaiseIRQ(m_vIndIRQs.at(index),value>0);
+	}
+}
+
+void IPCPrinter::SetMotorPosition(uint8_t index, int32_t steps)
+{
+	if (index>=m_vMotors.size())
+	{
+		return;
+	}
+	m_vMotors.at(index)->SetCurrentPos(steps);
+	if (m_vStepIRQs.at(index)!=COUNT)
+	{
+		RaiseIRQ(m_vStepIRQs.at(index),steps);
+		float fPos = m_vMotors.at(index)->GetCurrentPos();
+		uint32_t posOut = 0;
+		std::memcpy(&posOut, &fPos, sizeof(posOut)); // both 32 bits, just mangle it for sending over the wire.
+		RaiseIRQ(m_vStepIRQs.at(index)+1, posOut);
+	}
+}
+
 void IPCPrinter::UpdateIndicator()
 {
 	uint8_t index = m_msg.at(1)-'0';
@@ -212,12 +362,7 @@ void IPCPrinter::UpdateIndicator()
 	{
 		case 'V': // Value
 		{
-			m_vInds.at(index)->SetValue(m_msg.at(3));
-			if (m_vIndIRQs.at(index)!=COUNT)
-			{
-				// printf("IND %c set to %d\n",m_msg.at(1), m_msg.at(3));
-				RaiseIRQ(m_vIndIRQs.at(index),m_msg.at(3)>0);
-			}
+			SetIndicatorValue(index, m_msg.at(3));
 		}
 		break;
 		case 'L': // Label
@@ -279,15 +424,7 @@ void IPCPrinter::UpdateMotor()
 			// }
 			std::memcpy(&steps, m_msg.begin()+3, sizeof(steps)); // both 32 bits, just mangle it for sending over the wire.
 			// if (index==3) printf("Current step: %d\n",steps);
-			m_vMotors.at(index)->SetCurrentPos(steps);
-			if (m_vStepIRQs.at(index)!=COUNT)
-			{
-				RaiseIRQ(m_vStepIRQs.at(index),steps);
-				float fPos = m_vMotors.at(index)->GetCurrentPos();
-				uint32_t posOut = 0;
-				std::memcpy(&posOut, &fPos, sizeof(posOut)); // both 32 bits, just mangle it for sending over the wire.
-				RaiseIRQ(m_vStepIRQs.at(index)+1, posOut);
-			}
+			SetMotorPosition(index, steps);
 			break;
 		}
 		case 'E': // Enable - either 0 or 1, e.g. M1E0 or M1E1
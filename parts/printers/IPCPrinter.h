@@ -25,25 +25,33 @@
 #include "MK3SGL.h"
 #include "Printer.h"        // for Printer, Printer::VisualType
 #include <array>             // for array
+#include <cstddef>          // for size_t
 #include <cstdint>          // for uint32_t
 #include <memory>            // for unique_ptr
 #include <string>            // for string
 #include <vector>            // for vector
 
 #if ENABLE_PIPE || ENABLE_MQ || ENABLE_SHMQ
-	#define ENABLED_ANY_IPC
+	#define ENABLE_ANY_IPC
 #endif
 
 #if ENABLE_SHMQ
 extern "C" {
 	#include "../../3rdParty/shmemq404/shmemq.h"
 }
-	#include <gsl-lite.hpp>
 #elif ENABLE_MQ
 	#include <mqueue.h>
 #elif ENABLE_PIPE
 	#include <fstream>
 #endif
+#ifdef ENABLE_ANY_IPC
+	#include "IPCBatchDecoder.h"
+	#include "SPSCRing.h"
+	#include "ipc/mk404_ipc_proto.h"
+	#include <atomic>          // for atomic_bool
+	#include <gsl-lite.hpp>
+	#include <thread>          // for thread
+#endif
 #include <utility>          // for pair
 
 class IPCPrinter : public Boards::IPCBoard, public Printer, public BasePeripheral
@@ -78,9 +86,19 @@ class IPCPrinter : public Boards::IPCBoard, public Printer, public BasePeriphera
 		void SetupHardware() override;
 
 #ifdef ENABLE_ANY_IPC
-		void OnAVRCycle() override;
+		// Runs on m_receiver, moving everything that arrives on the IPC channel into m_ring.
+		void ReceiveLoop();
+
+		// Applies all messages received since the last call, at a fixed simulated-time rate.
+		avr_cycle_count_t OnApplyTimer(avr_t *avr, avr_cycle_count_t when);
+		avr_cycle_timer_t m_fcnApply = MAKE_C_TIMER_CALLBACK(IPCPrinter,OnApplyTimer);
+
+		void ApplyMessage();
+		void ApplyBatch();
 		void UpdateMotor();
 		void UpdateIndicator();
+		void SetMotorPosition(uint8_t index, int32_t steps);
+		void SetIndicatorValue(uint8_t index, uint8_t value);
 #endif
 
 		std::unique_ptr<MK3SGL> m_pVis {nullptr};
@@ -88,17 +106,44 @@ class IPCPrinter : public Boards::IPCBoard, public Printer, public BasePeriphera
 
 #if ENABLE_SHMQ
 		shmemq_t *m_queue = nullptr;
-		shm404_msg_t _m_msg {0};
-		gsl::span<char> m_msg {_m_msg};
-		uint16_t m_len = 0;
+		using IPCMsg = std::array<char, sizeof(shm404_msg_t)>;
 #elif ENABLE_MQ
 		mqd_t m_queue;
 		struct mq_attr m_qAttr;
+		using IPCMsg = std::array<char, 256>;
 #elif ENABLE_PIPE
 		std::ifstream m_ifIn;
+		using IPCMsg = std::array<char, 256>; // Length is sent as one byte, plus the terminator we add.
 		//void AddPart(const std::string& strIn);
 #endif
 
+#ifdef ENABLE_ANY_IPC
+		struct IPCFrame
+		{
+			IPCMsg data;
+			size_t uiLen; // As received, excluding any terminator we add.
+		};
+		SPSCRing<IPCFrame, 4096> m_ring;
+		gsl::span<char> m_msg {}; // The message being applied, points into m_ring.
+		size_t m_uiMsgLen = 0; // Received length of m_msg.
+		std::thread m_receiver;
+		std::atomic_bool m_bQuit {false};
+
+		// Binary batch state, see mk404_ipc_proto.h
+		IPCBatchDecoder m_decoder {[this](uint8_t channel, int32_t value)
+		{
+			if (MK404_IPC_IS_INDICATOR(channel))
+			{
+				SetIndicatorValue(channel - 128U, static_cast<uint8_t>(value));
+			}
+			else
+			{
+				SetMotorPosition(channel, value);
+			}
+		}};
+		bool m_bWarnedVersion = false;
+#endif
+
 		std::vector<unsigned int> m_vStepIRQs, m_vIndIRQs;
 
 		std::array<uint32_t,4> m_vStepsPerMM = {{100,100,400,280}};
@@ -46,7 +46,7 @@ void Prusa_CW1S::OnVisualTypeSet(const std::string &type)
 
 		AddHardware(*m_pVis);
 
-		m_pVis->ConnectFrom(m_tmc.GetIRQ(TMC2130::POSITION_OUT),MK3SGL::E_IN);
+		m_pVis->ConnectFrom(m_tmc.GetIRQ(TMC2130::POSITION_COARSE_OUT),MK3SGL::E_IN);
 		m_pVis->ConnectFrom(m_f1.GetIRQ(Fan::ROTATION_OUT), MK3SGL::EFAN_IN);
 		m_pVis->ConnectFrom(m_f2.GetIRQ(Fan::ROTATION_OUT), MK3SGL::PFAN_IN);
 		avr_raise_irq(m_pVis->GetIRQ(MK3SGL::GENERIC_3),1);
@@ -61,10 +61,10 @@ void Prusa_MK2_13::OnVisualTypeSet(const std::string &type)
 
 	AddHardware(*m_pVis);
 
-	m_pVis->ConnectFrom(X.GetIRQ(A4982::POSITION_OUT),MK3SGL::X_IN);
-	m_pVis->ConnectFrom(Y.GetIRQ(A4982::POSITION_OUT),MK3SGL::Y_IN);
-	m_pVis->ConnectFrom(Z.GetIRQ(A4982::POSITION_OUT),MK3SGL::Z_IN);
-	m_pVis->ConnectFrom(E.GetIRQ(A4982::POSITION_OUT),MK3SGL::E_IN);
+	m_pVis->ConnectFrom(X.GetIRQ(A4982::POSITION_COARSE_OUT),MK3SGL::X_IN);
+	m_pVis->ConnectFrom(Y.GetIRQ(A4982::POSITION_COARSE_OUT),MK3SGL::Y_IN);
+	m_pVis->ConnectFrom(Z.GetIRQ(A4982::POSITION_COARSE_OUT),MK3SGL::Z_IN);
+	m_pVis->ConnectFrom(E.GetIRQ(A4982::POSITION_COARSE_OUT),MK3SGL::E_IN);
 	m_pVis->ConnectFrom(X.GetIRQ(A4982::STEP_POS_OUT),MK3SGL::X_STEP_IN);
 	m_pVis->ConnectFrom(Y.GetIRQ(A4982::STEP_POS_OUT),MK3SGL::Y_STEP_IN);
 	m_pVis->ConnectFrom(Z.GetIRQ(A4982::STEP_POS_OUT),MK3SGL::Z_STEP_IN);
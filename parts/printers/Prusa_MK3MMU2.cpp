@@ -34,6 +34,6 @@ void Prusa_MK3MMU2::SetupIR()
 	lIR.ConnectFrom(LaserSensor.GetIRQ(PAT9125::LED_OUT),LED::LED_IN);
 
 	LaserSensor.ConnectFrom(E.GetIRQ(TMC2130::POSITION_OUT), PAT9125::E_IN);
-	LaserSensor.ConnectFrom(m_MMU.GetIRQ(MMU2::FEED_DISTANCE), PAT9125::P_IN);
+	LaserSensor.ConnectFrom(GetMMUIRQ(MMU2::FEED_DISTANCE), PAT9125::P_IN);
 	LaserSensor.Set(PAT9125::FS_AUTO); // No filament - but this just updates the LED.
 }; // Overridde to setup the PAT.
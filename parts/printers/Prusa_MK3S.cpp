@@ -106,10 +106,10 @@ void Prusa_MK3S::OnVisualTypeSet(const std::string &type)
 
 		AddHardware(*m_pVis);
 
-		m_pVis->ConnectFrom(X.GetIRQ(TMC2130::POSITION_OUT),MK3SGL::X_IN);
-		m_pVis->ConnectFrom(Y.GetIRQ(TMC2130::POSITION_OUT),MK3SGL::Y_IN);
-		m_pVis->ConnectFrom(Z.GetIRQ(TMC2130::POSITION_OUT),MK3SGL::Z_IN);
-		m_pVis->ConnectFrom(E.GetIRQ(TMC2130::POSITION_OUT),MK3SGL::E_IN);
+		m_pVis->ConnectFrom(X.GetIRQ(TMC2130::POSITION_COARSE_OUT),MK3SGL::X_IN);
+		m_pVis->ConnectFrom(Y.GetIRQ(TMC2130::POSITION_COARSE_OUT),MK3SGL::Y_IN);
+		m_pVis->ConnectFrom(Z.GetIRQ(TMC2130::POSITION_COARSE_OUT),MK3SGL::Z_IN);
+		m_pVis->ConnectFrom(E.GetIRQ(TMC2130::POSITION_COARSE_OUT),MK3SGL::E_IN);
 		m_pVis->ConnectFrom(X.GetIRQ(TMC2130::STEP_POS_OUT),MK3SGL::X_STEP_IN);
 		m_pVis->ConnectFrom(Y.GetIRQ(TMC2130::STEP_POS_OUT),MK3SGL::Y_STEP_IN);
 		m_pVis->ConnectFrom(Z.GetIRQ(TMC2130::STEP_POS_OUT),MK3SGL::Z_STEP_IN);
@@ -21,6 +21,8 @@
 
 #include "Prusa_MK3SMMU2.h"
 #include "BasePeripheral.h"       // for MAKE_C_CALLBACK
+#include "Config.h"               // for Config
+#include "GCodeTokenizer.h"       // for GCodeCommand
 #include "GLHelper.h"
 #include "IRSensor.h"             // for IRSensor, IRSensor::IRState::IR_AUTO
 #include "MK3SGL.h"               // for MK3SGL
@@ -32,17 +34,64 @@
 #include <cstring>
 #include <memory>                 // for unique_ptr
 
+Prusa_MK3SMMU2::Prusa_MK3SMMU2():Prusa_MK3S()
+{
+	if (Config::Get().GetMMUFast())
+	{
+		m_pMMUFast.reset(new MMU2Fast()); //NOLINT suggestion is c++14 and higher
+	}
+	else
+	{
+		m_pMMU.reset(new MMU2()); //NOLINT suggestion is c++14 and higher
+	}
+}
+
 void Prusa_MK3SMMU2::SetupHardware()
 {
+	if (m_pMMUFast)
+	{
+		// Before the base setup, so its IRQs exist when SetupIR() wants them.
+		AddHardware(*m_pMMUFast, '2');
+	}
 	Prusa_MK3S::SetupHardware();
-	TryConnect(MMU_HWRESET,&m_MMU,MMU2::RESET);
 	IR.Set(IRSensor::IR_AUTO);
-	avr_irq_register_notify(m_MMU.GetIRQ(MMU2::FEED_DISTANCE), MAKE_C_CALLBACK(Prusa_MK3SMMU2,OnMMUFeed),this);
+	avr_irq_register_notify(GetMMUIRQ(MMU2::FEED_DISTANCE), MAKE_C_CALLBACK(Prusa_MK3SMMU2,OnMMUFeed),this);
+	if (m_pMMUFast)
+	{
+		TryConnect(MMU_HWRESET,m_pMMUFast.get(),MMU2Fast::RESET);
+		return;
+	}
+	TryConnect(MMU_HWRESET,m_pMMU.get(),MMU2::RESET);
 
 	// Note we can't directly connect the MMU or you'll get serial flow issues/lost bytes.
 	// The serial_pipe thread lets us reuse the UART_PTY code and its internal xon/xoff/buffers
 	// rather than having to roll our own internal FIFO. As an added bonus you can tap the ports for debugging.
-	m_pipe.reset(new SerialPipe(UART2.GetSlaveName(), m_MMU.GetSerialPort())); //NOLINT suggestion is c++14 and higher
+	m_pipe.reset(new SerialPipe(UART2.GetSlaveName(), m_pMMU->GetSerialPort())); //NOLINT suggestion is c++14 and higher
+}
+
+avr_irq_t* Prusa_MK3SMMU2::GetMMUIRQ(unsigned int uiMMU2IRQ)
+{
+	if (m_pMMU)
+	{
+		return m_pMMU->GetIRQ(uiMMU2IRQ);
+	}
+	switch (uiMMU2IRQ)
+	{
+		case MMU2::FEED_DISTANCE:
+			return m_pMMUFast->GetIRQ(MMU2Fast::FEED_DISTANCE);
+		case MMU2::SELECTOR_OUT:
+			return m_pMMUFast->GetIRQ(MMU2Fast::SELECTOR_OUT);
+		case MMU2::IDLER_OUT:
+			return m_pMMUFast->GetIRQ(MMU2Fast::IDLER_OUT);
+		case MMU2::LEDS_OUT:
+			return m_pMMUFast->GetIRQ(MMU2Fast::LEDS_OUT);
+		case MMU2::FINDA_OUT:
+			return m_pMMUFast->GetIRQ(MMU2Fast::FINDA_OUT);
+		case MMU2::RESET:
+			return m_pMMUFast->GetIRQ(MMU2Fast::RESET);
+		default:
+			return nullptr;
+	}
 }
 
 void Prusa_MK3SMMU2::OnVisualTypeSet(const std::string &type)
@@ -53,12 +102,19 @@ void Prusa_MK3SMMU2::OnVisualTypeSet(const std::string &type)
 		// Wire up the additional MMU stuff.
 
 		AddHardware(m_sniffer,'2');
-		m_pVis->ConnectFrom(m_sniffer.GetIRQ(GCodeSniffer::CODEVAL_OUT),MK3SGL::TOOL_IN);
-		m_pVis->ConnectFrom(m_MMU.GetIRQ(MMU2::SELECTOR_OUT), MK3SGL::SEL_IN);
-		m_pVis->ConnectFrom(m_MMU.GetIRQ(MMU2::IDLER_OUT), MK3SGL::IDL_IN);
-		m_pVis->ConnectFrom(m_MMU.GetIRQ(MMU2::LEDS_OUT),MK3SGL::MMU_LEDS_IN);
-		m_pVis->ConnectFrom(m_MMU.GetIRQ(MMU2::FINDA_OUT),MK3SGL::FINDA_IN);
-		m_pVis->ConnectFrom(m_MMU.GetIRQ(MMU2::FEED_DISTANCE), MK3SGL::FEED_IN);
+		// Subscribed rather than wired to CODEVAL_OUT so a repeated T still reaches the visuals.
+		m_sniffer.AddSubscriber([this](const GCodeCommand &cmd)
+		{
+			if (cmd.chrLetter == 'T' && cmd.iCode >= 0)
+			{
+				m_pVis->SetTool(cmd.iCode);
+			}
+		});
+		m_pVis->ConnectFrom(GetMMUIRQ(MMU2::SELECTOR_OUT), MK3SGL::SEL_IN);
+		m_pVis->ConnectFrom(GetMMUIRQ(MMU2::IDLER_OUT), MK3SGL::IDL_IN);
+		m_pVis->ConnectFrom(GetMMUIRQ(MMU2::LEDS_OUT),MK3SGL::MMU_LEDS_IN);
+		m_pVis->ConnectFrom(GetMMUIRQ(MMU2::FINDA_OUT),MK3SGL::FINDA_IN);
+		m_pVis->ConnectFrom(GetMMUIRQ(MMU2::FEED_DISTANCE), MK3SGL::FEED_IN);
 	}
 }
 
@@ -73,7 +129,14 @@ void Prusa_MK3SMMU2::Draw()
 {
 	glPushMatrix();
 		Prusa_MK3S::Draw();
-		m_MMU.Draw(static_cast<float>(GetWindowSize().second));
+		if (m_pMMU)
+		{
+			m_pMMU->Draw(static_cast<float>(GetWindowSize().second));
+		}
+		else
+		{
+			m_pMMUFast->Draw(static_cast<float>(GetWindowSize().second));
+		}
 		m_gl.OnDraw();
 
 	glPopMatrix();
@@ -22,6 +22,7 @@
 
 #include "GCodeSniffer.h"  // for GCodeSniffer
 #include "MMU2.h"          // for MMU2
+#include "MMU2Fast.h"      // for MMU2Fast
 #include "Prusa_MK3S.h"    // for Prusa_MK3S
 #include "SerialPipe.h"
 #include "sim_irq.h"       // for avr_irq_t
@@ -34,7 +35,7 @@ class Prusa_MK3SMMU2 : public Prusa_MK3S
 {
 
 	public:
-		Prusa_MK3SMMU2():Prusa_MK3S(){};
+		Prusa_MK3SMMU2();
 		~Prusa_MK3SMMU2() override = default;
 
 		void Draw() override;
@@ -49,7 +50,12 @@ class Prusa_MK3SMMU2 : public Prusa_MK3S
 
 		void OnMMUFeed(avr_irq_t *irq, uint32_t value);// Helper for MMU IR sensor triggering.
 
-		MMU2 m_MMU;
+		// The MMU IRQ named by an MMU2 IRQ, from whichever MMU is in use.
+		avr_irq_t* GetMMUIRQ(unsigned int uiMMU2IRQ);
+
+		// Exactly one of these, depending on --mmu.
+		std::unique_ptr<MMU2> m_pMMU;
+		std::unique_ptr<MMU2Fast> m_pMMUFast;
 		GCodeSniffer m_sniffer = GCodeSniffer('T');
 		std::unique_ptr<SerialPipe> m_pipe {nullptr};
 
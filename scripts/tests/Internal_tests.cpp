@@ -25,25 +25,60 @@
 #include "ADC_Buttons.h"
 #include "Beeper.h"
 #include "Board.h"
+#include "CallbackProfiler.h"
 #include "EEPROM.h"
 #include "Fan.h"
+#include "FastForward.h"
+#include "FatImage.h"
+#include "FirmwareProfiler.h"
+#include "GCodeSniffer.h"
+#include "GCodeTokenizer.h"
 #include "GLHelper.h"
 #include "Heater.h"
 #include "HD44780.h"
 #include "IRSensor.h"
+#include "InputRecorder.h"
+#include "IPCBatchDecoder.h"
 #include "IScriptable.h"
+#include "ipc/mk404_ipc.h"
+#include "MappedFile.h"
 #include "MMU2.h"
 #include "MMUSideband.h"
 #include "PAT9125.h"
+#include "PatternMatcher.h"
 #include "PINDA.h"
+#include "PredecodedCore.h"
+#include "PrintHost.h"
 #include "SDCard.h"
+#include "SeqLock.h"
 #include "SerialLineMonitor.h"
+#include "SPSCRing.h"
+#include "TelemetryHost.h"
+#include "TelemetryStats.h"
+#include "TelemetryStream.h"
 #include "Test_Board.h"
 #include "Thermistor.h"
 #include "TMC2130.h"
 #include "VoltageSrc.h"
 #include "w25x20cl.h"
 #include "Color.h"
+#include "sim_avr.h"
+#include "sim_cycle_timers.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
 
 #ifndef TEST_MODE
 	#error "Internal_Tests requires TEST_MODE defined to access protected interface functions."
@@ -81,6 +116,7 @@ UNHANDLED_TEST_A(Heater, 1.F, 25.F, false, 'H', 30.F, 35.F)
 UNHANDLED_TEST(IRSensor);
 UNHANDLED_TEST(PAT9125);
 UNHANDLED_TEST(PINDA);
+UNHANDLED_TEST(PrintHost);
 UNHANDLED_TEST(SDCard);
 UNHANDLED_TEST_A(SerialLineMonitor,"SLM");
 UNHANDLED_TEST(Thermistor);
@@ -198,6 +234,412 @@ TEST_CASE("Internal_EEPROM_errors") {
 	Test_EEPROM_errors();
 }
 
+TEST_CASE("Internal_MappedFile") {
+	std::string strFile = "Internal_MappedFile.bin_test";
+	std::remove(strFile.c_str());
+	{
+		MappedFile f;
+		REQUIRE(f.Map(strFile, 4096));
+		REQUIRE(f.IsNew());
+		REQUIRE_FALSE(f.IsPrivate());
+		f.GetData()[10] = 0x5A;
+		// A second user of the same file gets a private copy.
+		MappedFile g;
+		REQUIRE(g.Map(strFile, 4096));
+		REQUIRE(g.IsPrivate());
+		REQUIRE(g.GetData()[10] == 0x5A);
+		g.GetData()[10] = 0xA5;
+		REQUIRE(f.GetData()[10] == 0x5A);
+	}
+	// Unmapped without an explicit sync, the write is still in the file.
+	MappedFile f;
+	REQUIRE(f.Map(strFile, 4096));
+	REQUIRE_FALSE(f.IsNew());
+	REQUIRE(f.GetData()[10] == 0x5A);
+	f.Unmap();
+	std::remove(strFile.c_str());
+}
+
+static void WriteHostFile(const std::string &strFile, size_t uiSize)
+{
+	std::ofstream fsOut(strFile, fsOut.binary | fsOut.trunc);
+	for (size_t i = 0; i < uiSize; i++)
+	{
+		fsOut.put(static_cast<char>(i & 0xFFU));
+	}
+}
+
+TEST_CASE("Internal_FatImage_AddFile") {
+	std::string strImage = "Internal_FatImage.img_test";
+	REQUIRE(FatImage::MakeFatImage(strImage, "32M"));
+	WriteHostFile("SHORT.G", 100);
+	WriteHostFile("A long file name.gcode", 1300);
+	WriteHostFile("Gr\xC3\xB6\xC3\x9F" "e.gco", 10);
+	WriteHostFile("bad\xFF.gco", 10);
+	REQUIRE(FatImage::AddFile(strImage, "SHORT.G"));
+	REQUIRE(FatImage::AddFile(strImage, "A long file name.gcode"));
+	REQUIRE(FatImage::AddFile(strImage, "Gr\xC3\xB6\xC3\x9F" "e.gco"));
+	REQUIRE_FALSE(FatImage::AddFile(strImage, "bad\xFF.gco"));
+	REQUIRE_FALSE(FatImage::AddFile(strImage, "SHORT.G"));
+
+	MappedFile img;
+	REQUIRE(img.Map(strImage, 32U<<20U));
+	auto data = img.GetData();
+	auto fcnGet16 = [&data](size_t uiAddr) { return static_cast<uint16_t>(data[uiAddr] | (data[uiAddr+1]<<8U)); };
+	auto fcnGet32 = [&](size_t uiAddr) { return fcnGet16(uiAddr) | (static_cast<uint32_t>(fcnGet16(uiAddr+2))<<16U); };
+	// 512 byte clusters; the root directory is cluster 2 and starts with the volume label.
+	size_t uiFAT = fcnGet16(0x0E) * 512U, uiFATBytes = fcnGet32(0x24) * 512U;
+	size_t uiRoot = uiFAT + (2*uiFATBytes);
+	REQUIRE(fcnGet32(0x2C) == 2);
+	auto fcnEntry = [&](size_t uiSlot) { return uiRoot + (uiSlot*32U); };
+	auto fcnName = [&](size_t uiSlot) { return std::string(&data[fcnEntry(uiSlot)], &data[fcnEntry(uiSlot)] + 11); };
+	auto fcnFAT = [&](uint32_t uiCl) { REQUIRE(fcnGet32(uiFAT + uiFATBytes + (uiCl*4)) == fcnGet32(uiFAT + (uiCl*4))); return fcnGet32(uiFAT + (uiCl*4)); };
+	auto fcnLFNChar = [&](size_t uiSlot, size_t uiChar)
+	{
+		static const std::array<uint8_t, 13> aOffsets {1,3,5,7,9,14,16,18,20,22,24,28,30};
+		return fcnGet16(fcnEntry(uiSlot) + gsl::at(aOffsets, uiChar));
+	};
+
+	// A plain 8.3 name needs no long name entries.
+	REQUIRE(fcnName(1) == "SHORT   G  ");
+	REQUIRE(fcnGet16(fcnEntry(1) + 0x1A) == 3);
+	REQUIRE(fcnGet32(fcnEntry(1) + 0x1C) == 100);
+	REQUIRE(fcnFAT(3) == 0x0FFFFFFFU);
+
+	// 22 characters: two long name entries, last part first, then the short alias.
+	REQUIRE(data[fcnEntry(2)] == 0x42);
+	REQUIRE(data[fcnEntry(2) + 11] == 0x0F);
+	REQUIRE(data[fcnEntry(3)] == 0x01);
+	REQUIRE(fcnLFNChar(3, 0) == 'A');
+	REQUIRE(fcnLFNChar(3, 12) == 'n');
+	REQUIRE(fcnLFNChar(2, 0) == 'a');
+	REQUIRE(fcnLFNChar(2, 8) == 'e');
+	REQUIRE(fcnLFNChar(2, 9) == 0);
+	REQUIRE(fcnLFNChar(2, 10) == 0xFFFFU);
+	REQUIRE(fcnName(4) == "ALONGF~1GCO");
+	REQUIRE(data[fcnEntry(2) + 13] == data[fcnEntry(3) + 13]);
+	REQUIRE(fcnGet16(fcnEntry(4) + 0x1A) == 4);
+	REQUIRE(fcnGet32(fcnEntry(4) + 0x1C) == 1300);
+	REQUIRE(fcnFAT(4) == 5);
+	REQUIRE(fcnFAT(5) == 6);
+	REQUIRE(fcnFAT(6) == 0x0FFFFFFFU);
+	REQUIRE(data[uiRoot + (4*512) + 1299 - 1024] == (1299 & 0xFF));
+
+	// Non-ASCII names are stored as UTF-16.
+	REQUIRE(data[fcnEntry(5)] == 0x41);
+	REQUIRE(fcnLFNChar(5, 1) == 'r');
+	REQUIRE(fcnLFNChar(5, 2) == 0xF6);
+	REQUIRE(fcnLFNChar(5, 3) == 0xDF);
+	REQUIRE(fcnLFNChar(5, 4) == 'e');
+	REQUIRE(fcnLFNChar(5, 9) == 0);
+	REQUIRE(fcnName(6) == "GRE~1   GCO");
+	REQUIRE(data[fcnEntry(7)] == 0);
+
+	img.Unmap();
+	for (auto &strFile : {strImage.c_str(), "SHORT.G", "A long file name.gcode", "Gr\xC3\xB6\xC3\x9F" "e.gco", "bad\xFF.gco"})
+	{
+		std::remove(strFile);
+	}
+}
+
+TEST_CASE("Internal_InputRecorder") {
+	std::string strFile = "Internal_InputRecorder.log_test";
+	auto &rec = InputRecorder::GetRecorder();
+	auto *pCh = rec.GetChannel("test");
+	std::vector<std::string> vGot;
+	auto fcnGot = [&vGot](const std::string &strData) { vGot.push_back(strData); };
+
+	// Live input is delivered (and logged) on the next Take, with whatever cycle that is.
+	REQUIRE(rec.Record(strFile));
+	rec.Queue(pCh, "first line");
+	rec.Queue(pCh, "second");
+	rec.Take(pCh, 100, fcnGot);
+	rec.Log(pCh, 250, "byte");
+	rec.Take(pCh, 280, fcnGot); // Nothing queued.
+	rec.Queue(pCh, "third");
+	rec.Take(pCh, 300, fcnGot);
+	REQUIRE(vGot == std::vector<std::string>{"first line", "second", "third"});
+	rec.Stop();
+
+	// Replay hands back exactly the logged inputs, each no earlier than its cycle, and drops live input.
+	vGot.clear();
+	REQUIRE(rec.Replay(strFile));
+	REQUIRE(rec.IsReplaying());
+	rec.Queue(pCh, "live");
+	rec.Take(pCh, 99, fcnGot);
+	REQUIRE(vGot.empty());
+	rec.Take(pCh, 100, fcnGot);
+	REQUIRE(vGot == std::vector<std::string>{"first line", "second"});
+	rec.Take(pCh, 299, fcnGot);
+	REQUIRE(vGot.back() == "byte");
+	rec.Take(pCh, 1000, fcnGot);
+	REQUIRE(vGot == std::vector<std::string>{"first line", "second", "byte", "third"});
+	rec.Take(pCh, 2000, fcnGot);
+	REQUIRE(vGot.size() == 4);
+	rec.Stop();
+	REQUIRE_FALSE(rec.IsActive());
+
+	REQUIRE_FALSE(rec.Replay("Internal_InputRecorder.missing"));
+	std::remove(strFile.c_str());
+}
+
+TEST_CASE("Internal_GCodeTokenizer") {
+	GCodeTokenizer t;
+	auto feed = [&t](const std::string &strLine) {
+		bool bDone = false;
+		for (auto c : strLine)
+		{
+			bDone = t.Feed(c);
+		}
+		return bDone;
+	};
+	REQUIRE(feed("N5 G1 X10.5 Y-2 E.25 ; move\n"));
+	const GCodeCommand &cmd = t.GetCommand();
+	REQUIRE(cmd.Is('G',1));
+	REQUIRE(cmd.iLine == 5);
+	REQUIRE(cmd.uiParamCount == 3);
+	REQUIRE(cmd.GetValue('X',0) == 10.5f);
+	REQUIRE(cmd.GetValue('Y',0) == -2.f);
+	REQUIRE(cmd.GetValue('E',0) == 0.25f);
+	REQUIRE_FALSE(cmd.bHasChecksum);
+	REQUIRE(feed("N5 G1 X10*84\n"));
+	REQUIRE(t.GetCommand().bChecksumOK);
+	REQUIRE(feed("N5 G1 X10*85\n"));
+	REQUIRE(t.GetCommand().bHasChecksum);
+	REQUIRE_FALSE(t.GetCommand().bChecksumOK);
+	REQUIRE(feed("G28 X Y\n"));
+	REQUIRE(t.GetCommand().Get('X') != nullptr);
+	REQUIRE_FALSE(t.GetCommand().Get('X')->bHasValue);
+	REQUIRE(feed("G29.1\n"));
+	REQUIRE(t.GetCommand().iSubCode == 1);
+	REQUIRE_FALSE(feed("; just a comment\n"));
+	REQUIRE_FALSE(feed("\r\n"));
+}
+
+TEST_CASE("Internal_GCodeSniffer_Subscribers") {
+	avr_t *avr = avr_make_mcu_by_name("atmega2560");
+	avr_init(avr);
+	GCodeSniffer sniff('T');
+	sniff.Init(avr, '0');
+	std::vector<int32_t> vTools;
+	unsigned int uiLines = 0;
+	sniff.AddSubscriber([&vTools](const GCodeCommand &cmd)
+	{
+		if (cmd.chrLetter == 'T')
+		{
+			vTools.push_back(cmd.iCode);
+		}
+	});
+	sniff.AddSubscriber([&uiLines](const GCodeCommand &) { uiLines++; });
+	for (auto c : std::string("T1\nT1\nG1 X5\nG1 X5\nT2\n"))
+	{
+		avr_raise_irq(sniff.GetIRQ(GCodeSniffer::BYTE_IN), static_cast<uint8_t>(c));
+	}
+	// Repeats reach every subscriber even though the IRQ values don't change.
+	REQUIRE(vTools == std::vector<int32_t>{1, 1, 2});
+	REQUIRE(uiLines == 5);
+	REQUIRE(sniff.GetIRQ(GCodeSniffer::CODEVAL_OUT)->value == 2);
+	REQUIRE(sniff.GetIRQ(GCodeSniffer::CMD_OUT)->value == GCodeSniffer::CommandValue('T', 2));
+	avr_terminate(avr);
+}
+
+TEST_CASE("Internal_PatternMatcher") {
+	PatternMatcher m;
+	REQUIRE(m.Add("ok") == 0);
+	REQUIRE(m.Add("T:{} /{} B:") == 1);
+	REQUIRE(m.Add("{} lines") == 2);
+	REQUIRE(m.Add("{}{}") == -1);
+	m.Compile();
+	auto feed = [&m](const std::string &strLine) {
+		for (auto c : strLine)
+		{
+			m.Feed(c);
+		}
+		return m.NewLine(strLine);
+	};
+	auto vMatch = feed("ok T:215.0 /210.0 B:60.0");
+	REQUIRE(vMatch.size() == 2);
+	REQUIRE(vMatch.at(0).id == 0);
+	REQUIRE(vMatch.at(1).captures == std::vector<std::string>{"215.0", "210.0"});
+	REQUIRE(feed("T:215.0 B:60.0").empty());
+	vMatch = feed("read 42 lines");
+	REQUIRE(vMatch.size() == 1);
+	REQUIRE(vMatch.at(0).captures.at(0) == "42");
+}
+
+TEST_CASE("Internal_SPSCRing") {
+	SPSCRing<uint32_t, 8> r;
+	std::array<uint32_t, 10> vIn {{0,1,2,3,4,5,6,7,8,9}};
+	REQUIRE(r.IsEmpty());
+	REQUIRE(r.Push(vIn.data(), 10) == 8); // Only as many as fit.
+	std::vector<uint32_t> vOut;
+	auto pop = [&vOut](uint32_t uiVal) { vOut.push_back(uiVal); };
+	REQUIRE(r.PopAll(pop) == 8);
+	REQUIRE(r.IsEmpty());
+	REQUIRE(r.Push(&vIn[8], 2) == 2); // Wraps around.
+	REQUIRE(r.PopAll(pop) == 2);
+	REQUIRE(vOut == std::vector<uint32_t>(vIn.begin(), vIn.end()));
+
+	// Everything arrives, in order, across threads.
+	static constexpr uint32_t COUNT = 100000;
+	std::thread producer([&r]() {
+		uint32_t uiNext = 0;
+		while (uiNext < COUNT)
+		{
+			uiNext += r.Push(&uiNext, 1);
+			std::this_thread::yield();
+		}
+	});
+	uint32_t uiExpected = 0;
+	bool bInOrder = true;
+	while (uiExpected < COUNT)
+	{
+		r.PopAll([&](uint32_t uiVal) { bInOrder &= (uiVal == uiExpected++); });
+		std::this_thread::yield();
+	}
+	producer.join();
+	REQUIRE(bInOrder);
+}
+
+TEST_CASE("Internal_IPCBatchDecoder") {
+	static constexpr int MOTORS = 20, INDICATORS = 2, DROP_EVERY = 50;
+	struct Link
+	{
+		IPCBatchDecoder *pDec;
+		bool bDropping;
+		uint32_t uiFrames, uiDropped;
+		std::vector<uint8_t> vLast; // Last frame that got through.
+	};
+	std::array<int32_t, 256> vValue {};
+	IPCBatchDecoder dec([&vValue](uint8_t channel, int32_t value) { vValue[channel] = value; });
+	Link link {&dec, true, 0, 0, {}};
+	auto fcnWrite = [](void *ctx, const uint8_t *data, size_t len)
+	{
+		auto pLink = static_cast<Link*>(ctx);
+		if (pLink->bDropping && (++pLink->uiFrames % DROP_EVERY) == 0)
+		{
+			pLink->uiDropped++;
+			return 0; // Lost in transit.
+		}
+		pLink->vLast.assign(data, data + len);
+		pLink->pDec->Apply(data, len);
+		return 0;
+	};
+
+	// Stream through the real client, dropping some frames on the way.
+	mk404_ipc_client_t c;
+	mk404_ipc_init(&c, fcnWrite, &link);
+	mk404_ipc_set_max_rate(&c, 2000);
+	std::array<int32_t, 256> vExpected {};
+	uint32_t uiNow = 0;
+	for (uint32_t uiStep = 0; uiStep < 20000; uiStep++, uiNow += 10)
+	{
+		for (int m = 0; m < MOTORS; m++)
+		{
+			uint32_t uiPhase = (uiStep * (m + 1U)) % 2000U;
+			vExpected[m] = uiPhase < 1000U ? uiPhase : 2000U - uiPhase;
+			mk404_ipc_sample(&c, uiNow, MK404_IPC_MOTOR(m), vExpected[m]);
+		}
+		for (int i = 0; i < INDICATORS; i++)
+		{
+			vExpected[MK404_IPC_INDICATOR(i)] = ((uiStep >> (4U + i)) & 1U) ? 255 : 0;
+			mk404_ipc_sample(&c, uiNow, MK404_IPC_INDICATOR(i), vExpected[MK404_IPC_INDICATOR(i)]);
+		}
+	}
+	link.bDropping = false; // The last frame must make it for the final values to match.
+	mk404_ipc_flush(&c, uiNow, 1);
+	REQUIRE(link.uiDropped > 0);
+	REQUIRE(dec.GetLostBatches() == link.uiDropped);
+	REQUIRE(dec.GetStaleSamples() == 0);
+	REQUIRE(vValue == vExpected);
+
+	// A repeated frame doesn't count as a loss.
+	REQUIRE(dec.Apply(link.vLast.data(), link.vLast.size()) == IPCBatchDecoder::Result::OK);
+	REQUIRE(dec.GetLostBatches() == link.uiDropped);
+
+	// Nor does an older sample replace a newer one.
+	std::array<mk404_ipc_sample_t, 1> vOld {{{uiNow - 1000U, MK404_IPC_MOTOR(0), 1234}}};
+	std::array<uint8_t, MK404_IPC_MAX_FRAME> vBuf {};
+	size_t uiLen = mk404_ipc_encode(vBuf.data(), c.seq, vOld.data(), 1);
+	vValue.fill(-1);
+	REQUIRE(dec.Apply(vBuf.data(), uiLen) == IPCBatchDecoder::Result::OK);
+	REQUIRE(dec.GetStaleSamples() == 1);
+	REQUIRE(vValue[0] == -1);
+
+	// Only the received length counts, not whatever follows it in the buffer.
+	REQUIRE(dec.Apply(vBuf.data(), uiLen - 1) == IPCBatchDecoder::Result::Malformed);
+	std::array<uint8_t, 2> vAscii {{'A','M'}};
+	REQUIRE(dec.Apply(vAscii.data(), vAscii.size()) == IPCBatchDecoder::Result::Malformed);
+	vBuf[1] = MK404_IPC_VERSION + 1;
+	REQUIRE(dec.Apply(vBuf.data(), uiLen) == IPCBatchDecoder::Result::Version);
+	REQUIRE(dec.GetLastVersion() == MK404_IPC_VERSION + 1);
+	REQUIRE(vValue[0] == -1);
+
+	// After a reconnect the client's clock and sequence start over.
+	dec.Reset();
+	vBuf[1] = MK404_IPC_VERSION;
+	REQUIRE(dec.Apply(vBuf.data(), uiLen) == IPCBatchDecoder::Result::OK);
+	REQUIRE(vValue[0] == 1234);
+	REQUIRE(dec.GetLostBatches() == link.uiDropped);
+}
+
+TEST_CASE("Internal_CallbackProfiler_SiteCache") {
+	// One call site shared by two instances that take turns must still keep them apart.
+	static const char* SITE = "Test::Cb"; // Sites are keyed by the literal's address, as in the macros.
+	int a = 0, b = 0;
+	CallbackProfiler::SiteCache site {};
+	for (int i=0; i<10; i++)
+	{
+		CallbackProfiler::Scope scopeA(site.Get(SITE, &a));
+		CallbackProfiler::Scope scopeB(site.Get(SITE, &b));
+	}
+	CallbackProfiler::Entry &entryA = site.Get(SITE, &a);
+	CallbackProfiler::Entry &entryB = site.Get(SITE, &b);
+	REQUIRE(&entryA != &entryB);
+	REQUIRE(entryA.uiCalls == 10);
+	REQUIRE(entryB.uiCalls == 10);
+	REQUIRE(site.vSeen.size() == 2);
+	// A fresh cache for the same site finds the existing entries.
+	CallbackProfiler::SiteCache other {};
+	REQUIRE(&other.Get(SITE, &b) == &entryB);
+}
+
+TEST_CASE("Internal_SeqLock") {
+	struct Frame { std::array<uint8_t, 37> data; }; // Not a whole number of words.
+	SeqLock<Frame> l;
+	Frame in {}, out {};
+	uint32_t uiGen = 0;
+	REQUIRE_FALSE(l.ReadIfChanged(out, uiGen)); // Nothing published yet.
+	in.data.fill(7);
+	l.Publish(in);
+	REQUIRE(l.ReadIfChanged(out, uiGen));
+	REQUIRE(out.data == in.data);
+	REQUIRE_FALSE(l.ReadIfChanged(out, uiGen)); // Same generation.
+
+	// A reader only ever sees whole frames.
+	static constexpr uint8_t FRAMES = 200;
+	std::thread writer([&l]() {
+		Frame f {};
+		for (uint8_t i = 1; i <= FRAMES; i++)
+		{
+			f.data.fill(i);
+			l.Publish(f);
+			std::this_thread::yield();
+		}
+	});
+	bool bTorn = false;
+	while (out.data[0] != FRAMES)
+	{
+		if (l.ReadIfChanged(out, uiGen))
+		{
+			bTorn |= std::count(out.data.begin(), out.data.end(), out.data[0]) != static_cast<long>(out.data.size());
+		}
+		std::this_thread::yield();
+	}
+	writer.join();
+	REQUIRE_FALSE(bTorn);
+}
+
 void Test_MMU2_internal() {
 	MMU2 m(true, true);
 
@@ -311,3 +753,507 @@ TEST_CASE("Internal_Colour_conversion") {
 	REQUIRE(out[2] == 0.F);
 
 }
+
+static unsigned int s_uiDeadlines = 0;
+static avr_cycle_count_t OnTestDeadline(avr_t*, avr_cycle_count_t, void*)
+{
+	s_uiDeadlines++;
+	return 0;
+}
+
+static void AdvanceTo(avr_t *avr, avr_cycle_count_t uiCycle)
+{
+	avr->cycle = uiCycle;
+	avr_cycle_timer_process(avr);
+}
+
+TEST_CASE("Internal_DeadlineTimer") {
+	avr_t *avr = avr_make_mcu_by_name("atmega2560");
+	avr_init(avr);
+	DeadlineTimer t(OnTestDeadline, nullptr);
+
+	// Pushing the deadline back repeatedly must not expire it.
+	t.Set(avr, 1000);
+	for (int i=1; i<=10; i++)
+	{
+		AdvanceTo(avr, 500U*i);
+		t.Set(avr, 1000);
+	}
+	AdvanceTo(avr, 5999);
+	REQUIRE(s_uiDeadlines == 0);
+	AdvanceTo(avr, 6000);
+	REQUIRE(s_uiDeadlines == 1);
+
+	// Cleared deadlines don't fire.
+	t.Set(avr, 100);
+	t.Clear();
+	AdvanceTo(avr, 6200);
+	REQUIRE(s_uiDeadlines == 1);
+
+	// Moving a deadline earlier is honoured.
+	t.Set(avr, 5000);
+	t.Set(avr, 10);
+	AdvanceTo(avr, 6210);
+	REQUIRE(s_uiDeadlines == 2);
+	AdvanceTo(avr, 20000);
+	REQUIRE(s_uiDeadlines == 2);
+
+	// A deadline pending when the AVR resets still expires on time.
+	t.Set(avr, 1000);
+	AdvanceTo(avr, 20400);
+	avr_reset(avr);
+	AdvanceTo(avr, avr->cycle + 599);
+	REQUIRE(s_uiDeadlines == 2);
+	AdvanceTo(avr, avr->cycle + 1);
+	REQUIRE(s_uiDeadlines == 3);
+	t.Cancel();
+	avr_terminate(avr);
+}
+
+// Reads from a telemetry client until strUntil has arrived, or a second has passed.
+static std::string ReadTelemetry(int fd, const std::string &strUntil)
+{
+	std::string strIn;
+	std::array<char,256> buff {};
+	auto tEnd = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+	while (strIn.find(strUntil) == std::string::npos && std::chrono::steady_clock::now() < tEnd)
+	{
+		pollfd pfd {fd, POLLIN, 0};
+		if (poll(&pfd, 1, 50) <= 0)
+		{
+			continue;
+		}
+		auto iRead = read(fd, buff.data(), buff.size());
+		if (iRead <= 0)
+		{
+			break;
+		}
+		strIn.append(buff.data(), iRead);
+	}
+	return strIn;
+}
+
+TEST_CASE("Internal_TelemetryStream") {
+	static constexpr const char* SOCKET = "Internal_TelemetryStream.sock";
+	avr_t *avr = avr_make_mcu_by_name("atmega2560");
+	avr_init(avr);
+	avr->frequency = 16000000;
+	avr->cycle = 0;
+	std::array<const char*, 1> names {">test.out"};
+	avr_irq_t *pIRQ = avr_alloc_irq(&avr->irq_pool, 0, 1, names.data());
+	{
+		TelemetryStream stream;
+		REQUIRE(stream.Init(avr, SOCKET, 1000)); // Batches every 16000 cycles.
+		stream.AddSignal("Test_>test.out", pIRQ, avr);
+
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		sockaddr_un addr {};
+		addr.sun_family = AF_UNIX;
+		strncpy(static_cast<char*>(addr.sun_path), SOCKET, sizeof(addr.sun_path)-1);
+		REQUIRE(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0); //NOLINT - sockaddr cast is the socket API.
+		REQUIRE(ReadTelemetry(fd, "\n") == "MK404 telemetry 1\n");
+
+		REQUIRE(write(fd, "list\n", 5) == 5);
+		REQUIRE(ReadTelemetry(fd, "end\n") == "signal 0 Test_>test.out\nend\n");
+		REQUIRE(write(fd, "sub Test_\n", 10) == 10);
+		REQUIRE(ReadTelemetry(fd, "\n") == "+ 0 Test_>test.out\n");
+
+		// The signal is hooked on the next batch, which also sends its current value.
+		avr_raise_irq(pIRQ, 7);
+		AdvanceTo(avr, 16000);
+		REQUIRE(ReadTelemetry(fd, " 7\n") == "batch 1\n1000000 0 7\n");
+		avr->cycle = 20000;
+		avr_raise_irq(pIRQ, 9);
+		AdvanceTo(avr, 32000);
+		REQUIRE(ReadTelemetry(fd, " 9\n") == "batch 1\n1250000 0 9\n");
+
+		// Batches keep coming after a reset has flushed the timers.
+		avr_reset(avr);
+		avr_cycle_count_t uiBase = avr->cycle;
+		avr->cycle = uiBase + 160;
+		avr_raise_irq(pIRQ, 11);
+		std::string strSample = std::to_string(avr_cycles_to_nsec(avr, uiBase + 160)) + " 0 11\n";
+		AdvanceTo(avr, uiBase + 16000);
+		REQUIRE(ReadTelemetry(fd, " 11\n") == "batch 1\n" + strSample);
+
+		close(fd);
+	}
+	avr_free_irq(pIRQ, 1);
+	avr_terminate(avr);
+}
+
+TEST_CASE("Internal_TelemetryStats") {
+	// Two boards; the signal belongs to the second.
+	avr_t *pOther = avr_make_mcu_by_name("atmega2560");
+	avr_init(pOther);
+	avr_t *avr = avr_make_mcu_by_name("atmega2560");
+	avr_init(avr);
+	avr->frequency = 16000000;
+	avr->cycle = 0;
+	std::array<const char*, 1> names {">test.out"};
+	avr_irq_t *pIRQ = avr_alloc_irq(&avr->irq_pool, 0, 1, names.data());
+	REQUIRE(TelemetryHost::GetIRQOwner(pIRQ) == avr);
+
+	TelemetryStats stats;
+	stats.Add(TelemetryHost::GetIRQOwner(pIRQ), "Test_>test.out", pIRQ);
+	for (auto &change : std::vector<std::pair<avr_cycle_count_t, uint32_t>> {{100,3}, {200,5}, {300,0}, {400,1}, {450,1}})
+	{
+		avr->cycle = change.first;
+		avr_raise_irq(pIRQ, change.second);
+	}
+	avr->cycle = 500;
+	std::ostringstream os;
+	stats.WriteJSON(os);
+	std::string strJSON = os.str();
+	// 0->3 and 0->1 are edges, 3->5 is not. The repeated 1 is not a change.
+	REQUIRE(strJSON.find("\"changes\": 4, \"rising\": 2, \"min\": 0, \"max\": 5, \"mean\": 2.25, \"time_avg\": 1.8,") != std::string::npos);
+
+	avr_free_irq(pIRQ, 1);
+	avr_terminate(avr);
+	avr_terminate(pOther);
+}
+
+static float ReadHeater(Heater &h)
+{
+	avr_raise_irq(h.GetIRQ(Heater::TEMP_REQ_IN), 1);
+	return static_cast<float>(h.GetIRQ(Heater::TEMP_OUT)->value)/256.f;
+}
+
+TEST_CASE("Internal_Heater_StepResponse") {
+	avr_t *avr = avr_make_mcu_by_name("atmega2560");
+	avr_init(avr);
+	avr->frequency = 16000000;
+	avr->cycle = 0;
+	static constexpr avr_cycle_count_t TICK = 4800000; // 300 ms, the old model's step.
+	{
+		Heater h {1.5,25.0,false,'A',30,250};
+		h.Init(avr, nullptr, nullptr);
+
+		// The old tick model: a linear rise while on, Newtonian decay when off.
+		float fLegacy = 25.f;
+		avr_cycle_count_t uiNow = 0;
+		avr_raise_irq(h.GetIRQ(Heater::PWM_IN), 255);
+		for (int i=0; i<200; i++)
+		{
+			AdvanceTo(avr, uiNow += TICK);
+			fLegacy += 1.5f*0.3f;
+			REQUIRE(std::abs(ReadHeater(h) - fLegacy) < 0.05f);
+		}
+		avr_raise_irq(h.GetIRQ(Heater::PWM_IN), 0);
+		for (int i=0; i<400; i++)
+		{
+			AdvanceTo(avr, uiNow += TICK);
+			fLegacy = 25.f + (fLegacy - 25.f)*std::exp(-0.005f*0.3f);
+			REQUIRE(std::abs(ReadHeater(h) - fLegacy) < 0.05f);
+		}
+	}
+	avr_terminate(avr);
+
+	avr = avr_make_mcu_by_name("atmega2560");
+	avr_init(avr);
+	avr->frequency = 16000000;
+	avr->cycle = 0;
+	{
+		// A short pulse reaches a lagging sensor well after the power is cut.
+		Heater h {1.5,25.0,false,'B',30,250};
+		h.AddNode(5);
+		h.Init(avr, nullptr, nullptr);
+		avr_raise_irq(h.GetIRQ(Heater::PWM_IN), 255);
+		AdvanceTo(avr, 16000000ULL);
+		avr_raise_irq(h.GetIRQ(Heater::PWM_IN), 0);
+		float fCut = ReadHeater(h);
+		REQUIRE(fCut < 25.3f);
+		AdvanceTo(avr, 16000000ULL*20);
+		REQUIRE(ReadHeater(h) > fCut + 0.5f);
+
+		// A sensor lag equal to the block's cooling constant (200 s) must behave like a nearby one.
+		Heater hSame {1.5,25.0,false,'C',30,250};
+		hSame.AddNode(200);
+		hSame.Init(avr, nullptr, nullptr);
+		Heater hNear {1.5,25.0,false,'D',30,250};
+		hNear.AddNode(201);
+		hNear.Init(avr, nullptr, nullptr);
+		avr_raise_irq(hSame.GetIRQ(Heater::PWM_IN), 255);
+		avr_raise_irq(hNear.GetIRQ(Heater::PWM_IN), 255);
+		AdvanceTo(avr, avr->cycle + 16000000ULL*60);
+		avr_raise_irq(hSame.GetIRQ(Heater::PWM_IN), 0);
+		avr_raise_irq(hNear.GetIRQ(Heater::PWM_IN), 0);
+		AdvanceTo(avr, avr->cycle + 16000000ULL*200);
+		float fNear = ReadHeater(hNear);
+		REQUIRE(fNear > 40.f);
+		REQUIRE(std::abs(ReadHeater(hSame) - fNear) < 0.5f);
+	}
+	avr_terminate(avr);
+}
+
+// Not part of the normal run, use: MK404_tests "[.benchmark]"
+static avr_cycle_count_t OnBenchDummy(avr_t*, avr_cycle_count_t when, void*)
+{
+	return when + 1200000;
+}
+
+// Runs uiSteps step pulses 200 cycles apart, with fcnStep standing in for the step handler,
+// against a timer list populated a bit like a running printer's.
+template<class F>
+static double NsPerStep(avr_t *avr, unsigned uiSteps, F fcnStep)
+{
+	std::vector<int> vDummies(24);
+	for (size_t i=0; i<vDummies.size(); i++)
+	{
+		avr_cycle_timer_register(avr, 1000U + 50000U*i, OnBenchDummy, &vDummies.at(i));
+	}
+	auto tStart = std::chrono::steady_clock::now();
+	for (unsigned i=0; i<uiSteps; i++)
+	{
+		avr->cycle += 200;
+		fcnStep();
+		avr_cycle_timer_process(avr);
+	}
+	auto dNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - tStart).count()/uiSteps;
+	for (auto &dummy : vDummies)
+	{
+		avr_cycle_timer_cancel(avr, OnBenchDummy, &dummy);
+	}
+	return dNs;
+}
+
+TEST_CASE("Internal_TMC2130_StepPath", "[.benchmark]") {
+	avr_t *avr = avr_make_mcu_by_name("atmega2560");
+	avr_init(avr);
+	static constexpr unsigned STEPS = 1000000;
+	static constexpr avr_cycle_count_t STANDSTILL = 1U<<20U;
+	int iParam = 0;
+	unsigned int uiExpired = s_uiDeadlines;
+
+	// Old step path: cancel + re-register the standstill timer on every step.
+	double dEager = NsPerStep(avr, STEPS, [avr, &iParam]()
+	{
+		avr_cycle_timer_cancel(avr, OnTestDeadline, &iParam);
+		avr_cycle_timer_register(avr, STANDSTILL, OnTestDeadline, &iParam);
+	});
+	avr_cycle_timer_cancel(avr, OnTestDeadline, &iParam);
+
+	// New step path: push the deadline back.
+	DeadlineTimer standstill(OnTestDeadline, &iParam);
+	double dDeadline = NsPerStep(avr, STEPS, [avr, &standstill]() { standstill.Set(avr, STANDSTILL); });
+	standstill.Cancel();
+	REQUIRE(s_uiDeadlines == uiExpired);
+
+	// For scale, the whole TMC2130 step handler on the same harness.
+	TMC2130 tmc('X');
+	tmc.Init(avr);
+	avr_raise_irq(tmc.GetIRQ(TMC2130::ENABLE_IN), 0);
+	double dStep = NsPerStep(avr, STEPS, [&tmc]()
+	{
+		avr_raise_irq(tmc.GetIRQ(TMC2130::STEP_IN), 1);
+		avr_raise_irq(tmc.GetIRQ(TMC2130::STEP_IN), 0);
+	});
+
+	std::cout << "Standstill timer, cancel+register: " << dEager << " ns/step\n";
+	std::cout << "Standstill timer, deadline: " << dDeadline << " ns/step (" << dEager/dDeadline << "x)\n";
+	std::cout << "Full TMC2130 step path: " << dStep << " ns/step\n";
+}
+
+// Hand-assembled: churns registers through most of the ALU, walks SRAM with each pointer
+// mode, reads its own code back with lpm and takes every kind of skip and jump, uiLoops
+// times. Then cli/sleep, which stops the core.
+static std::vector<uint16_t> PredecodeTestProgram(uint16_t uiLoops)
+{
+	auto fcnRR = [](unsigned uiBase, unsigned d, unsigned r) { return static_cast<uint16_t>(uiBase | ((r & 0x10U)<<5U) | (d<<4U) | (r & 0xFU)); };
+	auto fcnRK = [](unsigned uiBase, unsigned d, unsigned k) { return static_cast<uint16_t>(uiBase | ((k & 0xF0U)<<4U) | ((d-16U)<<4U) | (k & 0xFU)); };
+	auto fcnR = [](unsigned uiBase, unsigned d) { return static_cast<uint16_t>(uiBase | (d<<4U)); };
+	auto fcnQ = [](unsigned uiBase, unsigned d, unsigned q) { return static_cast<uint16_t>(uiBase | ((q & 0x20U)<<8U) | ((q & 0x18U)<<7U) | (d<<4U) | (q & 7U)); };
+	std::vector<uint16_t> vProg {
+		fcnRK(0xE000, 26, 0x00), fcnRK(0xE000, 27, 0x02), // X = 0x200
+		fcnRK(0xE000, 28, 0x00), fcnRK(0xE000, 29, 0x04), // Y = 0x400
+		fcnRK(0xE000, 30, 0x00), fcnRK(0xE000, 31, 0x00), // Z = 0
+		fcnRK(0xE000, 16, 0x37),
+		fcnRK(0xE000, 24, uiLoops & 0xFFU), fcnRK(0xE000, 25, uiLoops>>8U),
+	};
+	size_t uiLoop = vProg.size();
+	std::vector<uint16_t> vBody {
+		fcnRR(0x2C00, 17, 16), // mov r17,r16
+		fcnR(0x9406, 17), fcnR(0x9407, 18), fcnR(0x9405, 19), fcnR(0x9402, 20), // lsr, ror, asr, swap
+		fcnR(0x9400, 21), fcnR(0x9401, 22), fcnR(0x9403, 23), fcnR(0x940A, 2), // com, neg, inc, dec
+		fcnRR(0x0C00, 16, 17), fcnRR(0x1C00, 18, 16), fcnRR(0x1800, 19, 2), fcnRR(0x0800, 20, 18), // add, adc, sub, sbc
+		fcnRR(0x2400, 21, 16), fcnRR(0x2000, 22, 19), fcnRR(0x2800, 23, 20), // eor, and, or
+		fcnRK(0x5000, 17, 0x13), fcnRK(0x4000, 18, 0x01), fcnRK(0x7000, 19, 0xF7), fcnRK(0x6000, 20, 0x21), // subi, sbci, andi, ori
+		fcnRK(0x3000, 16, 0x80), fcnRR(0x0400, 17, 18), fcnRR(0x1400, 19, 20), // cpi, cpc, cp
+		fcnRR(0x9C00, 16, 17), 0x0150, // mul r16,r17; movw r10,r0
+		0x0215, 0x0323, // muls r17,r21; mulsu r18,r19
+		fcnRR(0x2C00, 3, 0), fcnRR(0x2C00, 4, 1), // mov r3,r0; mov r4,r1
+		fcnR(0x920D, 16), fcnR(0x900C, 7), // st X+,r16; ld r7,X
+		fcnQ(0x8208, 17, 37), fcnQ(0x8008, 5, 37), // std Y+37,r17; ldd r5,Y+37
+		fcnR(0x9209, 18), fcnR(0x900A, 6), // st Y+,r18; ld r6,-Y
+		fcnR(0x9200, 16), 0x0300, fcnR(0x9000, 8), 0x0300, // sts 0x300,r16; lds r8,0x300
+		fcnR(0x9005, 9), 0x95C8, 0x9631, // lpm r9,Z+; lpm; adiw r30,1
+		fcnR(0xFA03, 16), fcnR(0xF805, 19), // bst r16,3; bld r19,5
+		fcnR(0xFC00, 16), fcnR(0x9403, 12), // sbrc r16,0; inc r12
+		fcnR(0xFE01, 17), fcnR(0x9000, 13), 0x0301, // sbrs r17,1; lds r13,0x301
+		fcnRR(0x1000, 16, 17), fcnR(0x9200, 14), 0x0302, // cpse r16,r17; sts 0x302,r14
+		fcnRR(0x1000, 20, 20), fcnR(0x9403, 16), // cpse r20,r20; inc r16 (always skipped)
+		0x9408, 0x9488, 0x9468, 0x94E8, // sec, clc, set, clt
+		0xC000, // rjmp .+0
+	};
+	vProg.insert(vProg.end(), vBody.begin(), vBody.end());
+	vProg.push_back(0x940C); // jmp to the next instruction
+	vProg.push_back(vProg.size() + 1U);
+	vProg.push_back(0x9701); // sbiw r24,1
+	vProg.push_back(0xF009); // breq .+2
+	vProg.push_back(0xC000 | ((uiLoop - vProg.size() - 1U) & 0xFFFU)); // rjmp loop
+	vProg.push_back(0x94F8); // cli
+	vProg.push_back(0x9588); // sleep
+	return vProg;
+}
+
+static avr_t* MakePredecodeTestAVR(const std::vector<uint16_t> &vProg)
+{
+	avr_t *avr = avr_make_mcu_by_name("atmega2560");
+	avr_init(avr);
+	for (size_t i=0; i<vProg.size(); i++)
+	{
+		avr->flash[2U*i] = vProg.at(i) & 0xFFU; //NOLINT - flash is a raw buffer
+		avr->flash[(2U*i)+1U] = vProg.at(i)>>8U; //NOLINT - flash is a raw buffer
+	}
+	avr->pc = 0;
+	return avr;
+}
+
+// A/B: the predecoded core must end in exactly the state the stock interpreter does.
+TEST_CASE("Internal_PredecodedCore") {
+	static constexpr avr_cycle_count_t LIMIT = 1000000;
+	std::vector<uint16_t> vProg = PredecodeTestProgram(300);
+	avr_t *pStock = MakePredecodeTestAVR(vProg);
+	avr_t *pFast = MakePredecodeTestAVR(vProg);
+	PredecodedCore core;
+	core.Init(pFast);
+
+	int iStock = cpu_Running, iFast = cpu_Running;
+	while (iStock == cpu_Running && pStock->cycle < LIMIT)
+	{
+		iStock = avr_run(pStock);
+	}
+	while (iFast == cpu_Running && pFast->cycle < LIMIT)
+	{
+		iFast = core.Run(pFast);
+	}
+	REQUIRE(iStock == cpu_Done);
+	REQUIRE(iFast == iStock);
+	REQUIRE(pFast->cycle == pStock->cycle);
+	REQUIRE(pFast->pc == pStock->pc);
+	REQUIRE(std::equal(pFast->sreg, pFast->sreg + 8, pStock->sreg)); //NOLINT - sreg is a raw array
+	REQUIRE(std::equal(pFast->data, pFast->data + pFast->ramend + 1, pStock->data)); //NOLINT - data is a raw buffer
+	REQUIRE(core.GetFastCount() > 10U*core.GetSlowCount());
+	avr_terminate(pStock);
+	avr_terminate(pFast);
+}
+
+// Fast-forwarding a busy-wait must end in the same state, with a timer firing at the same cycles,
+// while the core itself only runs a small fraction of the loop.
+TEST_CASE("Internal_FastForward") {
+	// ldi r24,0xFF; ldi r25,0x7F; sbiw r24,1; brne .-4; ldi r16,200; dec r16; brne .-4; cli; sleep
+	std::vector<uint16_t> vProg {0xEF8F, 0xE79F, 0x9701, 0xF7F1, 0xEC08, 0x950A, 0xF7F1, 0x94F8, 0x9588};
+	avr_t *pStock = MakePredecodeTestAVR(vProg);
+	avr_t *pFast = MakePredecodeTestAVR(vProg);
+	// Batches end at each timer, i.e. part way through the loop body.
+	auto fcnTimer = [](avr_t *avr, avr_cycle_count_t when, void *param)
+	{
+		static_cast<std::vector<avr_cycle_count_t>*>(param)->push_back(avr->cycle);
+		return when + 997U;
+	};
+	std::vector<avr_cycle_count_t> vStockFired, vFastFired;
+	avr_cycle_timer_register(pStock, 997, fcnTimer, &vStockFired);
+	avr_cycle_timer_register(pFast, 997, fcnTimer, &vFastFired);
+	FastForward ff;
+	ff.Init(pFast);
+
+	int iStock = cpu_Running, iFast = cpu_Running;
+	while (iStock == cpu_Running)
+	{
+		iStock = avr_run(pStock);
+	}
+	while (iFast == cpu_Running)
+	{
+		iFast = ff.OnStep(pFast);
+		if (iFast == cpu_Running)
+		{
+			iFast = avr_run(pFast);
+		}
+	}
+	REQUIRE(iStock == cpu_Done);
+	REQUIRE(iFast == iStock);
+	REQUIRE(pFast->cycle == pStock->cycle);
+	REQUIRE(pFast->pc == pStock->pc);
+	REQUIRE(std::equal(pFast->sreg, pFast->sreg + 8, pStock->sreg)); //NOLINT - sreg is a raw array
+	REQUIRE(std::equal(pFast->data, pFast->data + pFast->ramend + 1, pStock->data)); //NOLINT - data is a raw buffer
+	REQUIRE(vFastFired == vStockFired);
+	REQUIRE(ff.GetSkippedCycles() > (pFast->cycle*9U)/10U);
+	avr_terminate(pStock);
+	avr_terminate(pFast);
+}
+
+TEST_CASE("Internal_FirmwareProfiler") {
+	// main: nop; nop; rcall spin; rjmp .-4; nop
+	// spin: ldi r24,0xFF; dec r24; brne .-4; ret
+	avr_t *avr = MakePredecodeTestAVR({0x0000, 0x0000, 0xD002, 0xCFFE, 0x0000, 0xEF8F, 0x958A, 0xF7F1, 0x9508});
+	{
+		FirmwareProfiler prof;
+		prof.AddSymbol(10, 8, "spin");
+		prof.AddSymbol(0, 10, "main");
+		prof.Init(avr, 997);
+		while (avr->cycle < 500000)
+		{
+			avr_run(avr);
+		}
+		// Sampling carries on through a reset.
+		avr_reset(avr);
+		avr_cycle_count_t uiEnd = avr->cycle + 500000;
+		while (avr->cycle < uiEnd)
+		{
+			avr_run(avr);
+		}
+		prof.Write("Internal_FirmwareProfiler");
+	}
+	std::ifstream fsIn("Internal_FirmwareProfiler.folded");
+	std::map<std::string, unsigned int> mStacks;
+	std::string strStack;
+	unsigned int uiCount = 0, uiTotal = 0;
+	while (fsIn >> strStack >> uiCount)
+	{
+		mStacks[strStack] = uiCount;
+		uiTotal += uiCount;
+	}
+	REQUIRE(uiTotal >= 990);
+	REQUIRE(mStacks.size() <= 2);
+	REQUIRE(mStacks["main;spin"] > 950);
+	std::remove("Internal_FirmwareProfiler.folded");
+	std::remove("Internal_FirmwareProfiler.txt");
+	avr_terminate(avr);
+}
+
+// Not part of the normal run, use: MK404_tests "[.benchmark]"
+TEST_CASE("Internal_PredecodedCore_Speed", "[.benchmark]") {
+	std::vector<uint16_t> vProg = PredecodeTestProgram(0xFFFF);
+	using Clock = std::chrono::steady_clock;
+	auto fcnMHz = [](avr_t *avr, Clock::time_point tStart)
+	{
+		return static_cast<double>(avr->cycle)/std::chrono::duration<double, std::micro>(Clock::now() - tStart).count();
+	};
+
+	avr_t *avr = MakePredecodeTestAVR(vProg);
+	auto tStart = Clock::now();
+	while (avr_run(avr) == cpu_Running) {};
+	double dStock = fcnMHz(avr, tStart);
+	avr_terminate(avr);
+
+	avr = MakePredecodeTestAVR(vProg);
+	PredecodedCore core;
+	core.Init(avr);
+	tStart = Clock::now();
+	while (core.Run(avr) == cpu_Running) {};
+	double dFast = fcnMHz(avr, tStart);
+	avr_terminate(avr);
+
+	std::cout << "Stock interpreter: " << dStock << " MHz simulated\n";
+	std::cout << "Predecoded core: " << dFast << " MHz simulated (" << dFast/dStock << "x)\n";
+}
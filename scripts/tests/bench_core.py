@@ -0,0 +1,67 @@
+#!/usr/bin/python3
+
+# A/B benchmark of the AVR instruction engines, --core stock against --core predecoded, on
+# script tests - by default the MK3S boot and the MK3S SD print. Runs use the same sandboxes
+# as run_parallel.py but go one at a time so they don't compete for the CPU.
+# Throughput is the simulated MHz of each board's AVR thread (cycles over the wall time
+# spent in its run loop), so GL and startup time don't water it down.
+#
+# Usage (from the build directory, after ctest has set up the firmware, SD image and EEPROM):
+#   ../scripts/tests/bench_core.py [-n runs] [-R regex]
+
+import argparse
+import os
+import re
+import shutil
+import statistics
+import sys
+from run_parallel import list_tests, run_test, SANDBOX
+
+RUN = re.compile(r'^(\S+): ran (\d+) cycles \(\d+ ms simulated\) in (\d+) ms', re.MULTILINE)
+CORES = ('stock', 'predecoded')
+
+# Appended, so the printer stays the first bare argument after ./MK404 (run_parallel's sandbox relies on it).
+def with_core(command, core):
+	return command + ['--core', core]
+
+def main():
+	parser = argparse.ArgumentParser(description='Compare the MK404 AVR instruction engines.')
+	parser.add_argument('-n', '--runs', type=int, default=3, help='Runs per test and engine (the median is reported)')
+	parser.add_argument('-R', '--regex', default=r'^(ext1_MK3S_Boot|ext2_Print)$', help='Tests to run (ctest names)')
+	parser.add_argument('-t', '--timeout', type=int, default=600, help='Per-run timeout, seconds')
+	parser.add_argument('-B', '--build-dir', default='.', help='ctest build directory')
+	args = parser.parse_args()
+
+	root = os.path.abspath(args.build_dir)
+	tests = [t for t in list_tests(root, args.regex) if './MK404' in t[1]]
+	if not tests:
+		print('No tests match ' + args.regex)
+		return 1
+	base = os.path.join(root, SANDBOX)
+	shutil.rmtree(base, ignore_errors=True)
+	os.makedirs(base)
+	parent = os.path.dirname(root)
+	for entry in os.listdir(parent):
+		os.symlink(os.path.join(parent, entry), os.path.join(base, entry))
+
+	print('{:<24} {:<11} {:>9} {:>9} {:>8}'.format('Test', 'Core', 'Wall s', 'MHz', 'Speedup'))
+	for name, command, cwd in tests:
+		stock_mhz = None
+		for core in CORES:
+			walls, mhz = [], []
+			for run in range(args.runs):
+				_, code, wall, _, output = run_test(root, '{}_{}_{}'.format(name, core, run), with_core(command, core), cwd, args.timeout)
+				if code != 0:
+					print('{} failed with --core {}:\n{}'.format(name, core, output))
+					return 1
+				# The busiest board is the printer; an MMU or other second board rides along.
+				_, cycles, ms = max(((b, int(c), int(m)) for b, c, m in RUN.findall(output)), key=lambda r: r[1])
+				walls.append(wall)
+				mhz.append(cycles / max(ms, 1) / 1000.0)
+			med = statistics.median(mhz)
+			stock_mhz = stock_mhz or med
+			print('{:<24} {:<11} {:9.2f} {:9.2f} {:7.2f}x'.format(name, core, statistics.median(walls), med, med / stock_mhz))
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main())
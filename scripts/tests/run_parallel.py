@@ -0,0 +1,170 @@
+#!/usr/bin/python3
+
+# Runs the script tests registered with ctest on a pool of workers, each in its own
+# sandbox directory so storage files (flash, EEPROM, SD images) and snapshots can't collide.
+# Writes a JUnit XML report with the wall time and simulated cycles of every test.
+#
+# Usage (from the build directory, after the firmwares and SD images exist):
+#   ../scripts/tests/run_parallel.py [-j N] [-R regex] [-o results.xml]
+
+import argparse
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import time
+import xml.etree.ElementTree as ET
+from concurrent.futures import ThreadPoolExecutor
+
+# Files the boards read and write. These are copied into each sandbox, everything else is linked.
+STORAGE_EXT = re.compile(r'\.(bin|bin_test|img|vcd)$')
+CYCLES = re.compile(r'^(\S+): ran (\d+) cycles \((\d+) ms simulated\)', re.MULTILINE)
+SANDBOX = '_parallel'
+# MK404 options that take a value (see MK404.cpp), so their values aren't mistaken for the printer.
+VALUE_OPTS = {'-t', '--trace', '-p', '--softPWM', '-g', '--graphics', '-f', '--firmware', '-F', '--firmware2',
+			  '--tracerate', '--telemetry-socket', '--pos-rate', '--hotend-lag', '--profile-fw', '--stats',
+			  '--record', '--replay', '--sdimage', '--script', '--lcd-scheme', '--mmu', '--core', '--image-size',
+			  '--sd-overlay', '--sd-add', '--extrusion', '--bootloader-file'}
+DEFAULT_PRINTER = 'Prusa_MK3S'
+
+def list_tests(build_dir, pattern):
+	out = subprocess.run(['ctest', '--show-only=json-v1'], cwd=build_dir,
+						 stdout=subprocess.PIPE, check=True, universal_newlines=True).stdout
+	tests = []
+	for test in json.loads(out)['tests']:
+		if not re.search(pattern, test['name']) or 'command' not in test:
+			continue
+		cwd = build_dir
+		for prop in test.get('properties', []):
+			if prop['name'] == 'WORKING_DIRECTORY':
+				cwd = prop['value']
+		tests.append((test['name'], test['command'], cwd))
+	return tests
+
+def copy_storage(src, dst):
+	# SD images are mostly holes, keep them that way.
+	subprocess.run(['cp', '--sparse=always', '--reflink=auto', src, dst], check=True)
+
+def find_printer(command):
+	# The printer is MK404's only positional argument, its default storage files share its name.
+	if './MK404' not in command:
+		return None
+	args = command[command.index('./MK404')+1:]
+	i = 0
+	while i < len(args):
+		if args[i] in VALUE_OPTS:
+			i += 2
+		elif args[i].startswith('-'):
+			i += 1
+		else:
+			return args[i]
+	return DEFAULT_PRINTER
+
+def make_sandbox(root, name, command, cwd):
+	# The sandbox stands in for the test's working directory, with a parent that
+	# mirrors the real one so ../scripts and ../assets resolve as usual.
+	box = os.path.join(root, SANDBOX, name)
+	os.makedirs(box)
+	text = ' '.join(command)
+	for arg in command:
+		if arg.endswith('.txt') and os.path.isfile(os.path.join(cwd, arg)):
+			with open(os.path.join(cwd, arg)) as script:
+				text += script.read()
+	printer = find_printer(command)
+	for entry in os.listdir(cwd):
+		src = os.path.join(cwd, entry)
+		dst = os.path.join(box, entry)
+		if entry == 'tests' and os.path.isdir(src):
+			os.makedirs(os.path.join(dst, 'snaps'))
+			for sub in os.listdir(src):
+				if sub != 'snaps':
+					os.symlink(os.path.join(src, sub), os.path.join(dst, sub))
+		elif STORAGE_EXT.search(entry) and os.path.isfile(src):
+			if entry in text or (printer and entry.startswith(printer + '_')):
+				copy_storage(src, dst)
+		elif not entry.startswith(SANDBOX):
+			os.symlink(src, dst)
+	return box
+
+def run_test(root, name, command, cwd, timeout):
+	box = make_sandbox(root, name, command, cwd)
+	start = time.monotonic()
+	try:
+		proc = subprocess.run(command, cwd=box, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+							  universal_newlines=True, errors='replace', timeout=timeout)
+		output, code = proc.stdout, proc.returncode
+	except subprocess.TimeoutExpired as e:
+		output = e.stdout.decode(errors='replace') if isinstance(e.stdout, bytes) else (e.stdout or '')
+		output, code = output + '\n*** Timed out ***\n', None
+	wall = time.monotonic() - start
+	# Snapshots go back where the image comparison tests expect them.
+	snaps = os.path.join(box, 'tests', 'snaps')
+	if os.path.isdir(snaps):
+		dest = os.path.join(cwd, 'tests', 'snaps')
+		os.makedirs(dest, exist_ok=True)
+		for snap in os.listdir(snaps):
+			shutil.copy(os.path.join(snaps, snap), dest)
+	cycles = {board: (int(c), int(ms)) for board, c, ms in CYCLES.findall(output)}
+	return name, code, wall, cycles, output
+
+def write_junit(path, results, wall):
+	suite = ET.Element('testsuite', name='MK404', tests=str(len(results)),
+					   failures=str(sum(1 for r in results if r[1] != 0)), time='{:.3f}'.format(wall))
+	for name, code, secs, cycles, output in results:
+		case = ET.SubElement(suite, 'testcase', classname=name.split('_')[0], name=name, time='{:.3f}'.format(secs))
+		props = ET.SubElement(case, 'properties')
+		for board, (count, ms) in sorted(cycles.items()):
+			ET.SubElement(props, 'property', name=board + '.cycles', value=str(count))
+			ET.SubElement(props, 'property', name=board + '.sim_ms', value=str(ms))
+		if code != 0:
+			msg = 'timed out' if code is None else 'exit code {}'.format(code)
+			ET.SubElement(case, 'failure', message=msg)
+		ET.SubElement(case, 'system-out').text = output
+	ET.ElementTree(suite).write(path, encoding='utf-8', xml_declaration=True)
+
+def main():
+	parser = argparse.ArgumentParser(description='Run MK404 script tests in parallel.')
+	parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count(), help='Number of tests to run at once')
+	parser.add_argument('-R', '--regex', default=r'^(parts|ext1)_(?!Image_compare)', help='Tests to run (ctest names)')
+	parser.add_argument('-o', '--output', default='parallel_results.xml', help='JUnit XML report')
+	parser.add_argument('-t', '--timeout', type=int, default=600, help='Per-test timeout, seconds')
+	parser.add_argument('-B', '--build-dir', default='.', help='ctest build directory')
+	args = parser.parse_args()
+
+	root = os.path.abspath(args.build_dir)
+	tests = list_tests(root, args.regex)
+	if not tests:
+		print('No tests match ' + args.regex)
+		return 1
+	base = os.path.join(root, SANDBOX)
+	shutil.rmtree(base, ignore_errors=True)
+	os.makedirs(base)
+	parent = os.path.dirname(root)
+	for entry in os.listdir(parent):
+		os.symlink(os.path.join(parent, entry), os.path.join(base, entry))
+	print('Running {} tests on {} workers'.format(len(tests), args.jobs))
+	start = time.monotonic()
+	results = []
+	with ThreadPoolExecutor(max_workers=args.jobs) as pool:
+		jobs = [pool.submit(run_test, root, name, cmd, cwd, args.timeout) for name, cmd, cwd in tests]
+		for job in jobs:
+			name, code, wall, cycles, output = job.result()
+			results.append((name, code, wall, cycles, output))
+			total = sum(c for c, _ in cycles.values())
+			status = 'Passed' if code == 0 else 'FAILED'
+			print('{:<32} {:>7} {:8.2f} s {:>14} cycles'.format(name, status, wall, total))
+	wall = time.monotonic() - start
+	write_junit(os.path.join(root, args.output), results, wall)
+	failed = [r[0] for r in results if r[1] != 0]
+	print('{} of {} passed in {:.1f} s, report in {}'.format(len(results)-len(failed), len(results), wall, args.output))
+	# What the same tests cost one after the other, as ctest runs them, against the pool's wall time.
+	serial = sum(r[2] for r in results)
+	print('{:.1f} s of test time in {:.1f} s on {} workers ({:.1f}x)'.format(serial, wall, args.jobs, serial / max(wall, 0.001)))
+	for name in failed:
+		print('  FAILED: ' + name)
+	return 1 if failed else 0
+
+if __name__ == '__main__':
+	sys.exit(main())
@@ -70,6 +70,10 @@ int main()
 
 	printf("G4 T3\n");
 
+	printf("N5 G1 X10*84\n");
+
+	printf("N6 G1 X1*0\n");
+
 	while(1){};
 
 	cli();
@@ -0,0 +1,108 @@
+/*
+	test_PrintHost.c
+
+	Acts as a firmware with a two line command queue for the print host: lines are
+	checked for line number and checksum and acknowledged with "ok". The first
+	time line 3 arrives it is rejected so the host has to resend it.
+	M999 prints the number of accepted lines.
+ */
+
+#include <avr/io.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/delay.h>
+
+#include "avr_mcu_section.h"
+AVR_MCU(16000000, "atmega2560");
+
+static int uart_putchar(char c, FILE *stream)
+{
+	loop_until_bit_is_set(UCSR0A, UDRE0);
+	UDR0 = c;
+	return 0;
+}
+static FILE mystdout = FDEV_SETUP_STREAM(uart_putchar, NULL,
+                                         _FDEV_SETUP_WRITE);
+
+#define LINES 2
+#define LINE_LEN 64
+char queue[LINES][LINE_LEN];
+volatile uint8_t head = 0, tail = 0, pos = 0;
+
+void USART_init(void)
+{
+    #define BAUD_PRESCALER (((F_CPU / (115200 * 16UL))) - 1)
+    UBRR0 = BAUD_PRESCALER;         // Set the baud rate prescale rate register
+	UCSR0C = ((0<<USBS0)|(1 << UCSZ01)|(1<<UCSZ00));   // Set frame format: 8data, 1 stop bit. See Table 22-7 for details
+	UCSR0B = ((1<<RXEN0)|(1<<TXEN0)|(1 << RXCIE0));       // Enable receiver and transmitter
+}
+
+ISR(USART0_RX_vect)
+{
+	char c = UDR0;
+	if (c == '\n')
+	{
+		queue[head][pos] = '\0';
+		head = (head + 1) % LINES;
+		pos = 0;
+	}
+	else if (pos < LINE_LEN - 1)
+	{
+		queue[head][pos++] = c;
+	}
+}
+
+int main()
+{
+	stdout = &mystdout;
+	USART_init();
+	sei();
+
+	printf("READY\n");
+
+	long last = 0;
+	uint8_t accepted = 0, rejected = 0;
+	while (1)
+	{
+		if (head == tail)
+		{
+			continue;
+		}
+		char *line = queue[tail];
+		if (line[0] == 'N')
+		{
+			char *star = strchr(line, '*');
+			uint8_t sum = 0;
+			for (char *p = line; p != star && *p; p++)
+			{
+				sum ^= *p;
+			}
+			long n = strtol(line + 1, NULL, 10);
+			if (!star || sum != atoi(star + 1) || n != last + 1 || (n == 3 && !rejected))
+			{
+				rejected = 1;
+				printf("Error:checksum mismatch, Last Line: %ld\nResend: %ld\nok\n", last, last + 1);
+				tail = (tail + 1) % LINES;
+				continue;
+			}
+			last = n;
+		}
+		else if (strncmp(line, "M110", 4) == 0)
+		{
+			last = 0;
+		}
+		else if (strncmp(line, "M999", 4) == 0)
+		{
+			printf("DONE %u\n", accepted);
+			tail = (tail + 1) % LINES;
+			continue;
+		}
+		accepted++;
+		_delay_ms(1); // "Execute" it.
+		printf("ok\n");
+		tail = (tail + 1) % LINES;
+	};
+}
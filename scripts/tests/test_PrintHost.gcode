@@ -0,0 +1,8 @@
+; Streamed by test_PrintHost.txt
+G28 ; home
+G1 X10 Y10 F3000
+
+  G1 X20
+G1 X30
+G1 X40
+M400
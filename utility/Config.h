@@ -23,6 +23,7 @@
 
 #include "EnabledType.h"
 #include "PrintVisualType.h"
+#include <cstdint>
 
 class Config
 {
@@ -64,6 +65,50 @@ class Config
 		inline void SetGDB2(bool bVal){ m_bGDB2 = bVal;}
 		inline const bool GetGDB2(){ return m_bGDB2;}
 
+		// Unix socket path for live telemetry streaming. Empty if disabled.
+		inline void SetTelemetrySocket(std::string strPath){ m_strTelSocket = std::move(strPath);}
+		inline const std::string& GetTelemetrySocket(){ return m_strTelSocket;}
+
+		// Firmware sampling profiler period in cycles, 0 if disabled.
+		inline void SetProfileRate(uint32_t uiVal){ m_uiProfileRate = uiVal;}
+		inline uint32_t GetProfileRate(){ return m_uiProfileRate;}
+
+		// Interrupt latency/duration tracking
+		inline void SetISRStats(bool bVal){ m_bISRStats = bVal;}
+		inline bool GetISRStats(){ return m_bISRStats;}
+
+		// Rate (Hz, simulated time) of the coalesced stepper position outputs used by visuals. 0 = every step.
+		inline void SetPosPublishRate(uint32_t uiVal){ m_uiPosRate = uiVal;}
+		inline uint32_t GetPosPublishRate(){ return m_uiPosRate;}
+
+		// Time constant (s) of the hotend thermistor lagging the heater block, 0 for none.
+		inline void SetHotendLag(float fVal){ m_fHotendLag = fVal;}
+		inline float GetHotendLag(){ return m_fHotendLag;}
+
+		// Skip AVR sleep and counted delay loops ahead to the next event instead of running them in (real) time.
+		inline void SetFastForward(bool bVal){ m_bFastFwd = bVal;}
+		inline bool GetFastForward(){ return m_bFastFwd;}
+
+		// Mount SD images copy-on-write: the image is shared read-only and writes stay in memory.
+		inline void SetSDOverlay(bool bVal){ m_bSDOverlay = bVal;}
+		inline bool GetSDOverlay(){ return m_bSDOverlay;}
+
+		// Write the overlay's changes back to the image at unmount instead of discarding them.
+		inline void SetSDOverlayCommit(bool bVal){ m_bSDCommit = bVal;}
+		inline bool GetSDOverlayCommit(){ return m_bSDCommit;}
+
+		// Draw the 3D printer meshes through GLRenderer instead of fixed-function calls.
+		inline void SetShaderRender(bool bVal){ m_bShaderRender = bVal;}
+		inline bool GetShaderRender(){ return m_bShaderRender;}
+
+		// Use the behavioural MMU2 model instead of running MM-control-01 firmware.
+		inline void SetMMUFast(bool bVal){ m_bMMUFast = bVal;}
+		inline bool GetMMUFast(){ return m_bMMUFast;}
+
+		// Run the AVR from a pre-decoded instruction table (PredecodedCore) instead of simavr's interpreter.
+		inline void SetPredecode(bool bVal){ m_bPredecode = bVal;}
+		inline bool GetPredecode(){ return m_bPredecode;}
+
 	private:
 		unsigned int m_iExtrusion = false;
 		bool m_bColorExtrusion = false;
@@ -73,4 +118,15 @@ class Config
 		std::string m_strSecFW = "MM-control-01.hex";
 		EnabledType::Type_t m_SoftPWM = EnabledType::Type_t::NotSet;
 		bool m_bGDB2 = false;
+		std::string m_strTelSocket;
+		uint32_t m_uiProfileRate = 0;
+		bool m_bISRStats = false;
+		uint32_t m_uiPosRate = 100;
+		float m_fHotendLag = 0;
+		bool m_bFastFwd = false;
+		bool m_bSDOverlay = false;
+		bool m_bSDCommit = false;
+		bool m_bShaderRender = false;
+		bool m_bMMUFast = false;
+		bool m_bPredecode = false;
 };
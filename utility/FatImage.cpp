@@ -22,11 +22,19 @@
  */
 
 #include "FatImage.h"
+#include "MappedFile.h"
 #include "gsl-lite.hpp"
+#include <algorithm>    // for min, find, fill, copy
+#include <array>
+#include <cctype>       // for isalnum, toupper, islower
 #include <cstdint>      // for perror
 #include <cstring>
+#include <ctime>        // for time, localtime
 #include <fstream> // IWYU pragma: keep
 #include <iostream>
+#include <iterator>     // for istreambuf_iterator
+#include <sys/stat.h>   // for stat
+#include <unistd.h>     // for truncate
 #include <vector>       // for vector
 
 // const map<FatImage::Size, uint32_t>FatImage::SectorsPerFat =
@@ -138,7 +146,7 @@ bool FatImage::MakeFatImage(const std::string &strFile, const std::string &strSi
 	FatImage::Size size = GetNameToSize().at(strSize);
 	uint32_t uiSize = GetSizeInBytes(size);
 
-	std::ofstream fsOut(strFile, fsOut.binary);
+	std::ofstream fsOut(strFile, fsOut.binary | fsOut.trunc);
 	if (!fsOut.is_open())
 	{
 		std::cerr << "Failed to open output file\n";
@@ -187,40 +195,358 @@ bool FatImage::MakeFatImage(const std::string &strFile, const std::string &strSi
 	data.resize(0x3FE);
 	data.insert(data.end(), FSInfo_3.begin(), FSInfo_3.end());
 
+	// Only the metadata is written, everything in between stays a hole in the file.
+	auto fcnWriteAt = [&fsOut](uint32_t uiAddr, gsl::span<const uint8_t> bytes)
+	{
+		fsOut.seekp(uiAddr);
+		fsOut.write(reinterpret_cast<const char*>(bytes.data()),bytes.size()); //NOLINT - my kingdom for an unsigned char fstream...
+	};
 
+	fcnWriteAt(0, data);
 	// Second copy of boot record @ 0xC00
-	data.resize(0xC00);
-	data.insert(data.end(), data.begin(), data.begin()+0x200);
+	fcnWriteAt(0xC00, gsl::span<const uint8_t>(data).first(0x200));
 
-	gsl::span<const uint8_t> FATHeader (_FATHeader);
 	// Copy fat header(s)
-	data.resize(FirstFATAddr);
-	data.insert(data.end(), FATHeader.begin(), FATHeader.end());
-
-	data.resize(GetSecondFatAddr(size));
-	data.insert(data.end(), FATHeader.begin(), FATHeader.end());
+	fcnWriteAt(FirstFATAddr, _FATHeader);
+	fcnWriteAt(GetSecondFatAddr(size), _FATHeader);
 
 	// Data start.
-	gsl::span<const uint8_t> DataRegion (_DataRegion);
-	data.resize(GetDataStartAddr(size));
-	data.insert(data.end(), DataRegion.begin(), DataRegion.end());
+	fcnWriteAt(GetDataStartAddr(size), _DataRegion);
+
+	fsOut.close();
+	if(!fsOut || truncate(strFile.c_str(), uiSize) != 0)
+	{
+		std::cerr << "Failed to write full file to disk...\n";
+		return false;
+	}
+	std::cout << "Wrote " << uiSize << " byte SD image.\n";
+	return true;
+}
+
+// Little-endian fields, wherever they fall.
+static uint32_t Get32(gsl::span<const uint8_t> data, size_t uiOffset)
+{
+	auto b = data.subspan(uiOffset, 4);
+	return b[0] | (b[1]<<8U) | (b[2]<<16U) | (static_cast<uint32_t>(b[3])<<24U);
+}
 
-	fsOut.write(reinterpret_cast<char*>(data.data()),data.size()); //NOLINT - my kingdom for an unsigned char fstream...
+static uint16_t Get16(gsl::span<const uint8_t> data, size_t uiOffset)
+{
+	auto b = data.subspan(uiOffset, 2);
+	return b[0] | (b[1]<<8U);
+}
 
-	fsOut.seekp(uiSize-1);
-	fsOut.put(0);
-	if(!fsOut)
+static void Set32(gsl::span<uint8_t> data, size_t uiOffset, uint32_t uiVal)
+{
+	auto b = data.subspan(uiOffset, 4);
+	for (auto &c : b)
 	{
-		std::cerr << "Failed to write full file to disk... " <<fsOut.tellp() << '\n';
-		fsOut.close();
+		c = uiVal & 0xFFU;
+		uiVal >>= 8U;
+	}
+}
+
+static void Set16(gsl::span<uint8_t> data, size_t uiOffset, uint16_t uiVal)
+{
+	data.subspan(uiOffset, 2)[0] = uiVal & 0xFFU;
+	data.subspan(uiOffset, 2)[1] = uiVal >> 8U;
+}
+
+// Long names are UTF-16; host names are taken as UTF-8. False if strIn isn't valid UTF-8.
+static bool Utf8ToUtf16(const std::string &strIn, std::vector<uint16_t> &vOut)
+{
+	vOut.clear();
+	for (size_t i = 0; i < strIn.size();)
+	{
+		auto uiLead = static_cast<uint8_t>(strIn[i]);
+		size_t uiLen = uiLead < 0x80U ? 1 : (uiLead & 0xE0U) == 0xC0U ? 2 : (uiLead & 0xF0U) == 0xE0U ? 3 : (uiLead & 0xF8U) == 0xF0U ? 4 : 0;
+		if (uiLen == 0 || i + uiLen > strIn.size())
+		{
+			return false;
+		}
+		uint32_t uiCode = uiLen == 1 ? uiLead : uiLead & (0x7FU >> uiLen);
+		for (size_t j = 1; j < uiLen; j++)
+		{
+			auto uiNext = static_cast<uint8_t>(strIn[i + j]);
+			if ((uiNext & 0xC0U) != 0x80U)
+			{
+				return false;
+			}
+			uiCode = (uiCode << 6U) | (uiNext & 0x3FU);
+		}
+		// Overlong forms, surrogates and anything past U+10FFFF are not UTF-8.
+		static const std::array<uint32_t, 5> aMin {0, 0, 0x80, 0x800, 0x10000};
+		if (uiCode < gsl::at(aMin, uiLen) || uiCode > 0x10FFFFU || (uiCode >= 0xD800U && uiCode <= 0xDFFFU))
+		{
+			return false;
+		}
+		if (uiCode >= 0x10000U)
+		{
+			uiCode -= 0x10000U;
+			vOut.push_back(0xD800U | (uiCode >> 10U));
+			vOut.push_back(0xDC00U | (uiCode & 0x3FFU));
+		}
+		else
+		{
+			vOut.push_back(uiCode);
+		}
+		i += uiLen;
+	}
+	return true;
+}
+
+uint8_t FatImage::ShortNameChecksum(const std::string &strShort)
+{
+	uint8_t uiSum = 0;
+	for (auto c : strShort)
+	{
+		uiSum = ((uiSum & 1U) << 7U) + (uiSum >> 1U) + static_cast<uint8_t>(c);
+	}
+	return uiSum;
+}
+
+std::string FatImage::MakeShortName(const std::string &strName, const std::vector<std::string> &vUsed, bool &bLossy)
+{
+	auto fcnClean = [&bLossy](const std::string &strIn)
+	{
+		std::string strOut;
+		for (auto c : strIn)
+		{
+			if (std::isalnum(static_cast<unsigned char>(c)) || std::strchr("!#$%&'()-@^_`{}~", c) != nullptr)
+			{
+				strOut.push_back(std::toupper(static_cast<unsigned char>(c)));
+				bLossy |= std::islower(static_cast<unsigned char>(c));
+			}
+			else
+			{
+				bLossy |= (c != ' ');
+			}
+		}
+		return strOut;
+	};
+	bLossy = false;
+	auto uiDot = strName.find_last_of('.');
+	std::string strBase = fcnClean(strName.substr(0, uiDot));
+	std::string strExt = uiDot == std::string::npos ? "" : fcnClean(strName.substr(uiDot+1));
+	bLossy |= strBase.size() > 8 || strExt.size() > 3 || strName.find('.') != uiDot || strBase.empty();
+	strExt = strExt.substr(0,3);
+	strExt.resize(3, ' ');
+	if (!bLossy)
+	{
+		strBase.resize(8, ' ');
+		return strBase + strExt;
+	}
+	// Numeric tail, as DOS would do it: FILENA~1.GCO
+	for (unsigned int i = 1; i < 1000000; i++)
+	{
+		std::string strTail = "~" + std::to_string(i);
+		std::string strShort = strBase.substr(0, 8 - strTail.size()) + strTail;
+		strShort.resize(8, ' ');
+		strShort += strExt;
+		if (std::find(vUsed.begin(), vUsed.end(), strShort) == vUsed.end())
+		{
+			return strShort;
+		}
+	}
+	return "";
+}
+
+bool FatImage::AddFile(const std::string &strImage, const std::string &strHostFile)
+{
+	struct stat stat_buf {};
+	MappedFile img;
+	if (stat(strImage.c_str(), &stat_buf) != 0 || stat_buf.st_size == 0 || !img.Map(strImage, stat_buf.st_size) || img.IsPrivate())
+	{
+		std::cerr << "Could not open SD image " << strImage << " for writing\n";
 		return false;
 	}
-	else
+	return AddFile(img.GetData(), strHostFile);
+}
+
+bool FatImage::AddFile(gsl::span<uint8_t> image, const std::string &strHostFile)
+{
+	std::ifstream fsIn(strHostFile, fsIn.binary);
+	if (!fsIn.is_open())
 	{
-		std::cout << "Wrote " << fsOut.tellp() << " bytes to SD image.";
+		std::cerr << "Could not open " << strHostFile << '\n';
+		return false;
+	}
+	std::vector<uint8_t> vFile {std::istreambuf_iterator<char>(fsIn), std::istreambuf_iterator<char>()};
+	std::string strName = strHostFile.substr(strHostFile.find_last_of('/') + 1);
+	std::vector<uint16_t> vLongName;
+	if (!Utf8ToUtf16(strName, vLongName))
+	{
+		std::cerr << "File name " << strName << " is not valid UTF-8\n";
+		return false;
 	}
 
+	// Geometry from the BPB.
+	if (image.size() < 0x200 || Get16(image, 0x1FE) != 0xAA55U || Get16(image, 0x16) != 0 || Get32(image, 0x24) == 0)
+	{
+		std::cerr << "SD image is not FAT32\n";
+		return false;
+	}
+	uint32_t uiBPS = Get16(image, 0x0B);
+	uint32_t uiClusterBytes = uiBPS * image[0x0D];
+	uint32_t uiFATBytes = Get32(image, 0x24) * uiBPS;
+	uint32_t uiFATStart = Get16(image, 0x0E) * uiBPS;
+	uint8_t uiFATs = image[0x10];
+	size_t uiDataStart = uiFATStart + (static_cast<size_t>(uiFATs) * uiFATBytes);
+	if (uiClusterBytes == 0 || uiDataStart >= image.size())
+	{
+		std::cerr << "SD image has a bad FAT32 layout\n";
+		return false;
+	}
+	uint32_t uiClusters = std::min<size_t>(uiFATBytes/4, ((image.size() - uiDataStart)/uiClusterBytes) + 2);
 
-	fsOut.close();
+	auto fcnGetFAT = [&](uint32_t uiCl) { return Get32(image, uiFATStart + (uiCl*4U)) & 0x0FFFFFFFU; };
+	auto fcnSetFAT = [&](uint32_t uiCl, uint32_t uiVal)
+	{
+		for (unsigned int i = 0; i < uiFATs; i++)
+		{
+			Set32(image, uiFATStart + (i*uiFATBytes) + (uiCl*4U), uiVal);
+		}
+	};
+	auto fcnCluster = [&](uint32_t uiCl) { return image.subspan(uiDataStart + (static_cast<size_t>(uiCl - 2) * uiClusterBytes), uiClusterBytes); };
+	uint32_t uiNextFree = 2;
+	// Takes the next free cluster and appends it to the chain ending at uiPrev (if any).
+	auto fcnAlloc = [&](uint32_t uiPrev) -> uint32_t
+	{
+		while (uiNextFree < uiClusters && fcnGetFAT(uiNextFree) != 0)
+		{
+			uiNextFree++;
+		}
+		if (uiNextFree >= uiClusters)
+		{
+			return 0;
+		}
+		fcnSetFAT(uiNextFree, 0x0FFFFFFFU);
+		if (uiPrev != 0)
+		{
+			fcnSetFAT(uiPrev, uiNextFree);
+		}
+		return uiNextFree++;
+	};
+
+	// Walk the root directory for its slots, names in use and a free run long enough for us.
+	std::vector<size_t> vSlots;
+	std::vector<std::string> vUsed;
+	uint32_t uiCl = Get32(image, 0x2C), uiLast = 0;
+	while (uiCl >= 2 && uiCl < uiClusters && uiCl != uiLast)
+	{
+		size_t uiBase = uiDataStart + (static_cast<size_t>(uiCl - 2) * uiClusterBytes);
+		for (size_t i = 0; i < uiClusterBytes; i += 32)
+		{
+			vSlots.push_back(uiBase + i);
+			auto entry = image.subspan(uiBase + i, 32);
+			if (entry[0] != 0 && entry[0] != 0xE5U && entry[11] != 0x0FU)
+			{
+				vUsed.emplace_back(entry.begin(), entry.begin() + 11);
+			}
+		}
+		uiLast = uiCl;
+		uiCl = fcnGetFAT(uiCl);
+	}
+	if (vSlots.empty())
+	{
+		std::cerr << "SD image has no root directory\n";
+		return false;
+	}
+
+	bool bLossy = false;
+	std::string strShort = MakeShortName(strName, vUsed, bLossy);
+	if (strShort.empty() || (!bLossy && std::find(vUsed.begin(), vUsed.end(), strShort) != vUsed.end()))
+	{
+		std::cerr << "SD image already has a file named " << strName << '\n';
+		return false;
+	}
+	size_t uiLFN = bLossy ? (vLongName.size() + 12)/13 : 0;
+
+	size_t uiRun = 0, uiFirst = 0;
+	for (size_t i = 0; i < vSlots.size() && uiRun <= uiLFN; i++)
+	{
+		uint8_t uiMark = image[vSlots[i]];
+		uiRun = (uiMark == 0 || uiMark == 0xE5U) ? uiRun + 1 : 0;
+		uiFirst = i + 1 - uiRun;
+	}
+	while (uiRun <= uiLFN)
+	{
+		uiLast = fcnAlloc(uiLast);
+		if (uiLast == 0)
+		{
+			std::cerr << "SD image is full\n";
+			return false;
+		}
+		auto cluster = fcnCluster(uiLast);
+		std::fill(cluster.begin(), cluster.end(), 0);
+		size_t uiBase = uiDataStart + (static_cast<size_t>(uiLast - 2) * uiClusterBytes);
+		for (size_t i = 0; i < uiClusterBytes && uiRun <= uiLFN; i += 32)
+		{
+			vSlots.push_back(uiBase + i);
+			uiRun++;
+		}
+		uiFirst = vSlots.size() - uiRun;
+	}
+
+	// File data.
+	uint32_t uiStart = 0, uiPrev = 0;
+	for (size_t uiPos = 0; uiPos < vFile.size(); uiPos += uiClusterBytes)
+	{
+		uiPrev = fcnAlloc(uiPrev);
+		if (uiPrev == 0)
+		{
+			std::cerr << "SD image is full\n";
+			return false;
+		}
+		uiStart = uiStart == 0 ? uiPrev : uiStart;
+		auto cluster = fcnCluster(uiPrev);
+		auto uiLen = std::min<size_t>(uiClusterBytes, vFile.size() - uiPos);
+		std::copy(vFile.begin() + uiPos, vFile.begin() + uiPos + uiLen, cluster.begin());
+		std::fill(cluster.begin() + uiLen, cluster.end(), 0);
+	}
+
+	// Long name entries go in front of the short one, last part first.
+	uint8_t uiSum = ShortNameChecksum(strShort);
+	for (size_t i = 0; i < uiLFN; i++)
+	{
+		auto entry = image.subspan(vSlots[uiFirst + i], 32);
+		std::fill(entry.begin(), entry.end(), 0);
+		size_t uiPart = uiLFN - i; // 1-based
+		entry[0] = uiPart | (i == 0 ? 0x40U : 0U);
+		entry[11] = 0x0F;
+		entry[13] = uiSum;
+		static const std::array<uint8_t, 13> aOffsets {1,3,5,7,9,14,16,18,20,22,24,28,30};
+		for (size_t j = 0; j < aOffsets.size(); j++)
+		{
+			size_t uiChar = ((uiPart - 1) * 13) + j;
+			uint16_t uiVal = uiChar < vLongName.size() ? vLongName[uiChar] : (uiChar == vLongName.size() ? 0 : 0xFFFFU);
+			Set16(entry, gsl::at(aOffsets, j), uiVal);
+		}
+	}
+	auto entry = image.subspan(vSlots[uiFirst + uiLFN], 32);
+	std::fill(entry.begin(), entry.end(), 0);
+	std::copy(strShort.begin(), strShort.end(), entry.begin());
+	entry[11] = 0x20; // Archive
+	std::time_t tNow = std::time(nullptr);
+	std::tm tmNow = *std::localtime(&tNow);
+	uint16_t uiDate = ((tmNow.tm_year - 80) << 9U) | ((tmNow.tm_mon + 1) << 5U) | tmNow.tm_mday;
+	uint16_t uiTime = (tmNow.tm_hour << 11U) | (tmNow.tm_min << 5U) | (tmNow.tm_sec / 2);
+	Set16(entry, 0x0E, uiTime);
+	Set16(entry, 0x10, uiDate);
+	Set16(entry, 0x12, uiDate);
+	Set16(entry, 0x14, uiStart >> 16U);
+	Set16(entry, 0x16, uiTime);
+	Set16(entry, 0x18, uiDate);
+	Set16(entry, 0x1A, uiStart & 0xFFFFU);
+	Set32(entry, 0x1C, vFile.size());
+
+	// Free count and next-free hints in FSInfo are now stale; mark them unknown.
+	size_t uiInfo = Get16(image, 0x30) * static_cast<size_t>(uiBPS);
+	if (uiInfo != 0 && uiInfo + uiBPS <= image.size() && Get32(image, uiInfo) == 0x41615252U)
+	{
+		Set32(image, uiInfo + 0x1E8, 0xFFFFFFFFU);
+		Set32(image, uiInfo + 0x1EC, 0xFFFFFFFFU);
+	}
+	std::cout << "Added " << strName << " (" << vFile.size() << " bytes) to the SD image\n";
 	return true;
 }
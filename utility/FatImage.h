@@ -23,6 +23,7 @@
 
 #pragma once
 
+#include "gsl-lite.hpp"
 #include <cstdint>  // for uint32_t, uint8_t
 #include <map>       // for _Rb_tree_const_iterator, map
 #include <string>    // for string
@@ -45,8 +46,13 @@ class FatImage
 
 		static std::vector<std::string> GetSizes();
 
+		// Creates a sparse image: the file is sized up front and only the metadata sectors are written.
 		static bool MakeFatImage(const std::string &strFile, const std::string &strSize);
 
+		// Copies a host file into the root directory of a FAT32 image file, or of an image already in memory.
+		static bool AddFile(const std::string &strImage, const std::string &strHostFile);
+		static bool AddFile(gsl::span<uint8_t> image, const std::string &strHostFile);
+
 	private:
 		static inline constexpr uint32_t Sector2Bytes(uint32_t val) { return val<<9u; } // <<9 = 512 bytes/sector.
 		static inline constexpr uint32_t Byte2Sector(uint32_t val) { return val>>9u; } // <<9 = 512 bytes/sector.
@@ -63,6 +69,11 @@ class FatImage
 
 		static uint32_t SectorsPerFat(Size size);
 
+		// Makes a unique 8.3 name for strName (as stored, space padded), and says whether it lost anything.
+		static std::string MakeShortName(const std::string &strName, const std::vector<std::string> &vUsed, bool &bLossy);
+
+		static uint8_t ShortNameChecksum(const std::string &strShort);
+
 		static const std::map<std::string, Size>& GetNameToSize();
 
 		static const uint8_t _FAT32[];
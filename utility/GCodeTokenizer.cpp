@@ -0,0 +1,161 @@
+/*
+	GCodeTokenizer.cpp - Streaming, allocation-free G-code line decoder.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GCodeTokenizer.h"
+#include <cctype>     // for isalpha, isdigit, toupper
+
+void GCodeTokenizer::Reset()
+{
+	m_cmd = GCodeCommand();
+	m_state = State::Word;
+	m_bLineStarted = false;
+	m_chrWord = 0;
+	m_uiSum = 0;
+	m_iChecksum = 0;
+}
+
+void GCodeTokenizer::EndWord()
+{
+	if (m_chrWord == 0)
+	{
+		return;
+	}
+	float fValue = static_cast<float>(m_iInt) + (static_cast<float>(m_iFrac)/static_cast<float>(m_iFracDiv));
+	if (m_bNegative)
+	{
+		fValue = -fValue;
+	}
+	if (m_chrWord == 'N' && m_cmd.chrLetter == 0 && m_cmd.iLine < 0 && m_bDigits)
+	{
+		m_cmd.iLine = m_iInt;
+	}
+	else if (m_cmd.chrLetter == 0)
+	{
+		// The first word is the command. This also covers the MMU's single letter commands.
+		m_cmd.chrLetter = m_chrWord;
+		m_cmd.iCode = m_bDigits ? m_iInt : -1;
+		m_cmd.iSubCode = (m_bDigits && m_bFraction) ? m_iFrac : -1;
+	}
+	else if (m_cmd.uiParamCount < GCodeCommand::MAX_PARAMS)
+	{
+		m_cmd.params[m_cmd.uiParamCount++] = {m_chrWord, fValue, m_bDigits};
+	}
+	else
+	{
+		m_cmd.bParamsDropped = true;
+	}
+	m_bLineStarted = true;
+	m_chrWord = 0;
+}
+
+bool GCodeTokenizer::Feed(char chr)
+{
+	auto c = static_cast<unsigned char>(chr);
+	if (c == '\n' || c == '\r')
+	{
+		bool bLine = m_bLineStarted || m_chrWord != 0;
+		if (bLine)
+		{
+			EndWord();
+			m_cmd.bChecksumOK = m_cmd.bHasChecksum && (m_iChecksum == m_uiSum);
+		}
+		m_state = State::Word;
+		m_bLineStarted = false;
+		m_uiSum = 0;
+		m_iChecksum = 0;
+		return bLine;
+	}
+	if (!m_bLineStarted && m_chrWord == 0 && m_state == State::Word)
+	{
+		m_cmd = GCodeCommand(); // The previous line has been consumed.
+	}
+	if (m_state == State::Checksum)
+	{
+		if (std::isdigit(c) && m_iChecksum < 256)
+		{
+			m_iChecksum = (m_iChecksum * 10) + (c - '0');
+		}
+		return false;
+	}
+	if (c == '*' && m_state != State::ParenComment && m_state != State::Comment)
+	{
+		EndWord();
+		m_cmd.bHasChecksum = true;
+		m_state = State::Checksum;
+		return false;
+	}
+	m_uiSum ^= static_cast<uint8_t>(c);
+	if (m_state == State::Comment)
+	{
+		return false;
+	}
+	else if (m_state == State::ParenComment)
+	{
+		if (c == ')')
+		{
+			m_state = State::Word;
+		}
+		return false;
+	}
+
+	if (std::isalpha(c))
+	{
+		EndWord();
+		m_chrWord = static_cast<char>(std::toupper(c));
+		m_bDigits = m_bNegative = m_bFraction = false;
+		m_iInt = m_iFrac = 0;
+		m_iFracDiv = 1;
+	}
+	else if (m_chrWord != 0 && std::isdigit(c))
+	{
+		m_bDigits = true;
+		if (!m_bFraction && m_iInt < 100000000)
+		{
+			m_iInt = (m_iInt * 10) + (c - '0');
+		}
+		else if (m_bFraction && m_iFracDiv < 1000000)
+		{
+			m_iFrac = (m_iFrac * 10) + (c - '0');
+			m_iFracDiv *= 10;
+		}
+	}
+	else if (m_chrWord != 0 && !m_bDigits && !m_bFraction && (c == '-' || c == '+'))
+	{
+		m_bNegative = (c == '-');
+	}
+	else if (m_chrWord != 0 && c == '.' && !m_bFraction)
+	{
+		m_bFraction = true;
+	}
+	else
+	{
+		EndWord();
+		if (c == ';')
+		{
+			m_state = State::Comment;
+		}
+		else if (c == '(')
+		{
+			m_state = State::ParenComment;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,107 @@
+/*
+	GCodeTokenizer.h - Streaming, allocation-free G-code line decoder.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>       // for array
+#include <cstdint>     // for int32_t, uint8_t
+
+// One decoded line, e.g. "N12 G1 X10.5 E-2*3 ;move" gives line 12, command G1,
+// parameters X and E, and whether the checksum after * matched.
+struct GCodeCommand
+{
+	struct Param
+	{
+		char chrLetter;
+		float fValue;
+		bool bHasValue; // e.g. the axes of "G28 X Y"
+	};
+
+	static constexpr uint8_t MAX_PARAMS = 16;
+
+	char chrLetter = 0; // Command letter (G, M, T...), 0 if the line had none.
+	int32_t iCode = -1; // Command number, -1 if none.
+	int32_t iSubCode = -1; // The 1 of G29.1, -1 if none.
+	int32_t iLine = -1; // N word, -1 if none.
+	bool bHasChecksum = false;
+	bool bChecksumOK = false;
+	bool bParamsDropped = false; // More than MAX_PARAMS parameters.
+	uint8_t uiParamCount = 0;
+	std::array<Param, MAX_PARAMS> params {};
+
+	inline bool Is(char chrCmd, int32_t iNum) const { return chrLetter == chrCmd && iCode == iNum; }
+
+	inline const Param* Get(char chrParam) const
+	{
+		for (uint8_t i = 0; i < uiParamCount; i++)
+		{
+			if (params[i].chrLetter == chrParam)
+			{
+				return &params[i];
+			}
+		}
+		return nullptr;
+	}
+
+	inline float GetValue(char chrParam, float fDefault) const
+	{
+		auto p = Get(chrParam);
+		return (p != nullptr && p->bHasValue) ? p->fValue : fDefault;
+	}
+};
+
+// Fed a byte at a time, e.g. straight from a UART IRQ. Keeps no history beyond the
+// current line and never allocates. Text arguments (M117 messages and the like) are not
+// kept; their characters are treated as separate parameter letters.
+class GCodeTokenizer
+{
+	public:
+		// Returns true when c completed a non-empty line, which is then available from GetCommand()
+		// until the next byte is fed.
+		bool Feed(char c);
+
+		inline const GCodeCommand& GetCommand() const { return m_cmd; }
+
+		void Reset();
+
+	private:
+		void EndWord();
+
+		enum class State
+		{
+			Word, // Between words, or reading a word's number.
+			Comment, // Inside ( ) or after ;
+			ParenComment,
+			Checksum
+		};
+
+		GCodeCommand m_cmd;
+		State m_state = State::Word;
+		bool m_bLineStarted = false;
+
+		// Word being read
+		char m_chrWord = 0;
+		bool m_bDigits = false, m_bNegative = false, m_bFraction = false;
+		int32_t m_iInt = 0, m_iFrac = 0, m_iFracDiv = 1;
+
+		uint8_t m_uiSum = 0; // XOR of everything before the *
+		int32_t m_iChecksum = 0;
+};
@@ -21,6 +21,7 @@
 
 
 #include "GLObj.h"
+#include "GLRenderer.h"
 #include "gsl-lite.hpp"
 #include "tiny_obj_loader.h"  // for attrib_t, index_t, mesh_t, shape_t, Loa...
 #include <GL/glew.h>          // for glMaterialfv, GL_FRONT, glBindTexture
@@ -41,6 +42,13 @@
 // Also cuts GPU RAM usage in half, and probably has performance gains for not needing to set the vertex properties.
 #define TEX_VCOLOR 0
 
+#if TEX_VCOLOR
+static constexpr GLsizei VERTEX_FLOATS = 3 + 3 + 3 + 2; // position, normal, colour, texcoord
+#else
+static constexpr GLsizei VERTEX_FLOATS = 3 + 3; // position, normal
+#endif
+static constexpr GLsizei VERTEX_STRIDE = VERTEX_FLOATS * sizeof(float);
+
 GLObj::GLObj(std::string strFile,  float fTX, float fTY, float fTZ, float fScale):m_strFile(std::move(strFile)),m_fScale(fScale),m_fCorr{fTX,fTY,fTZ}
 {
 }
@@ -60,6 +68,10 @@ void GLObj::Load()
 	{
 		std::cout << "Failed to load obj\n";
 	}
+	else if (GLRenderer::GetActive())
+	{
+		AddRendererMaterials();
+	}
 
 	m_fMaxExtent = 0.5f * (m_extMax[0] - m_extMin[0]);
 	if (m_fMaxExtent < 0.5f * (m_extMax[1] - m_extMin[1]))
@@ -130,11 +142,7 @@ void GLObj::Draw() {
 	glPolygonMode(GL_FRONT, GL_FILL);
 	glPolygonMode(GL_BACK, GL_FILL);
 
-#if TEX_VCOLOR
-	GLsizei stride = (3 + 3 + 3 + 2) * sizeof(float);
-#else
-	GLsizei stride = (3 + 3) * sizeof(float);
-#endif
+	GLsizei stride = VERTEX_STRIDE;
 	glPushMatrix();
 	glTranslatef(m_fCorr[0],m_fCorr[1],m_fCorr[2]);
 	//glScalef(m_fScale,m_fScale,m_fScale);
@@ -143,9 +151,40 @@ void GLObj::Draw() {
 		glRotatef(-90,1,0,0);
 	}
 	std::lock_guard<std::mutex> lock(m_lock);
+	auto fcnTextured = [this](const DrawObject &o)
+	{
+		return o.material_id < m_materials.size() && m_textures.count(m_materials[o.material_id].diffuse_texname) > 0;
+	};
+	GLRenderer *pRenderer = GLRenderer::GetActive();
+	bool bQueued = pRenderer && !m_vRendererMats.empty();
+	if (bQueued)
+	{
+		uint32_t uiTransform = pRenderer->PushTransform();
+		bool bTextured = false;
+		for (auto &o : m_DrawObjects)
+		{
+			if (o.vao != 0 && o.bDraw)
+			{
+				// The renderer has no texture support; textured parts take the fixed-function path below.
+				if (fcnTextured(o))
+				{
+					bTextured = true;
+					continue;
+				}
+				// Same as below, an out of range ID leaves the default material in place.
+				size_t iMat = std::min(o.material_id, m_vRendererMats.size() - 1);
+				pRenderer->Submit(o.vao, 3 * o.numTriangles, m_vRendererMats[iMat], uiTransform);
+			}
+		}
+		if (!bTextured)
+		{
+			glPopMatrix();
+			return;
+		}
+	}
 	for (auto o : m_DrawObjects)
 	{
-		if (o.vb < 1 || !o.bDraw)
+		if (o.vb < 1 || !o.bDraw || (bQueued && (o.vao == 0 || !fcnTextured(o))))
 		{
 			continue;
 		}
@@ -192,6 +231,27 @@ void GLObj::Draw() {
 }
 
 
+void GLObj::AddRendererMaterials()
+{
+	GLRenderer *pRenderer = GLRenderer::GetActive();
+	m_vRendererMats.clear();
+	for (auto &mat : m_materials)
+	{
+		GLRenderer::Material rMat {};
+		for (int i=0; i<3; i++)
+		{
+			rMat.ambient[i] = m_matMode == GL_AMBIENT_AND_DIFFUSE ? mat.diffuse[i] : mat.ambient[i];
+			rMat.diffuse[i] = mat.diffuse[i];
+			rMat.specular[i] = mat.specular[i];
+			rMat.emission[i] = mat.emission[i];
+		}
+		rMat.ambient[3] = rMat.diffuse[3] = rMat.specular[3] = mat.dissolve;
+		rMat.emission[3] = 1.f;
+		rMat.fShininess = (mat.shininess/1000.f)*128.f;
+		m_vRendererMats.push_back(pRenderer->AddMaterial(rMat));
+	}
+}
+
 static std::string GetBaseDir(const std::string &filepath) {
 	if (filepath.find_last_of("/\\") != std::string::npos)
 	{
@@ -491,12 +551,12 @@ void GLObj::AddObject(const std::vector<float> &vb, int iMatlId)
 		glBindBuffer(GL_ARRAY_BUFFER, obj.vb);
 		glBufferData(GL_ARRAY_BUFFER, vb.size() * sizeof(float), &vb.at(0),
 									GL_STATIC_DRAW);
-#if TEX_VCOLOR
-		obj.numTriangles = vb.size() / ((3 + 3 + 3 + 2) * 3);
-#else
-		obj.numTriangles = vb.size() / ((3 + 3) * 3);
-#endif
+		obj.numTriangles = vb.size() / (VERTEX_FLOATS * 3);
 		// printf("shape[%d] # of triangles = %d\n", static_cast<int>(s), obj.numTriangles);
+		if (GLRenderer::GetActive())
+		{
+			obj.vao = GLRenderer::GetActive()->CreateMeshVAO(obj.vb, VERTEX_STRIDE);
+		}
 	}
 	obj.bDraw = true;
 	obj.material_id = iMatlId;
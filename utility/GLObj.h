@@ -25,6 +25,7 @@
 #include "tiny_obj_loader.h"  // for material_t
 #include <GL/glew.h>          // for GLuint
 #include <cstddef>           // for size_t
+#include <cstdint>            // for uint32_t
 #include <map>                // for map
 #include <mutex>
 #include <string>             // for string
@@ -87,6 +88,7 @@ class GLObj
 
         using DrawObject = struct DrawObject{
             GLuint vb {0};  // vertex buffer
+            GLuint vao {0}; // Only when drawing through GLRenderer.
             int numTriangles {0};
             size_t material_id {0}; // Atomic to allow for cross thread
             bool bDraw {false};
@@ -96,6 +98,7 @@ class GLObj
 		gsl::span<float> m_extMin {_m_extMin}, m_extMax {_m_extMax};
         bool m_bLoaded = false, m_bNoNewNormals = false, m_bSetDissolve = false, m_bReverseNormals = false;
         std::vector<tinyobj::material_t> m_materials;
+        std::vector<uint32_t> m_vRendererMats; // GLRenderer IDs, indexed as m_materials.
         std::map<std::string, GLuint> m_textures;
         std::vector<DrawObject> m_DrawObjects;
 
@@ -113,4 +116,7 @@ class GLObj
         bool LoadObjAndConvert(const char* filename);
 
 		void AddObject(const std::vector<float> &vb, int iMatlId);
+
+		// Converts the loaded materials to what the fixed-function path would have set.
+		void AddRendererMaterials();
 };
@@ -0,0 +1,312 @@
+/*
+	GLRenderer.cpp - Retained shader path for the 3D printer meshes.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GLRenderer.h"
+#include "gsl-lite.hpp"
+#include <algorithm>     // for find, stable_sort
+#include <array>         // for array
+#include <cmath>         // for fabs
+#include <iostream>      // for cerr, cout
+#include <string>        // for string, to_string
+
+GLRenderer* GLRenderer::g_pActive = nullptr;
+
+// Per-vertex lighting, the same as the fixed-function pipeline does it for one light with
+// GL_NORMALIZE, an infinite viewer and colours clamped per vertex.
+static const char VERTEX_SRC[] = R"(
+	in vec3 aPos;
+	in vec3 aNormal;
+
+	layout(std140) uniform Transforms
+	{
+		mat4 uModelView[MAX_TRANSFORMS];
+		mat4 uNormal[MAX_TRANSFORMS];
+	};
+
+	uniform int uIndex;
+	uniform mat4 uProjection;
+	uniform vec4 uMatAmbient, uMatDiffuse, uMatSpecular, uMatEmission;
+	uniform float uShininess;
+	uniform vec4 uLightAmbient, uLightDiffuse, uLightSpecular, uLightPos, uSceneAmbient;
+
+	out vec4 vColor;
+
+	void main()
+	{
+		vec4 eyePos = uModelView[uIndex] * vec4(aPos, 1.0);
+		gl_Position = uProjection * eyePos;
+		vec3 n = normalize(mat3(uNormal[uIndex]) * aNormal);
+		vec3 l = normalize(uLightPos.w == 0.0 ? uLightPos.xyz : uLightPos.xyz - eyePos.xyz);
+		float nDotL = max(dot(n, l), 0.0);
+		vec4 c = uMatEmission + (uMatAmbient * (uSceneAmbient + uLightAmbient)) + (nDotL * uMatDiffuse * uLightDiffuse);
+		if (nDotL > 0.0)
+		{
+			vec3 h = normalize(l + vec3(0.0, 0.0, 1.0));
+			c += pow(max(dot(n, h), 1e-6), uShininess) * uMatSpecular * uLightSpecular;
+		}
+		vColor = vec4(clamp(c.rgb, 0.0, 1.0), uMatDiffuse.a);
+	}
+)";
+
+static const char FRAGMENT_SRC[] = R"(
+	in vec4 vColor;
+	out vec4 fragColor;
+
+	void main()
+	{
+		fragColor = vColor;
+	}
+)";
+
+static GLuint CompileShader(GLenum type, const char *pSrc, uint32_t uiMaxTransforms)
+{
+	std::string strHeader = "#version 140\n#define MAX_TRANSFORMS " + std::to_string(uiMaxTransforms) + "\n";
+	std::array<const char*, 2> vSrc {{strHeader.c_str(), pSrc}};
+	GLuint uiShader = glCreateShader(type);
+	glShaderSource(uiShader, vSrc.size(), vSrc.data(), nullptr);
+	glCompileShader(uiShader);
+	GLint iOK = 0;
+	glGetShaderiv(uiShader, GL_COMPILE_STATUS, &iOK);
+	if (!iOK)
+	{
+		std::array<char, 1024> log {};
+		glGetShaderInfoLog(uiShader, log.size(), nullptr, log.data());
+		std::cerr << "GLRenderer: shader compile failed: " << log.data() << '\n';
+		glDeleteShader(uiShader);
+		return 0;
+	}
+	return uiShader;
+}
+
+bool GLRenderer::Material::operator==(const Material &other) const
+{
+	return ambient == other.ambient && diffuse == other.diffuse && specular == other.specular
+		&& emission == other.emission && fShininess == other.fShininess; //NOLINT - exact match is what we want.
+}
+
+GLRenderer::~GLRenderer()
+{
+	// The GL objects go with the window's context.
+	if (g_pActive == this)
+	{
+		g_pActive = nullptr;
+	}
+}
+
+bool GLRenderer::Init()
+{
+	if (!GLEW_VERSION_3_1)
+	{
+		std::cerr << "GLRenderer: OpenGL 3.1 is not available, using fixed-function drawing.\n";
+		return false;
+	}
+	GLuint uiVert = CompileShader(GL_VERTEX_SHADER, static_cast<const char*>(VERTEX_SRC), MAX_TRANSFORMS);
+	GLuint uiFrag = CompileShader(GL_FRAGMENT_SHADER, static_cast<const char*>(FRAGMENT_SRC), MAX_TRANSFORMS);
+	if (uiVert == 0 || uiFrag == 0)
+	{
+		return false;
+	}
+	m_uiProgram = glCreateProgram();
+	glAttachShader(m_uiProgram, uiVert);
+	glAttachShader(m_uiProgram, uiFrag);
+	glBindAttribLocation(m_uiProgram, 0, "aPos");
+	glBindAttribLocation(m_uiProgram, 1, "aNormal");
+	glBindFragDataLocation(m_uiProgram, 0, "fragColor");
+	glLinkProgram(m_uiProgram);
+	glDeleteShader(uiVert);
+	glDeleteShader(uiFrag);
+	GLint iOK = 0;
+	glGetProgramiv(m_uiProgram, GL_LINK_STATUS, &iOK);
+	if (!iOK)
+	{
+		std::array<char, 1024> log {};
+		glGetProgramInfoLog(m_uiProgram, log.size(), nullptr, log.data());
+		std::cerr << "GLRenderer: shader link failed: " << log.data() << '\n';
+		glDeleteProgram(m_uiProgram);
+		m_uiProgram = 0;
+		return false;
+	}
+
+	glUniformBlockBinding(m_uiProgram, glGetUniformBlockIndex(m_uiProgram, "Transforms"), 0);
+	m_iIndexLoc = glGetUniformLocation(m_uiProgram, "uIndex");
+	m_iProjLoc = glGetUniformLocation(m_uiProgram, "uProjection");
+	m_iMatAmbLoc = glGetUniformLocation(m_uiProgram, "uMatAmbient");
+	m_iMatDiffLoc = glGetUniformLocation(m_uiProgram, "uMatDiffuse");
+	m_iMatSpecLoc = glGetUniformLocation(m_uiProgram, "uMatSpecular");
+	m_iMatEmLoc = glGetUniformLocation(m_uiProgram, "uMatEmission");
+	m_iShinyLoc = glGetUniformLocation(m_uiProgram, "uShininess");
+	m_iLightAmbLoc = glGetUniformLocation(m_uiProgram, "uLightAmbient");
+	m_iLightDiffLoc = glGetUniformLocation(m_uiProgram, "uLightDiffuse");
+	m_iLightSpecLoc = glGetUniformLocation(m_uiProgram, "uLightSpecular");
+	m_iLightPosLoc = glGetUniformLocation(m_uiProgram, "uLightPos");
+	m_iSceneAmbLoc = glGetUniformLocation(m_uiProgram, "uSceneAmbient");
+
+	glGenBuffers(1, &m_uiUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_uiUBO);
+	glBufferData(GL_UNIFORM_BUFFER, m_vTransforms.size() * sizeof(float), nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	g_pActive = this;
+	std::cout << "GLRenderer: drawing meshes with shaders.\n";
+	return true;
+}
+
+uint32_t GLRenderer::AddMaterial(const Material &mat)
+{
+	auto it = std::find(m_vMaterials.begin(), m_vMaterials.end(), mat);
+	if (it != m_vMaterials.end())
+	{
+		return it - m_vMaterials.begin();
+	}
+	m_vMaterials.push_back(mat);
+	return m_vMaterials.size() - 1;
+}
+
+GLuint GLRenderer::CreateMeshVAO(GLuint uiVB, GLsizei iStride)
+{
+	GLuint uiVAO = 0;
+	glGenVertexArrays(1, &uiVAO);
+	glBindVertexArray(uiVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, uiVB);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, iStride, nullptr);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, iStride, (const void*)(sizeof(float) * 3)); //NOLINT it is what it is.
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return uiVAO;
+}
+
+void GLRenderer::BeginFrame()
+{
+	glGetFloatv(GL_PROJECTION_MATRIX, m_fProjection.data());
+	glGetLightfv(GL_LIGHT0, GL_AMBIENT, m_fLightAmb.data());
+	glGetLightfv(GL_LIGHT0, GL_DIFFUSE, m_fLightDiff.data());
+	glGetLightfv(GL_LIGHT0, GL_SPECULAR, m_fLightSpec.data());
+	glGetLightfv(GL_LIGHT0, GL_POSITION, m_fLightPos.data()); // Already in eye coordinates.
+	glGetFloatv(GL_LIGHT_MODEL_AMBIENT, m_fSceneAmb.data());
+	m_uiTransforms = 0;
+}
+
+uint32_t GLRenderer::PushTransform()
+{
+	if (m_uiTransforms == MAX_TRANSFORMS)
+	{
+		Flush();
+	}
+	auto fMV = gsl::span<float>(m_vTransforms).subspan(m_uiTransforms * 16U, 16);
+	auto fN = gsl::span<float>(m_vTransforms).subspan((MAX_TRANSFORMS + m_uiTransforms) * 16U, 16);
+	glGetFloatv(GL_MODELVIEW_MATRIX, fMV.data());
+
+	// Inverse transpose of the upper 3x3, i.e. its cofactors over the determinant.
+	auto a = [&fMV](int r, int c) { return fMV[(c*4) + r]; };
+	std::array<float,9> cof {{
+		a(1,1)*a(2,2) - a(1,2)*a(2,1), a(1,2)*a(2,0) - a(1,0)*a(2,2), a(1,0)*a(2,1) - a(1,1)*a(2,0),
+		a(0,2)*a(2,1) - a(0,1)*a(2,2), a(0,0)*a(2,2) - a(0,2)*a(2,0), a(0,1)*a(2,0) - a(0,0)*a(2,1),
+		a(0,1)*a(1,2) - a(0,2)*a(1,1), a(0,2)*a(1,0) - a(0,0)*a(1,2), a(0,0)*a(1,1) - a(0,1)*a(1,0)}};
+	float fDet = a(0,0)*cof[0] + a(0,1)*cof[1] + a(0,2)*cof[2];
+	float fInv = std::fabs(fDet) > 1e-30f ? 1.f/fDet : 1.f;
+	for (int r = 0; r < 3; r++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			fN[(c*4) + r] = cof[(r*3) + c] * fInv;
+		}
+		fN[(r*4) + 3] = 0;
+		fN[12 + r] = 0;
+	}
+	fN[15] = 1;
+	return m_uiTransforms++;
+}
+
+void GLRenderer::Submit(GLuint uiVAO, GLsizei iVertices, uint32_t uiMaterial, uint32_t uiTransform)
+{
+	if (m_vMaterials.at(uiMaterial).diffuse[3] < 1.f)
+	{
+		m_vTranslucent.push_back({uiVAO, iVertices, uiMaterial, uiTransform});
+	}
+	else
+	{
+		m_vOpaque.push_back({uiVAO, iVertices, uiMaterial, uiTransform});
+	}
+}
+
+void GLRenderer::SetMaterial(const Material &mat)
+{
+	glUniform4fv(m_iMatAmbLoc, 1, mat.ambient.data());
+	glUniform4fv(m_iMatDiffLoc, 1, mat.diffuse.data());
+	glUniform4fv(m_iMatSpecLoc, 1, mat.specular.data());
+	glUniform4fv(m_iMatEmLoc, 1, mat.emission.data());
+	glUniform1f(m_iShinyLoc, mat.fShininess);
+}
+
+void GLRenderer::Flush()
+{
+	if (m_vOpaque.empty() && m_vTranslucent.empty())
+	{
+		m_uiTransforms = 0;
+		return;
+	}
+	glUseProgram(m_uiProgram);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_uiUBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, m_vTransforms.size() * sizeof(float), m_vTransforms.data());
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_uiUBO);
+	glUniformMatrix4fv(m_iProjLoc, 1, GL_FALSE, m_fProjection.data());
+	glUniform4fv(m_iLightAmbLoc, 1, m_fLightAmb.data());
+	glUniform4fv(m_iLightDiffLoc, 1, m_fLightDiff.data());
+	glUniform4fv(m_iLightSpecLoc, 1, m_fLightSpec.data());
+	glUniform4fv(m_iLightPosLoc, 1, m_fLightPos.data());
+	glUniform4fv(m_iSceneAmbLoc, 1, m_fSceneAmb.data());
+
+	std::stable_sort(m_vOpaque.begin(), m_vOpaque.end(), [](const Item &a, const Item &b) { return a.uiMaterial < b.uiMaterial; });
+
+	uint32_t uiMaterial = UINT32_MAX, uiTransform = UINT32_MAX;
+	auto draw = [&](const Item &item)
+	{
+		if (item.uiMaterial != uiMaterial)
+		{
+			uiMaterial = item.uiMaterial;
+			SetMaterial(m_vMaterials[uiMaterial]);
+		}
+		if (item.uiTransform != uiTransform)
+		{
+			uiTransform = item.uiTransform;
+			glUniform1i(m_iIndexLoc, uiTransform);
+		}
+		glBindVertexArray(item.uiVAO);
+		glDrawArrays(GL_TRIANGLES, 0, item.iVertices);
+	};
+	for (auto &item : m_vOpaque)
+	{
+		draw(item);
+	}
+	for (auto &item : m_vTranslucent)
+	{
+		draw(item);
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glUseProgram(0);
+
+	m_vOpaque.clear();
+	m_vTranslucent.clear();
+	m_uiTransforms = 0;
+}
@@ -0,0 +1,107 @@
+/*
+	GLRenderer.h - Retained shader path for the 3D printer meshes.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <GL/glew.h>   // for GLuint, GLsizei
+#include <array>       // for array
+#include <cstdint>     // for uint32_t
+#include <vector>      // for vector
+
+// Instead of drawing straight away, GLObj::Draw() queues each visible sub-object (its VAO,
+// material and the current modelview). Flush() then uploads all the queued transforms into
+// one uniform buffer and draws with a single shader program, sorted by material so material
+// uniforms only change when they have to. Opaque objects go first, translucent ones after
+// in the order they were queued.
+//
+// The shader reproduces the fixed-function lighting for GL_LIGHT0 (read back each frame),
+// so the scene setup code keeps using the matrix stack and glLight as before.
+class GLRenderer
+{
+	public:
+		struct Material
+		{
+			std::array<float,4> ambient;
+			std::array<float,4> diffuse;
+			std::array<float,4> specular;
+			std::array<float,4> emission;
+			float fShininess; // GL units, 0-128
+
+			bool operator==(const Material &other) const;
+		};
+
+		~GLRenderer();
+
+		// Builds the shader and buffers in the current context. Returns false, leaving the
+		// fixed-function path in use, if the context can't support it.
+		bool Init();
+
+		// The renderer GLObj should queue into, or nullptr for immediate fixed-function drawing.
+		static inline GLRenderer* GetActive() { return g_pActive; }
+
+		// Returns an ID for the material, reusing an existing one if identical.
+		uint32_t AddMaterial(const Material &mat);
+
+		// Makes a VAO for an interleaved position + normal buffer.
+		GLuint CreateMeshVAO(GLuint uiVB, GLsizei iStride);
+
+		// Reads the projection and lighting state. Call once the frame's lights are set up.
+		void BeginFrame();
+
+		// Captures the current modelview matrix and returns its index for Submit().
+		uint32_t PushTransform();
+
+		void Submit(GLuint uiVAO, GLsizei iVertices, uint32_t uiMaterial, uint32_t uiTransform);
+
+		// Draws everything queued since the last call.
+		void Flush();
+
+	private:
+		struct Item
+		{
+			GLuint uiVAO;
+			GLsizei iVertices;
+			uint32_t uiMaterial;
+			uint32_t uiTransform;
+		};
+
+		void SetMaterial(const Material &mat);
+
+		static GLRenderer *g_pActive;
+
+		// Per-flush capacity of the transform buffer. A frame that pushes more flushes early.
+		static constexpr uint32_t MAX_TRANSFORMS = 64;
+
+		GLuint m_uiProgram = 0, m_uiUBO = 0;
+		GLint m_iIndexLoc = -1, m_iProjLoc = -1;
+		GLint m_iMatAmbLoc = -1, m_iMatDiffLoc = -1, m_iMatSpecLoc = -1, m_iMatEmLoc = -1, m_iShinyLoc = -1;
+		GLint m_iLightAmbLoc = -1, m_iLightDiffLoc = -1, m_iLightSpecLoc = -1, m_iLightPosLoc = -1, m_iSceneAmbLoc = -1;
+
+		std::vector<Material> m_vMaterials;
+		std::vector<Item> m_vOpaque, m_vTranslucent;
+
+		// Modelview matrices, then the matching normal matrices, as laid out in the uniform block.
+		std::vector<float> m_vTransforms = std::vector<float>(MAX_TRANSFORMS * 32U);
+		uint32_t m_uiTransforms = 0;
+
+		std::array<float,16> m_fProjection {};
+		std::array<float,4> m_fLightAmb {}, m_fLightDiff {}, m_fLightSpec {}, m_fLightPos {}, m_fSceneAmb {};
+};
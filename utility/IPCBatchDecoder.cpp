@@ -0,0 +1,70 @@
+/*
+	IPCBatchDecoder.cpp - Receiving end of the IPC printer's binary batch protocol.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "IPCBatchDecoder.h"
+
+void IPCBatchDecoder::Reset()
+{
+	m_bSeqValid = false;
+	m_vHaveSample.fill(false);
+}
+
+IPCBatchDecoder::Result IPCBatchDecoder::Apply(const uint8_t *pBuf, size_t uiLen)
+{
+	mk404_ipc_header_t hdr {};
+	int iErr = mk404_ipc_decode_header(pBuf, uiLen, &hdr);
+	m_uiLastVersion = hdr.version;
+	if (iErr == -2)
+	{
+		return Result::Version;
+	}
+	else if (iErr != 0)
+	{
+		return Result::Malformed;
+	}
+	if (m_bSeqValid)
+	{
+		uint16_t uiLost = mk404_ipc_seq_lost(m_uiNextSeq, hdr.seq);
+		m_uiLostBatches += uiLost;
+		if (uiLost > 0 || hdr.seq == m_uiNextSeq)
+		{
+			m_uiNextSeq = hdr.seq + 1U;
+		}
+	}
+	else
+	{
+		m_uiNextSeq = hdr.seq + 1U;
+		m_bSeqValid = true;
+	}
+	for (uint8_t i = 0; i < hdr.count; i++)
+	{
+		auto sample = mk404_ipc_decode_sample(pBuf, i);
+		if (m_vHaveSample[sample.channel] && mk404_ipc_time_before(sample.time_us, m_vLastSampleUs[sample.channel]))
+		{
+			m_uiStaleSamples++; // Older than what's shown already.
+			continue;
+		}
+		m_vHaveSample[sample.channel] = true;
+		m_vLastSampleUs[sample.channel] = sample.time_us;
+		m_fcnSample(sample.channel, sample.value);
+	}
+	return Result::OK;
+}
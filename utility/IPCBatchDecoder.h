@@ -0,0 +1,68 @@
+/*
+	IPCBatchDecoder.h - Receiving end of the IPC printer's binary batch protocol.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "ipc/mk404_ipc_proto.h"
+#include <array>       // for array
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint32_t, uint16_t, uint8_t, int32_t
+#include <functional>  // for function
+#include <utility>     // for move
+
+// Applies batch frames (see mk404_ipc_proto.h) from one client. Lost frames are counted from
+// gaps in the sequence, and a sample older than one already applied to its channel is dropped.
+class IPCBatchDecoder
+{
+	public:
+		enum class Result
+		{
+			OK,
+			Malformed, // Not a batch, or shorter than its sample count says.
+			Version // A protocol version we don't understand.
+		};
+
+		// Called for every sample that is applied.
+		using SampleFcn = std::function<void(uint8_t channel, int32_t value)>;
+
+		explicit IPCBatchDecoder(SampleFcn fcn):m_fcnSample(std::move(fcn)){};
+
+		// pBuf holds a frame of uiLen bytes, as received.
+		Result Apply(const uint8_t *pBuf, size_t uiLen);
+
+		// Forgets the sequence and sample history, e.g. because the client reconnected.
+		void Reset();
+
+		inline uint32_t GetLostBatches() const { return m_uiLostBatches; }
+		inline uint32_t GetStaleSamples() const { return m_uiStaleSamples; }
+		inline uint8_t GetLastVersion() const { return m_uiLastVersion; }
+
+	private:
+		SampleFcn m_fcnSample;
+
+		bool m_bSeqValid = false;
+		uint16_t m_uiNextSeq = 0;
+		uint8_t m_uiLastVersion = 0;
+		uint32_t m_uiLostBatches = 0;
+		uint32_t m_uiStaleSamples = 0;
+		std::array<bool, 256> m_vHaveSample {};
+		std::array<uint32_t, 256> m_vLastSampleUs {};
+};
@@ -23,6 +23,7 @@
 #include "CW1S_Full.h"
 #include "CW1S_Lite.h"
 #include "Camera.hpp"         // for Camera
+#include "Config.h"
 #include "GLPrint.h"          // for GLPrint
 #include "HD44780GL.h"        // for HD44780GL
 #include "KeyController.h"
@@ -153,6 +154,15 @@ MK3SGL::MK3SGL(const std::string &strModel, bool bMMU, Printer *pParent):Scripta
 
 	ResetCamera();
 
+	if (Config::Get().GetShaderRender())
+	{
+		m_pRenderer.reset(new GLRenderer());
+		if (!m_pRenderer->Init())
+		{
+			m_pRenderer.reset();
+		}
+	}
+
 	m_Objs->Load();
 
 	if (m_bMMU)
@@ -509,10 +519,18 @@ void MK3SGL::OnPosChanged(avr_irq_t *irq, uint32_t value)
 	m_bDirty = true;
 }
 
-void MK3SGL::OnToolChanged(avr_irq_t *, uint32_t iIdx)
+void MK3SGL::SetTool(uint32_t iIdx)
 {
 	// Need to stop the old tool and start the new one at the right location.
-	m_iCurTool = iIdx;
+	if (iIdx < m_vPrints.size())
+	{
+		m_iCurTool = iIdx;
+	}
+}
+
+void MK3SGL::OnToolChanged(avr_irq_t *, uint32_t iIdx)
+{
+	SetTool(iIdx);
 };
 
 void MK3SGL::OnGenericChanged(avr_irq_t *irq, uint32_t uiVal)
@@ -587,6 +605,11 @@ void MK3SGL::Draw()
 		glEnable(GL_NORMALIZE);
 		glLoadIdentity();
 
+		if (m_pRenderer)
+		{
+			m_pRenderer->BeginFrame();
+		}
+
 		if (!m_bFollowNozzle)
 		{
 			float fSize = 0.1f;
@@ -708,6 +731,10 @@ void MK3SGL::Draw()
 		{
 			DrawMMU();
 		}
+		if (m_pRenderer)
+		{
+			m_pRenderer->Flush();
+		}
 		m_snap.OnDraw();
 		glutSwapBuffers();
 		m_bDirty = false;
@@ -24,6 +24,7 @@
 #include "Camera.hpp"        // for Camera
 #include "GLHelper.h"
 #include "GLObj.h"           // for GLObj
+#include "GLRenderer.h"      // for GLRenderer
 #include "HD44780.h"         // for _IRQ
 #include "IKeyClient.h"
 #include "IScriptable.h"     // for IScriptable::LineStatus
@@ -37,6 +38,7 @@
 #include <atomic>            // for atomic, atomic_bool, atomic_int
 #include <algorithm>
 #include <cstdint>          // for uint32_t
+#include <memory>            // for unique_ptr
 #include <string>            // for string
 #include <vector>            // for vector
 
@@ -80,6 +82,9 @@ class MK3SGL: public BasePeripheral, public Scriptable, private IKeyClient
         // Clears the displayed print.
         void ClearPrint() { m_bClearPrints = true; }
 
+        // Switches the print that extrusion is drawn into, e.g. on a T command. Out of range tools are ignored.
+        void SetTool(uint32_t iIdx);
+
         void ExportPLY() { m_bExportPLY = true; }
 
         // Resets the camera view to the starting position.
@@ -130,6 +135,8 @@ class MK3SGL: public BasePeripheral, public Scriptable, private IKeyClient
 
 		OBJCollection *m_Objs = nullptr;
 
+		std::unique_ptr<GLRenderer> m_pRenderer;
+
 		std::atomic_int m_iCurTool = {0};
         GLPrint m_Print = {0.8,0,0}, m_T1 = {0,0.8,0}, m_T2 = {0,0,0.8}, m_T3 = {0.8,0.4,0}, m_T4 = {0.8,0,0.8};
 
@@ -0,0 +1,115 @@
+/*
+	MappedFile.cpp - A storage file mapped into memory, used as a live backing store.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MappedFile.h"
+#include "Macros.h"      // for US
+#include <algorithm>     // for min
+#include <fcntl.h>       // for open, O_RDWR, O_CREAT...
+#include <iostream>      // for operator<<, cerr
+#include <sys/file.h>    // for flock, LOCK_EX, LOCK_NB, LOCK_UN
+#include <sys/mman.h>    // for mmap, msync, munmap, MAP_FAILED, MAP_SHARED
+#include <sys/stat.h>    // for fstat, stat
+#include <unistd.h>      // for close, ftruncate, sysconf
+
+MappedFile::~MappedFile()
+{
+	Unmap();
+}
+
+bool MappedFile::Map(const std::string &strFile, size_t uiSize)
+{
+	Unmap();
+	m_bPrivate = false;
+	m_bNew = false;
+	m_fd = open(strFile.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH); //NOLINT - no c++ stl non vararg memmap available.
+	if (m_fd == -1)
+	{
+		m_fd = open(strFile.c_str(), O_RDONLY | O_CLOEXEC); //NOLINT - no c++ stl non vararg memmap available.
+		m_bPrivate = true;
+	}
+	// Another instance owns it; share its pages but keep our writes to ourselves.
+	else if (flock(m_fd, US(LOCK_EX) | US(LOCK_NB)) == -1)
+	{
+		m_bPrivate = true;
+	}
+	if (m_fd == -1)
+	{
+		std::cerr << "Could not open " << strFile << '\n';
+		return false;
+	}
+	struct stat stat_buf {};
+	if (fstat(m_fd, &stat_buf) == -1)
+	{
+		Unmap();
+		return false;
+	}
+	if (static_cast<size_t>(stat_buf.st_size) < uiSize)
+	{
+		// Growing a file we don't own would pull it out from under the owner.
+		if (m_bPrivate || ftruncate(m_fd, uiSize) == -1)
+		{
+			std::cerr << strFile << " is too small and could not be resized\n";
+			Unmap();
+			return false;
+		}
+		m_bNew = true;
+	}
+	void *pMap = mmap(nullptr, uiSize, US(PROT_READ) | US(PROT_WRITE), m_bPrivate ? MAP_PRIVATE : MAP_SHARED, m_fd, 0);
+	if (pMap == MAP_FAILED) //NOLINT - complaint in system library
+	{
+		std::cerr << "Could not map " << strFile << '\n';
+		Unmap();
+		return false;
+	}
+	m_data = {static_cast<uint8_t*>(pMap), uiSize};
+	return true;
+}
+
+void MappedFile::Sync(size_t uiOffset, size_t uiLen, bool bAsync)
+{
+	if (m_data.empty() || m_bPrivate || uiOffset >= m_data.size())
+	{
+		return;
+	}
+	// msync wants a page-aligned start.
+	static const size_t uiPage = sysconf(_SC_PAGESIZE);
+	size_t uiStart = uiOffset - (uiOffset % uiPage);
+	size_t uiEnd = std::min(uiOffset + uiLen, m_data.size());
+	msync(m_data.subspan(uiStart).data(), uiEnd - uiStart, bAsync ? MS_ASYNC : MS_SYNC);
+}
+
+void MappedFile::Unmap()
+{
+	if (!m_data.empty())
+	{
+		munmap(m_data.data(), m_data.size());
+		m_data = {};
+	}
+	if (m_fd != -1)
+	{
+		if (!m_bPrivate)
+		{
+			flock(m_fd, LOCK_UN);
+		}
+		close(m_fd);
+		m_fd = -1;
+	}
+}
@@ -0,0 +1,68 @@
+/*
+	MappedFile.h - A storage file mapped into memory, used as a live backing store.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "gsl-lite.hpp"
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint8_t
+#include <string>      // for string
+
+// Writes to the mapping land in the page cache directly, so they survive a crash of
+// the process and nothing needs writing out at shutdown. A file that is read-only or
+// already in use by another instance is mapped copy-on-write instead: the pages stay
+// shared until this instance writes to them, and changes are not persisted.
+class MappedFile
+{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		// Maps uiSize bytes of strFile, creating or growing the file as needed.
+		bool Map(const std::string &strFile, size_t uiSize);
+
+		// Flushes dirty pages to the file and waits for the write.
+		inline void Sync() { Sync(0, m_data.size()); }
+
+		// Flushes the pages covering uiLen bytes at uiOffset. bAsync only schedules the write.
+		void Sync(size_t uiOffset, size_t uiLen, bool bAsync = false);
+
+		void Unmap();
+
+		inline bool IsMapped() const { return !m_data.empty(); }
+
+		// True if changes are private to this instance (copy-on-write).
+		inline bool IsPrivate() const { return m_bPrivate; }
+
+		// True if the file was created or grown by Map, i.e. the contents are not meaningful yet.
+		inline bool IsNew() const { return m_bNew; }
+
+		inline gsl::span<uint8_t> GetData() { return m_data; }
+
+	private:
+		gsl::span<uint8_t> m_data {};
+		int m_fd = -1;
+		bool m_bPrivate = false;
+		bool m_bNew = false;
+};
@@ -0,0 +1,185 @@
+/*
+	PatternMatcher.cpp - Matches a set of patterns against a byte stream, one line at a time.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PatternMatcher.h"
+#include <cctype>        // for isspace
+#include <queue>         // for queue
+
+static constexpr const char* CAPTURE = "{}";
+
+int PatternMatcher::Add(const std::string &strPattern)
+{
+	Pattern p;
+	p.strText = strPattern;
+	size_t uiPos = 0, uiFound;
+	while ((uiFound = strPattern.find(CAPTURE, uiPos)) != std::string::npos)
+	{
+		p.vLiterals.push_back(strPattern.substr(uiPos, uiFound - uiPos));
+		uiPos = uiFound + 2;
+	}
+	p.vLiterals.push_back(strPattern.substr(uiPos));
+	if (p.vLiterals.size() > 1)
+	{
+		p.bLeadCapture = p.vLiterals.front().empty();
+	}
+	// Adjacent captures can't be told apart.
+	for (size_t i = 1; i + 1 < p.vLiterals.size(); i++)
+	{
+		if (p.vLiterals.at(i).empty())
+		{
+			return -1;
+		}
+	}
+	p.uiAnchor = p.bLeadCapture ? 1 : 0;
+	if (p.uiAnchor >= p.vLiterals.size() || p.vLiterals.at(p.uiAnchor).empty())
+	{
+		return -1;
+	}
+	m_vPatterns.push_back(p);
+	return static_cast<int>(m_vPatterns.size() - 1);
+}
+
+void PatternMatcher::Clear()
+{
+	m_vPatterns.clear();
+	m_vStates.clear();
+	m_vHit.clear();
+	m_vHitOrder.clear();
+	m_uiState = 0;
+}
+
+void PatternMatcher::Compile()
+{
+	// Trie of the anchors, with 0 as "no edge" since nothing transitions back into the root.
+	m_vStates.assign(1, State());
+	for (size_t id = 0; id < m_vPatterns.size(); id++)
+	{
+		uint32_t uiState = 0;
+		for (auto c : m_vPatterns.at(id).vLiterals.at(m_vPatterns.at(id).uiAnchor))
+		{
+			auto &uiNext = m_vStates[uiState].next[static_cast<uint8_t>(c)];
+			if (uiNext == 0)
+			{
+				uiNext = m_vStates.size();
+				m_vStates.emplace_back();
+			}
+			uiState = m_vStates[uiState].next[static_cast<uint8_t>(c)]; // emplace_back may have moved it.
+		}
+		m_vStates[uiState].out.push_back(id);
+	}
+	// Breadth-first, fill in the missing edges from each state's failure state so
+	// Feed() is a single lookup per byte. The root's children fail back to the root.
+	std::vector<uint32_t> vFail(m_vStates.size(), 0);
+	std::queue<uint32_t> qStates;
+	for (auto uiNext : m_vStates[0].next)
+	{
+		if (uiNext != 0)
+		{
+			qStates.push(uiNext);
+		}
+	}
+	while (!qStates.empty())
+	{
+		uint32_t uiState = qStates.front();
+		qStates.pop();
+		auto &vOut = m_vStates[uiState].out;
+		vOut.insert(vOut.end(), m_vStates[vFail[uiState]].out.begin(), m_vStates[vFail[uiState]].out.end());
+		for (size_t c = 0; c < 256; c++)
+		{
+			uint32_t &uiNext = m_vStates[uiState].next[c];
+			if (uiNext != 0)
+			{
+				vFail[uiNext] = m_vStates[vFail[uiState]].next[c];
+				qStates.push(uiNext);
+			}
+			else
+			{
+				uiNext = m_vStates[vFail[uiState]].next[c];
+			}
+		}
+	}
+	m_vHit.assign(m_vPatterns.size(), false);
+	m_vHitOrder.clear();
+	m_uiState = 0;
+}
+
+bool PatternMatcher::Capture(const Pattern &p, const std::string &strLine, std::vector<std::string> &vCaptures)
+{
+	const std::string &strAnchor = p.vLiterals.at(p.uiAnchor);
+	// The anchor may occur more than once, only some of which lead to a full match.
+	for (size_t uiStart = strLine.find(strAnchor); uiStart != std::string::npos; uiStart = strLine.find(strAnchor, uiStart + 1))
+	{
+		vCaptures.clear();
+		if (p.bLeadCapture)
+		{
+			size_t uiToken = uiStart;
+			while (uiToken > 0 && !std::isspace(static_cast<unsigned char>(strLine[uiToken - 1])))
+			{
+				uiToken--;
+			}
+			vCaptures.push_back(strLine.substr(uiToken, uiStart - uiToken));
+		}
+		size_t uiPos = uiStart + strAnchor.size();
+		bool bMatch = true;
+		for (size_t i = p.uiAnchor + 1; i < p.vLiterals.size(); i++)
+		{
+			const std::string &strLit = p.vLiterals.at(i);
+			size_t uiEnd = uiPos;
+			if (strLit.empty()) // Trailing capture, up to whitespace.
+			{
+				while (uiEnd < strLine.size() && !std::isspace(static_cast<unsigned char>(strLine[uiEnd])))
+				{
+					uiEnd++;
+				}
+			}
+			else if ((uiEnd = strLine.find(strLit, uiPos)) == std::string::npos)
+			{
+				bMatch = false;
+				break;
+			}
+			vCaptures.push_back(strLine.substr(uiPos, uiEnd - uiPos));
+			uiPos = uiEnd + strLit.size();
+		}
+		if (bMatch)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+std::vector<PatternMatcher::Match> PatternMatcher::NewLine(const std::string &strLine)
+{
+	std::vector<Match> vResult;
+	for (auto id : m_vHitOrder)
+	{
+		const Pattern &p = m_vPatterns.at(id);
+		Match m {id, {}};
+		if (p.vLiterals.size() == 1 || Capture(p, strLine, m.captures))
+		{
+			vResult.push_back(m);
+		}
+		m_vHit[id] = false;
+	}
+	m_vHitOrder.clear();
+	m_uiState = 0;
+	return vResult;
+}
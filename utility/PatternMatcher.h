@@ -0,0 +1,99 @@
+/*
+	PatternMatcher.h - Matches a set of patterns against a byte stream, one line at a time.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>       // for array
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint32_t
+#include <string>      // for string
+#include <vector>      // for vector
+
+// A pattern is literal text that must appear somewhere in a line, where "{}" stands for
+// a captured field. A field runs up to the literal text that follows it, or is a single
+// whitespace-delimited token at either end of the pattern. E.g. "T:{} /{} B:" on the line
+// "ok T:215.0 /215.0 B:60.0" captures "215.0" and "215.0".
+//
+// The first literal run of every pattern goes into one Aho-Corasick automaton that is
+// advanced a byte at a time, so the per-byte cost doesn't grow with the number of patterns.
+// Only the patterns it hit are checked in full (for captures) once the line is complete.
+class PatternMatcher
+{
+	public:
+		struct Match
+		{
+			size_t id; // Index of the pattern, in the order it was added.
+			std::vector<std::string> captures;
+		};
+
+		// Adds a pattern and returns its index, or -1 if it has no literal text to match.
+		int Add(const std::string &strPattern);
+
+		// Builds the automaton. Must be called after adding patterns and before Feed().
+		void Compile();
+
+		void Clear();
+
+		inline bool IsEmpty() const { return m_vPatterns.empty(); }
+
+		inline const std::string& GetPattern(size_t id) const { return m_vPatterns.at(id).strText; }
+
+		// Advances the automaton. Call NewLine() instead of feeding the line terminator.
+		inline void Feed(char c)
+		{
+			m_uiState = m_vStates[m_uiState].next[static_cast<uint8_t>(c)];
+			for (auto id : m_vStates[m_uiState].out)
+			{
+				if (!m_vHit[id])
+				{
+					m_vHit[id] = true;
+					m_vHitOrder.push_back(id);
+				}
+			}
+		}
+
+		// Returns the patterns that matched the completed line (in the order they were seen)
+		// and resets for the next one. strLine is the text that was fed.
+		std::vector<Match> NewLine(const std::string &strLine);
+
+	private:
+		struct Pattern
+		{
+			std::string strText;
+			std::vector<std::string> vLiterals; // Literal runs, with a capture between each pair.
+			bool bLeadCapture = false;
+			size_t uiAnchor = 0; // Index of the first non-empty literal.
+		};
+
+		struct State
+		{
+			std::array<uint32_t, 256> next {};
+			std::vector<size_t> out;
+		};
+
+		static bool Capture(const Pattern &p, const std::string &strLine, std::vector<std::string> &vCaptures);
+
+		std::vector<Pattern> m_vPatterns;
+		std::vector<State> m_vStates;
+		uint32_t m_uiState = 0;
+		std::vector<bool> m_vHit;
+		std::vector<size_t> m_vHitOrder;
+};
@@ -0,0 +1,74 @@
+/*
+	SPSCRing.h - Lock-free single producer, single consumer ring buffer.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>       // for array
+#include <atomic>      // for atomic, memory_order_acquire, memory_order_release
+#include <cstddef>     // for size_t
+
+// One thread pushes, one other thread pops. Both ends work in batches so the
+// indices are only published once per batch rather than once per element.
+template<typename T, size_t N>
+class SPSCRing
+{
+	static_assert(N > 0 && (N & (N - 1)) == 0, "Ring size must be a power of 2");
+
+	public:
+		// Producer: copies as many of the uiCount items as fit, returns how many did.
+		size_t Push(const T *pItems, size_t uiCount)
+		{
+			size_t uiHead = m_uiHead.load(std::memory_order_relaxed);
+			size_t uiFree = N - (uiHead - m_uiTail.load(std::memory_order_acquire));
+			size_t uiPushed = uiCount < uiFree ? uiCount : uiFree;
+			for (size_t i = 0; i < uiPushed; i++)
+			{
+				m_buffer[(uiHead + i) & (N - 1)] = pItems[i];
+			}
+			m_uiHead.store(uiHead + uiPushed, std::memory_order_release);
+			return uiPushed;
+		}
+
+		// Consumer: calls fcn on everything pushed so far, returns the count.
+		template<typename F>
+		size_t PopAll(F fcn)
+		{
+			size_t uiTail = m_uiTail.load(std::memory_order_relaxed);
+			size_t uiHead = m_uiHead.load(std::memory_order_acquire);
+			for (size_t i = uiTail; i != uiHead; i++)
+			{
+				fcn(m_buffer[i & (N - 1)]);
+			}
+			m_uiTail.store(uiHead, std::memory_order_release);
+			return uiHead - uiTail;
+		}
+
+		inline bool IsEmpty() const
+		{
+			return m_uiHead.load(std::memory_order_acquire) == m_uiTail.load(std::memory_order_acquire);
+		}
+
+	private:
+		std::array<T, N> m_buffer {};
+		// Kept on separate cache lines so the two threads don't contend on them.
+		alignas(64) std::atomic<size_t> m_uiHead {0};
+		alignas(64) std::atomic<size_t> m_uiTail {0};
+};
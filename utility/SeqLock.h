@@ -0,0 +1,84 @@
+/*
+	SeqLock.h - Single writer, multiple reader snapshot of a plain struct.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>       // for array
+#include <atomic>      // for atomic
+#include <cstdint>     // for uint32_t
+#include <cstring>     // for memcpy
+#include <type_traits> // for is_trivially_copyable
+
+// The writer works on its own copy of T and publishes it whole; readers copy out the
+// latest complete one. Neither side ever waits on the other - a reader that overlaps a
+// publish just keeps what it had and tries again next time.
+// The payload is held as atomic words so the overlapping copy isn't a data race.
+template<typename T>
+class SeqLock
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock payload must be trivially copyable");
+
+	public:
+		// Writer only.
+		void Publish(const T &value)
+		{
+			std::array<uint32_t, WORDS> vWords {};
+			std::memcpy(vWords.data(), &value, sizeof(T));
+			uint32_t uiSeq = m_uiSeq.load(std::memory_order_relaxed);
+			m_uiSeq.store(uiSeq + 1, std::memory_order_relaxed); // Odd while writing.
+			for (size_t i = 0; i < WORDS; i++)
+			{
+				// Release so a reader that sees this word also sees the odd sequence above.
+				m_vWords[i].store(vWords[i], std::memory_order_release);
+			}
+			m_uiSeq.store(uiSeq + 2, std::memory_order_release);
+		}
+
+		// Copies the latest frame into value if it is newer than uiGen (initially 0), and
+		// updates uiGen. Returns false, leaving both alone, if there's nothing new or the
+		// writer was mid-publish.
+		bool ReadIfChanged(T &value, uint32_t &uiGen) const
+		{
+			uint32_t uiSeq = m_uiSeq.load(std::memory_order_acquire);
+			if (uiSeq == uiGen || (uiSeq & 1U))
+			{
+				return false;
+			}
+			std::array<uint32_t, WORDS> vWords {};
+			for (size_t i = 0; i < WORDS; i++)
+			{
+				vWords[i] = m_vWords[i].load(std::memory_order_acquire);
+			}
+			if (m_uiSeq.load(std::memory_order_relaxed) != uiSeq)
+			{
+				return false;
+			}
+			std::memcpy(&value, vWords.data(), sizeof(T));
+			uiGen = uiSeq;
+			return true;
+		}
+
+	private:
+		static constexpr size_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1)/sizeof(uint32_t);
+
+		std::atomic<uint32_t> m_uiSeq {0};
+		std::array<std::atomic<uint32_t>, WORDS> m_vWords {};
+};
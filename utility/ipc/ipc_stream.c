@@ -0,0 +1,97 @@
+/*
+	ipc_stream.c - Example producer for the IPC printer's binary batch protocol.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+	Streams moving axes and a blinking bed indicator to a running MK404 IPCPrinter
+	(built with -DENABLE_PIPE=1) for a few seconds.
+
+	Usage: mk404_ipc_stream [fifo], the default being MK404's own /MK404IPC.
+ */
+
+#include "mk404_ipc.h"
+#include <stdio.h>
+#include <time.h>
+
+/* Triangle wave per motor, offset by index. */
+static int32_t motor_pos(int motor, uint32_t step)
+{
+	uint32_t phase = (step * (uint32_t)(motor + 1)) % 2000U;
+	return phase < 1000U ? (int32_t)phase : (int32_t)(2000U - phase);
+}
+
+static uint32_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((ts.tv_sec * 1000000U) + (ts.tv_nsec / 1000));
+}
+
+static int run_pipe(const char *path)
+{
+	static const char axes[] = "XYZE";
+	static const struct timespec ts_period = {0, 1000000};
+	mk404_ipc_client_t c;
+	char msg[8];
+	uint32_t step;
+	int m;
+
+	printf("Waiting for MK404 on %s...\n", path);
+	if (mk404_ipc_open_pipe(&c, path) != 0)
+	{
+		perror(path);
+		return 1;
+	}
+	mk404_ipc_set_max_rate(&c, 500);
+	mk404_ipc_send_raw(&c, "C", 1);
+	for (m = 0; m < 4; m++)
+	{
+		mk404_ipc_send_raw(&c, "AM", 2);
+		snprintf(msg, sizeof(msg), "M%cL%c", '0' + m, axes[m]);
+		mk404_ipc_send_raw(&c, msg, 4);
+		snprintf(msg, sizeof(msg), "M%cE1", '0' + m);
+		mk404_ipc_send_raw(&c, msg, 4);
+	}
+	mk404_ipc_send_raw(&c, "AIB", 3);
+
+	for (step = 0; step < 5000; step++)
+	{
+		for (m = 0; m < 4; m++)
+		{
+			mk404_ipc_sample(&c, now_us(), MK404_IPC_MOTOR(m), motor_pos(m, step) * 10);
+		}
+		mk404_ipc_sample(&c, now_us(), MK404_IPC_INDICATOR(0), ((step >> 8U) & 1U) ? 255 : 0);
+		nanosleep(&ts_period, NULL);
+	}
+	mk404_ipc_close(&c, now_us());
+	printf("Sent %u frames, %u samples (%u coalesced), %u write errors.\n",
+		c.frames_sent, c.samples_sent, c.samples_coalesced, c.write_errors);
+	return c.write_errors ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 2)
+	{
+		printf("Usage: %s [fifo]\n", argv[0]);
+		return 2;
+	}
+	return run_pipe(argc == 2 ? argv[1] : "/MK404IPC");
+}
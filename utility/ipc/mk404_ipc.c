@@ -0,0 +1,151 @@
+/*
+	mk404_ipc.c - Small C client for streaming samples to MK404's IPC printer.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mk404_ipc.h"
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/* The pipe transport prefixes each message with its length. The whole thing is
+   written at once, and is under PIPE_BUF, so it can't be interleaved with another writer's. */
+static int write_pipe(void *ctx, const uint8_t *data, size_t len)
+{
+	uint8_t buf[MK404_IPC_MAX_FRAME + 1];
+	int fd = *(int*)ctx;
+	if (len > MK404_IPC_MAX_FRAME)
+	{
+		return -1;
+	}
+	buf[0] = (uint8_t)len;
+	memcpy(buf + 1, data, len);
+	return write(fd, buf, len + 1) == (ssize_t)(len + 1) ? 0 : -1;
+}
+
+static int send_pending(mk404_ipc_client_t *c)
+{
+	uint8_t frame[MK404_IPC_MAX_FRAME];
+	size_t len;
+	uint8_t i;
+	int ret;
+	if (c->count == 0)
+	{
+		return 0;
+	}
+	len = mk404_ipc_encode(frame, c->seq++, c->pending, c->count);
+	ret = c->write(c->ctx, frame, len);
+	if (ret == 0)
+	{
+		c->frames_sent++;
+		c->samples_sent += c->count;
+	}
+	else
+	{
+		c->write_errors++;
+	}
+	for (i = 0; i < c->count; i++)
+	{
+		c->slot[c->pending[i].channel] = 0;
+	}
+	c->count = 0;
+	return ret;
+}
+
+void mk404_ipc_init(mk404_ipc_client_t *c, mk404_ipc_write_fn write, void *ctx)
+{
+	memset(c, 0, sizeof(*c));
+	c->write = write;
+	c->ctx = ctx;
+	c->fd = -1;
+}
+
+int mk404_ipc_open_pipe(mk404_ipc_client_t *c, const char *path)
+{
+	mk404_ipc_init(c, write_pipe, NULL);
+	c->fd = open(path, O_WRONLY);
+	c->ctx = &c->fd;
+	return c->fd < 0 ? -1 : 0;
+}
+
+void mk404_ipc_close(mk404_ipc_client_t *c, uint32_t now_us)
+{
+	mk404_ipc_flush(c, now_us, 1);
+	if (c->fd >= 0)
+	{
+		close(c->fd);
+		c->fd = -1;
+	}
+}
+
+void mk404_ipc_set_max_rate(mk404_ipc_client_t *c, uint32_t frames_per_sec)
+{
+	c->min_interval_us = frames_per_sec ? 1000000U / frames_per_sec : 0;
+}
+
+int mk404_ipc_send_raw(mk404_ipc_client_t *c, const void *data, size_t len)
+{
+	int ret = send_pending(c);
+	if (c->write(c->ctx, (const uint8_t*)data, len) != 0)
+	{
+		c->write_errors++;
+		return -1;
+	}
+	return ret;
+}
+
+int mk404_ipc_sample(mk404_ipc_client_t *c, uint32_t time_us, uint8_t channel, int32_t value)
+{
+	mk404_ipc_sample_t *s;
+	if (c->slot[channel])
+	{
+		s = &c->pending[c->slot[channel] - 1];
+		c->samples_coalesced++;
+	}
+	else
+	{
+		if (c->count == 0)
+		{
+			c->window_start_us = time_us;
+		}
+		s = &c->pending[c->count++];
+		c->slot[channel] = c->count;
+	}
+	s->time_us = time_us;
+	s->channel = channel;
+	s->value = value;
+	if (c->count == MK404_IPC_MAX_SAMPLES)
+	{
+		return send_pending(c);
+	}
+	return mk404_ipc_flush(c, time_us, 0);
+}
+
+int mk404_ipc_flush(mk404_ipc_client_t *c, uint32_t now_us, int force)
+{
+	if (c->count == 0)
+	{
+		return 0;
+	}
+	if (force || (uint32_t)(now_us - c->window_start_us) >= c->min_interval_us)
+	{
+		return send_pending(c);
+	}
+	return 0;
+}
@@ -0,0 +1,99 @@
+/*
+	mk404_ipc.h - Small C client for streaming samples to MK404's IPC printer.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+	Typical use:
+
+		mk404_ipc_client_t c;
+		mk404_ipc_open_pipe(&c, "/MK404IPC");
+		mk404_ipc_send_raw(&c, "AM", 2);            // ASCII setup directives as before
+		mk404_ipc_set_max_rate(&c, 1000);           // at most 1000 frames/s
+		...
+		mk404_ipc_sample(&c, now_us, MK404_IPC_MOTOR(0), steps);
+		...
+		mk404_ipc_flush(&c, now_us, 1);
+		mk404_ipc_close(&c, now_us);
+
+	Samples are held for at least 1/rate seconds before being sent. Within that window a newer
+	sample for a channel replaces the pending one, so a fast producer costs no more than a slow
+	one. A frame that fills up is sent straight away.
+ */
+
+#ifndef MK404_IPC_H
+#define MK404_IPC_H
+
+#include "mk404_ipc_proto.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Sends one frame. Returns 0 on success. */
+typedef int (*mk404_ipc_write_fn)(void *ctx, const uint8_t *data, size_t len);
+
+typedef struct
+{
+	mk404_ipc_write_fn write;
+	void *ctx;
+	int fd; /* Set by mk404_ipc_open_pipe, -1 otherwise. */
+
+	uint16_t seq;
+	uint32_t min_interval_us;
+	uint32_t window_start_us;
+
+	mk404_ipc_sample_t pending[MK404_IPC_MAX_SAMPLES];
+	uint8_t count;
+	uint8_t slot[256]; /* Per channel, 1 + its index in pending, or 0. */
+
+	/* Statistics */
+	uint32_t frames_sent;
+	uint32_t samples_sent;
+	uint32_t samples_coalesced;
+	uint32_t write_errors;
+} mk404_ipc_client_t;
+
+/* Uses a caller-supplied transport, e.g. a message queue or shared memory. */
+void mk404_ipc_init(mk404_ipc_client_t *c, mk404_ipc_write_fn write, void *ctx);
+
+/* Opens MK404's FIFO (created by MK404 when built with -DENABLE_PIPE=1). Blocks until it is running.
+   Returns 0 on success. */
+int mk404_ipc_open_pipe(mk404_ipc_client_t *c, const char *path);
+
+/* Flushes anything pending and closes the pipe, if open. */
+void mk404_ipc_close(mk404_ipc_client_t *c, uint32_t now_us);
+
+/* 0 (the default) sends each sample as soon as it is added. */
+void mk404_ipc_set_max_rate(mk404_ipc_client_t *c, uint32_t frames_per_sec);
+
+/* Sends an ASCII directive (or anything else) as-is, after flushing pending samples. */
+int mk404_ipc_send_raw(mk404_ipc_client_t *c, const void *data, size_t len);
+
+/* Queues a sample, sending the pending frame if it is full or the rate window has passed. */
+int mk404_ipc_sample(mk404_ipc_client_t *c, uint32_t time_us, uint8_t channel, int32_t value);
+
+/* Sends the pending frame if the rate window has passed, or regardless if force is set. */
+int mk404_ipc_flush(mk404_ipc_client_t *c, uint32_t now_us, int force);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MK404_IPC_H */
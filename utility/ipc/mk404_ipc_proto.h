@@ -0,0 +1,157 @@
+/*
+	mk404_ipc_proto.h - Binary batch format for the IPC printer, shared by MK404 and clients.
+
+	Copyright 2020 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of MK404.
+
+	MK404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	MK404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with MK404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+	Plain C so it can be used by external producers as-is.
+
+	A batch frame sits alongside the ASCII directives (AM, M0P..., etc.) on the same channel
+	and is told apart by its first byte. All multi-byte fields are little-endian:
+
+		0      'B'
+		1      version (MK404_IPC_VERSION)
+		2..3   sequence number, incremented per frame, wraps
+		4      sample count, at most MK404_IPC_MAX_SAMPLES
+		5..    samples, 9 bytes each:
+				0..3   timestamp in microseconds (producer's clock, wraps)
+				4      channel - 0..127 is the motor of that index (value is its step position),
+						128..255 is indicator (channel-128) (value is its brightness)
+				5..8   value, signed
+
+	The receiver detects lost frames from gaps in the sequence and ignores any sample that is
+	older than one already applied to the same channel.
+ */
+
+#ifndef MK404_IPC_PROTO_H
+#define MK404_IPC_PROTO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MK404_IPC_BATCH 'B'
+#define MK404_IPC_VERSION 1
+
+#define MK404_IPC_HEADER_SIZE 5
+#define MK404_IPC_SAMPLE_SIZE 9
+/* Largest frame that still fits the pipe transport's one-byte length prefix. */
+#define MK404_IPC_MAX_FRAME 255
+#define MK404_IPC_MAX_SAMPLES ((MK404_IPC_MAX_FRAME - MK404_IPC_HEADER_SIZE)/MK404_IPC_SAMPLE_SIZE)
+
+#define MK404_IPC_MOTOR(index) ((uint8_t)(index))
+#define MK404_IPC_INDICATOR(index) ((uint8_t)(128U + (index)))
+#define MK404_IPC_IS_INDICATOR(channel) ((channel) >= 128U)
+
+typedef struct
+{
+	uint32_t time_us;
+	uint8_t channel;
+	int32_t value;
+} mk404_ipc_sample_t;
+
+typedef struct
+{
+	uint8_t version;
+	uint16_t seq;
+	uint8_t count;
+} mk404_ipc_header_t;
+
+static inline void mk404_ipc_put32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8U);
+	p[2] = (uint8_t)(v >> 16U);
+	p[3] = (uint8_t)(v >> 24U);
+}
+
+static inline uint32_t mk404_ipc_get32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8U) | ((uint32_t)p[2] << 16U) | ((uint32_t)p[3] << 24U);
+}
+
+/* Writes a frame of count samples into buf (at least MK404_IPC_MAX_FRAME bytes), returns its size. */
+static inline size_t mk404_ipc_encode(uint8_t *buf, uint16_t seq, const mk404_ipc_sample_t *samples, uint8_t count)
+{
+	size_t i;
+	uint8_t *p = buf + MK404_IPC_HEADER_SIZE;
+	if (count > MK404_IPC_MAX_SAMPLES)
+	{
+		count = MK404_IPC_MAX_SAMPLES;
+	}
+	buf[0] = MK404_IPC_BATCH;
+	buf[1] = MK404_IPC_VERSION;
+	buf[2] = (uint8_t)seq;
+	buf[3] = (uint8_t)(seq >> 8U);
+	buf[4] = count;
+	for (i = 0; i < count; i++, p += MK404_IPC_SAMPLE_SIZE)
+	{
+		mk404_ipc_put32(p, samples[i].time_us);
+		p[4] = samples[i].channel;
+		mk404_ipc_put32(p + 5, (uint32_t)samples[i].value);
+	}
+	return (size_t)(p - buf);
+}
+
+/* Returns 0 and fills hdr if buf holds a complete frame of a version we understand. */
+static inline int mk404_ipc_decode_header(const uint8_t *buf, size_t len, mk404_ipc_header_t *hdr)
+{
+	if (len < MK404_IPC_HEADER_SIZE || buf[0] != MK404_IPC_BATCH)
+	{
+		return -1;
+	}
+	hdr->version = buf[1];
+	hdr->seq = (uint16_t)(buf[2] | (buf[3] << 8U));
+	hdr->count = buf[4];
+	if (hdr->version != MK404_IPC_VERSION)
+	{
+		return -2;
+	}
+	if (hdr->count > MK404_IPC_MAX_SAMPLES || len < MK404_IPC_HEADER_SIZE + ((size_t)hdr->count * MK404_IPC_SAMPLE_SIZE))
+	{
+		return -3;
+	}
+	return 0;
+}
+
+/* Sample i of a frame that passed mk404_ipc_decode_header. */
+static inline mk404_ipc_sample_t mk404_ipc_decode_sample(const uint8_t *buf, uint8_t i)
+{
+	mk404_ipc_sample_t s;
+	const uint8_t *p = buf + MK404_IPC_HEADER_SIZE + ((size_t)i * MK404_IPC_SAMPLE_SIZE);
+	s.time_us = mk404_ipc_get32(p);
+	s.channel = p[4];
+	s.value = (int32_t)mk404_ipc_get32(p + 5);
+	return s;
+}
+
+/* Frames lost between the expected and received sequence numbers. Anything over
+   half the sequence space is taken to be a duplicate or reordered frame instead. */
+static inline uint16_t mk404_ipc_seq_lost(uint16_t expected, uint16_t received)
+{
+	uint16_t gap = (uint16_t)(received - expected);
+	return gap < 0x8000U ? gap : 0;
+}
+
+/* True if sample time a is before b, allowing for wraparound. */
+static inline int mk404_ipc_time_before(uint32_t a, uint32_t b)
+{
+	return (int32_t)(a - b) < 0;
+}
+
+#endif /* MK404_IPC_PROTO_H */